@@ -19,9 +19,33 @@
 //=============================================================================
 #ifndef _POSUTILS_H_
 #define _POSUTILS_H_
+
+/**** Includes ***************************************************************/
+/* Included outside the C linkage block, some of the headers carry C++ templates */
+#include <pthread.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <signal.h>
+#include "pudefs.h"
+#include "putimer.h"
+#include "purwlock.h"
+#include "puseqlock.h"
+#include "pufutex.h"
+#include "pubarrier.h"
+#include "puqueue.h"
+#include "pudelayqueue.h"
+#include "puebr.h"
+#include "puhazard.h"
+#include "puratelimit.h"
+#include "puprofiler.h"
+#include "puperf.h"
+#include "putrace.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
+PU_API_BEGIN
 
 /**
  * \file     posutils.h
@@ -50,13 +74,23 @@ extern "C" {
  * Some simple Posix utilities. Interface for:
  * - Thread creation
  * - Mutex creation
+ * - Reader-writer lock creation
+ * - Semaphores and event counts, see pufutex.h
+ * - Barriers, latches and thread groups, see pubarrier.h
+ * - Lock-free bounded queues, see puqueue.h
+ * - Delay queues, see pudelayqueue.h
+ * - Epoch based memory reclamation, see puebr.h
+ * - Hazard pointers, see puhazard.h
+ * - Token bucket rate limiting, see puratelimit.h
+ * - Sampling profiler with folded stack output, see puprofiler.h
+ * - Per-thread performance counters, see puperf.h
+ * - Event tracing with Chrome trace output, see putrace.h
+ * - Futures, promises and executors, see pufuture.h
+ * - C++20 coroutine awaitables for timers and executors, see pucoro.h
+ * - I/O reactor on io_uring or epoll, see pureactor.h
+ * - Process-shared synchronisation, see pushm.h
  */
 
-/**** Includes ***************************************************************/
-#include <pthread.h>
-#include <errno.h>
-#include "putimer.h"
-
 /**** Definitions ************************************************************/
 
 /**
@@ -112,6 +146,16 @@ extern "C" {
  * These are used in scenarios where it is important to know where and when a deadlock occurs. A macro is provided
  * trap deadlocks (\ref PU_MUTEX_LOCK_ERROR). This macro throws a fatal log if a deadlock is detected.
  *
+ * \section pmtx_sect_3 Instrumented mutexes
+ * Any mutex type may be created with attributes (\ref pu_mutex_create_attr). The
+ * \ref PU_MUTEX_ATTR_PROFILE attribute records, per lock, the number of acquisitions, the number
+ * of contended acquisitions, the total and maximum wait time and the maximum hold time.
+ * Locks are labelled with their creation site, and \ref pu_mutex_profile_report lists the worst
+ * offenders. Instrumented locks must be locked and unlocked through \ref pu_mutex_lock and
+ * \ref pu_mutex_unlock. While no instrumented mutex exists (and the tracer, see putrace.h, is
+ * stopped) these cost a couple of loads and one branch on top of the plain pthread call, so the
+ * hooks can stay in production code.
+ *
  * \section pmtx_sect_4 Mutex usage
  * The factory simply creates a standard Posix pthread mutex with some constraints. All the
  * mutex calls may be used as normal, i.e.:
@@ -120,6 +164,35 @@ extern "C" {
  * - \c pthread_mutex_trylock( pthread_mutex_t* )
  * .
  *
+ * \section pmtx_sect_5 Lock order checking
+ * The \ref PU_MUTEX_ATTR_LOCKDEP attribute adds the mutex to a lock order ("lockdep" style)
+ * checker. Every label is a lock class, so all the mutexes created at one site share a class.
+ * Each thread tracks the locks it holds. Acquiring class B while holding class A records the
+ * dependency A->B in a global, lock-free graph. When a new dependency closes a cycle (e.g. A->B
+ * and B->A) it is reported straight away, the first time the order is seen, whether or not the
+ * threads ever actually deadlock. Re-locking a mutex the thread already holds is reported too.
+ * This finds far more than an error checking mutex, and it works with fast mutexes.
+ *
+ * \section pmtx_sect_6 Priority inheritance and robust mutexes
+ * A \ref PU_MUTEX_TYPE_PRIO_INHERIT mutex boosts the owner to the priority of the highest priority
+ * waiter, which prevents priority inversion between real-time and normal threads. Note that
+ * a contended PI mutex always goes through the kernel (\c FUTEX_LOCK_PI), so it is noticeably
+ * slower than a fast mutex under contention. Only use it where RT threads share a lock.
+ *
+ * A \ref PU_MUTEX_TYPE_ROBUST mutex survives the death of its owner. The next locker gets
+ * \c EOWNERDEAD and must repair the protected state, then mark the mutex consistent. Use
+ * \ref pu_mutex_lock_robust, which does this with a caller supplied recovery function.
+ *
+ * \section pmtx_sect_7 Spinlocks
+ * \ref pu_spinlock_t is for critical sections that are a handful of instructions long, e.g. a
+ * counter bump or a list splice. It never sleeps in the kernel, so it must \b never be held across
+ * anything that can block. It is a test-and-test-and-set lock: the waiters spin on a plain read,
+ * which stays in their own cache, and only retry the atomic exchange when the lock looks free.
+ * Between reads they back off exponentially with the CPU \c pause hint. After a configurable
+ * number of rounds at the maximum backoff they also yield the CPU, which matters when the owner
+ * has been preempted. Each lock fills its own cache line, so neighbouring locks do not interfere.
+ * In debug builds the owner is recorded, and recursive locking or unlocking by a non-owner asserts.
+ *
  * \{
  */
 
@@ -135,6 +208,8 @@ typedef enum
 {
     PU_MUTEX_TYPE_FAST,         /*!< Default (timed) fast mutex       */
     PU_MUTEX_TYPE_ERROR,        /*!< Error mutex, to trap deadlocks   */
+    PU_MUTEX_TYPE_PRIO_INHERIT, /*!< Priority inheritance mutex       */
+    PU_MUTEX_TYPE_ROBUST,       /*!< Robust mutex, survives owner death */
     PU_MUTEX_TYPE_ENDDEF        /* Enum terminator                    */
 }   pu_mutex_type;
 
@@ -174,6 +249,217 @@ int pu_mutex_create_type(
     pthread_mutex_t* pMtx,
     pu_mutex_type    enType );
 
+/**
+ * \brief Mutex attribute flags, see \ref pu_mutex_attr_t
+ */
+#define PU_MUTEX_ATTR_PROFILE  (0x00000001)  /*!< Record contention statistics */
+#define PU_MUTEX_ATTR_LOCKDEP  (0x00000002)  /*!< Lock order (deadlock) checking */
+#define PU_MUTEX_ATTR_PSHARED  (0x00000004)  /*!< Process shared, the mutex lives in shared memory */
+
+/* The flags that need a per process instrumentation record */
+#define PU_MUTEX_ATTR_INSTRUMENT (PU_MUTEX_ATTR_PROFILE | PU_MUTEX_ATTR_LOCKDEP)
+
+/**
+ * \brief Expands to a "file:line" string literal for the current source location
+ */
+#define PU_MUTEX_SITE __FILE__ ":" PU_STRINGIFY(__LINE__)
+
+/**
+ * \brief Static initialiser for the attributes, labels the lock with the current source location
+ */
+#define PU_MUTEX_ATTR_INITIALIZER(flags_) { (flags_), PU_MUTEX_SITE }
+
+/**
+ * \brief Optional mutex attributes
+ */
+typedef struct pu_mutex_attr_tag
+{
+    unsigned int uiFlags;   /*!< Combination of PU_MUTEX_ATTR_xxx flags               */
+    const char*  szLabel;   /*!< Persistent label, normally the creation site. May be NULL */
+}   pu_mutex_attr_t;
+
+/**
+ * \brief   Creates (initialises) a mutex of the specified type with additional attributes
+ *
+ * \param[in] pMtx   : Pointer to a valid mutex
+ * \param[in] enType : Mutex type
+ * \param[in] pAttr  : Attributes, NULL is the same as \ref pu_mutex_create_type
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ *
+ * \pre     The mutex pointer is non-null
+ * \post    The mutex is initialised
+ *
+ * \par Description
+ * The label \b MUST be persistent, only the pointer is stored. Use \ref PU_MUTEX_ATTR_INITIALIZER
+ * at the creation site to get a "file:line" label:
+ * \code
+ * pu_mutex_attr_t stAttr = PU_MUTEX_ATTR_INITIALIZER( PU_MUTEX_ATTR_PROFILE );
+ * iResult = pu_mutex_create_attr( &mtxRoutes, PU_MUTEX_TYPE_FAST, &stAttr );
+ * \endcode
+ *
+ * \note
+ * The number of instrumented mutexes is limited (\ref PU_MUTEX_MAX_INSTRUMENTED). Beyond that
+ * the mutex is still created, but it is not instrumented.
+ */
+int pu_mutex_create_attr(
+    pthread_mutex_t*       pMtx,
+    pu_mutex_type          enType,
+    const pu_mutex_attr_t* pAttr );
+
+/**
+ * \brief   Destroys a mutex created by the factory
+ *
+ * \param[in] pMtx : Pointer to a valid mutex
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ *
+ * \par Description
+ * Releases any instrumentation, then destroys the pthread mutex.
+ */
+int pu_mutex_destroy( pthread_mutex_t* pMtx );
+
+/**
+ * \brief   Locks a mutex created by the factory
+ *
+ * \param[in] pMtx : Pointer to a valid mutex
+ * \retval  The \c pthread_mutex_lock() result
+ *
+ * \par Description
+ * Equivalent to \c pthread_mutex_lock(), plus the instrumentation hooks.
+ */
+int pu_mutex_lock( pthread_mutex_t* pMtx );
+
+/**
+ * \brief   Unlocks a mutex created by the factory
+ *
+ * \param[in] pMtx : Pointer to a valid mutex
+ * \retval  The \c pthread_mutex_unlock() result
+ */
+int pu_mutex_unlock( pthread_mutex_t* pMtx );
+
+/**
+ * \brief   Robust mutex recovery function
+ *
+ * \param[in] pMtx : The mutex, held by the caller
+ * \param[in] pArg : Recovery argument
+ * \retval  0 if the protected state was repaired
+ * \retval  Non-zero if the state cannot be repaired
+ */
+typedef int (*pu_mutex_recover_fct_t)(
+    pthread_mutex_t* pMtx,
+    void*            pArg );
+
+/**
+ * \brief   Locks a robust mutex, and recovers it if the previous owner died
+ *
+ * \param[in] pMtx       : Pointer to a valid \ref PU_MUTEX_TYPE_ROBUST mutex
+ * \param[in] fctRecover : Recovery function, may be NULL if there is nothing to repair
+ * \param[in] pArg       : Recovery argument
+ * \retval  0 the mutex is held, and consistent
+ * \retval  ENOTRECOVERABLE the state could not be repaired, the mutex is permanently unusable
+ * \retval  Other \c pthread_mutex_lock() errors
+ *
+ * \par Description
+ * If the lock returns \c EOWNERDEAD the recovery function is called with the mutex held. If it
+ * succeeds the mutex is marked consistent (\c pthread_mutex_consistent()) and the call returns 0
+ * as if nothing happened. If it fails the mutex is released without being made consistent, and
+ * every later lock attempt returns \c ENOTRECOVERABLE.
+ */
+int pu_mutex_lock_robust(
+    pthread_mutex_t*       pMtx,
+    pu_mutex_recover_fct_t fctRecover,
+    void*                  pArg );
+
+/**
+ * \brief Maximum number of instrumented mutexes that can exist at the same time
+ */
+#define PU_MUTEX_MAX_INSTRUMENTED (256)
+
+/**
+ * \brief Contention statistics for one instrumented mutex
+ */
+typedef struct pu_mutex_stats_tag
+{
+    const char*            szLabel;          /*!< Creation site label          */
+    const pthread_mutex_t* pMtx;             /*!< The mutex                    */
+    uint64_t               uiAcquisitions;   /*!< Successful lock calls        */
+    uint64_t               uiContended;      /*!< Lock calls that had to wait  */
+    uint64_t               uiWaitTotalNs;    /*!< Total time spent waiting     */
+    uint64_t               uiWaitMaxNs;      /*!< Longest single wait          */
+    uint64_t               uiHoldMaxNs;      /*!< Longest time the lock was held */
+}   pu_mutex_stats_t;
+
+/**
+ * \brief   Reports the most contended instrumented mutexes
+ *
+ * \param[out] pStats : Array to fill
+ * \param[in]  uiMax  : Number of entries in the array
+ * \retval  Number of entries filled
+ *
+ * \par Description
+ * The entries are sorted worst first, i.e. by total wait time, then by contended acquisitions.
+ * The values are sampled without stopping the lock users, so each one is accurate, but the
+ * set as a whole is not an atomic snapshot.
+ */
+size_t pu_mutex_profile_report(
+    pu_mutex_stats_t* pStats,
+    size_t            uiMax );
+
+/**
+ * \brief   Prints the most contended instrumented mutexes
+ *
+ * \param[in] pFile : Output stream, e.g. stderr
+ * \param[in] uiTop : Maximum number of locks to list
+ */
+void pu_mutex_profile_print(
+    FILE*  pFile,
+    size_t uiTop );
+
+/**
+ * \brief   Clears the statistics of all the instrumented mutexes
+ */
+void pu_mutex_profile_reset( void );
+
+/**
+ * \brief Maximum number of lock classes (distinct labels) tracked by the lock order checker
+ */
+#define PU_LOCKDEP_MAX_CLASSES (128)
+
+/**
+ * \brief Maximum number of checked locks a thread may hold at the same time
+ */
+#define PU_LOCKDEP_MAX_DEPTH   (16)
+
+/**
+ * \brief   Lock order violation callback
+ *
+ * \param[in] szHeld     : Class (label) of the lock already held
+ * \param[in] szAcquired : Class (label) of the lock being acquired
+ * \param[in] szReason   : Short description of the problem
+ *
+ * \par Description
+ * Invoked in the context of the thread that acquires the lock, before it blocks.
+ */
+typedef void (*pu_lockdep_report_fct_t)(
+    const char* szHeld,
+    const char* szAcquired,
+    const char* szReason );
+
+/**
+ * \brief   Replaces the lock order violation callback
+ *
+ * \param[in] fctReport : New callback, NULL restores the default (print to stderr)
+ */
+void pu_lockdep_set_report( pu_lockdep_report_fct_t fctReport );
+
+/**
+ * \brief   Number of lock order violations reported so far
+ *
+ * \retval  Violation count
+ */
+size_t pu_lockdep_violations( void );
+
 /**
  * \param pMtx: pointer to a mutex
  *
@@ -183,7 +469,7 @@ int pu_mutex_create_type(
  * \note
  * \b ONLY for use with the \ref PU_MUTEX_TYPE_ERROR mutex type
  */
-#define PU_MUTEX_LOCK_ERROR(pMtx) {if (EDEADLK == pthread_mutex_lock( pMtx )) {LOG_FATAL( "MUTEX DEADLOCK (0x%zu)\n", (size_t)(pMtx) );}}
+#define PU_MUTEX_LOCK_ERROR(pMtx) {if (EDEADLK == pu_mutex_lock( pMtx )) {LOG_FATAL( "MUTEX DEADLOCK (0x%zx)\n", (size_t)(pMtx) );}}
 
 /**
  * \param pMtx: pointer to a mutex
@@ -197,7 +483,107 @@ int pu_mutex_create_type(
  * \note
  * \b ONLY for use with the \ref PU_MUTEX_TYPE_ERROR mutex type
  */
-#define PU_MUTEX_UNLOCK_ERROR(pMtx) {if (EPERM == pthread_mutex_unlock( pMtx )) {LOG_FATAL("CANT UNLOCK MTX, NOT OWNER (0x%08x)\n", (size_t)(pMtx) );}}
+#define PU_MUTEX_UNLOCK_ERROR(pMtx) {if (EPERM == pu_mutex_unlock( pMtx )) {LOG_FATAL("CANT UNLOCK MTX, NOT OWNER (0x%zx)\n", (size_t)(pMtx) );}}
+
+/**
+ * Default number of maximum backoff rounds before a spinlock waiter starts to yield
+ */
+#define PU_SPINLOCK_YIELD_DEFAULT (16)
+
+/**
+ * \brief Spinlock, padded to a full cache line
+ *
+ * \note
+ * Treat the contents as private, the structure is exposed so that the caller can provide the storage
+ */
+typedef struct PU_CACHELINE_ALIGNED pu_spinlock_tag
+{
+    unsigned int uiLocked;       /* Non-zero while held                          */
+    unsigned int uiYieldAfter;   /* Backoff rounds before yielding, 0 for never  */
+    int          iOwner;         /* Owner thread ID, debug builds only           */
+}   pu_spinlock_t;
+
+/**
+ * Static initialiser, with the default yield threshold
+ */
+#define PU_SPINLOCK_INITIALIZER { 0, PU_SPINLOCK_YIELD_DEFAULT, 0 }
+
+/**
+ * \brief   Creates (initialises) a spinlock
+ *
+ * \param[in] pLock        : Pointer to a valid spinlock
+ * \param[in] uiYieldAfter : Backoff rounds before yielding, 0 to never yield
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ *
+ * \par Description
+ * Only disable yielding if every thread that takes the lock has a dedicated CPU.
+ */
+int pu_spinlock_create(
+    pu_spinlock_t* pLock,
+    unsigned int   uiYieldAfter );
+
+/**
+ * \brief   Contended path of \ref pu_spinlock_lock, do not call directly
+ * \param[in] pLock : Pointer to a valid spinlock
+ */
+void pu_spinlock_lock_slow( pu_spinlock_t* pLock );
+
+/**
+ * \brief   Debug owner tracking, do not call directly
+ * \param[in] pLock : Pointer to a valid spinlock
+ */
+void pu_spinlock_debug_acquired( pu_spinlock_t* pLock );
+void pu_spinlock_debug_releasing( pu_spinlock_t* pLock );
+
+/**
+ * \brief   Acquires a spinlock
+ * \param[in] pLock : Pointer to a valid spinlock
+ *
+ * \par Description
+ * The uncontended case is a single atomic exchange, inlined.
+ */
+static inline void pu_spinlock_lock( pu_spinlock_t* pLock )
+{
+    if (__builtin_expect( 0 != __atomic_exchange_n( &(pLock->uiLocked), 1, __ATOMIC_ACQUIRE ), 0 ))
+    {
+        pu_spinlock_lock_slow( pLock );
+    }
+#if !defined(NDEBUG)
+    pu_spinlock_debug_acquired( pLock );
+#endif
+}
+
+/**
+ * \brief   Tries to acquire a spinlock, never spins
+ * \param[in] pLock : Pointer to a valid spinlock
+ * \retval  0 the lock is held
+ * \retval  EBUSY the lock is held by another thread
+ */
+static inline int pu_spinlock_trylock( pu_spinlock_t* pLock )
+{
+    if ((0 != __atomic_load_n( &(pLock->uiLocked), __ATOMIC_RELAXED )) ||
+        (0 != __atomic_exchange_n( &(pLock->uiLocked), 1, __ATOMIC_ACQUIRE )))
+    {
+        return (EBUSY);
+    }
+#if !defined(NDEBUG)
+    pu_spinlock_debug_acquired( pLock );
+#endif
+    return (0);
+}
+
+/**
+ * \brief   Releases a spinlock
+ * \param[in] pLock : Pointer to a spinlock held by the caller
+ */
+static inline void pu_spinlock_unlock( pu_spinlock_t* pLock )
+{
+#if !defined(NDEBUG)
+    pu_spinlock_debug_releasing( pLock );
+#endif
+    __atomic_store_n( &(pLock->uiLocked), 0, __ATOMIC_RELEASE );
+}
 
 /**
  * \}
@@ -226,6 +612,12 @@ int pu_mutex_create_type(
  * they are added to the list, as they exit they are moved from the list. This list can
  * iterated through. This allows for things like debug and graceful shutdown.
  *
+ * \par Hang detection
+ * A thread created by the factory can declare a heartbeat budget with \ref pu_thread_watch, and
+ * then call \ref pu_thread_heartbeat whenever it makes progress. The monitor
+ * (\ref pu_thread_monitor_start) is a periodic timer that reports every watched thread whose
+ * heartbeat has not moved for longer than its budget.
+ *
  * \{
  */
 
@@ -342,10 +734,185 @@ int pu_thread_init( void );
  */
 int pu_thread_exit( void );
 
+/* Forward declaration */
+typedef struct pu_thread_group_tag pu_thread_group_t;
+
+/**
+ * \brief   Entry point of a thread group member
+ *
+ * \param[in] pGroup  : The group, for \ref pu_thread_group_barrier
+ * \param[in] uiIndex : Index of this member, 0 .. (number of threads - 1)
+ * \param[in] pArg    : Argument passed to \ref pu_thread_group_create
+ */
+typedef void (*pu_thread_group_fct_t)(
+    pu_thread_group_t* pGroup,
+    size_t             uiIndex,
+    void*              pArg );
+
+/**
+ * \brief A group of threads sharing a phase barrier
+ *
+ * \note
+ * Treat the contents as private, the structure is exposed so that the caller can provide the storage
+ */
+struct pu_thread_group_tag
+{
+    pu_barrier_t          barPhase;    /* Shared by all the members                 */
+    pu_latch_t            latStart;    /* Holds the members until all are created   */
+    int                   bAbort;      /* Set if the group could not be created     */
+    size_t                uiThreads;   /* Number of members                         */
+    pthread_t*            pThreads;    /* Member thread IDs                         */
+    void*                 pMembers;    /* Per member start records                  */
+    pu_thread_group_fct_t fctMain;     /* Member entry point                        */
+    void*                 pArg;        /* Member argument                           */
+};
+
+/**
+ * \brief   Creates a group of threads that share a barrier
+ *
+ * \param[in] pGroup      : Pointer to a valid group
+ * \param[in] uiThreads   : Number of threads
+ * \param[in] fctMain     : Member entry point
+ * \param[in] pArg        : Member argument
+ * \param[in] uiStackSize : Stack size of every member
+ * \param[in] szName      : Thread name, shared by the members, persistent
+ * \retval  0 for success
+ * \retval  Non-zero for failure, no member has run
+ *
+ * \par Description
+ * Every member is created with \ref pu_thread_create. The members are held until they have all
+ * been created, so either all of them run or (on failure) none of them do, and the barrier never
+ * waits for a thread that does not exist.
+ * \code
+ * static void solver( pu_thread_group_t* pGroup, size_t uiIndex, void* pArg ) {
+ *     for (int iStep = 0; iStep < STEPS; iStep++) {
+ *         compute_slice( uiIndex, iStep );
+ *         pu_thread_group_barrier( pGroup );
+ *     }
+ * }
+ * pu_thread_group_t stGroup;
+ * pu_thread_group_create( &stGroup, 8, solver, NULL, 0, "solver" );
+ * pu_thread_group_join( &stGroup );
+ * \endcode
+ */
+int pu_thread_group_create(
+    pu_thread_group_t*    pGroup,
+    size_t                uiThreads,
+    pu_thread_group_fct_t fctMain,
+    void*                 pArg,
+    size_t                uiStackSize,
+    const char*           szName );
+
+/**
+ * \brief   Waits at the group barrier, called by a member
+ *
+ * \param[in] pGroup : Pointer to a valid group
+ * \retval  \ref PU_BARRIER_SERIAL_THREAD for one member per phase, 0 for the others
+ */
+int pu_thread_group_barrier( pu_thread_group_t* pGroup );
+
+/**
+ * \brief   Waits for all the members to exit, and releases the group
+ *
+ * \param[in] pGroup : Pointer to a valid group
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ */
+int pu_thread_group_join( pu_thread_group_t* pGroup );
+
+/**
+ * \brief Monitor flag: send the hung thread \ref PU_THREAD_BACKTRACE_SIGNAL, which writes its backtrace to stderr
+ */
+#define PU_THREAD_MONITOR_BACKTRACE (0x00000001)
+
+/**
+ * \brief The signal used for \ref PU_THREAD_MONITOR_BACKTRACE, may be overridden at build time
+ */
+#if !defined(PU_THREAD_BACKTRACE_SIGNAL)
+    #define PU_THREAD_BACKTRACE_SIGNAL (SIGRTMIN + 1)
+#endif
+
+/**
+ * \brief   Hang report, called on the timer thread once per stall
+ *
+ * \param[in] szName      : Thread name
+ * \param[in] iTid        : Linux thread ID
+ * \param[in] uiStalledMs : Time since the heartbeat last moved
+ */
+typedef void (*pu_thread_hang_fct_t)(
+    const char* szName,
+    int         iTid,
+    size_t      uiStalledMs );
+
+/**
+ * \brief   Records progress of the calling thread
+ *
+ * \par Description
+ * One relaxed store to the thread's heartbeat word, the clock is not read. Does nothing in a
+ * thread that was not created by \ref pu_thread_create.
+ */
+void pu_thread_heartbeat( void );
+
+/**
+ * \brief   Puts the calling thread under watch, or takes it off
+ *
+ * \param[in] uiBudgetMs : Longest expected gap between heartbeats, 0 to stop watching
+ * \retval  0 for success
+ * \retval  Non-zero for failure (not a factory thread)
+ *
+ * \par Description
+ * Counts as a heartbeat. The thread is taken off the watch list when it exits.
+ */
+int pu_thread_watch( size_t uiBudgetMs );
+
+/**
+ * \brief   Starts the hang monitor
+ *
+ * \param[in] uiPeriodMs : Scan period, at least \ref PUTIMER_MIN_TIMEOUT
+ * \param[in] fctHang    : Hang report, NULL to print a line to stderr
+ * \param[in] uiFlags    : \ref PU_THREAD_MONITOR_BACKTRACE, or 0
+ * \retval  0 for success
+ * \retval  Non-zero for failure, or already started
+ *
+ * \pre     The timer service is initialised (\ref POSUTILS_INIT)
+ *
+ * \par Description
+ * Each scan compares the heartbeat of every watched thread with the previous scan. A thread is
+ * reported once its heartbeat has stood still for longer than its budget, so a hang is seen
+ * between one budget and one budget plus two periods after the last heartbeat. It is reported
+ * once, and again only after it has made progress and stalled anew.
+ *
+ * \par Backtraces
+ * With \ref PU_THREAD_MONITOR_BACKTRACE a handler for \ref PU_THREAD_BACKTRACE_SIGNAL is
+ * installed, and the hung thread is sent the signal. The handler writes the thread name and
+ * a raw backtrace (\c backtrace_symbols_fd) to stderr. A thread blocked in the kernel takes the
+ * signal as well, an interrupted system call may then return \c EINTR. The handler is installed
+ * on the first start with the flag and stays installed, also after \ref pu_thread_monitor_stop.
+ */
+int pu_thread_monitor_start(
+    size_t               uiPeriodMs,
+    pu_thread_hang_fct_t fctHang,
+    unsigned int         uiFlags );
+
+/**
+ * \brief   Stops the hang monitor, waiting for a scan that is running
+ *
+ * \retval  0 for success
+ * \retval  Non-zero for failure, or not started
+ *
+ * \pre     Called before \ref POSUTILS_EXIT, and not from the hang report
+ *
+ * \par Description
+ * No hang is reported once it returns. The backtrace signal handler stays installed, a signal
+ * sent by the last scan may still be delivered.
+ */
+int pu_thread_monitor_stop( void );
+
 /**
  * \}
  */
 
+PU_API_END
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
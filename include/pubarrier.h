@@ -0,0 +1,194 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUBARRIER_H_
+#define _PUBARRIER_H_
+#include "pudefs.h"
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+PU_API_BEGIN
+
+/**
+ * \file     pubarrier.h
+ * \brief    Reusable thread barrier and one-shot latch
+ */
+
+/**
+ * \defgroup PBARRIER Barrier and latch utility
+ * \ingroup  POSUTILS
+ *
+ * \brief
+ * Phase synchronisation for groups of threads.
+ *
+ * \section pbar_sect_1 Barrier
+ * \ref pu_barrier_t is a reusable, sense-reversing barrier. Each arrival decrements a counter.
+ * The last thread to arrive resets the counter and flips the phase word, which releases all the
+ * others. Because the phase flips, the barrier can be re-entered straight away, there is no
+ * separate reset step. The counter and the phase word are on different cache lines, so the
+ * stream of arrivals does not disturb the threads that are already waiting.
+ *
+ * \section pbar_sect_2 Spin then block
+ * A \c pthread_barrier_t always sleeps in the kernel. Here a waiter first spins on the phase
+ * word, and only parks on a futex if the phase has not flipped after the spin. Spinning only
+ * helps if every participant has its own CPU, so the spin is disabled when the barrier has more
+ * participants than there are online CPUs.
+ *
+ * \section pbar_sect_3 Latch
+ * \ref pu_latch_t is a one-shot count down, e.g. "wait until N workers have started". It cannot
+ * be reused, once it reaches zero it stays there.
+ *
+ * \section pbar_sect_4 Thread groups
+ * \ref pu_thread_group_create starts a set of threads with \ref pu_thread_create, all sharing one
+ * barrier (see \ref pu_thread_group_barrier). This is the normal way to run a phased parallel job.
+ *
+ * \{
+ */
+
+/**** Includes ***************************************************************/
+#include <stddef.h>
+#include "pufutex.h"
+
+/**** Definitions ************************************************************/
+
+/**
+ * Returned by \ref pu_barrier_wait to exactly one of the threads, in each phase
+ */
+#define PU_BARRIER_SERIAL_THREAD (1)
+
+/**
+ * \brief Reusable barrier
+ *
+ * \note
+ * Treat the contents as private, the structure is exposed so that the caller can provide the storage
+ */
+typedef struct pu_barrier_tag
+{
+    /* Written by every arrival */
+    struct PU_CACHELINE_ALIGNED
+    {
+        unsigned int uiRemaining;   /* Threads still to arrive in this phase */
+    }   stArrive;
+
+    /* Written once per phase, read by the waiters */
+    struct PU_CACHELINE_ALIGNED
+    {
+        unsigned int uiPhase;       /* Futex word, flipped (incremented) by the last arrival */
+        unsigned int uiSleepers;    /* Waiters parked on the futex           */
+        unsigned int uiCount;       /* Number of participants                */
+        unsigned int uiSpin;        /* Spin iterations before parking        */
+    }   stRelease;
+}   pu_barrier_t;
+
+/**
+ * \brief One-shot latch
+ *
+ * \note
+ * Treat the contents as private, the structure is exposed so that the caller can provide the storage
+ */
+typedef struct pu_latch_tag
+{
+    unsigned int uiCount;     /* Futex word, counts down to zero */
+    unsigned int uiWaiters;   /* Waiters parked on the futex     */
+}   pu_latch_t;
+
+/**
+ * \brief   Creates (initialises) a barrier
+ *
+ * \param[in] pBar    : Pointer to a valid barrier
+ * \param[in] uiCount : Number of participating threads, non-zero
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ */
+int pu_barrier_create(
+    pu_barrier_t* pBar,
+    unsigned int  uiCount );
+
+/**
+ * \brief   Waits until all the participants have arrived
+ *
+ * \param[in] pBar : Pointer to a valid barrier
+ * \retval  \ref PU_BARRIER_SERIAL_THREAD for one (the last arriving) thread
+ * \retval  0 for all the others
+ */
+int pu_barrier_wait( pu_barrier_t* pBar );
+
+/**
+ * \brief   Destroys a barrier
+ *
+ * \param[in] pBar : Pointer to a valid barrier
+ * \retval  0 for success
+ *
+ * \pre     No thread is waiting on the barrier
+ */
+int pu_barrier_destroy( pu_barrier_t* pBar );
+
+/**
+ * \brief   Creates (initialises) a latch
+ *
+ * \param[in] pLatch  : Pointer to a valid latch
+ * \param[in] uiCount : Initial count
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ */
+int pu_latch_create(
+    pu_latch_t*  pLatch,
+    unsigned int uiCount );
+
+/**
+ * \brief   Decrements the latch, and releases the waiters when it reaches zero
+ *
+ * \param[in] pLatch  : Pointer to a valid latch
+ * \param[in] uiCount : Amount to count down by
+ *
+ * \pre     The count does not go below zero
+ */
+void pu_latch_count_down(
+    pu_latch_t*  pLatch,
+    unsigned int uiCount );
+
+/**
+ * \brief   Checks the latch without waiting
+ *
+ * \param[in] pLatch : Pointer to a valid latch
+ * \retval  Non-zero if the latch has reached zero
+ */
+int pu_latch_try_wait( const pu_latch_t* pLatch );
+
+/**
+ * \brief   Waits until the latch reaches zero, or the timeout expires
+ *
+ * \param[in] pLatch      : Pointer to a valid latch
+ * \param[in] uiTimeoutMs : Timeout in ms, or \ref PU_FUTEX_WAIT_FOREVER
+ * \retval  0 the latch reached zero
+ * \retval  ETIMEDOUT the timeout expired
+ */
+int pu_latch_wait(
+    pu_latch_t* pLatch,
+    size_t      uiTimeoutMs );
+
+/**
+ * \}
+ */
+
+PU_API_END
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* _PUBARRIER_H_ */
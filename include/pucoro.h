@@ -0,0 +1,358 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUCORO_H_
+#define _PUCORO_H_
+
+/**
+ * \file     pucoro.h
+ * \brief    C++20 coroutine awaitables for timers and executor handoff
+ */
+
+/**
+ * \defgroup PCORO Coroutine awaitables
+ * \ingroup  POSUTILS
+ *
+ * \brief
+ * Lets a coroutine wait on the timer service, or move to an executor, without a thread of its
+ * own. The header is empty unless it is compiled as C++20 with coroutine support, check
+ * \c PU_HAS_COROUTINES. The library itself stays C++11.
+ *
+ * \section pcoro_sect_1 Awaitables
+ * - \ref pu::sleep_for suspends for a time, then resumes on an executor
+ * - \ref pu::resume_on moves the coroutine to an executor
+ * - \ref pu::coro_timer is a periodic timer, each \c co_await waits for the next tick
+ * .
+ * A waiting coroutine costs one \ref putimer_create slot. There is no allocation: the awaiter
+ * lives in the coroutine frame and is the timer cookie, and it carries the \ref pu_task_t it
+ * is resumed with.
+ *
+ * \section pcoro_sect_2 Where the coroutine resumes
+ * Timer callbacks run in the timer thread. The awaitables never resume there, they submit the
+ * coroutine to the executor they were given. \ref pu_executor_inline is allowed, but the
+ * coroutine then runs in the timer thread and delays every other timer while it does.
+ * If the executor refuses the task, the coroutine resumes in the thread that tried to submit it,
+ * except for \ref pu::coro_timer, which retries on its next tick.
+ *
+ * \par Usage
+ * \code
+ * pu::coro_task poll_sensor( pu_executor_pool_t& stPool )
+ * {
+ *     co_await pu::resume_on( stPool );
+ *     for (;;) {
+ *         read_sensor();
+ *         co_await pu::sleep_for( 100, &(stPool.stExec) );
+ *     }
+ * }
+ * \endcode
+ */
+
+#if defined(__cplusplus) && (__cplusplus >= 202002L) && defined(__cpp_impl_coroutine)
+
+/**** Includes ***************************************************************/
+#include <coroutine>
+#include <exception>
+#include <pthread.h>
+#include "pufuture.h"
+#include "putimer.h"
+
+/**** Definitions ************************************************************/
+
+/**
+ * Defined when the awaitables are available
+ */
+#define PU_HAS_COROUTINES (1)
+
+namespace pu {
+
+/**
+ * \brief Coroutine return type for detached coroutines, the frame frees itself on completion
+ * \ingroup PCORO
+ *
+ * The coroutine starts straight away in the calling thread. An exception that escapes it
+ * terminates the process.
+ */
+struct coro_task
+{
+    struct promise_type
+    {
+        coro_task get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+namespace detail {
+
+/* Common part of the awaiters: the handle and the task that resumes it on an executor */
+class coro_resumer
+{
+protected:
+    explicit coro_resumer( pu_executor_t* pExec ) : m_pExec( pExec ), m_stTask{ &coro_resumer::run, this } {}
+    coro_resumer( const coro_resumer& ) = delete;
+    coro_resumer& operator=( const coro_resumer& ) = delete;
+
+    /* Returns false if the executor refused the task, the caller resumes the coroutine itself.
+     * Once the task is submitted the coroutine may already be running, and the awaiter gone.
+     */
+    bool submit() {
+        return ((nullptr != m_pExec) && (0 == m_pExec->fctSubmit( m_pExec, &m_stTask )));
+    }
+    void dispatch() {
+        if (!submit()) {
+            m_hCoro.resume();
+        }
+    }
+
+    std::coroutine_handle<> m_hCoro;
+
+private:
+    static void run( void* pArg ) {
+        static_cast<coro_resumer*>( pArg )->m_hCoro.resume();
+    }
+
+    pu_executor_t* m_pExec;
+    pu_task_t      m_stTask;
+};
+
+} // namespace detail
+
+/**
+ * \brief Awaiter returned by \ref pu::resume_on
+ * \ingroup PCORO
+ */
+class resume_on_awaiter : private detail::coro_resumer
+{
+public:
+    explicit resume_on_awaiter( pu_executor_t* pExec ) : coro_resumer( pExec ) {}
+
+    bool await_ready() const noexcept { return (false); }
+    bool await_suspend( std::coroutine_handle<> hCoro ) {
+        m_hCoro = hCoro;
+        return (submit());
+    }
+    void await_resume() const noexcept {}
+};
+
+/**
+ * \brief   Moves the coroutine to an executor
+ * \ingroup PCORO
+ *
+ * \param[in] pExec : Executor to continue on
+ */
+inline resume_on_awaiter resume_on( pu_executor_t* pExec )
+{
+    return (resume_on_awaiter( pExec ));
+} /* resume_on */
+
+/**
+ * \brief   Moves the coroutine to a thread pool
+ * \ingroup PCORO
+ *
+ * \param[in] stPool : Pool to continue on
+ */
+inline resume_on_awaiter resume_on( pu_executor_pool_t& stPool )
+{
+    return (resume_on_awaiter( &(stPool.stExec) ));
+} /* resume_on */
+
+/**
+ * \brief Awaiter returned by \ref pu::sleep_for, \c co_await gives 0, or -1 if no timer was available
+ * \ingroup PCORO
+ */
+class sleep_awaiter : private detail::coro_resumer
+{
+public:
+    sleep_awaiter( size_t uiMs, pu_executor_t* pExec )
+        : coro_resumer( pExec ), m_uiMs( uiMs ), m_hTimer( nullptr ), m_iResult( 0 ) {}
+
+    bool await_ready() const noexcept { return (false); }
+    bool await_suspend( std::coroutine_handle<> hCoro ) {
+        m_hCoro = hCoro;
+
+        /* Nothing to wait for, just a trip through the executor */
+        if (0 == m_uiMs) {
+            return (submit());
+        }
+
+        /* The timer cannot fire before putimer_start has released the timer lock */
+        m_hTimer = putimer_create( PUTIMER_TYPE_SINGLESHOT, &sleep_awaiter::expired, m_uiMs, this );
+        if (!m_hTimer) {
+            m_iResult = -1;
+            return (false);
+        }
+        if (0 != putimer_start( m_hTimer )) {
+            putimer_delete( m_hTimer );
+            m_iResult = -1;
+            return (false);
+        }
+        return (true);
+    }
+    int await_resume() const noexcept { return (m_iResult); }
+
+private:
+    /* Timer thread: give the slot back, then hand the coroutine over */
+    static void expired( void* pCookie ) {
+        sleep_awaiter* pThis = static_cast<sleep_awaiter*>( pCookie );
+        putimer_delete( pThis->m_hTimer );
+        pThis->dispatch();
+    }
+
+    size_t        m_uiMs;
+    putimer_hnd_t m_hTimer;
+    int           m_iResult;
+};
+
+/**
+ * \brief   Suspends the coroutine for a time
+ * \ingroup PCORO
+ *
+ * \param[in] uiMs  : Time in ms, rounded up to \ref PUTIMER_MIN_TIMEOUT. 0 only goes through the executor.
+ * \param[in] pExec : Executor the coroutine resumes on
+ *
+ * \pre     The timer service is initialised (\ref POSUTILS_INIT)
+ */
+inline sleep_awaiter sleep_for( size_t uiMs, pu_executor_t* pExec )
+{
+    return (sleep_awaiter( uiMs, pExec ));
+} /* sleep_for */
+
+/**
+ * \brief Periodic timer a coroutine can await
+ * \ingroup PCORO
+ *
+ * \c co_await \c tick() waits for the next expiry and gives the number of expiries since the
+ * previous one, so a slow consumer sees that it missed ticks. One coroutine waits at a time.
+ * The timer is lock-able, once the object is destroyed its callback never runs again. The tick
+ * is dispatched under the timer lock, so the coroutine never resumes inline there: if the
+ * executor refuses the task (a full pool queue), the waiter stays parked and the tick is counted,
+ * the next expiry tries again. Give it an executor with threads of its own.
+ *
+ * \code
+ * pu::coro_timer tmrPoll( 100, &(stPool.stExec) );
+ * while (tmrPoll.valid()) {
+ *     size_t uiTicks = co_await tmrPoll.tick();
+ *     ...
+ * }
+ * \endcode
+ */
+class coro_timer
+{
+public:
+    class awaiter : private detail::coro_resumer
+    {
+    public:
+        explicit awaiter( coro_timer& tmr ) : coro_resumer( tmr.m_pExec ), m_tmr( tmr ), m_uiTicks( 0 ) {}
+
+        bool await_ready() noexcept { return (m_tmr.take( m_uiTicks )); }
+        bool await_suspend( std::coroutine_handle<> hCoro ) {
+            m_hCoro = hCoro;
+            return (m_tmr.park( this ));
+        }
+        size_t await_resume() const noexcept { return (m_uiTicks); }
+
+    private:
+        friend class coro_timer;
+        coro_timer& m_tmr;
+        size_t      m_uiTicks;
+    };
+
+    coro_timer( size_t uiPeriodMs, pu_executor_t* pExec )
+        : m_pExec( pExec ), m_pWaiter( nullptr ), m_uiPending( 0 ) {
+        pthread_mutex_init( &m_mtxLock, nullptr );
+        m_hTimer = putimer_create_lockable( PUTIMER_TYPE_PERIODIC, &coro_timer::expired, uiPeriodMs, this );
+        if ((m_hTimer) && (0 != putimer_start( m_hTimer ))) {
+            putimer_delete( m_hTimer );
+            m_hTimer = nullptr;
+        }
+    }
+    ~coro_timer() {
+        if (m_hTimer) {
+            putimer_delete( m_hTimer );
+        }
+        pthread_mutex_destroy( &m_mtxLock );
+    }
+    coro_timer( const coro_timer& ) = delete;
+    coro_timer& operator=( const coro_timer& ) = delete;
+
+    bool valid() const { return (nullptr != m_hTimer); }
+    awaiter tick() { return (awaiter( *this )); }
+
+private:
+    /* Takes the ticks counted while nobody was waiting */
+    bool take( size_t& uiTicks ) {
+        pthread_mutex_lock( &m_mtxLock );
+        uiTicks = m_uiPending;
+        m_uiPending = 0;
+        pthread_mutex_unlock( &m_mtxLock );
+        return (0 != uiTicks);
+    }
+
+    /* Returns false if a tick came in since await_ready */
+    bool park( awaiter* pWaiter ) {
+        bool bParked = false;
+        pthread_mutex_lock( &m_mtxLock );
+        if (m_uiPending) {
+            pWaiter->m_uiTicks = m_uiPending;
+            m_uiPending = 0;
+        }
+        else {
+            m_pWaiter = pWaiter;
+            bParked = true;
+        }
+        pthread_mutex_unlock( &m_mtxLock );
+        return (bParked);
+    }
+
+    /* Timer thread, under the timer lock. The coroutine must never resume here, a refused
+     * submit parks the waiter again with its ticks, for the next expiry to retry.
+     */
+    static void expired( void* pCookie ) {
+        coro_timer* pThis = static_cast<coro_timer*>( pCookie );
+        awaiter*    pWaiter;
+        pthread_mutex_lock( &(pThis->m_mtxLock) );
+        pThis->m_uiPending++;
+        pWaiter = pThis->m_pWaiter;
+        pThis->m_pWaiter = nullptr;
+        if (pWaiter) {
+            pWaiter->m_uiTicks = pThis->m_uiPending;
+            pThis->m_uiPending = 0;
+        }
+        pthread_mutex_unlock( &(pThis->m_mtxLock) );
+        if ((pWaiter) && (!pWaiter->submit())) {
+            pthread_mutex_lock( &(pThis->m_mtxLock) );
+            pThis->m_uiPending += pWaiter->m_uiTicks;
+            pThis->m_pWaiter = pWaiter;
+            pthread_mutex_unlock( &(pThis->m_mtxLock) );
+        }
+    }
+
+    pu_executor_t*  m_pExec;
+    putimer_hnd_t   m_hTimer;
+    pthread_mutex_t m_mtxLock;
+    awaiter*        m_pWaiter;
+    size_t          m_uiPending;
+};
+
+} // namespace pu
+
+#endif /* C++20 coroutines */
+#endif /* _PUCORO_H_ */
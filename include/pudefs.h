@@ -0,0 +1,90 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUDEFS_H_
+#define _PUDEFS_H_
+
+/**
+ * \file     pudefs.h
+ * \brief    Small set of definitions shared by all the posutils headers
+ */
+
+/**** Definitions ************************************************************/
+
+/**
+ * Assumed size of a cache line. Used to pad shared data so that independent
+ * hot words do not end up on the same line (false sharing).
+ */
+#define PU_CACHELINE_SIZE (64)
+
+/**
+ * Alignment attribute for data that must start on a cache line
+ */
+#define PU_CACHELINE_ALIGNED __attribute__((aligned(PU_CACHELINE_SIZE)))
+
+/**
+ * Turn a macro argument (e.g. __LINE__) into a string literal
+ */
+#define PU_STRINGIFY_(x_) #x_
+#define PU_STRINGIFY(x_)  PU_STRINGIFY_(x_)
+
+/**
+ * \brief Linkage of the small, hot library functions
+ *
+ * Normally they are ordinary functions in the library. When \c PU_INLINE is defined (the CMake
+ * option \c POSUTILS_INLINE does it for the library and every user of it) their bodies are in the
+ * headers instead, \c static \c inline, so calls to them compile down to a few instructions. The
+ * library and its users must agree on \c PU_INLINE, the inline build does not export them.
+ */
+#if defined(PU_INLINE)
+    #define PU_INLINE_FCT static inline
+#else
+    #define PU_INLINE_FCT
+#endif
+
+/**
+ * \brief Exported part of a public header
+ *
+ * The shared library is built with hidden visibility, so only what is declared between
+ * \c PU_API_BEGIN and \c PU_API_END is exported (and src/posutils.map names it). Calls inside the
+ * library then go direct, not through the PLT. No effect on the static library.
+ */
+#if defined(__GNUC__)
+    #define PU_API_BEGIN _Pragma("GCC visibility push(default)")
+    #define PU_API_END   _Pragma("GCC visibility pop")
+#else
+    #define PU_API_BEGIN
+    #define PU_API_END
+#endif
+
+/**
+ * \brief Spin-wait hint for the CPU
+ *
+ * Used inside busy-wait loops. On x86 this is the \c pause instruction, which reduces
+ * power and the memory-order mis-speculation penalty when the loop exits.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+    #define PU_CPU_RELAX() __builtin_ia32_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+    #define PU_CPU_RELAX() __asm__ __volatile__("yield" ::: "memory")
+#else
+    #define PU_CPU_RELAX() __asm__ __volatile__("" ::: "memory")
+#endif
+
+#endif /* _PUDEFS_H_ */
@@ -0,0 +1,209 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUDELAYQUEUE_H_
+#define _PUDELAYQUEUE_H_
+#include "pudefs.h"
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+PU_API_BEGIN
+
+/**
+ * \file     pudelayqueue.h
+ * \brief    Delay queue, items become available to consumers at their ready time
+ */
+
+/**
+ * \defgroup PDELAYQUEUE Delay queue
+ * \ingroup  POSUTILS
+ *
+ * \brief
+ * Producers put \c void* items with a ready time. Consumers block in \ref pu_delayqueue_take
+ * until the earliest item is due, and get the items in ready time order (items due at the
+ * same time come out in the order they were put). Nothing runs on the timer thread, and an
+ * item costs no timer resource, so a retry or backoff pipeline can hold any number of them.
+ *
+ * \section pdelayqueue_sect_1 Time
+ * Ready times are \c CLOCK_MONOTONIC nanoseconds, the same clock as
+ * \ref timespec_now_ns_monotonic and the timer service. Items are kept in a binary heap.
+ *
+ * \section pdelayqueue_sect_2 Waking
+ * One consumer waits for the head item, the others wait for a signal. A producer only signals
+ * when its item becomes the new head, a consumer that takes an item hands the wait over to
+ * the next one when there are more items.
+ *
+ * \par Usage
+ * \code
+ * // Producer, retry in 200ms
+ * pu_delayqueue_put( &stRetries, pRequest, 200 );
+ *
+ * // Consumer
+ * while (0 == pu_delayqueue_take( &stRetries, &pItem, PU_DELAYQUEUE_WAIT_FOREVER )) { ... }
+ * \endcode
+ *
+ * \{
+ */
+
+/**** Includes ***************************************************************/
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**** Definitions ************************************************************/
+
+/**
+ * Timeout value for an unbounded wait
+ */
+#define PU_DELAYQUEUE_WAIT_FOREVER ((size_t)-1)
+
+/**
+ * \brief A queued item
+ */
+typedef struct pu_delayqueue_entry_tag
+{
+    uint64_t ulReadyNs;        /* Ready time, monotonic ns         */
+    uint64_t ulSeq;            /* Put order, for equal ready times */
+    void*    pItem;            /* The item                         */
+}   pu_delayqueue_entry_t;
+
+/**
+ * \brief Delay queue
+ *
+ * \note
+ * Treat the contents as private, the structure is exposed so that the caller can provide the storage
+ */
+typedef struct pu_delayqueue_tag
+{
+    pthread_mutex_t        mtxLock;
+    pthread_cond_t         cndReady;     /* Monotonic clock                   */
+    pu_delayqueue_entry_t* pHeap;        /* Min-heap on (ready time, seq)     */
+    size_t                 uiCount;
+    size_t                 uiCapacity;   /* Grows on demand                   */
+    uint64_t               ulSeq;
+    size_t                 uiWaiters;    /* Consumers in take                 */
+    const void*            pLeader;      /* The consumer waiting for the head */
+    int                    bClosed;
+}   pu_delayqueue_t;
+
+/**
+ * \brief   Creates (initialises) a delay queue
+ *
+ * \param[in] pQueue     : Pointer to a valid queue
+ * \param[in] uiCapacity : Initial number of items, the queue grows past it
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ */
+int pu_delayqueue_create(
+    pu_delayqueue_t* pQueue,
+    size_t           uiCapacity );
+
+/**
+ * \brief   Destroys a delay queue, items still queued are not freed
+ *
+ * \param[in] pQueue : Pointer to a valid queue
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ *
+ * \pre     No consumer is waiting, see \ref pu_delayqueue_close
+ */
+int pu_delayqueue_destroy( pu_delayqueue_t* pQueue );
+
+/**
+ * \brief   Puts an item that becomes available after a delay
+ *
+ * \param[in] pQueue    : Pointer to a valid queue
+ * \param[in] pItem     : Item
+ * \param[in] uiDelayMs : Delay in ms, 0 for straight away
+ * \retval  0 for success
+ * \retval  Non-zero for failure (no memory, or closed)
+ */
+int pu_delayqueue_put(
+    pu_delayqueue_t* pQueue,
+    void*            pItem,
+    size_t           uiDelayMs );
+
+/**
+ * \brief   Puts an item that becomes available at a given time
+ *
+ * \param[in] pQueue    : Pointer to a valid queue
+ * \param[in] pItem     : Item
+ * \param[in] ulReadyNs : Ready time, monotonic ns (see \ref timespec_now_ns_monotonic)
+ * \retval  0 for success
+ * \retval  Non-zero for failure (no memory, or closed)
+ */
+int pu_delayqueue_put_at(
+    pu_delayqueue_t* pQueue,
+    void*            pItem,
+    uint64_t         ulReadyNs );
+
+/**
+ * \brief   Takes the earliest item once it is due, waiting at most the timeout
+ *
+ * \param[in]  pQueue      : Pointer to a valid queue
+ * \param[out] ppItem      : The item
+ * \param[in]  uiTimeoutMs : Timeout in ms, or \ref PU_DELAYQUEUE_WAIT_FOREVER
+ * \retval  0 for success
+ * \retval  ETIMEDOUT no item became due in time
+ * \retval  EPIPE the queue is closed and no item is due
+ */
+int pu_delayqueue_take(
+    pu_delayqueue_t* pQueue,
+    void**           ppItem,
+    size_t           uiTimeoutMs );
+
+/**
+ * \brief   Takes the earliest item if it is due, never waits
+ *
+ * \param[in]  pQueue : Pointer to a valid queue
+ * \param[out] ppItem : The item
+ * \retval  0 for success
+ * \retval  EAGAIN no item is due
+ */
+int pu_delayqueue_poll(
+    pu_delayqueue_t* pQueue,
+    void**           ppItem );
+
+/**
+ * \brief   Number of queued items, due or not (a snapshot)
+ *
+ * \param[in] pQueue : Pointer to a valid queue
+ * \retval  The number of items
+ */
+size_t pu_delayqueue_size( pu_delayqueue_t* pQueue );
+
+/**
+ * \brief   Closes the queue: puts fail, and takes return \c EPIPE instead of waiting
+ *
+ * \param[in] pQueue : Pointer to a valid queue
+ *
+ * \par Description
+ * Items that are already due can still be taken. Meant for shutting the consumers down.
+ */
+void pu_delayqueue_close( pu_delayqueue_t* pQueue );
+
+/**
+ * \}
+ */
+
+PU_API_END
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* _PUDELAYQUEUE_H_ */
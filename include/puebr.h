@@ -0,0 +1,204 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUEBR_H_
+#define _PUEBR_H_
+#include "pudefs.h"
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+PU_API_BEGIN
+
+/**
+ * \file     puebr.h
+ * \brief    Epoch based memory reclamation for lock-free structures
+ */
+
+/**
+ * \defgroup PEBR Epoch based reclamation
+ * \ingroup  POSUTILS
+ *
+ * \brief
+ * A lock-free reader can still be looking at an object after a writer has unlinked it, so the
+ * writer cannot free it straight away. Epoch based reclamation (EBR) defers the free until every
+ * reader that could have seen the object has left its read-side section, without a reference
+ * count per object.
+ *
+ * \section pebr_sect_1 How it works
+ * There is a global epoch. A reader entering a read-side section publishes the epoch it saw.
+ * An unlinked object is retired into a list tagged with the current epoch. The epoch can only
+ * advance when every thread inside a read-side section has seen the current one, so once it has
+ * advanced twice past the tag no reader can still hold the object and the list is freed.
+ *
+ * Entering and leaving a section are a few thread local stores and one fence, readers never
+ * write to shared cache lines. Retired objects are freed in batches: every
+ * \ref PU_EBR_RETIRE_BATCH retires the thread tries to advance the epoch and frees what it can.
+ *
+ * \section pebr_sect_2 Threads
+ * Every thread that uses EBR must be registered. Threads created with \ref pu_thread_create are
+ * registered on entry and unregistered on exit, other threads (e.g. main) call
+ * \ref pu_ebr_register and \ref pu_ebr_unregister themselves. Objects a thread retired but could
+ * not free before it exited stay with its record, and are freed by \ref pu_ebr_barrier or by the
+ * next thread that reuses the record.
+ *
+ * \section pebr_sect_3 Quiescent states
+ * A thread that retires little, or only reads, can call \ref pu_ebr_quiescent at a point where
+ * it holds no references, e.g. once per loop of its event loop. It pushes the epoch along and
+ * frees the thread's own eligible lists.
+ *
+ * \section pebr_sect_4 Limits
+ * A thread that stalls inside a read-side section stops the epoch, and retired objects pile up
+ * until it leaves. Keep the sections short, and never block inside one.
+ *
+ * \par Usage
+ * \code
+ * typedef struct { pu_ebr_node_t stNode; int iValue; } config_t;
+ * static config_t* pConfig;
+ *
+ * static void config_free( pu_ebr_node_t* pNode ) {
+ *     free( (config_t*)((char*)pNode - offsetof(config_t, stNode)) );
+ * }
+ *
+ * // Reader
+ * pu_ebr_enter();
+ * iValue = __atomic_load_n( &pConfig, __ATOMIC_ACQUIRE )->iValue;
+ * pu_ebr_exit();
+ *
+ * // Writer
+ * config_t* pOld = __atomic_exchange_n( &pConfig, pNew, __ATOMIC_ACQ_REL );
+ * pu_ebr_retire( &(pOld->stNode), config_free );
+ * \endcode
+ *
+ * \{
+ */
+
+/**** Includes ***************************************************************/
+#include <stddef.h>
+
+/**** Definitions ************************************************************/
+
+/**
+ * Number of retires after which a thread tries to advance the epoch and reclaim
+ */
+#define PU_EBR_RETIRE_BATCH (64)
+
+/**
+ * \brief Retire list link, embedded in the object to be reclaimed
+ */
+typedef struct pu_ebr_node_tag pu_ebr_node_t;
+
+/**
+ * \brief Free function, called with the node that was retired
+ */
+typedef void (*pu_ebr_free_fct_t)( pu_ebr_node_t* pNode );
+
+struct pu_ebr_node_tag
+{
+    pu_ebr_node_t*    pNext;      /* Retire list link */
+    pu_ebr_free_fct_t fctFree;    /* Free function    */
+};
+
+/**
+ * \brief   Registers the calling thread with the EBR domain
+ *
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ *
+ * \par Description
+ * Registrations nest, a thread registered by \ref pu_thread_create may register again.
+ */
+int pu_ebr_register( void );
+
+/**
+ * \brief   Unregisters the calling thread
+ *
+ * \pre     The thread is not inside a read-side section
+ */
+void pu_ebr_unregister( void );
+
+/**
+ * \brief   Enters a read-side section. Sections nest.
+ *
+ * \pre     The thread is registered
+ */
+void pu_ebr_enter( void );
+
+/**
+ * \brief   Leaves a read-side section
+ */
+void pu_ebr_exit( void );
+
+/**
+ * \brief   Retires an unlinked object, it is freed once no reader can hold it
+ *
+ * \param[in] pNode   : Node embedded in the object
+ * \param[in] fctFree : Called with \c pNode once it is safe to free the object
+ *
+ * \pre     The object is no longer reachable from the shared structure
+ * \pre     The thread is registered
+ */
+void pu_ebr_retire(
+    pu_ebr_node_t*    pNode,
+    pu_ebr_free_fct_t fctFree );
+
+/**
+ * \brief   Quiescent state hook, the caller holds no references
+ *
+ * \par Description
+ * Tries to advance the epoch, and frees the calling thread's eligible retire lists.
+ */
+void pu_ebr_quiescent( void );
+
+/**
+ * \brief   Waits for all the current readers, then frees everything retired so far
+ *
+ * \pre     The caller is not inside a read-side section
+ *
+ * \par Description
+ * Also frees the lists left behind by threads that have exited. Meant for shutdown and tests,
+ * it spins (with yields) until the readers leave their sections.
+ */
+void pu_ebr_barrier( void );
+
+/**
+ * \}
+ */
+
+PU_API_END
+#ifdef __cplusplus
+}
+
+namespace pu {
+
+/**
+ * \brief C++ wrapper, a read-side section for the lifetime of the object
+ * \ingroup PEBR
+ */
+class ebr_guard
+{
+public:
+    ebr_guard() { pu_ebr_enter(); }
+    ~ebr_guard() { pu_ebr_exit(); }
+    ebr_guard( const ebr_guard& ) = delete;
+    ebr_guard& operator=( const ebr_guard& ) = delete;
+};
+
+} // namespace pu
+#endif /* __cplusplus */
+#endif /* _PUEBR_H_ */
@@ -0,0 +1,294 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUFUTEX_H_
+#define _PUFUTEX_H_
+#include "pudefs.h"
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+PU_API_BEGIN
+
+/**
+ * \file     pufutex.h
+ * \brief    Futex wrappers, and the semaphore and event count built on them
+ */
+
+/**
+ * \defgroup PFUTEX Futex based primitives
+ * \ingroup  POSUTILS
+ *
+ * \brief
+ * Light weight replacements for \c sem_t and for mutex + condition variable pairs that are
+ * only used for signalling.
+ *
+ * \section pfutex_sect_1 Fast path
+ * Both primitives track whether any thread is (about to be) asleep. A post or notify with
+ * nobody asleep costs one atomic operation and never enters the kernel. The \c FUTEX_WAKE
+ * syscall is only made when a thread actually has to be woken.
+ *
+ * \section pfutex_sect_2 Semaphore
+ * \ref pu_sem_t is a counting semaphore. \ref pu_sem_post_n releases a batch of units with one
+ * atomic add and at most one syscall, e.g. after pushing a batch of work items.
+ *
+ * \section pfutex_sect_3 Event count
+ * \ref pu_eventcount_t lets a thread sleep until "something changed", on top of any lock-free
+ * condition. It replaces a condition variable when there is no mutex to pair it with:
+ * \code
+ * for (;;) {
+ *     if (try_pop( &stQueue, &stItem )) break;
+ *     unsigned int uiKey = pu_eventcount_prepare_wait( &ecQueue );
+ *     if (try_pop( &stQueue, &stItem )) { pu_eventcount_cancel_wait( &ecQueue ); break; }
+ *     pu_eventcount_wait( &ecQueue, uiKey, PU_FUTEX_WAIT_FOREVER );
+ * }
+ * ...
+ * push( &stQueue, &stItem );
+ * pu_eventcount_notify( &ecQueue );
+ * \endcode
+ * The condition is re-checked after \ref pu_eventcount_prepare_wait, so a notify that happens
+ * between the check and the wait is never lost.
+ *
+ * A waiter sets the low bit of the epoch. A notify that finds the bit clear does not write to
+ * the event count at all. One that finds it set advances the epoch, which clears the bit, and
+ * wakes every sleeper. Until one of them waits again further notifies stay in user space,
+ * which matters when a producer runs ahead of a sleeping consumer. The price is that a notify
+ * can wake more threads than it needs to, the extra ones re-check and wait again.
+ *
+ * \section pfutex_sect_4 Timeouts
+ * Timed waits take a timeout in ms, and are measured against \c CLOCK_MONOTONIC. Internally an
+ * absolute deadline is used, so spurious wakes do not stretch the timeout.
+ *
+ * \{
+ */
+
+/**** Includes ***************************************************************/
+#include <stddef.h>
+#include <time.h>
+
+/**** Definitions ************************************************************/
+
+/**
+ * Timeout value for an unbounded wait
+ */
+#define PU_FUTEX_WAIT_FOREVER ((size_t)-1)
+
+/**
+ * \brief Counting semaphore
+ *
+ * \note
+ * Treat the contents as private, the structure is exposed so that the caller can provide the storage
+ */
+typedef struct pu_sem_tag
+{
+    unsigned int uiCount;     /* Futex word, the semaphore value    */
+    unsigned int uiWaiters;   /* Number of sleeping (or about to sleep) waiters */
+    int          bShared;     /* Non-zero if used between processes */
+}   pu_sem_t;
+
+/**
+ * \brief Event count
+ *
+ * \note
+ * Treat the contents as private, the structure is exposed so that the caller can provide the storage
+ */
+typedef struct pu_eventcount_tag
+{
+    unsigned int uiEpoch;     /* Futex word. Bit 0 is set while somebody waits, the rest counts notifies */
+}   pu_eventcount_t;
+
+/**
+ * Static initialiser for a private event count
+ */
+#define PU_EVENTCOUNT_INITIALIZER { 0 }
+
+/**
+ * \brief   Waits while a futex word holds the expected value
+ *
+ * \param[in] pWord      : Futex word
+ * \param[in] uiExpected : Expected value
+ * \param[in] pDeadline  : Absolute \c CLOCK_MONOTONIC deadline, NULL to wait forever
+ * \param[in] bShared    : Non-zero if the word is in memory shared between processes
+ * \retval  0 woken (possibly spuriously)
+ * \retval  EAGAIN the word did not hold the expected value
+ * \retval  ETIMEDOUT the deadline passed
+ * \retval  EINTR interrupted by a signal
+ */
+int pu_futex_wait(
+    unsigned int*          pWord,
+    unsigned int           uiExpected,
+    const struct timespec* pDeadline,
+    int                    bShared );
+
+/**
+ * \brief   Wakes threads waiting on a futex word
+ *
+ * \param[in] pWord   : Futex word
+ * \param[in] iCount  : Maximum number of threads to wake, INT_MAX for all
+ * \param[in] bShared : Non-zero if the word is in memory shared between processes
+ * \retval  The number of threads woken
+ */
+int pu_futex_wake(
+    unsigned int* pWord,
+    int           iCount,
+    int           bShared );
+
+/**
+ * \brief   Converts a timeout into an absolute \c CLOCK_MONOTONIC deadline
+ *
+ * \param[out] pTs         : Deadline storage
+ * \param[in]  uiTimeoutMs : Timeout in ms, or \ref PU_FUTEX_WAIT_FOREVER
+ * \retval  pTs, or NULL for \ref PU_FUTEX_WAIT_FOREVER
+ */
+const struct timespec* pu_futex_deadline(
+    struct timespec* pTs,
+    size_t           uiTimeoutMs );
+
+/**
+ * \brief   Creates (initialises) a semaphore
+ *
+ * \param[in] pSem      : Pointer to a valid semaphore
+ * \param[in] uiInitial : Initial value
+ * \param[in] bShared   : Non-zero if the semaphore is in memory shared between processes
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ */
+int pu_sem_create(
+    pu_sem_t*    pSem,
+    unsigned int uiInitial,
+    int          bShared );
+
+/**
+ * \brief   Increments the semaphore, waking one waiter if there is one
+ *
+ * \param[in] pSem : Pointer to a valid semaphore
+ * \retval  0 for success
+ */
+int pu_sem_post( pu_sem_t* pSem );
+
+/**
+ * \brief   Adds a batch of units to the semaphore, waking up to that many waiters
+ *
+ * \param[in] pSem    : Pointer to a valid semaphore
+ * \param[in] uiCount : Number of units
+ * \retval  0 for success
+ */
+int pu_sem_post_n(
+    pu_sem_t*    pSem,
+    unsigned int uiCount );
+
+/**
+ * \brief   Decrements the semaphore if it is non-zero, never waits
+ *
+ * \param[in] pSem : Pointer to a valid semaphore
+ * \retval  0 for success
+ * \retval  EAGAIN the value was zero
+ */
+int pu_sem_trywait( pu_sem_t* pSem );
+
+/**
+ * \brief   Decrements the semaphore, waiting at most the timeout
+ *
+ * \param[in] pSem        : Pointer to a valid semaphore
+ * \param[in] uiTimeoutMs : Timeout in ms, or \ref PU_FUTEX_WAIT_FOREVER
+ * \retval  0 for success
+ * \retval  ETIMEDOUT the timeout expired
+ */
+int pu_sem_timedwait(
+    pu_sem_t* pSem,
+    size_t    uiTimeoutMs );
+
+/**
+ * \brief   Decrements the semaphore, waiting for as long as it takes
+ *
+ * \param[in] pSem : Pointer to a valid semaphore
+ * \retval  0 for success
+ */
+int pu_sem_wait( pu_sem_t* pSem );
+
+/**
+ * \brief   Current value of the semaphore (a snapshot)
+ *
+ * \param[in] pSem : Pointer to a valid semaphore
+ * \retval  The value
+ */
+unsigned int pu_sem_value( const pu_sem_t* pSem );
+
+/**
+ * \brief   Creates (initialises) an event count
+ *
+ * \param[in] pEc : Pointer to a valid event count
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ */
+int pu_eventcount_create( pu_eventcount_t* pEc );
+
+/**
+ * \brief   Announces an intent to wait
+ *
+ * \param[in] pEc : Pointer to a valid event count
+ * \retval  The key, to pass to \ref pu_eventcount_wait
+ *
+ * \post    The caller \b MUST follow up with either \ref pu_eventcount_wait or \ref pu_eventcount_cancel_wait
+ */
+unsigned int pu_eventcount_prepare_wait( pu_eventcount_t* pEc );
+
+/**
+ * \brief   Withdraws an intent to wait, the condition became true
+ *
+ * \param[in] pEc : Pointer to a valid event count
+ */
+void pu_eventcount_cancel_wait( pu_eventcount_t* pEc );
+
+/**
+ * \brief   Waits until the event count is notified after the key was taken
+ *
+ * \param[in] pEc         : Pointer to a valid event count
+ * \param[in] uiKey       : Value returned by \ref pu_eventcount_prepare_wait
+ * \param[in] uiTimeoutMs : Timeout in ms, or \ref PU_FUTEX_WAIT_FOREVER
+ * \retval  0 notified, re-check the condition
+ * \retval  ETIMEDOUT the timeout expired
+ */
+int pu_eventcount_wait(
+    pu_eventcount_t* pEc,
+    unsigned int     uiKey,
+    size_t           uiTimeoutMs );
+
+/**
+ * \brief   Notifies the waiters (at least one), no syscall when nobody waits
+ *
+ * \param[in] pEc : Pointer to a valid event count
+ */
+void pu_eventcount_notify( pu_eventcount_t* pEc );
+
+/**
+ * \brief   Notifies all the waiters, no syscall when nobody waits
+ *
+ * \param[in] pEc : Pointer to a valid event count
+ */
+void pu_eventcount_notify_all( pu_eventcount_t* pEc );
+
+/**
+ * \}
+ */
+
+PU_API_END
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* _PUFUTEX_H_ */
@@ -0,0 +1,486 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUFUTURE_H_
+#define _PUFUTURE_H_
+
+/**** Includes ***************************************************************/
+/* Outside the extern "C" block, posutils.h carries C++ templates */
+#include <stddef.h>
+#include <stdint.h>
+#include "posutils.h"
+
+#include "pudefs.h"
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+PU_API_BEGIN
+
+/**
+ * \file     pufuture.h
+ * \brief    Futures, promises, continuations and the executors that run them
+ */
+
+/**
+ * \defgroup PFUTURE Futures and executors
+ * \ingroup  POSUTILS
+ *
+ * \brief
+ * A promise/future pair carries one result, a \c void* value or an error, from the thread that
+ * produces it to the code that needs it. Rather than blocking a thread on the result, a
+ * continuation can be attached with \ref pu_future_then. It runs on a chosen executor once the
+ * result is known, and yields a new future, so asynchronous steps compose without any thread
+ * waiting in between.
+ *
+ * \section pfuture_sect_1 Results
+ * A future completes exactly once, with a value and an error code (0 for success). Completing
+ * a promise, or releasing it unfulfilled, hands over the promise reference. An unfulfilled
+ * promise completes its future with \c EPIPE, so a continuation always runs eventually.
+ * Derived futures complete with:
+ * - \ref pu_future_then : the value and error returned by the continuation
+ * - \ref pu_future_when_all : NULL, and the first non-zero error of the inputs
+ * - \ref pu_future_when_any : the index of the first input to complete, and its error
+ * - \ref pu_future_timeout : the input's result, or \c ETIMEDOUT if the timer fires first
+ * .
+ *
+ * \section pfuture_sect_2 Cost
+ * Shared states come from a pre-allocated pool, with a heap fallback when it runs dry. Setting
+ * a value, attaching a continuation and reading a ready future are atomic operations only, no
+ * mutex is taken. The futex wake is only made when a thread is blocked in \ref pu_future_wait.
+ * Timeouts go through one timer of the timer service (see putimer.h), re-armed for the
+ * earliest deadline, so their resolution is \ref PUTIMER_MIN_TIMEOUT.
+ *
+ * \section pfuture_sect_3 Executors
+ * An executor is anything that can run a \ref pu_task_t. Two are provided:
+ * - \ref pu_executor_inline runs the task straight away, in the thread that completed the future.
+ *   Only suitable for short continuations.
+ * - \ref pu_executor_pool_t is a fixed set of threads (created with \ref pu_thread_create)
+ *   fed by a lock-free queue.
+ * .
+ *
+ * \par Usage
+ * \code
+ * pu_promise_t prmReply;
+ * pu_future_t  futReply;
+ * pu_promise_create( &prmReply, &futReply );
+ * pu_future_t futParsed = pu_future_then( futReply, &(stPool.stExec), parse_reply, NULL );
+ * pu_future_t futDone   = pu_future_timeout( futParsed, 500 );
+ * send_request( prmReply );                     // some other thread calls pu_promise_set_value
+ * ...
+ * if (0 == pu_future_get( futDone, &pResult, PU_FUTURE_WAIT_FOREVER )) { ... }
+ * pu_future_release( futDone );
+ * pu_future_release( futParsed );
+ * pu_future_release( futReply );
+ * \endcode
+ *
+ * \{
+ */
+
+/**** Definitions ************************************************************/
+
+/**
+ * Timeout value for an unbounded wait
+ */
+#define PU_FUTURE_WAIT_FOREVER PU_FUTEX_WAIT_FOREVER
+
+/**
+ * Shared states in the pre-allocated pool
+ */
+#define PU_FUTURE_POOL_SIZE (1024)
+
+/**
+ * \brief Task function
+ */
+typedef void (*pu_task_fct_t)( void* pArg );
+
+/**
+ * \brief A unit of work for an executor. The submitter owns the memory until it has run.
+ */
+typedef struct pu_task_tag
+{
+    pu_task_fct_t fctTask;    /* Work function */
+    void*         pArg;       /* Its argument  */
+}   pu_task_t;
+
+/**
+ * \brief Executor interface
+ */
+typedef struct pu_executor_tag pu_executor_t;
+struct pu_executor_tag
+{
+    /* Runs the task, now or later. Returns 0 if the task will run. */
+    int (*fctSubmit)( pu_executor_t* pExec, pu_task_t* pTask );
+};
+
+/**
+ * \brief A pool of threads running tasks from a queue
+ *
+ * \note
+ * Treat the contents as private, the structure is exposed so that the caller can provide the storage.
+ * \c stExec is the executor to pass to \ref pu_future_then.
+ */
+typedef struct pu_executor_pool_tag
+{
+    pu_executor_t     stExec;     /* Must be first */
+    pu_queue_t        stQueue;    /* Pending tasks */
+    pu_thread_group_t stGroup;    /* Workers       */
+}   pu_executor_pool_t;
+
+/**
+ * \brief Future handle, a reference to a shared state
+ */
+typedef struct pu_future_state_tag* pu_future_t;
+
+/**
+ * \brief Promise handle, the producer side of a shared state
+ */
+typedef struct
+{
+    pu_future_t hState;
+}   pu_promise_t;
+
+/**
+ * \brief   Continuation function
+ *
+ * \param[in]  pValue   : Value of the completed future
+ * \param[in]  iError   : Error of the completed future, 0 for success
+ * \param[in]  pArg     : Argument passed to \ref pu_future_then
+ * \param[out] ppResult : Value of the derived future
+ * \retval  Error of the derived future, 0 for success
+ */
+typedef int (*pu_future_then_fct_t)(
+    void*  pValue,
+    int    iError,
+    void*  pArg,
+    void** ppResult );
+
+/**
+ * \brief   Returns the executor that runs tasks in the calling thread
+ */
+pu_executor_t* pu_executor_inline( void );
+
+/**
+ * \brief   Creates a thread pool executor
+ *
+ * \param[in] pPool       : Pointer to a valid pool
+ * \param[in] uiThreads   : Number of worker threads
+ * \param[in] uiQueueSize : Pending tasks before a submit is refused (EAGAIN)
+ * \param[in] szName      : Worker thread name, persistent
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ */
+int pu_executor_pool_create(
+    pu_executor_pool_t* pPool,
+    size_t              uiThreads,
+    size_t              uiQueueSize,
+    const char*         szName );
+
+/**
+ * \brief   Runs the tasks already submitted, then stops the workers
+ *
+ * \param[in] pPool : Pointer to a valid pool
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ *
+ * \pre     Nothing submits to the pool any more
+ */
+int pu_executor_pool_destroy( pu_executor_pool_t* pPool );
+
+/**
+ * \brief   Creates a promise and its future
+ *
+ * \param[out] pPromise : Promise, completed (or released) exactly once
+ * \param[out] pFuture  : Future, released with \ref pu_future_release
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ */
+int pu_promise_create(
+    pu_promise_t* pPromise,
+    pu_future_t*  pFuture );
+
+/**
+ * \brief   Completes the promise with a value. The promise is consumed.
+ *
+ * \param[in] pPromise : Promise
+ * \param[in] pValue   : Value
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ */
+int pu_promise_set_value(
+    pu_promise_t* pPromise,
+    void*         pValue );
+
+/**
+ * \brief   Completes the promise with an error. The promise is consumed.
+ *
+ * \param[in] pPromise : Promise
+ * \param[in] iError   : Non-zero error code
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ */
+int pu_promise_set_error(
+    pu_promise_t* pPromise,
+    int           iError );
+
+/**
+ * \brief   Releases a promise. If it was not completed its future fails with \c EPIPE.
+ *
+ * \param[in] pPromise : Promise
+ */
+void pu_promise_release( pu_promise_t* pPromise );
+
+/**
+ * \brief   Checks if a future has completed, never blocks
+ *
+ * \param[in] hFuture : Future
+ * \retval  Non-zero if it has completed
+ */
+int pu_future_is_ready( pu_future_t hFuture );
+
+/**
+ * \brief   Waits for a future to complete
+ *
+ * \param[in] hFuture     : Future
+ * \param[in] uiTimeoutMs : Timeout in ms, or \ref PU_FUTURE_WAIT_FOREVER
+ * \retval  0 completed
+ * \retval  ETIMEDOUT the timeout expired
+ */
+int pu_future_wait(
+    pu_future_t hFuture,
+    size_t      uiTimeoutMs );
+
+/**
+ * \brief   Waits for a future to complete, and reads its result
+ *
+ * \param[in]  hFuture     : Future
+ * \param[out] ppValue     : Value, may be NULL
+ * \param[in]  uiTimeoutMs : Timeout in ms, or \ref PU_FUTURE_WAIT_FOREVER
+ * \retval  The error of the future, 0 for success
+ * \retval  ETIMEDOUT if it did not complete in time (the future may also fail with ETIMEDOUT)
+ */
+int pu_future_get(
+    pu_future_t hFuture,
+    void**      ppValue,
+    size_t      uiTimeoutMs );
+
+/**
+ * \brief   Releases a future handle
+ *
+ * \param[in] hFuture : Future
+ *
+ * \par Description
+ * Continuations already attached still run, they hold their own references.
+ */
+void pu_future_release( pu_future_t hFuture );
+
+/**
+ * \brief   Attaches a continuation
+ *
+ * \param[in] hFuture : Future, the caller keeps its reference
+ * \param[in] pExec   : Executor that runs the continuation
+ * \param[in] fctThen : Continuation, called with the result of \c hFuture
+ * \param[in] pArg    : Continuation argument
+ * \retval  A new future, completed with the result of the continuation
+ * \retval  NULL on failure
+ */
+pu_future_t pu_future_then(
+    pu_future_t          hFuture,
+    pu_executor_t*       pExec,
+    pu_future_then_fct_t fctThen,
+    void*                pArg );
+
+/**
+ * \brief   Combines futures, completes when all of them have
+ *
+ * \param[in] pFutures : Futures, the caller keeps its references
+ * \param[in] uiCount  : Number of futures, non-zero
+ * \retval  A new future: value NULL, error the first non-zero error of the inputs
+ * \retval  NULL on failure
+ */
+pu_future_t pu_future_when_all(
+    const pu_future_t* pFutures,
+    size_t             uiCount );
+
+/**
+ * \brief   Combines futures, completes when the first of them does
+ *
+ * \param[in] pFutures : Futures, the caller keeps its references
+ * \param[in] uiCount  : Number of futures, non-zero
+ * \retval  A new future: value the index of the first input (as \c uintptr_t), error its error
+ * \retval  NULL on failure
+ */
+pu_future_t pu_future_when_any(
+    const pu_future_t* pFutures,
+    size_t             uiCount );
+
+/**
+ * \brief   Bounds the time a future may take
+ *
+ * \param[in] hFuture     : Future, the caller keeps its reference
+ * \param[in] uiTimeoutMs : Timeout in ms
+ * \retval  A new future: the result of \c hFuture, or \c ETIMEDOUT
+ * \retval  NULL on failure
+ *
+ * \pre     The timer service is initialised (\ref POSUTILS_INIT)
+ */
+pu_future_t pu_future_timeout(
+    pu_future_t hFuture,
+    size_t      uiTimeoutMs );
+
+/**
+ * \}
+ */
+
+PU_API_END
+#ifdef __cplusplus
+}
+
+#include <string.h>
+#include <type_traits>
+#include <utility>
+
+namespace pu {
+
+namespace detail {
+
+/* Values travel through the C API as void*, so they must fit in one */
+template <typename T>
+struct future_value
+{
+    static_assert( (sizeof(T) <= sizeof(void*)) && std::is_trivially_copyable<T>::value,
+                   "future values must be trivially copyable and pointer sized" );
+
+    static void* pack( T value ) {
+        void* p = nullptr;
+        memcpy( &p, &value, sizeof(T) );
+        return (p);
+    }
+    static T unpack( void* p ) {
+        T value;
+        memcpy( &value, &p, sizeof(T) );
+        return (value);
+    }
+};
+
+} // namespace detail
+
+/**
+ * \brief C++ wrapper, a move-only future handle
+ * \ingroup PFUTURE
+ *
+ * \code
+ * pu::promise<int> prmCount;
+ * pu::future<int>  futCount = prmCount.get_future();
+ * pu::future<double> futMean = futCount.then<double>( &(stPool.stExec), [&]( int iCount, int& iError ) {
+ *     return (iCount ? dSum / iCount : (iError = EDOM, 0.0));
+ * } ).timeout( 100 );
+ * prmCount.set_value( 42 );
+ * \endcode
+ */
+template <typename T>
+class future
+{
+public:
+    future() : m_h( nullptr ) {}
+    explicit future( pu_future_t h ) : m_h( h ) {}
+    future( future&& other ) : m_h( other.m_h ) { other.m_h = nullptr; }
+    future& operator=( future&& other ) {
+        std::swap( m_h, other.m_h );
+        return (*this);
+    }
+    future( const future& ) = delete;
+    future& operator=( const future& ) = delete;
+    ~future() { if (m_h) pu_future_release( m_h ); }
+
+    bool valid() const { return (nullptr != m_h); }
+    bool ready() const { return (0 != pu_future_is_ready( m_h )); }
+    pu_future_t handle() const { return (m_h); }
+
+    /* Returns the error of the future (0 for success), or ETIMEDOUT */
+    int get( T& value, size_t uiTimeoutMs = PU_FUTURE_WAIT_FOREVER ) const {
+        void* p = nullptr;
+        int   iError = pu_future_get( m_h, &p, uiTimeoutMs );
+        if (0 == iError) {
+            value = detail::future_value<T>::unpack( p );
+        }
+        return (iError);
+    }
+
+    /* fct is called as R fct( T value, int& iError ), iError is the error of this future */
+    template <typename R, typename F>
+    future<R> then( pu_executor_t* pExec, F fct ) const {
+        F* pFct = new F( std::move( fct ) );
+        pu_future_t h = pu_future_then( m_h, pExec, &future::template run_then<R, F>, pFct );
+        if (!h) {
+            delete pFct;
+        }
+        return (future<R>( h ));
+    }
+
+    future timeout( size_t uiTimeoutMs ) const {
+        return (future( pu_future_timeout( m_h, uiTimeoutMs ) ));
+    }
+
+private:
+    template <typename R, typename F>
+    static int run_then( void* pValue, int iError, void* pArg, void** ppResult ) {
+        F* pFct = static_cast<F*>( pArg );
+        R  result = (*pFct)( detail::future_value<T>::unpack( pValue ), iError );
+        delete pFct;
+        *ppResult = detail::future_value<R>::pack( result );
+        return (iError);
+    }
+
+    pu_future_t m_h;
+};
+
+/**
+ * \brief C++ wrapper, the producer side. An unfulfilled promise fails its future with EPIPE.
+ * \ingroup PFUTURE
+ */
+template <typename T>
+class promise
+{
+public:
+    promise() : m_future() {
+        pu_future_t h = nullptr;
+        if (0 == pu_promise_create( &m_prm, &h )) {
+            m_future = future<T>( h );
+        } else {
+            m_prm.hState = nullptr;
+        }
+    }
+    promise( const promise& ) = delete;
+    promise& operator=( const promise& ) = delete;
+    ~promise() { if (m_prm.hState) pu_promise_release( &m_prm ); }
+
+    /* Once only */
+    future<T> get_future() { return (std::move( m_future )); }
+
+    int set_value( T value ) { return (pu_promise_set_value( &m_prm, detail::future_value<T>::pack( value ) )); }
+    int set_error( int iError ) { return (pu_promise_set_error( &m_prm, iError )); }
+
+private:
+    pu_promise_t m_prm;
+    future<T>    m_future;
+};
+
+} // namespace pu
+#endif /* __cplusplus */
+#endif /* _PUFUTURE_H_ */
@@ -0,0 +1,210 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUHAZARD_H_
+#define _PUHAZARD_H_
+#include "pudefs.h"
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+PU_API_BEGIN
+
+/**
+ * \file     puhazard.h
+ * \brief    Hazard pointers, bounded memory reclamation for lock-free structures
+ */
+
+/**
+ * \defgroup PHAZARD Hazard pointers
+ * \ingroup  POSUTILS
+ *
+ * \brief
+ * Hazard pointers solve the same problem as \ref PEBR "EBR", but a reader protects the
+ * individual objects it uses instead of a whole section. A thread that stalls, or blocks for a
+ * long time, only keeps the (few) objects it has published alive. The memory waiting to be
+ * freed stays bounded whatever the readers do.
+ *
+ * \section phazard_sect_1 How it works
+ * Every thread owns \ref PU_HAZARD_SLOTS slots. Before using a shared pointer a reader publishes
+ * it in a slot and checks that it is still the current value, see \ref pu_hazard_protect.
+ * A retired object goes on the retiring thread's list. Once the list holds more than the scan
+ * threshold, the thread collects all the published pointers and frees every object that is not
+ * among them.
+ *
+ * \section phazard_sect_2 Cost
+ * Protecting a pointer is a store, a fence and a re-load. That is more than an EBR section,
+ * which pays the fence once for any number of loads, so use EBR where stalls are not an issue.
+ * The scan threshold is \ref PU_HAZARD_RETIRE_MIN or twice the number of slots, whichever is
+ * larger. Each scan therefore frees at least half of the list, and the scan cost is constant
+ * per retired object.
+ *
+ * \section phazard_sect_3 Threads
+ * The slots come with the thread: threads created with \ref pu_thread_create are registered on
+ * entry and unregistered on exit, other threads call \ref pu_hazard_register and
+ * \ref pu_hazard_unregister themselves.
+ *
+ * \par Usage
+ * \code
+ * // Reader
+ * config_t* pCfg = (config_t*)pu_hazard_protect( 0, (void* const*)&pConfig );
+ * iValue = pCfg->iValue;
+ * pu_hazard_clear( 0 );
+ *
+ * // Writer
+ * config_t* pOld = __atomic_exchange_n( &pConfig, pNew, __ATOMIC_ACQ_REL );
+ * pu_hazard_retire( &(pOld->stNode), pOld, free );
+ * \endcode
+ *
+ * \{
+ */
+
+/**** Includes ***************************************************************/
+#include <stddef.h>
+
+/**** Definitions ************************************************************/
+
+/**
+ * Hazard slots per thread
+ */
+#define PU_HAZARD_SLOTS (4)
+
+/**
+ * Smallest retire list that triggers a scan
+ */
+#define PU_HAZARD_RETIRE_MIN (64)
+
+/**
+ * \brief Free function, called with the retired object
+ */
+typedef void (*pu_hazard_free_fct_t)( void* pObj );
+
+/**
+ * \brief Retire list link, embedded in the object to be reclaimed
+ */
+typedef struct pu_hazard_node_tag
+{
+    struct pu_hazard_node_tag* pNext;     /* Retire list link                     */
+    void*                      pObj;      /* Object, as published by the readers  */
+    pu_hazard_free_fct_t       fctFree;   /* Free function                        */
+}   pu_hazard_node_t;
+
+/**
+ * \brief   Registers the calling thread, and gives it its hazard slots
+ *
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ *
+ * \par Description
+ * Registrations nest, a thread registered by \ref pu_thread_create may register again.
+ */
+int pu_hazard_register( void );
+
+/**
+ * \brief   Unregisters the calling thread, its slots are cleared
+ */
+void pu_hazard_unregister( void );
+
+/**
+ * \brief   Loads a shared pointer and protects it
+ *
+ * \param[in] uiSlot : Slot to use, less than \ref PU_HAZARD_SLOTS
+ * \param[in] ppSrc  : Shared pointer
+ * \retval  The pointer, safe to use until the slot is cleared or reused. May be NULL.
+ */
+void* pu_hazard_protect(
+    unsigned int uiSlot,
+    void* const* ppSrc );
+
+/**
+ * \brief   Clears a slot, the object it protected may be freed
+ *
+ * \param[in] uiSlot : Slot to clear
+ */
+void pu_hazard_clear( unsigned int uiSlot );
+
+/**
+ * \brief   Retires an unlinked object, it is freed once no slot holds it
+ *
+ * \param[in] pNode   : Node embedded in (or allocated with) the object
+ * \param[in] pObj    : The object, as the readers protect it
+ * \param[in] fctFree : Free function
+ *
+ * \pre     The object is no longer reachable from the shared structure
+ * \pre     The thread is registered
+ */
+void pu_hazard_retire(
+    pu_hazard_node_t*    pNode,
+    void*                pObj,
+    pu_hazard_free_fct_t fctFree );
+
+/**
+ * \brief   Scans now, whatever the length of the retire list
+ */
+void pu_hazard_scan( void );
+
+/**
+ * \brief   Frees every retired object that is not protected, including the ones left by exited threads
+ *
+ * \par Description
+ * Meant for shutdown and tests. Objects that are still protected are kept.
+ */
+void pu_hazard_flush( void );
+
+/**
+ * \}
+ */
+
+PU_API_END
+#ifdef __cplusplus
+}
+
+namespace pu {
+
+/**
+ * \brief C++ wrapper, a hazard slot protecting one pointer for the lifetime of the object
+ * \ingroup PHAZARD
+ *
+ * \code
+ * pu::hazard_ptr<config_t> pCfg( 0, &pConfig );
+ * iValue = pCfg->iValue;
+ * \endcode
+ */
+template <typename T>
+class hazard_ptr
+{
+public:
+    hazard_ptr( unsigned int uiSlot, T* const* ppSrc )
+        : m_uiSlot( uiSlot ),
+          m_p( static_cast<T*>( pu_hazard_protect( uiSlot, reinterpret_cast<void* const*>( ppSrc ) ) ) ) {}
+    ~hazard_ptr() { pu_hazard_clear( m_uiSlot ); }
+    hazard_ptr( const hazard_ptr& ) = delete;
+    hazard_ptr& operator=( const hazard_ptr& ) = delete;
+
+    T* get() const { return (m_p); }
+    T* operator->() const { return (m_p); }
+    T& operator*() const { return (*m_p); }
+
+private:
+    unsigned int m_uiSlot;
+    T*           m_p;
+};
+
+} // namespace pu
+#endif /* __cplusplus */
+#endif /* _PUHAZARD_H_ */
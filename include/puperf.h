@@ -0,0 +1,155 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUPERF_H_
+#define _PUPERF_H_
+#include "pudefs.h"
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+PU_API_BEGIN
+
+/**
+ * \file     puperf.h
+ * \brief    Per-thread performance counters
+ */
+
+/**
+ * \defgroup PPERF Performance counters
+ * \ingroup  POSUTILS
+ *
+ * \brief
+ * Once enabled, every thread created by \ref pu_thread_create opens its own counters with
+ * \c perf_event_open when it starts, and closes them when it exits. The counters only count
+ * while that thread runs, so cycles, instructions and cache misses can be put down to a named
+ * worker (IPC = instructions / cycles).
+ *
+ * \section pperf_sect_1 Availability
+ * Each counter is opened on its own, and the ones the system refuses are left out, see
+ * \c uiValid in \ref pu_perf_counters_t. Hardware counters need a PMU (often missing in virtual
+ * machines), and \c perf_event_paranoid at 2 or less. Kernel time is counted where permitted.
+ *
+ * \section pperf_sect_2 Reading
+ * A thread reads its own counters with \ref pu_perf_read. On x86 a hardware counter that is
+ * on the PMU, and was never multiplexed, is read in user space with \c rdpmc (the kernel allows
+ * it when \c /sys/bus/event_source/devices/cpu/rdpmc is 1 or more). Any other counter costs a
+ * \c read() system call, with the value scaled up when the kernel has multiplexed it.
+ * \ref pu_perf_read_all reads every registered thread with \c read().
+ *
+ * \par Usage
+ * \code
+ * pu_perf_enable( PU_PERF_ALL );
+ * ...
+ * uiThreads = pu_perf_read_all( pCounters, MAX_WORKERS );
+ * \endcode
+ *
+ * \{
+ */
+
+/**** Includes ***************************************************************/
+#include <stddef.h>
+#include <stdint.h>
+
+/**** Definitions ************************************************************/
+
+/**
+ * Counters
+ */
+typedef enum
+{
+    PU_PERF_CYCLES,            /*!< CPU cycles                    */
+    PU_PERF_INSTRUCTIONS,      /*!< Instructions retired          */
+    PU_PERF_CACHE_MISSES,      /*!< Last level cache misses       */
+    PU_PERF_CONTEXT_SWITCHES,  /*!< Context switches (software)   */
+    PU_PERF_UNDEF              /* enum terminator..               */
+}   pu_perf_event_t;
+
+/**
+ * Mask bit of a counter
+ */
+#define PU_PERF_MASK(event_) (1U << (event_))
+
+/**
+ * Every counter
+ */
+#define PU_PERF_ALL (PU_PERF_MASK(PU_PERF_UNDEF) - 1)
+
+/**
+ * \brief A snapshot of the counters of one thread
+ */
+typedef struct pu_perf_counters_tag
+{
+    const char*  szName;                    /* Thread name                     */
+    int          iTid;                      /* Linux thread ID                 */
+    unsigned int uiValid;                   /* PU_PERF_MASK of the open counters */
+    uint64_t     pValues[PU_PERF_UNDEF];    /* Counts since the thread started */
+}   pu_perf_counters_t;
+
+/**
+ * \brief   Selects the counters of threads created from now on
+ *
+ * \param[in] uiEvents : \ref PU_PERF_MASK combination, 0 to stop opening counters
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ */
+int pu_perf_enable( unsigned int uiEvents );
+
+/**
+ * \brief   Opens the counters of the calling thread, done by \ref pu_thread_create for its threads
+ *
+ * \param[in] szName : Thread name, persistent
+ * \retval  0 for success
+ * \retval  Non-zero when counters are not enabled, or none could be opened
+ */
+int pu_perf_register( const char* szName );
+
+/**
+ * \brief   Closes the counters of the calling thread
+ */
+void pu_perf_unregister( void );
+
+/**
+ * \brief   Reads the counters of the calling thread
+ *
+ * \param[out] pCounters : Snapshot
+ * \retval  0 for success
+ * \retval  Non-zero for failure (the thread has no counters)
+ */
+int pu_perf_read( pu_perf_counters_t* pCounters );
+
+/**
+ * \brief   Reads the counters of every registered thread
+ *
+ * \param[out] pCounters : Snapshots
+ * \param[in]  uiMax     : Size of the array
+ * \retval  The number of snapshots written
+ */
+size_t pu_perf_read_all(
+    pu_perf_counters_t* pCounters,
+    size_t              uiMax );
+
+/**
+ * \}
+ */
+
+PU_API_END
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* _PUPERF_H_ */
@@ -0,0 +1,101 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUPROBES_H_
+#define _PUPROBES_H_
+
+/**
+ * \file     puprobes.h
+ * \brief    USDT (statically defined tracing) probes
+ */
+
+/**
+ * \defgroup PPROBES Static probes
+ * \ingroup  POSUTILS
+ *
+ * \brief
+ * The library marks its key points with USDT probes, for \c bpftrace, \c perf and SystemTap.
+ * A probe is a single \c nop in the code plus an ELF note describing where its arguments live,
+ * so it costs next to nothing until a tool attaches to it. The arguments are values the code
+ * already has at that point, the timer lateness is the only one computed (a subtraction).
+ *
+ * \section pprobes_sect_1 Availability
+ * The probes are built when \c <sys/sdt.h> is found (package \c systemtap-sdt-dev or
+ * \c systemtap-sdt-devel), unless \c PU_PROBES_DISABLE is defined. Without it the macros compile
+ * to nothing. With them, \ref pu_mutex_lock takes a contended mutex with a trylock first.
+ *
+ * \section pprobes_sect_2 Probes
+ * Provider \c posutils:
+ * | Probe                      | Arguments                                           |
+ * |----------------------------|-----------------------------------------------------|
+ * | thread__create             | name, pthread_t                                     |
+ * | thread__start              | name, tid                                           |
+ * | thread__exit               | name, tid                                           |
+ * | timer__create              | handle, type, period ms, callback                   |
+ * | timer__start               | handle, deadline (CLOCK_MONOTONIC ns), period ms    |
+ * | timer__stop                | handle, was active, ms left                         |
+ * | timer__fire                | handle, deadline (CLOCK_MONOTONIC ns), lateness ns  |
+ * | timer__callback__entry     | handle, callback                                    |
+ * | timer__callback__return    | handle, callback                                    |
+ * | mutex__contended           | mutex, label (NULL unless instrumented)             |
+ * | mutex__acquired            | mutex, label, only after mutex__contended           |
+ *
+ * \c timer__start also fires each time a periodic timer is re-armed.
+ *
+ * \par Usage
+ * \code
+ * bpftrace -e 'usdt:./my_app:posutils:timer__fire { @late_us = hist(arg2 / 1000); }'
+ * \endcode
+ *
+ * \{
+ */
+
+/**** Includes ***************************************************************/
+#if !defined(PU_PROBES_DISABLE) && defined(__has_include)
+    #if __has_include(<sys/sdt.h>)
+        #include <sys/sdt.h>
+        #define PU_PROBES_ENABLED (1)
+    #endif
+#endif
+
+/**** Definitions ************************************************************/
+
+/**
+ * Probes with zero to four arguments, the arguments must be integers or pointers
+ */
+#if defined(PU_PROBES_ENABLED)
+    #define PU_PROBE0(name_)                    DTRACE_PROBE( posutils, name_ )
+    #define PU_PROBE1(name_,a1_)                DTRACE_PROBE1( posutils, name_, a1_ )
+    #define PU_PROBE2(name_,a1_,a2_)            DTRACE_PROBE2( posutils, name_, a1_, a2_ )
+    #define PU_PROBE3(name_,a1_,a2_,a3_)        DTRACE_PROBE3( posutils, name_, a1_, a2_, a3_ )
+    #define PU_PROBE4(name_,a1_,a2_,a3_,a4_)    DTRACE_PROBE4( posutils, name_, a1_, a2_, a3_, a4_ )
+#else
+    /* Never evaluated, but the arguments still count as used */
+    #define PU_PROBE0(name_)                    do { } while (0)
+    #define PU_PROBE1(name_,a1_)                do { if (0) { (void)(a1_); } } while (0)
+    #define PU_PROBE2(name_,a1_,a2_)            do { if (0) { (void)(a1_); (void)(a2_); } } while (0)
+    #define PU_PROBE3(name_,a1_,a2_,a3_)        do { if (0) { (void)(a1_); (void)(a2_); (void)(a3_); } } while (0)
+    #define PU_PROBE4(name_,a1_,a2_,a3_,a4_)    do { if (0) { (void)(a1_); (void)(a2_); (void)(a3_); (void)(a4_); } } while (0)
+#endif
+
+/**
+ * \}
+ */
+
+#endif /* _PUPROBES_H_ */
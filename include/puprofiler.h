@@ -0,0 +1,193 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUPROFILER_H_
+#define _PUPROFILER_H_
+#include "pudefs.h"
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+PU_API_BEGIN
+
+/**
+ * \file     puprofiler.h
+ * \brief    Per-thread sampling profiler on CPU-time timers
+ */
+
+/**
+ * \defgroup PPROFILER Sampling profiler
+ * \ingroup  POSUTILS
+ *
+ * \brief
+ * While the profiler is started, every thread created by \ref pu_thread_create arms a
+ * \c CLOCK_THREAD_CPUTIME_ID timer when it starts. The timer is delivered to that thread only
+ * (\c SIGEV_THREAD_ID), so a thread is sampled in proportion to the CPU time it uses, and a
+ * blocked thread costs nothing. The kernel checks CPU time timers on the scheduler tick, rates
+ * above \c CONFIG_HZ (100 to 1000, depending on the kernel) come out at the tick rate.
+ *
+ * \section pprofiler_sect_1 Samples
+ * The signal handler records the interrupted call stack into a ring owned by the thread. There
+ * is no lock, the handler is the only writer and \ref pu_profiler_collect the only reader. A
+ * full ring drops the sample (see \ref pu_profiler_dropped). The stack comes from \c backtrace(),
+ * or with \ref PU_PROFILER_FLAG_FRAME_POINTERS from a walk of the frame pointer chain (x86-64
+ * and AArch64, code built with \c -fno-omit-frame-pointer), which is cheaper and never takes an
+ * unwinder lock.
+ *
+ * \section pprofiler_sect_2 Output
+ * \ref pu_profiler_dump writes folded stacks, one line per distinct stack:
+ * \code
+ * thread_name;outer_function;...;inner_function count
+ * \endcode
+ * which is the input of \c flamegraph.pl. Functions are named with \c dladdr(), so only exported
+ * symbols have names (link executables with \c -rdynamic). The others show as \c module+0xoffset.
+ *
+ * \par Usage
+ * \code
+ * pu_profiler_start( 99, 0 );
+ * ...
+ * pu_profiler_dump( pFile );
+ * \endcode
+ *
+ * \{
+ */
+
+/**** Includes ***************************************************************/
+#include <stddef.h>
+#include <stdio.h>
+
+/**** Definitions ************************************************************/
+
+/**
+ * Deepest stack recorded, outer frames beyond it are cut off
+ */
+#if !defined(PU_PROFILER_MAX_DEPTH)
+    #define PU_PROFILER_MAX_DEPTH (32)
+#endif
+
+/**
+ * Samples held per thread between two \ref pu_profiler_collect calls
+ */
+#if !defined(PU_PROFILER_RING_SAMPLES)
+    #define PU_PROFILER_RING_SAMPLES (128)
+#endif
+
+/**
+ * The sampling signal, may be overridden at build time
+ */
+#if !defined(PU_PROFILER_SIGNAL)
+    #define PU_PROFILER_SIGNAL (SIGPROF)
+#endif
+
+/**
+ * Highest sampling rate, per thread
+ */
+#define PU_PROFILER_MAX_HZ (10000)
+
+/**
+ * Walk the frame pointers instead of calling \c backtrace()
+ */
+#define PU_PROFILER_FLAG_FRAME_POINTERS (0x00000001)
+
+/**
+ * \brief   Starts sampling threads created from now on
+ *
+ * \param[in] uiHz    : Samples per second of thread CPU time, 1 to \ref PU_PROFILER_MAX_HZ
+ * \param[in] uiFlags : \ref PU_PROFILER_FLAG_FRAME_POINTERS, or 0
+ * \retval  0 for success
+ * \retval  Non-zero for failure, or already started
+ *
+ * \par Description
+ * Threads registered before a \ref pu_profiler_stop are sampled again. The signal handler is
+ * installed on the first start and stays installed.
+ */
+int pu_profiler_start(
+    unsigned int uiHz,
+    unsigned int uiFlags );
+
+/**
+ * \brief   Changes the sampling rate of every registered thread
+ *
+ * \param[in] uiHz : Samples per second, 0 pauses sampling
+ * \retval  0 for success
+ * \retval  Non-zero for failure, or not started
+ */
+int pu_profiler_set_rate( unsigned int uiHz );
+
+/**
+ * \brief   Stops sampling, the samples are kept
+ *
+ * \retval  0 for success
+ * \retval  Non-zero for failure, or not started
+ */
+int pu_profiler_stop( void );
+
+/**
+ * \brief   Samples the calling thread, done by \ref pu_thread_create for its threads
+ *
+ * \param[in] szName : Thread name, persistent
+ * \retval  0 for success
+ * \retval  Non-zero when the profiler is not started, or on failure
+ */
+int pu_profiler_register( const char* szName );
+
+/**
+ * \brief   Stops sampling the calling thread, and keeps its samples
+ */
+void pu_profiler_unregister( void );
+
+/**
+ * \brief   Moves the samples out of the thread rings into the profile
+ *
+ * \retval  The number of samples moved
+ *
+ * \par Description
+ * Call it often enough that the rings do not fill up, e.g. from a timer. The dump does it too.
+ */
+size_t pu_profiler_collect( void );
+
+/**
+ * \brief   Writes the profile as folded stacks
+ *
+ * \param[in] pFile : Output
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ */
+int pu_profiler_dump( FILE* pFile );
+
+/**
+ * \brief   Discards the profile, and the drop count
+ */
+void pu_profiler_reset( void );
+
+/**
+ * \brief   Samples dropped because a ring was full
+ *
+ * \retval  The number of samples
+ */
+size_t pu_profiler_dropped( void );
+
+/**
+ * \}
+ */
+
+PU_API_END
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* _PUPROFILER_H_ */
@@ -0,0 +1,470 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUQUEUE_H_
+#define _PUQUEUE_H_
+
+/**** Includes ***************************************************************/
+/* Outside the extern "C" block, the C++ part uses templates */
+#include <stddef.h>
+#include <time.h>
+#include "pudefs.h"
+#include "pufutex.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+PU_API_BEGIN
+
+/**
+ * \file     puqueue.h
+ * \brief    Lock-free bounded message queue
+ */
+
+/**
+ * \defgroup PQUEUE Bounded queue utility
+ * \ingroup  POSUTILS
+ *
+ * \brief
+ * A bounded, lock-free queue for passing messages between threads, based on D. Vyukov's
+ * bounded MPMC queue.
+ *
+ * \section pq_sect_1 Algorithm
+ * The capacity is a power of two. Every slot carries a sequence number, which tells a producer
+ * whether the slot is free for its lap, and a consumer whether the slot has been filled for its
+ * lap. A producer claims a position with a CAS on the enqueue index, writes the item, then
+ * publishes it by advancing the slot sequence. Consumers do the same on the dequeue index.
+ * Producers and consumers only meet on the slot they both use, the two indices are on separate
+ * cache lines.
+ *
+ * \section pq_sect_2 Specialisations
+ * - \ref PU_QUEUE_TYPE_MPMC : any number of producers and consumers.
+ * - \ref PU_QUEUE_TYPE_MPSC : one consumer. The dequeue side needs no CAS.
+ * - \ref PU_QUEUE_TYPE_SPSC : one producer and one consumer. Neither side needs a CAS.
+ * .
+ * Using a single producer/consumer type with more than one thread on that side is undefined.
+ *
+ * \section pq_sect_3 Batches and blocking
+ * The batch calls claim several consecutive slots with one CAS. The plain calls never block,
+ * they return \c EAGAIN when the queue is full or empty. The \c _wait calls park on an
+ * event count (see \ref PFUTEX) until there is room or data. A producer or consumer only pays
+ * for the wake-up syscall when somebody is actually parked.
+ *
+ * \section pq_sect_4 C++
+ * \ref pu::queue holds values of any copyable type, with the type selected at compile time.
+ * The C API passes \c void* items.
+ *
+ * \{
+ */
+
+/**** Definitions ************************************************************/
+
+/**
+ * \brief Queue types, by number of producers and consumers
+ */
+typedef enum
+{
+    PU_QUEUE_TYPE_MPMC,    /*!< Multiple producers, multiple consumers */
+    PU_QUEUE_TYPE_MPSC,    /*!< Multiple producers, single consumer    */
+    PU_QUEUE_TYPE_SPSC,    /*!< Single producer, single consumer       */
+    PU_QUEUE_TYPE_ENDDEF   /* Enum terminator                          */
+}   pu_queue_type;
+
+/**
+ * \brief Bounded queue of \c void* items
+ *
+ * \note
+ * Treat the contents as private, the structure is exposed so that the caller can provide the storage
+ */
+typedef struct pu_queue_tag
+{
+    /* Read only after creation */
+    struct PU_CACHELINE_ALIGNED
+    {
+        void*         pSlots;     /* Slot array                  */
+        size_t        uiMask;     /* Capacity - 1                */
+        pu_queue_type enType;     /* Producer/consumer model     */
+    }   stConst;
+
+    struct PU_CACHELINE_ALIGNED
+    {
+        size_t        uiPos;      /* Next position to enqueue    */
+    }   stEnq;
+
+    struct PU_CACHELINE_ALIGNED
+    {
+        size_t        uiPos;      /* Next position to dequeue    */
+    }   stDeq;
+
+    struct PU_CACHELINE_ALIGNED
+    {
+        pu_eventcount_t ecNotEmpty;   /* Parked consumers        */
+        pu_eventcount_t ecNotFull;    /* Parked producers        */
+    }   stWait;
+}   pu_queue_t;
+
+/**
+ * \brief   Creates (initialises) a queue
+ *
+ * \param[in] pQueue     : Pointer to a valid queue
+ * \param[in] enType     : Producer/consumer model
+ * \param[in] uiCapacity : Number of items, rounded up to a power of two (minimum 2)
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ */
+int pu_queue_create(
+    pu_queue_t*   pQueue,
+    pu_queue_type enType,
+    size_t        uiCapacity );
+
+/**
+ * \brief   Destroys a queue. Items still in the queue are not touched.
+ *
+ * \param[in] pQueue : Pointer to a valid queue
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ */
+int pu_queue_destroy( pu_queue_t* pQueue );
+
+/**
+ * \brief   Adds an item, never blocks
+ *
+ * \param[in] pQueue : Pointer to a valid queue
+ * \param[in] pItem  : Item
+ * \retval  0 for success
+ * \retval  EAGAIN the queue is full
+ */
+int pu_queue_push(
+    pu_queue_t* pQueue,
+    void*       pItem );
+
+/**
+ * \brief   Removes the oldest item, never blocks
+ *
+ * \param[in]  pQueue : Pointer to a valid queue
+ * \param[out] ppItem : Item
+ * \retval  0 for success
+ * \retval  EAGAIN the queue is empty
+ */
+int pu_queue_pop(
+    pu_queue_t* pQueue,
+    void**      ppItem );
+
+/**
+ * \brief   Adds as many items from an array as fit, never blocks
+ *
+ * \param[in] pQueue  : Pointer to a valid queue
+ * \param[in] ppItems : Items
+ * \param[in] uiCount : Number of items
+ * \retval  The number added, from the start of the array
+ */
+size_t pu_queue_push_batch(
+    pu_queue_t*  pQueue,
+    void* const* ppItems,
+    size_t       uiCount );
+
+/**
+ * \brief   Removes up to uiMax items, never blocks
+ *
+ * \param[in]  pQueue  : Pointer to a valid queue
+ * \param[out] ppItems : Items, oldest first
+ * \param[in]  uiMax   : Array size
+ * \retval  The number removed
+ */
+size_t pu_queue_pop_batch(
+    pu_queue_t* pQueue,
+    void**      ppItems,
+    size_t      uiMax );
+
+/**
+ * \brief   Adds an item, waiting for room if the queue is full
+ *
+ * \param[in] pQueue      : Pointer to a valid queue
+ * \param[in] pItem       : Item
+ * \param[in] uiTimeoutMs : Timeout in ms, or \ref PU_FUTEX_WAIT_FOREVER
+ * \retval  0 for success
+ * \retval  ETIMEDOUT the timeout expired
+ */
+int pu_queue_push_wait(
+    pu_queue_t* pQueue,
+    void*       pItem,
+    size_t      uiTimeoutMs );
+
+/**
+ * \brief   Removes the oldest item, waiting for one if the queue is empty
+ *
+ * \param[in]  pQueue      : Pointer to a valid queue
+ * \param[out] ppItem      : Item
+ * \param[in]  uiTimeoutMs : Timeout in ms, or \ref PU_FUTEX_WAIT_FOREVER
+ * \retval  0 for success
+ * \retval  ETIMEDOUT the timeout expired
+ */
+int pu_queue_pop_wait(
+    pu_queue_t* pQueue,
+    void**      ppItem,
+    size_t      uiTimeoutMs );
+
+/**
+ * \brief   Approximate number of items in the queue
+ *
+ * \param[in] pQueue : Pointer to a valid queue
+ * \retval  The number of items, a snapshot
+ */
+size_t pu_queue_size( const pu_queue_t* pQueue );
+
+/**
+ * \}
+ */
+
+PU_API_END
+#ifdef __cplusplus
+}
+
+namespace pu {
+namespace detail {
+
+/* One slot: the lap sequence number, then the value */
+template <typename T>
+struct queue_slot
+{
+    size_t uiSeq;
+    T      value;
+};
+
+/* Round a capacity up to a power of two, minimum 2 */
+inline size_t queue_capacity( size_t uiCapacity )
+{
+    size_t uiSize = 2;
+    while (uiSize < uiCapacity)
+    {
+        uiSize <<= 1;
+    }
+    return (uiSize);
+}
+
+/**
+ * Claims up to uiMax consecutive positions on one side of the queue. A slot is ready for this
+ * side when its sequence is (position + uiOffset): 0 for producers (free), 1 for consumers (full).
+ * MULTI selects a CAS on the index, otherwise the calling thread owns the index.
+ */
+template <typename T, bool MULTI>
+inline size_t queue_claim(
+    size_t*        pPos,
+    queue_slot<T>* pSlots,
+    size_t         uiMask,
+    size_t         uiOffset,
+    size_t         uiMax,
+    size_t*        pFirst )
+{
+    size_t uiPos = __atomic_load_n( pPos, __ATOMIC_RELAXED );
+    size_t uiCount;
+    size_t uiSeq;
+
+    for (;;)
+    {
+        for (uiCount = 0; uiCount < uiMax; uiCount++)
+        {
+            uiSeq = __atomic_load_n( &(pSlots[(uiPos + uiCount) & uiMask].uiSeq), __ATOMIC_ACQUIRE );
+            if (uiSeq != (uiPos + uiCount + uiOffset))
+            {
+                break;
+            }
+        }
+        if (0 == uiCount)
+        {
+            /* Behind this lap: full (producer) or empty (consumer). Ahead: the index moved on. */
+            uiSeq = __atomic_load_n( &(pSlots[uiPos & uiMask].uiSeq), __ATOMIC_ACQUIRE );
+            if ((!MULTI) || ((ptrdiff_t)(uiSeq - (uiPos + uiOffset)) < 0))
+            {
+                return (0);
+            }
+            uiPos = __atomic_load_n( pPos, __ATOMIC_RELAXED );
+        }
+        else if (!MULTI)
+        {
+            __atomic_store_n( pPos, uiPos + uiCount, __ATOMIC_RELAXED );
+            *pFirst = uiPos;
+            return (uiCount);
+        }
+        else if (__atomic_compare_exchange_n( pPos, &uiPos, uiPos + uiCount, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ))
+        {
+            *pFirst = uiPos;
+            return (uiCount);
+        }
+    }
+}
+
+template <typename T, bool MULTI>
+inline size_t queue_enqueue(
+    size_t*        pPos,
+    queue_slot<T>* pSlots,
+    size_t         uiMask,
+    const T*       pItems,
+    size_t         uiCount )
+{
+    size_t uiFirst = 0;
+    size_t uiClaimed = queue_claim<T, MULTI>( pPos, pSlots, uiMask, 0, uiCount, &uiFirst );
+    for (size_t i = 0; i < uiClaimed; i++)
+    {
+        queue_slot<T>* pSlot = &(pSlots[(uiFirst + i) & uiMask]);
+        pSlot->value = pItems[i];
+        __atomic_store_n( &(pSlot->uiSeq), uiFirst + i + 1, __ATOMIC_RELEASE );
+    }
+    return (uiClaimed);
+}
+
+template <typename T, bool MULTI>
+inline size_t queue_dequeue(
+    size_t*        pPos,
+    queue_slot<T>* pSlots,
+    size_t         uiMask,
+    T*             pItems,
+    size_t         uiMax )
+{
+    size_t uiFirst = 0;
+    size_t uiClaimed = queue_claim<T, MULTI>( pPos, pSlots, uiMask, 1, uiMax, &uiFirst );
+    for (size_t i = 0; i < uiClaimed; i++)
+    {
+        queue_slot<T>* pSlot = &(pSlots[(uiFirst + i) & uiMask]);
+        pItems[i] = pSlot->value;
+        __atomic_store_n( &(pSlot->uiSeq), uiFirst + i + uiMask + 1, __ATOMIC_RELEASE );
+    }
+    return (uiClaimed);
+}
+
+/* Retry fctTry, parking on the event count in between, until it succeeds or the timeout expires */
+template <typename F>
+inline bool queue_wait(
+    pu_eventcount_t* pEc,
+    size_t           uiTimeoutMs,
+    F                fctTry )
+{
+    struct timespec tsDeadline;
+    struct timespec tsNow;
+    size_t          uiLeftMs = uiTimeoutMs;
+
+    pu_futex_deadline( &tsDeadline, uiTimeoutMs );
+    for (;;)
+    {
+        if (fctTry())
+        {
+            return (true);
+        }
+        unsigned int uiKey = pu_eventcount_prepare_wait( pEc );
+        if (fctTry())
+        {
+            pu_eventcount_cancel_wait( pEc );
+            return (true);
+        }
+        if (PU_FUTEX_WAIT_FOREVER != uiTimeoutMs)
+        {
+            clock_gettime( CLOCK_MONOTONIC, &tsNow );
+            long long llLeftNs = ((long long)(tsDeadline.tv_sec - tsNow.tv_sec) * 1000000000LL) +
+                                 (long long)(tsDeadline.tv_nsec - tsNow.tv_nsec);
+            if (llLeftNs <= 0)
+            {
+                pu_eventcount_cancel_wait( pEc );
+                return (fctTry());
+            }
+            uiLeftMs = (size_t)((llLeftNs + 999999LL) / 1000000LL);
+        }
+        pu_eventcount_wait( pEc, uiKey, uiLeftMs );
+    }
+}
+
+} // namespace detail
+
+/**
+ * \brief C++ bounded queue of T, with the producer/consumer model fixed at compile time
+ * \ingroup PQUEUE
+ *
+ * \code
+ * pu::queue<msg_t, PU_QUEUE_TYPE_MPSC> qMsgs( 1024 );
+ * qMsgs.try_push( stMsg );          // any producer
+ * if (qMsgs.pop( stMsg, 100 )) ...  // the consumer, waits up to 100ms
+ * \endcode
+ */
+template <typename T, pu_queue_type KIND = PU_QUEUE_TYPE_MPMC>
+class queue
+{
+    static const bool MULTI_PRODUCER = (KIND == PU_QUEUE_TYPE_MPMC) || (KIND == PU_QUEUE_TYPE_MPSC);
+    static const bool MULTI_CONSUMER = (KIND == PU_QUEUE_TYPE_MPMC);
+
+public:
+    /* The capacity is rounded up to a power of two */
+    explicit queue( size_t uiCapacity ) :
+        m_uiMask( detail::queue_capacity( uiCapacity ) - 1 ),
+        m_pSlots( new detail::queue_slot<T>[m_uiMask + 1] )
+    {
+        for (size_t i = 0; i <= m_uiMask; i++)
+        {
+            m_pSlots[i].uiSeq = i;
+        }
+        m_stEnq.uiPos = 0;
+        m_stDeq.uiPos = 0;
+        pu_eventcount_create( &(m_stWait.ecNotEmpty) );
+        pu_eventcount_create( &(m_stWait.ecNotFull) );
+    }
+    ~queue() { delete[] m_pSlots; }
+    queue( const queue& ) = delete;
+    queue& operator=( const queue& ) = delete;
+
+    size_t capacity() const { return (m_uiMask + 1); }
+
+    bool try_push( const T& value ) { return (1 == try_push_batch( &value, 1 )); }
+    bool try_pop( T& value ) { return (1 == try_pop_batch( &value, 1 )); }
+
+    size_t try_push_batch( const T* pValues, size_t uiCount ) {
+        size_t uiDone = detail::queue_enqueue<T, MULTI_PRODUCER>( &(m_stEnq.uiPos), m_pSlots, m_uiMask, pValues, uiCount );
+        if (uiDone > 0)
+        {
+            pu_eventcount_notify( &(m_stWait.ecNotEmpty) );
+        }
+        return (uiDone);
+    }
+
+    size_t try_pop_batch( T* pValues, size_t uiMax ) {
+        size_t uiDone = detail::queue_dequeue<T, MULTI_CONSUMER>( &(m_stDeq.uiPos), m_pSlots, m_uiMask, pValues, uiMax );
+        if (uiDone > 0)
+        {
+            pu_eventcount_notify( &(m_stWait.ecNotFull) );
+        }
+        return (uiDone);
+    }
+
+    /* Blocking, false on timeout */
+    bool push( const T& value, size_t uiTimeoutMs = PU_FUTEX_WAIT_FOREVER ) {
+        return (detail::queue_wait( &(m_stWait.ecNotFull), uiTimeoutMs, [&]() { return (try_push( value )); } ));
+    }
+
+    bool pop( T& value, size_t uiTimeoutMs = PU_FUTEX_WAIT_FOREVER ) {
+        return (detail::queue_wait( &(m_stWait.ecNotEmpty), uiTimeoutMs, [&]() { return (try_pop( value )); } ));
+    }
+
+private:
+    size_t                  m_uiMask;
+    detail::queue_slot<T>*  m_pSlots;
+    struct PU_CACHELINE_ALIGNED { size_t uiPos; } m_stEnq;
+    struct PU_CACHELINE_ALIGNED { size_t uiPos; } m_stDeq;
+    struct PU_CACHELINE_ALIGNED { pu_eventcount_t ecNotEmpty; pu_eventcount_t ecNotFull; } m_stWait;
+};
+
+} // namespace pu
+#endif /* __cplusplus */
+#endif /* _PUQUEUE_H_ */
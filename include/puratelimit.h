@@ -0,0 +1,218 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PURATELIMIT_H_
+#define _PURATELIMIT_H_
+#include "pudefs.h"
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+PU_API_BEGIN
+
+/**
+ * \file     puratelimit.h
+ * \brief    Lock-free token bucket rate limiter
+ */
+
+/**
+ * \defgroup PRATELIMIT Rate limiter
+ * \ingroup  POSUTILS
+ *
+ * \brief
+ * A token bucket: it holds up to \c uiBurst tokens, and gains \c uiRate tokens per second.
+ * No timer is involved. Taking tokens is one atomic subtraction. The bucket is only topped up,
+ * from the monotonic clock, when a taker finds it short.
+ *
+ * \section pratelimit_sect_1 Refill
+ * The bucket remembers the time it was last topped up to. A taker that comes up short backs
+ * out, credits the time elapsed since then (one CAS decides who credits it) and tries again.
+ * The taker that takes the first tokens out of a full bucket restarts the clock, so time spent
+ * full earns nothing. A burst is therefore never larger than the bucket.
+ *
+ * \section pratelimit_sect_2 Waiting
+ * \ref pu_ratelimit_acquire sleeps until the missing tokens are due, then tries again. There
+ * is no queue, waiters are not served in order.
+ *
+ * \section pratelimit_sect_3 Sharding
+ * At very high rates the single counter becomes the bottleneck. \ref pu_ratelimit_sharded_t
+ * splits the rate and the burst over one bucket per CPU. A taker uses the bucket of its CPU,
+ * and only looks at the others when that one is short.
+ *
+ * \par Usage
+ * \code
+ * pu_ratelimit_t stLimit;
+ * pu_ratelimit_init( &stLimit, 1000, 50 );   // 1000/s, bursts of 50
+ * if (0 == pu_ratelimit_try_acquire( &stLimit, 1 )) { send(...); }
+ * \endcode
+ *
+ * \{
+ */
+
+/**** Includes ***************************************************************/
+#include <stddef.h>
+#include <stdint.h>
+
+/**** Definitions ************************************************************/
+
+/**
+ * Timeout value for an unbounded wait
+ */
+#define PU_RATELIMIT_WAIT_FOREVER ((size_t)-1)
+
+/**
+ * \brief Token bucket
+ *
+ * \note
+ * Treat the contents as private, the structure is exposed so that the caller can provide the storage
+ */
+typedef struct PU_CACHELINE_ALIGNED pu_ratelimit_tag
+{
+    int64_t  iTokens;          /* Tokens in the bucket, briefly negative while a taker backs out */
+    uint64_t ulLastNs;         /* Topped up to this time, monotonic ns                          */
+    uint64_t ulNsPerToken;     /* Refill interval, read only                                    */
+    int64_t  iBurst;           /* Bucket size, read only                                        */
+}   pu_ratelimit_t;
+
+/**
+ * \brief One bucket per CPU
+ */
+typedef struct pu_ratelimit_sharded_tag
+{
+    pu_ratelimit_t* pShards;   /* Bucket array                                 */
+    unsigned int    uiShards;  /* Number of buckets                            */
+}   pu_ratelimit_sharded_t;
+
+/**
+ * \brief   Initialises a full bucket
+ *
+ * \param[in] pLimit  : Pointer to a valid bucket
+ * \param[in] uiRate  : Tokens per second, 1 to 10^9
+ * \param[in] uiBurst : Bucket size, at least 1
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ */
+int pu_ratelimit_init(
+    pu_ratelimit_t* pLimit,
+    size_t          uiRate,
+    size_t          uiBurst );
+
+/**
+ * \brief   Takes tokens if there are enough, never waits
+ *
+ * \param[in] pLimit   : Pointer to a valid bucket
+ * \param[in] uiTokens : Tokens to take
+ * \retval  0 for success
+ * \retval  EAGAIN not enough tokens
+ * \retval  EINVAL more tokens than the bucket holds
+ */
+int pu_ratelimit_try_acquire(
+    pu_ratelimit_t* pLimit,
+    size_t          uiTokens );
+
+/**
+ * \brief   Takes tokens, waiting at most the timeout for them
+ *
+ * \param[in] pLimit      : Pointer to a valid bucket
+ * \param[in] uiTokens    : Tokens to take
+ * \param[in] uiTimeoutMs : Timeout in ms, or \ref PU_RATELIMIT_WAIT_FOREVER
+ * \retval  0 for success
+ * \retval  ETIMEDOUT the timeout expired
+ * \retval  EINVAL more tokens than the bucket holds
+ */
+int pu_ratelimit_acquire(
+    pu_ratelimit_t* pLimit,
+    size_t          uiTokens,
+    size_t          uiTimeoutMs );
+
+/**
+ * \brief   Tokens available now (a snapshot, after a refill)
+ *
+ * \param[in] pLimit : Pointer to a valid bucket
+ * \retval  The number of tokens
+ */
+size_t pu_ratelimit_available( pu_ratelimit_t* pLimit );
+
+/**
+ * \brief   Creates per-CPU buckets sharing a rate
+ *
+ * \param[in] pSharded : Pointer to a valid sharded limiter
+ * \param[in] uiRate   : Tokens per second, in total
+ * \param[in] uiBurst  : Bucket size, in total
+ * \param[in] uiShards : Number of buckets, 0 for one per configured CPU
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ *
+ * \par Description
+ * Each bucket gets an equal share of the rate and of the burst, the remainders go to the first
+ * buckets, so the buckets add up to exactly \p uiRate and \p uiBurst. A bucket needs at least
+ * one token of each, so the number of buckets is capped at the smaller of \p uiRate and
+ * \p uiBurst. The uiShards field holds the number actually created.
+ */
+int pu_ratelimit_sharded_create(
+    pu_ratelimit_sharded_t* pSharded,
+    size_t                  uiRate,
+    size_t                  uiBurst,
+    unsigned int            uiShards );
+
+/**
+ * \brief   Frees the buckets
+ *
+ * \param[in] pSharded : Pointer to a valid sharded limiter
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ */
+int pu_ratelimit_sharded_destroy( pu_ratelimit_sharded_t* pSharded );
+
+/**
+ * \brief   Takes tokens from the bucket of the calling CPU, or from another one, never waits
+ *
+ * \param[in] pSharded : Pointer to a valid sharded limiter
+ * \param[in] uiTokens : Tokens to take, from a single bucket
+ * \retval  0 for success
+ * \retval  EAGAIN not enough tokens in any bucket
+ * \retval  EINVAL more tokens than a bucket holds
+ */
+int pu_ratelimit_sharded_try_acquire(
+    pu_ratelimit_sharded_t* pSharded,
+    size_t                  uiTokens );
+
+/**
+ * \brief   Takes tokens from the bucket of the calling CPU, waiting at most the timeout
+ *
+ * \param[in] pSharded    : Pointer to a valid sharded limiter
+ * \param[in] uiTokens    : Tokens to take, from a single bucket
+ * \param[in] uiTimeoutMs : Timeout in ms, or \ref PU_RATELIMIT_WAIT_FOREVER
+ * \retval  0 for success
+ * \retval  ETIMEDOUT the timeout expired
+ * \retval  EINVAL more tokens than a bucket holds
+ */
+int pu_ratelimit_sharded_acquire(
+    pu_ratelimit_sharded_t* pSharded,
+    size_t                  uiTokens,
+    size_t                  uiTimeoutMs );
+
+/**
+ * \}
+ */
+
+PU_API_END
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* _PURATELIMIT_H_ */
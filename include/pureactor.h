@@ -0,0 +1,313 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUREACTOR_H_
+#define _PUREACTOR_H_
+
+/**** Includes ***************************************************************/
+/* Outside the extern "C" block, posutils.h carries C++ templates */
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/uio.h>
+#include "posutils.h"
+
+#include "pudefs.h"
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+PU_API_BEGIN
+
+/**
+ * \file     pureactor.h
+ * \brief    I/O reactor thread on io_uring, with an epoll fallback
+ */
+
+/**
+ * \defgroup PREACTOR I/O reactor
+ * \ingroup  POSUTILS
+ *
+ * \brief
+ * A reactor owns one thread (created with \ref pu_thread_create) that runs I/O operations and
+ * timeouts, and calls their completion functions. On io_uring the reactor thread waits for I/O
+ * completions and timer expiries in one \c io_uring_enter call, on epoll in one \c epoll_wait.
+ *
+ * \section preactor_sect_1 Operations
+ * An operation is a caller owned \ref pu_reactor_op_t. It is prepared with one of the
+ * \c pu_reactor_prep_ functions, optionally adjusted (fixed file, fixed buffer, timeout) and
+ * handed over with \ref pu_reactor_submit. The reactor does not allocate. The operation belongs
+ * to the reactor until its completion function has been called, in the reactor thread, with:
+ * - the byte count for a read or write
+ * - the ready events for a poll
+ * - 0 for an expired timeout
+ * - a negative errno on failure, \c -ETIMEDOUT if the operation timeout expired first
+ * .
+ * Completion functions may submit new operations, they are picked up before the next wait.
+ *
+ * \section preactor_sect_2 Batching
+ * Submitting threads push onto a lock-free list and only wake the reactor when the list was
+ * empty. The reactor takes the whole list at once: on io_uring every operation gathered
+ * since the previous wait goes to the kernel in the same system call as that wait.
+ *
+ * \section preactor_sect_3 Registered files and buffers
+ * The files and buffers in \ref pu_reactor_config_t are registered with the ring when the
+ * reactor is created. \ref PU_REACTOR_FLAG_FIXED_FILE makes \c iFd an index into the file
+ * table, \ref PU_REACTOR_FLAG_FIXED_BUF makes the read or write use the registered buffer
+ * \c uiBufIndex (the data pointer must lie inside it). The kernel then skips the file lookup
+ * and page pinning on every operation. The epoll fallback honours the indexes, without the gain.
+ *
+ * \section preactor_sect_4 Fallback
+ * \ref PU_REACTOR_BACKEND_AUTO uses io_uring when the kernel supports it (5.6 or later, and
+ * not disabled), otherwise epoll. The epoll backend completes operations on regular files
+ * synchronously, and allows one pending operation per file descriptor.
+ *
+ * \par Usage
+ * \code
+ * pu_reactor_t    hReactor;
+ * pu_reactor_op_t stRead;
+ *
+ * pu_reactor_create( &hReactor, NULL );
+ * pu_reactor_prep_read( &stRead, iSocket, pBuf, sizeof(pBuf), PU_REACTOR_OFFSET_NONE, on_read, pConn );
+ * stRead.uiTimeoutMs = 500;
+ * pu_reactor_submit( hReactor, &stRead );
+ * \endcode
+ *
+ * \{
+ */
+
+/**** Definitions ************************************************************/
+
+/**
+ * Default queue depth
+ */
+#define PU_REACTOR_DEPTH (256)
+
+/**
+ * Read or write at the current file position
+ */
+#define PU_REACTOR_OFFSET_NONE ((uint64_t)-1)
+
+/**
+ * \c iFd is an index into the registered files
+ */
+#define PU_REACTOR_FLAG_FIXED_FILE (1U << 0)
+
+/**
+ * The data lies in the registered buffer \c uiBufIndex
+ */
+#define PU_REACTOR_FLAG_FIXED_BUF  (1U << 1)
+
+/**
+ * Reactor backends
+ */
+typedef enum
+{
+    PU_REACTOR_BACKEND_AUTO,   /*!< io_uring if available, else epoll */
+    PU_REACTOR_BACKEND_URING,  /*!< io_uring only                      */
+    PU_REACTOR_BACKEND_EPOLL,  /*!< epoll only                         */
+    PU_REACTOR_BACKEND_UNDEF   /* enum terminator..                    */
+}   pu_reactor_backend_t;
+
+/**
+ * Operation types
+ */
+typedef enum
+{
+    PU_REACTOR_OP_READ,
+    PU_REACTOR_OP_WRITE,
+    PU_REACTOR_OP_POLL,
+    PU_REACTOR_OP_TIMEOUT,
+    PU_REACTOR_OP_UNDEF        /* enum terminator.. */
+}   pu_reactor_opcode_t;
+
+/**
+ * \brief Reactor handle
+ */
+typedef struct pu_reactor_tag* pu_reactor_t;
+
+typedef struct pu_reactor_op_tag pu_reactor_op_t;
+
+/**
+ * \brief Completion function, called in the reactor thread
+ */
+typedef void (*pu_reactor_done_fct_t)( pu_reactor_op_t* pOp, int iResult );
+
+/**
+ * \brief An operation, owned by the caller. Fields are set by the prep functions.
+ */
+struct pu_reactor_op_tag
+{
+    pu_reactor_done_fct_t fctDone;    /* Completion function                     */
+    void*                 pArg;       /* Caller data                             */
+    pu_reactor_opcode_t   enOpcode;   /* Operation                               */
+    unsigned int          uiFlags;    /* PU_REACTOR_FLAG_xxx                     */
+    int                   iFd;        /* File descriptor, or registered index    */
+    unsigned int          uiBufIndex; /* Registered buffer, FIXED_BUF            */
+    void*                 pBuf;       /* Data                                    */
+    size_t                uiLen;      /* Data length                             */
+    uint64_t              ulOffset;   /* File offset, or PU_REACTOR_OFFSET_NONE  */
+    uint32_t              uiEvents;   /* Poll events (POLLIN, ...)               */
+    size_t                uiTimeoutMs;/* Timeout, or timer period. 0 for none.   */
+
+    /* Reactor private */
+    pu_reactor_op_t*      pNext;      /* Submission list                         */
+    pu_reactor_op_t*      pTmoPrev;   /* Deadline list, epoll                    */
+    pu_reactor_op_t*      pTmoNext;
+    struct timespec       tsDeadline; /* Deadline, epoll                         */
+    int64_t               pTmo[2];    /* Relative timeout, io_uring              */
+    int                   bTmoLinked; /* On the deadline list                    */
+};
+
+/**
+ * \brief Reactor configuration, zero (or NULL) for the defaults
+ */
+typedef struct pu_reactor_config_tag
+{
+    pu_reactor_backend_t enBackend;   /* Backend                                 */
+    unsigned int         uiDepth;     /* Submission queue entries, 0 for default */
+    const int*           piFiles;     /* Files to register                       */
+    unsigned int         uiFiles;
+    const struct iovec*  pBuffers;    /* Buffers to register                     */
+    unsigned int         uiBuffers;
+    const char*          szName;      /* Thread name, persistent. NULL for default */
+}   pu_reactor_config_t;
+
+/**
+ * \brief   Creates a reactor and starts its thread
+ *
+ * \param[out] phReactor : Reactor handle
+ * \param[in]  pConfig   : Configuration, NULL for the defaults
+ * \retval  0 for success
+ * \retval  Non-zero for failure, including an explicitly requested backend that is not available
+ */
+int pu_reactor_create(
+    pu_reactor_t*              phReactor,
+    const pu_reactor_config_t* pConfig );
+
+/**
+ * \brief   Stops the reactor thread and frees the reactor
+ *
+ * \param[in] hReactor : Reactor
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ *
+ * \pre     No operations are in flight, any left are dropped without completion
+ * \pre     Not called from the reactor thread
+ */
+int pu_reactor_destroy( pu_reactor_t hReactor );
+
+/**
+ * \brief   Returns the backend in use
+ */
+pu_reactor_backend_t pu_reactor_backend( pu_reactor_t hReactor );
+
+/**
+ * \brief   Prepares a read
+ *
+ * \param[out] pOp      : Operation
+ * \param[in]  iFd      : File descriptor
+ * \param[out] pBuf     : Buffer
+ * \param[in]  uiLen    : Bytes to read
+ * \param[in]  ulOffset : File offset, or \ref PU_REACTOR_OFFSET_NONE
+ * \param[in]  fctDone  : Completion function
+ * \param[in]  pArg     : Caller data
+ */
+void pu_reactor_prep_read(
+    pu_reactor_op_t*      pOp,
+    int                   iFd,
+    void*                 pBuf,
+    size_t                uiLen,
+    uint64_t              ulOffset,
+    pu_reactor_done_fct_t fctDone,
+    void*                 pArg );
+
+/**
+ * \brief   Prepares a write
+ *
+ * \param[out] pOp      : Operation
+ * \param[in]  iFd      : File descriptor
+ * \param[in]  pBuf     : Data
+ * \param[in]  uiLen    : Bytes to write
+ * \param[in]  ulOffset : File offset, or \ref PU_REACTOR_OFFSET_NONE
+ * \param[in]  fctDone  : Completion function
+ * \param[in]  pArg     : Caller data
+ */
+void pu_reactor_prep_write(
+    pu_reactor_op_t*      pOp,
+    int                   iFd,
+    const void*           pBuf,
+    size_t                uiLen,
+    uint64_t              ulOffset,
+    pu_reactor_done_fct_t fctDone,
+    void*                 pArg );
+
+/**
+ * \brief   Prepares a readiness wait
+ *
+ * \param[out] pOp      : Operation
+ * \param[in]  iFd      : File descriptor
+ * \param[in]  uiEvents : Events, POLLIN, POLLOUT, ...
+ * \param[in]  fctDone  : Completion function
+ * \param[in]  pArg     : Caller data
+ */
+void pu_reactor_prep_poll(
+    pu_reactor_op_t*      pOp,
+    int                   iFd,
+    uint32_t              uiEvents,
+    pu_reactor_done_fct_t fctDone,
+    void*                 pArg );
+
+/**
+ * \brief   Prepares a timer
+ *
+ * \param[out] pOp     : Operation
+ * \param[in]  uiMs    : Time in ms
+ * \param[in]  fctDone : Completion function, called with 0 on expiry
+ * \param[in]  pArg    : Caller data
+ */
+void pu_reactor_prep_timeout(
+    pu_reactor_op_t*      pOp,
+    size_t                uiMs,
+    pu_reactor_done_fct_t fctDone,
+    void*                 pArg );
+
+/**
+ * \brief   Hands an operation to the reactor
+ *
+ * \param[in] hReactor : Reactor
+ * \param[in] pOp      : Prepared operation
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ *
+ * \par Description
+ * May be called from any thread, including the reactor thread.
+ */
+int pu_reactor_submit(
+    pu_reactor_t     hReactor,
+    pu_reactor_op_t* pOp );
+
+/**
+ * \}
+ */
+
+PU_API_END
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* _PUREACTOR_H_ */
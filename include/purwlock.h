@@ -0,0 +1,197 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PURWLOCK_H_
+#define _PURWLOCK_H_
+#include "pudefs.h"
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+PU_API_BEGIN
+
+/**
+ * \file     purwlock.h
+ * \brief    Scalable reader-writer lock for read-mostly data
+ */
+
+/**
+ * \defgroup PRWLOCK Reader-writer lock utility
+ * \ingroup  POSUTILS
+ *
+ * \brief
+ * A distributed ("big reader") reader-writer lock. It is intended for data that is read
+ * on every request and written rarely, e.g. configuration and routing tables.
+ *
+ * \section prw_sect_1 Reader indicators
+ * A \c pthread_rwlock_t keeps a single reader count, so every reader writes the same cache
+ * line and the line bounces between CPUs. This lock keeps an array of reader counters, one per
+ * cache line. Each thread is bound to one counter, so readers on different CPUs never write
+ * to a shared line. The price is paid by the writer, which has to scan all the counters.
+ *
+ * \section prw_sect_2 Preference
+ * - \ref PU_RWLOCK_TYPE_WRITER_PREF : a waiting writer blocks new readers. Writers cannot be
+ *   starved. This is the recommended type.
+ * - \ref PU_RWLOCK_TYPE_READER_PREF : a writer backs off while readers are present. Read latency
+ *   is never affected by a writer, but a constant stream of readers can starve a writer.
+ * .
+ *
+ * \section prw_sect_3 Usage
+ * Readers that find a writer active spin briefly and then sleep on a futex. Writers are
+ * serialised by a fast mutex, and wait for the readers to drain by spinning/yielding. Read-side
+ * critical sections should therefore be short.
+ *
+ * \{
+ */
+
+/**** Includes ***************************************************************/
+#include <pthread.h>
+
+/**** Definitions ************************************************************/
+
+/**
+ * \brief Reader-writer lock types supported
+ */
+typedef enum
+{
+    PU_RWLOCK_TYPE_WRITER_PREF,   /*!< Waiting writer blocks new readers (default) */
+    PU_RWLOCK_TYPE_READER_PREF,   /*!< Writer backs off while readers are present  */
+    PU_RWLOCK_TYPE_ENDDEF         /* Enum terminator                               */
+}   pu_rwlock_type;
+
+/**
+ * \brief Reader-writer lock
+ *
+ * \note
+ * Treat the contents as private. The structure is exposed only so that the caller can
+ * provide the storage, in the same fashion as a \c pthread_rwlock_t.
+ */
+typedef struct pu_rwlock_tag
+{
+    void*           pSlots;       /* Reader indicators, one per cache line        */
+    unsigned int    uiSlotMask;   /* Number of indicators - 1 (power of two)      */
+    unsigned int    uiWriter;     /* Futex word, non-zero when a writer holds/wants the lock */
+    unsigned int    uiWaiters;    /* Number of readers parked on uiWriter         */
+    pu_rwlock_type  enType;       /* Preference                                   */
+    pthread_mutex_t mtxWriter;    /* Serialises the writers                       */
+}   pu_rwlock_t;
+
+/**
+ * \brief   Creates (initialises) a reader-writer lock of the specified type
+ *
+ * \param[in] pLock  : Pointer to a valid lock
+ * \param[in] enType : Lock type
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ *
+ * \pre     The lock pointer is non-null
+ * \post    The lock is initialised
+ *
+ * \par Description
+ * Allocates one reader indicator per configured CPU (rounded up to a power of two, and
+ * limited to a sane range). An example is shown below:
+ * \code
+ * static pu_rwlock_t lckRoutes;
+ * iResult = pu_rwlock_create_type( &lckRoutes, PU_RWLOCK_TYPE_WRITER_PREF );
+ * ...
+ * pu_rwlock_rdlock( &lckRoutes );
+ * // look up a route
+ * pu_rwlock_rdunlock( &lckRoutes );
+ * \endcode
+ */
+int pu_rwlock_create_type(
+    pu_rwlock_t*   pLock,
+    pu_rwlock_type enType );
+
+/**
+ * \brief   Destroys a reader-writer lock
+ *
+ * \param[in] pLock : Pointer to a valid lock
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ *
+ * \pre     The lock is not held
+ * \post    The lock resources are released
+ */
+int pu_rwlock_destroy( pu_rwlock_t* pLock );
+
+/**
+ * \brief   Acquires the lock for reading
+ *
+ * \param[in] pLock : Pointer to a valid lock
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ *
+ * \par Description
+ * Uncontended, this is one atomic increment on the caller's own reader indicator plus one
+ * load of the writer word. The lock is \b NOT recursive for readers when a writer is waiting
+ * on a writer preference lock.
+ */
+int pu_rwlock_rdlock( pu_rwlock_t* pLock );
+
+/**
+ * \brief   Tries to acquire the lock for reading, without blocking
+ *
+ * \param[in] pLock : Pointer to a valid lock
+ * \retval  0 for success
+ * \retval  EBUSY if a writer holds (or is waiting for) the lock
+ */
+int pu_rwlock_tryrdlock( pu_rwlock_t* pLock );
+
+/**
+ * \brief   Releases a read lock
+ *
+ * \param[in] pLock : Pointer to a valid lock
+ * \retval  0 for success
+ *
+ * \pre     The calling thread holds a read lock
+ */
+int pu_rwlock_rdunlock( pu_rwlock_t* pLock );
+
+/**
+ * \brief   Acquires the lock for writing
+ *
+ * \param[in] pLock : Pointer to a valid lock
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ *
+ * \par Description
+ * Blocks until all the readers have drained. The cost grows with the number of reader
+ * indicators, so this lock only makes sense when writes are rare.
+ */
+int pu_rwlock_wrlock( pu_rwlock_t* pLock );
+
+/**
+ * \brief   Releases a write lock
+ *
+ * \param[in] pLock : Pointer to a valid lock
+ * \retval  0 for success
+ *
+ * \pre     The calling thread holds the write lock
+ */
+int pu_rwlock_wrunlock( pu_rwlock_t* pLock );
+
+/**
+ * \}
+ */
+
+PU_API_END
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* _PURWLOCK_H_ */
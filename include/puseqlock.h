@@ -0,0 +1,258 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUSEQLOCK_H_
+#define _PUSEQLOCK_H_
+#include "pudefs.h"
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+PU_API_BEGIN
+
+/**
+ * \file     puseqlock.h
+ * \brief    Sequence lock for small, hot, read-mostly structures
+ */
+
+/**
+ * \defgroup PSEQLOCK Sequence lock utility
+ * \ingroup  POSUTILS
+ *
+ * \brief
+ * A sequence lock (seqlock) protects a small structure that has a single writer and many
+ * readers, e.g. a published time, a set of statistics counters or a configuration epoch.
+ *
+ * \par How it works
+ * The writer makes the sequence number odd, updates the data, then makes it even again.
+ * A reader samples the sequence number, copies the data, and checks the sequence number again.
+ * If the number was odd, or has changed, the copy may be torn and the reader retries.
+ * Readers never write to shared memory and never block the writer.
+ *
+ * \par Constraints
+ * - There must only ever be one writer at a time. If there can be more, serialise them with a mutex.
+ * - The data must be small and trivially copyable. Readers copy it, they never use it in place.
+ * - The reader must not dereference pointers read from the protected data before validating the copy.
+ * .
+ *
+ * \par Usage
+ * \code
+ * static pu_seqlock_t   seqStats = PU_SEQLOCK_INITIALIZER;
+ * static stats_t        stStats;
+ *
+ * // Writer
+ * pu_seqlock_write_begin( &seqStats );
+ * stStats.uiRequests++;
+ * pu_seqlock_write_end( &seqStats );
+ *
+ * // Reader
+ * stats_t  stCopy;
+ * unsigned uiSeq;
+ * do {
+ *     uiSeq = pu_seqlock_read_begin( &seqStats );
+ *     stCopy = stStats;
+ * } while (pu_seqlock_read_retry( &seqStats, uiSeq ));
+ * \endcode
+ *
+ * \{
+ */
+
+/**** Includes ***************************************************************/
+#include <stddef.h>
+#include <string.h>
+
+/**** Definitions ************************************************************/
+
+/**
+ * \brief Sequence lock
+ */
+typedef struct pu_seqlock_tag
+{
+    unsigned int uiSeq;     /* Odd while a write is in progress */
+}   pu_seqlock_t;
+
+/**
+ * Static initialiser
+ */
+#define PU_SEQLOCK_INITIALIZER { 0 }
+
+/**
+ * \brief   Initialises a sequence lock
+ * \param[in] pSeq : Pointer to a valid sequence lock
+ */
+static inline void pu_seqlock_init( pu_seqlock_t* pSeq )
+{
+    __atomic_store_n( &(pSeq->uiSeq), 0, __ATOMIC_RELAXED );
+}
+
+/**
+ * \brief   Starts a write. The sequence number becomes odd.
+ * \param[in] pSeq : Pointer to a valid sequence lock
+ *
+ * \pre     The caller is the only writer
+ */
+static inline void pu_seqlock_write_begin( pu_seqlock_t* pSeq )
+{
+    unsigned int uiSeq = __atomic_load_n( &(pSeq->uiSeq), __ATOMIC_RELAXED );
+    __atomic_store_n( &(pSeq->uiSeq), uiSeq + 1, __ATOMIC_RELAXED );
+
+    /* the odd value must be visible before any of the data stores */
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+}
+
+/**
+ * \brief   Ends a write. The sequence number becomes even, the new data is published.
+ * \param[in] pSeq : Pointer to a valid sequence lock
+ */
+static inline void pu_seqlock_write_end( pu_seqlock_t* pSeq )
+{
+    unsigned int uiSeq = __atomic_load_n( &(pSeq->uiSeq), __ATOMIC_RELAXED );
+    __atomic_store_n( &(pSeq->uiSeq), uiSeq + 1, __ATOMIC_RELEASE );
+}
+
+/**
+ * \brief   Starts a read
+ * \param[in] pSeq : Pointer to a valid sequence lock
+ * \retval  The (even) sequence number to pass to \ref pu_seqlock_read_retry
+ *
+ * \par Description
+ * Spins while a write is in progress. Writes are expected to be a handful of stores,
+ * so the spin is short.
+ */
+static inline unsigned int pu_seqlock_read_begin( const pu_seqlock_t* pSeq )
+{
+    unsigned int uiSeq;
+
+    while ((uiSeq = __atomic_load_n( &(pSeq->uiSeq), __ATOMIC_ACQUIRE )) & 1)
+    {
+        PU_CPU_RELAX();
+    }
+    return (uiSeq);
+}
+
+/**
+ * \brief   Ends a read
+ * \param[in] pSeq  : Pointer to a valid sequence lock
+ * \param[in] uiSeq : Value returned by \ref pu_seqlock_read_begin
+ * \retval  0     The copy is consistent
+ * \retval  non-0 A write overlapped the read, retry
+ */
+static inline int pu_seqlock_read_retry(
+    const pu_seqlock_t* pSeq,
+    unsigned int        uiSeq )
+{
+    /* the data loads must complete before the sequence number is re-checked */
+    __atomic_thread_fence( __ATOMIC_ACQUIRE );
+    return (uiSeq != __atomic_load_n( &(pSeq->uiSeq), __ATOMIC_RELAXED ));
+}
+
+/**
+ * \brief   Publishes a block of data under the sequence lock
+ *
+ * \param[in] pSeq   : Pointer to a valid sequence lock
+ * \param[in] pData  : Protected data
+ * \param[in] pSrc   : New value
+ * \param[in] uiSize : Size of the data
+ */
+static inline void pu_seqlock_write(
+    pu_seqlock_t* pSeq,
+    void*         pData,
+    const void*   pSrc,
+    size_t        uiSize )
+{
+    pu_seqlock_write_begin( pSeq );
+    memcpy( pData, pSrc, uiSize );
+    pu_seqlock_write_end( pSeq );
+}
+
+/**
+ * \brief   Takes a consistent copy of a block of data protected by the sequence lock
+ *
+ * \param[in]  pSeq   : Pointer to a valid sequence lock
+ * \param[in]  pData  : Protected data
+ * \param[out] pDst   : Copy destination
+ * \param[in]  uiSize : Size of the data
+ */
+static inline void pu_seqlock_read(
+    const pu_seqlock_t* pSeq,
+    const void*         pData,
+    void*               pDst,
+    size_t              uiSize )
+{
+    unsigned int uiSeq;
+
+    do
+    {
+        uiSeq = pu_seqlock_read_begin( pSeq );
+        memcpy( pDst, pData, uiSize );
+    } while (pu_seqlock_read_retry( pSeq, uiSeq ));
+}
+
+/**
+ * \}
+ */
+
+PU_API_END
+#ifdef __cplusplus
+}
+
+#include <type_traits>
+
+namespace pu {
+
+/**
+ * \brief C++ wrapper, a value of type T published under a sequence lock
+ * \ingroup PSEQLOCK
+ *
+ * \code
+ * pu::seqlock<struct timespec> seqNow;
+ * seqNow.store( tsNow );           // single writer
+ * struct timespec ts = seqNow.load(); // any number of readers
+ * \endcode
+ */
+template <typename T>
+class seqlock
+{
+    static_assert( std::is_trivially_copyable<T>::value, "seqlock data must be trivially copyable" );
+
+public:
+    seqlock() : m_value() { pu_seqlock_init( &m_seq ); }
+    explicit seqlock( const T& value ) : m_value( value ) { pu_seqlock_init( &m_seq ); }
+    seqlock( const seqlock& ) = delete;
+    seqlock& operator=( const seqlock& ) = delete;
+
+    /* Single writer only */
+    void store( const T& value ) {
+        pu_seqlock_write( &m_seq, &m_value, &value, sizeof(T) );
+    }
+
+    /* Any number of readers, never blocks the writer */
+    T load() const {
+        T value;
+        pu_seqlock_read( &m_seq, &m_value, &value, sizeof(T) );
+        return (value);
+    }
+
+private:
+    pu_seqlock_t m_seq;
+    T            m_value;
+};
+
+} // namespace pu
+#endif /* __cplusplus */
+#endif /* _PUSEQLOCK_H_ */
@@ -0,0 +1,282 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUSHM_H_
+#define _PUSHM_H_
+
+/**** Includes ***************************************************************/
+/* Outside the extern "C" block, posutils.h carries C++ templates */
+#include <stddef.h>
+#include <pthread.h>
+#include "posutils.h"
+
+#include "pudefs.h"
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+PU_API_BEGIN
+
+/**
+ * \file     pushm.h
+ * \brief    Process-shared synchronisation inside a shared memory segment
+ */
+
+/**
+ * \defgroup PSHM Shared memory synchronisation utility
+ * \ingroup  POSUTILS
+ *
+ * \brief
+ * Factory functions that create synchronisation objects inside memory that is mapped by more
+ * than one process, e.g. a \c shm_open() region mapped with \c MAP_SHARED. The caller owns
+ * the mapping. Exactly one process creates each object, the others simply use it.
+ *
+ * \section pshm_sect_1 Objects
+ * - Mutexes, any \ref pu_mutex_type, created with \c PTHREAD_PROCESS_SHARED. A process that
+ *   can die while holding the lock should use \ref PU_MUTEX_TYPE_ROBUST.
+ * - Condition variables, process shared and timed against \c CLOCK_MONOTONIC.
+ * - Counting semaphores, a \ref pu_sem_t on a shared futex word. Posting does not enter the
+ *   kernel unless another process is actually waiting.
+ * - A single producer, single consumer ring of fixed size slots. The producer writes straight
+ *   into the ring (reserve/commit) and the consumer reads it in place (peek/release), so a
+ *   message is never copied and no syscall is made while both sides are busy.
+ * .
+ *
+ * \section pshm_sect_2 Rules
+ * Objects in shared memory must not contain pointers, the segment may be mapped at a different
+ * address in each process. The ring therefore only stores indices and offsets, and
+ * \ref pu_shm_ring_attach re-derives the addresses in the calling process.
+ *
+ * \code
+ * // Producer process
+ * int   iFd  = shm_open( "/feed", O_CREAT | O_RDWR, 0600 );
+ * ftruncate( iFd, uiSize );
+ * void* pMem = mmap( NULL, uiSize, PROT_READ | PROT_WRITE, MAP_SHARED, iFd, 0 );
+ * pu_shm_ring_t* pRing = pu_shm_ring_create( pMem, uiSize, sizeof(msg_t), 1024 );
+ * msg_t* pMsg = (msg_t*)pu_shm_ring_reserve( pRing );
+ * if (pMsg) { fill( pMsg ); pu_shm_ring_commit( pRing ); }
+ *
+ * // Consumer process
+ * pu_shm_ring_t* pRing = pu_shm_ring_attach( pMem );
+ * if (0 == pu_shm_ring_wait_data( pRing, PU_SHM_WAIT_FOREVER )) {
+ *     const msg_t* pMsg = (const msg_t*)pu_shm_ring_peek( pRing );
+ *     use( pMsg );
+ *     pu_shm_ring_release( pRing );
+ * }
+ * \endcode
+ *
+ * \{
+ */
+
+/**** Definitions ************************************************************/
+
+/**
+ * Timeout value for an unbounded wait
+ */
+#define PU_SHM_WAIT_FOREVER PU_FUTEX_WAIT_FOREVER
+
+/**
+ * \brief Process-shared counting semaphore, a \ref pu_sem_t on a shared futex
+ */
+typedef pu_sem_t pu_shm_sem_t;
+
+/**
+ * \brief Single producer, single consumer ring (opaque, lives in the shared segment)
+ */
+typedef struct pu_shm_ring_tag pu_shm_ring_t;
+
+/**
+ * \brief   Creates a process-shared mutex
+ *
+ * \param[in] pMtx   : Pointer to a mutex inside the shared segment
+ * \param[in] enType : Mutex type
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ *
+ * \par Description
+ * Same as \ref pu_mutex_create_attr with \ref PU_MUTEX_ATTR_PSHARED. Lock and unlock it with
+ * \ref pu_mutex_lock and \ref pu_mutex_unlock (or \ref pu_mutex_lock_robust), and destroy it
+ * once, from one process, when no process uses it any more.
+ */
+int pu_shm_mutex_create(
+    pthread_mutex_t* pMtx,
+    pu_mutex_type    enType );
+
+/**
+ * \brief   Creates a process-shared condition variable
+ *
+ * \param[in] pCond : Pointer to a condition variable inside the shared segment
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ *
+ * \par Description
+ * Timed waits use \c CLOCK_MONOTONIC, see \c timespec_now_plus_ms_monotonic(). Use it with a
+ * mutex from \ref pu_shm_mutex_create.
+ */
+int pu_shm_cond_create( pthread_cond_t* pCond );
+
+/**
+ * \brief   Creates a process-shared semaphore
+ *
+ * \param[in] pSem      : Pointer to a semaphore inside the shared segment
+ * \param[in] uiInitial : Initial value
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ */
+int pu_shm_sem_create(
+    pu_shm_sem_t* pSem,
+    unsigned int  uiInitial );
+
+/**
+ * \brief   Increments the semaphore, and wakes one waiter if there is one
+ *
+ * \param[in] pSem : Pointer to a valid semaphore
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ */
+int pu_shm_sem_post( pu_shm_sem_t* pSem );
+
+/**
+ * \brief   Decrements the semaphore, waiting for as long as it takes
+ *
+ * \param[in] pSem : Pointer to a valid semaphore
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ */
+int pu_shm_sem_wait( pu_shm_sem_t* pSem );
+
+/**
+ * \brief   Decrements the semaphore if it is non-zero, never waits
+ *
+ * \param[in] pSem : Pointer to a valid semaphore
+ * \retval  0 for success
+ * \retval  EAGAIN the value was zero
+ */
+int pu_shm_sem_trywait( pu_shm_sem_t* pSem );
+
+/**
+ * \brief   Decrements the semaphore, waiting at most the timeout
+ *
+ * \param[in] pSem        : Pointer to a valid semaphore
+ * \param[in] uiTimeoutMs : Timeout in ms, or \ref PU_SHM_WAIT_FOREVER
+ * \retval  0 for success
+ * \retval  ETIMEDOUT the timeout expired
+ */
+int pu_shm_sem_timedwait(
+    pu_shm_sem_t* pSem,
+    size_t        uiTimeoutMs );
+
+/**
+ * \brief   Bytes of shared memory needed for a ring
+ *
+ * \param[in] uiSlotSize : Size of one message
+ * \param[in] uiSlots    : Number of slots, a power of two
+ * \retval  The size in bytes, including the ring header
+ */
+size_t pu_shm_ring_size(
+    size_t uiSlotSize,
+    size_t uiSlots );
+
+/**
+ * \brief   Creates a ring at the start of a block of shared memory
+ *
+ * \param[in] pMem       : Start of the block, cache line aligned (a mapping always is)
+ * \param[in] uiMemSize  : Size of the block, at least \ref pu_shm_ring_size
+ * \param[in] uiSlotSize : Size of one message
+ * \param[in] uiSlots    : Number of slots, a power of two
+ * \retval  The ring, or NULL if the parameters are invalid
+ *
+ * \pre     No other process uses the block yet
+ */
+pu_shm_ring_t* pu_shm_ring_create(
+    void*  pMem,
+    size_t uiMemSize,
+    size_t uiSlotSize,
+    size_t uiSlots );
+
+/**
+ * \brief   Attaches to a ring created by another process
+ *
+ * \param[in] pMem : Start of the block, as mapped in this process
+ * \retval  The ring, or NULL if the block does not hold a ring
+ */
+pu_shm_ring_t* pu_shm_ring_attach( void* pMem );
+
+/**
+ * \brief   Producer: gets the next free slot
+ *
+ * \param[in] pRing : Pointer to a valid ring
+ * \retval  Pointer to the slot, to be filled in place, or NULL if the ring is full
+ */
+void* pu_shm_ring_reserve( pu_shm_ring_t* pRing );
+
+/**
+ * \brief   Producer: publishes the slot returned by \ref pu_shm_ring_reserve
+ *
+ * \param[in] pRing : Pointer to a valid ring
+ */
+void pu_shm_ring_commit( pu_shm_ring_t* pRing );
+
+/**
+ * \brief   Consumer: gets the oldest message
+ *
+ * \param[in] pRing : Pointer to a valid ring
+ * \retval  Pointer to the message, valid until \ref pu_shm_ring_release, or NULL if the ring is empty
+ */
+const void* pu_shm_ring_peek( pu_shm_ring_t* pRing );
+
+/**
+ * \brief   Consumer: frees the slot returned by \ref pu_shm_ring_peek
+ *
+ * \param[in] pRing : Pointer to a valid ring
+ */
+void pu_shm_ring_release( pu_shm_ring_t* pRing );
+
+/**
+ * \brief   Consumer: waits until there is at least one message
+ *
+ * \param[in] pRing       : Pointer to a valid ring
+ * \param[in] uiTimeoutMs : Timeout in ms, or \ref PU_SHM_WAIT_FOREVER
+ * \retval  0 a message is available
+ * \retval  ETIMEDOUT the timeout expired
+ */
+int pu_shm_ring_wait_data(
+    pu_shm_ring_t* pRing,
+    size_t         uiTimeoutMs );
+
+/**
+ * \brief   Producer: waits until there is at least one free slot
+ *
+ * \param[in] pRing       : Pointer to a valid ring
+ * \param[in] uiTimeoutMs : Timeout in ms, or \ref PU_SHM_WAIT_FOREVER
+ * \retval  0 a slot is free
+ * \retval  ETIMEDOUT the timeout expired
+ */
+int pu_shm_ring_wait_space(
+    pu_shm_ring_t* pRing,
+    size_t         uiTimeoutMs );
+
+/**
+ * \}
+ */
+
+PU_API_END
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* _PUSHM_H_ */
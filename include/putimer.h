@@ -26,9 +26,11 @@
 #ifndef __PUTIMER_H_
 #define __PUTIMER_H_
 
+#include "pudefs.h"
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
+PU_API_BEGIN
 
 /**
  * @brief Simple timer callback utility
@@ -56,6 +58,7 @@ extern "C" {
 
 /**** Includes ***************************************************************/
 #include <stddef.h>
+#include <stdint.h>
 #include <time.h>
 
 /**** Definitions ************************************************************/
@@ -69,6 +72,12 @@ typedef void* putimer_hnd_t;
  */
 #define PUTIMER_MIN_TIMEOUT (10) /* milliseconds */
 
+/**
+ * Callback data a timer can hold itself, see \ref putimer_create_inplace. A multiple of 8, the
+ * data is 8 byte aligned.
+ */
+#define PUTIMER_INPLACE_SIZE (32) /* bytes */
+
 /**
  * Different timer types
  */
@@ -189,6 +198,37 @@ putimer_hnd_t putimer_create_lockable(
     size_t                 uiPeriodMs,
     void*                  pCookie );
 
+/**
+ * @brief   Creates a timer resource that holds its callback data
+ *
+ * @param   enType      :timer type
+ * @param   fctCallback :function to call on expiration
+ * @param   uiPeriodMs  :timeout period in ms
+ * @param   pData       :callback data, copied into the timer
+ * @param   uiSize      :size of the data, up to PUTIMER_INPLACE_SIZE
+ * @param   bLockable   :lock-able (see \ref putimer_create_lockable) or not (see \ref putimer_create)
+ * @retval  non-NULL    : Valid handle
+ * @retval  NULL        : Failure
+ *
+ * @pre     Module is initialised
+ * @pre     timeout is >= PUTIMER_MIN_TIMEOUT
+ * @post    Timer is created
+ *
+ * @par Description
+ * The data is copied into the timer slot, and the callback gets a pointer to it as the cookie,
+ * so the caller keeps nothing alive for the timer. The data \b MUST be plain bytes (trivially
+ * copyable), and the callback must not modify it: a non-lock-able timer is called on a copy,
+ * taken under the lock, since the timer can be deleted while its callback runs.
+ * This is the base of the C++ \ref pu::timer.
+ */
+putimer_hnd_t putimer_create_inplace(
+    putimer_type_t         enType,
+    putimer_callback_fct_t fctCallback,
+    size_t                 uiPeriodMs,
+    const void*            pData,
+    size_t                 uiSize,
+    bool                   bLockable );
+
 /**
  * @brief   Delete a timer resource
  *
@@ -316,6 +356,32 @@ int putimer_stop(
     putimer_hnd_t hndTimer,
     size_t*       pMsLeft );
 
+/**
+ * Timer service information, published by the timer thread
+ */
+typedef struct putimer_info_tag
+{
+    struct timespec tsNextDeadline;  /*!< CLOCK_MONOTONIC expiry of the queue head        */
+    int             iHasDeadline;    /*!< Non-zero if tsNextDeadline is valid (queue not empty) */
+    size_t          uiFiredCount;    /*!< Total number of expirations taken off the queue  */
+}   putimer_info_t;
+
+/**
+ * @brief   Reads the timer service information
+ *
+ * @param[out] pInfo : Pointer to the information structure
+ * @retval  0  If successful
+ * @retval -1  On failure
+ *
+ * @pre     pInfo is valid
+ * @post    none
+ *
+ * @par Description
+ * The information is published under a sequence lock every time the timer queue head changes.
+ * Reading it takes no lock, so it never blocks (or is blocked by) the timer thread.
+ */
+int putimer_get_info( putimer_info_t* pInfo );
+
 /**
  * @brief Posix "timespec" utility functions
  * @defgroup TSPEC Posix "timespec" utility functions
@@ -340,7 +406,7 @@ int putimer_stop(
  * @par Description
  * Determines if timespec A is after (later than) timespec B
  */
-int timespec_is_a_after_b(
+PU_INLINE_FCT int timespec_is_a_after_b(
     struct timespec* pA,
     struct timespec* pB );
 
@@ -357,7 +423,7 @@ int timespec_is_a_after_b(
  * @par Description
  * Subtracts timespec B from timespec A
  */
-void timespec_a_sub_b(
+PU_INLINE_FCT void timespec_a_sub_b(
     struct timespec* pA,
     struct timespec* pB,
     struct timespec* pRes );
@@ -374,7 +440,7 @@ void timespec_a_sub_b(
  * @par Description
  * Add a millisecond value to a timespec
  */
-void timespec_add_ms(
+PU_INLINE_FCT void timespec_add_ms(
     struct timespec* pTs,
     size_t           uiMs );
 
@@ -392,7 +458,7 @@ void timespec_add_ms(
  * Subtracts timespec B from timespec A (i.e. A-B=ms) and return the value in milliseconds.
  * Note that there is no error checking. If the difference is too large it may result in strange results.
  */
-size_t timespec_a_sub_b_ms(
+PU_INLINE_FCT size_t timespec_a_sub_b_ms(
     struct timespec* pA,
     struct timespec* pB );
 
@@ -410,7 +476,7 @@ size_t timespec_a_sub_b_ms(
  * Subtracts timespec B from timespec A (i.e. A-B=ms) and return the value in microseconds.
  * Note that there is no error checking. If the difference is too large it may result in strange results.
  */
-size_t timespec_a_sub_b_us(
+PU_INLINE_FCT size_t timespec_a_sub_b_us(
     struct timespec* pA,
     struct timespec* pB );
 
@@ -431,7 +497,7 @@ size_t timespec_a_sub_b_us(
  * @note
  * Uses CLOCK_REALTIME
  */
-void timespec_now_plus_ms(
+PU_INLINE_FCT void timespec_now_plus_ms(
     struct timespec* pTs,
     size_t           uiMs );
 
@@ -452,7 +518,7 @@ void timespec_now_plus_ms(
  * @note
  * Uses CLOCK_MONOTONIC
  */
-void timespec_now_plus_ms_monotonic(
+PU_INLINE_FCT void timespec_now_plus_ms_monotonic(
     struct timespec* pTs,
     size_t           uiMs );
 
@@ -469,6 +535,16 @@ void timespec_now_plus_ms_monotonic(
  */
 void timespec_realtime_to_monotonic( struct timespec* pTs );
 
+/**
+ * @brief  Current CLOCK_MONOTONIC time in nanoseconds
+ *
+ * @retval ns The time
+ *
+ * @par Description
+ * A single integer is easier to keep in an atomic than a timespec. It wraps after some 580 years.
+ */
+PU_INLINE_FCT uint64_t timespec_now_ns_monotonic( void );
+
 /**
  * @}
  */
@@ -509,8 +585,82 @@ void timespec_realtime_to_monotonic( struct timespec* pTs );
  * @}
  */
 
+/* Inline build, the small timespec functions are defined here */
+#if defined(PU_INLINE)
+    #include "putimer_inline.h"
+#endif
+
+PU_API_END
 #ifdef __cplusplus
 }
+
+#include <type_traits>
+#include <utility>
+
+namespace pu {
+
+/**
+ * @brief C++ wrapper, a move-only timer that calls a callable of type F
+ * @ingroup PUTIMER
+ *
+ * The callable is stored in the timer slot (\ref putimer_create_inplace), no closure is allocated.
+ * The callback is a thunk instantiated for F, so the call to F is direct and can be inlined:
+ * the only indirect call left is the timer thread calling the thunk. F must fit in
+ * \ref PUTIMER_INPLACE_SIZE bytes and be trivially copyable, e.g. a lambda capturing pointers
+ * and numbers, and it is called as const. The timer is deleted with the object.
+ *
+ * @code
+ * auto tmrPoll = pu::make_timer( PUTIMER_TYPE_PERIODIC, 100, [pDev]() { dev_poll( pDev ); } );
+ * tmrPoll.start();
+ * @endcode
+ */
+template <typename F>
+class timer
+{
+    static_assert( sizeof(F) <= PUTIMER_INPLACE_SIZE,
+                   "timer callables must fit in PUTIMER_INPLACE_SIZE, capture a pointer instead" );
+    static_assert( alignof(F) <= alignof(uint64_t), "timer callables must be at most 8 byte aligned" );
+    static_assert( std::is_trivially_copyable<F>::value && std::is_trivially_destructible<F>::value,
+                   "timer callables must be trivially copyable, capture pointers not objects" );
+
+public:
+    timer() : m_hnd( nullptr ) {}
+    timer( putimer_type_t enType, size_t uiPeriodMs, const F& fct, bool bLockable = false ) :
+        m_hnd( putimer_create_inplace( enType, &timer::thunk, uiPeriodMs, &fct, sizeof(F), bLockable ) ) {}
+    timer( timer&& other ) : m_hnd( other.m_hnd ) { other.m_hnd = nullptr; }
+    timer& operator=( timer&& other ) {
+        std::swap( m_hnd, other.m_hnd );
+        return (*this);
+    }
+    timer( const timer& ) = delete;
+    timer& operator=( const timer& ) = delete;
+    ~timer() { if (m_hnd) putimer_delete( m_hnd ); }
+
+    bool valid() const { return (nullptr != m_hnd); }
+    putimer_hnd_t handle() const { return (m_hnd); }
+
+    int start() { return (putimer_start( m_hnd )); }
+    int stop( size_t* pMsLeft = nullptr ) { return (putimer_stop( m_hnd, pMsLeft )); }
+    int set_period( size_t uiPeriodMs ) { return (putimer_set_period( m_hnd, uiPeriodMs )); }
+    bool active() const {
+        bool bActive = false;
+        return ((0 == putimer_is_active( m_hnd, &bActive )) && bActive);
+    }
+
+private:
+    static void thunk( void* pData ) { (*static_cast<const F*>( pData ))(); }
+
+    putimer_hnd_t m_hnd;
+};
+
+/* Deduces F, C++11 has no class template argument deduction */
+template <typename F>
+inline timer<F> make_timer( putimer_type_t enType, size_t uiPeriodMs, F fct, bool bLockable = false )
+{
+    return (timer<F>( enType, uiPeriodMs, fct, bLockable ));
+}
+
+} // namespace pu
 #endif /* __cplusplus */
 
 #endif /* __PUTIMER_H_ */
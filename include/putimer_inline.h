@@ -0,0 +1,147 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     putimer_inline.h
+ * @brief    Bodies of the small timespec functions
+ *
+ * @par Description
+ * Do not include this directly. With \c PU_INLINE defined putimer.h includes it, and the functions
+ * are \c static \c inline in every caller. Otherwise putimer.cpp includes it, and they are ordinary
+ * library functions. Either way there is one copy of the code, see \ref PU_INLINE_FCT.
+ */
+#ifndef __PUTIMER_INLINE_H_
+#define __PUTIMER_INLINE_H_
+
+/* is A after B */
+PU_INLINE_FCT int timespec_is_a_after_b(
+    struct timespec* pA,
+    struct timespec* pB )
+{
+    /* test seconds first - easy */
+    int iIsAfter = (pA->tv_sec > pB->tv_sec) ? 1 : 0;
+
+    /* test case where seconds are the same */
+    if ((!iIsAfter) && (pA->tv_sec == pB->tv_sec))
+    {
+        iIsAfter = (pA->tv_nsec > pB->tv_nsec) ? 1 : 0;
+    }
+
+    /* all cases covered */
+    return (iIsAfter);
+}
+/* timespec_is_a_after_b */
+
+/* subtract b from a (a is definitely after b) */
+PU_INLINE_FCT void timespec_a_sub_b(
+    struct timespec* pA,
+    struct timespec* pB,
+    struct timespec* pRes )
+{
+    pRes->tv_sec = pA->tv_sec - pB->tv_sec;
+    if (pA->tv_nsec >= pB->tv_nsec)
+    {
+        pRes->tv_nsec = (pA->tv_nsec - pB->tv_nsec);
+    }
+    else
+    {
+        pRes->tv_nsec = (1000000000 - pB->tv_nsec) + pA->tv_nsec;
+        pRes->tv_sec -= 1;
+    }
+}
+/* timespec_a_sub_b */
+
+/* Difference between A and B in milliseconds */
+PU_INLINE_FCT size_t timespec_a_sub_b_ms(
+    struct timespec* pA,
+    struct timespec* pB )
+{
+    struct timespec tsDiff;
+    size_t          lMs;
+    timespec_a_sub_b( pA, pB, &tsDiff );
+    lMs  = (size_t)(tsDiff.tv_sec * 1000);
+    lMs += (size_t)(tsDiff.tv_nsec / 1000000);
+    return (lMs);
+}
+/* timespec_a_sub_b_ms */
+
+/* Difference between A and B in microseconds */
+PU_INLINE_FCT size_t timespec_a_sub_b_us(
+    struct timespec* pA,
+    struct timespec* pB )
+{
+    struct timespec tsDiff;
+    size_t          lUs;
+    timespec_a_sub_b( pA, pB, &tsDiff );
+    lUs  = (size_t)(tsDiff.tv_sec * 1000000);
+    lUs += (size_t)(tsDiff.tv_nsec / 1000);
+    return (lUs);
+
+}
+/* timespec_a_sub_b_us */
+
+/* add a millisecond value to a timespec */
+PU_INLINE_FCT void timespec_add_ms( struct timespec* pTs, size_t ulMs )
+{
+    long lNs;
+
+    pTs->tv_sec += (time_t)(ulMs / 1000);
+    ulMs -= ((ulMs / 1000) * 1000);
+    lNs = (long)(ulMs * 1000000);
+    pTs->tv_nsec += lNs;
+    if (pTs->tv_nsec > 1000000000)
+    {
+        pTs->tv_sec += 1;
+        pTs->tv_nsec -= 1000000000;
+    }
+}
+/* timespec_add_ms */
+
+/* "now" + ms, CLOCK_REALTIME */
+PU_INLINE_FCT void timespec_now_plus_ms(
+    struct timespec* pTs,
+    size_t           ulMs )
+{
+    clock_gettime( CLOCK_REALTIME, pTs );
+    timespec_add_ms( pTs, ulMs );
+}
+/* timespec_now_plus_ms */
+
+/* "now" + ms, CLOCK_MONOTONIC */
+PU_INLINE_FCT void timespec_now_plus_ms_monotonic(
+    struct timespec* pTs,
+    size_t           ulMs )
+{
+    clock_gettime( CLOCK_MONOTONIC, pTs );
+    timespec_add_ms( pTs, ulMs );
+}
+/* timespec_now_plus_ms_monotonic */
+
+/* Current CLOCK_MONOTONIC time in nanoseconds */
+PU_INLINE_FCT uint64_t timespec_now_ns_monotonic( void )
+{
+    struct timespec tsNow;
+
+    clock_gettime( CLOCK_MONOTONIC, &tsNow );
+    return ((uint64_t)tsNow.tv_sec * 1000000000ULL + (uint64_t)tsNow.tv_nsec);
+}
+/* timespec_now_ns_monotonic */
+
+#endif /* __PUTIMER_INLINE_H_ */
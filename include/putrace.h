@@ -0,0 +1,204 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUTRACE_H_
+#define _PUTRACE_H_
+#include "pudefs.h"
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+PU_API_BEGIN
+
+/**
+ * \file     putrace.h
+ * \brief    Event tracer with Chrome trace output
+ */
+
+/**
+ * \defgroup PTRACE Event tracer
+ * \ingroup  POSUTILS
+ *
+ * \brief
+ * Records a timeline of library events, for latency investigations:
+ * - thread create (on the creating thread) and exit, from \ref pu_thread_create threads
+ * - timer arm and fire, and the time spent in each timer callback
+ * - contended acquisitions of mutexes locked with \ref pu_mutex_lock, labelled with the
+ *   creation site when the mutex is instrumented (see \ref PU_MUTEX_ATTR_INSTRUMENT)
+ * .
+ * Applications can add their own events with \ref PU_TRACE_INSTANT, \ref PU_TRACE_BEGIN and
+ * \ref PU_TRACE_END.
+ *
+ * \section ptrace_sect_1 Buffers
+ * Every thread appends to its own buffer, allocated on its first event, so recording takes no
+ * lock and no atomic read-modify-write. A full buffer drops the event (see \ref pu_trace_dropped).
+ * Buffers outlive their thread, up to the next \ref pu_trace_reset.
+ *
+ * \section ptrace_sect_2 Cost
+ * While the tracer is stopped every trace point is one load and one branch. For
+ * \ref pu_mutex_lock that branch is shared with the mutex instrumentation check.
+ *
+ * \section ptrace_sect_3 Output
+ * \ref pu_trace_write_json writes the Chrome trace event format, which \c chrome://tracing and
+ * the Perfetto UI (ui.perfetto.dev) both open. Names and categories \b MUST be persistent, only
+ * the pointers are recorded.
+ *
+ * \par Usage
+ * \code
+ * pu_trace_start( 0 );
+ * ...
+ * pu_trace_stop();
+ * pu_trace_write_json( pFile );
+ * \endcode
+ *
+ * \{
+ */
+
+/**** Includes ***************************************************************/
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**** Definitions ************************************************************/
+
+/**
+ * Default events per thread buffer
+ */
+#if !defined(PU_TRACE_DEFAULT_EVENTS)
+    #define PU_TRACE_DEFAULT_EVENTS (16384)
+#endif
+
+/**
+ * Event phases, as in the Chrome trace event format
+ */
+#define PU_TRACE_PHASE_BEGIN    ('B')   /*!< Start of a span on this thread      */
+#define PU_TRACE_PHASE_END      ('E')   /*!< End of the innermost span           */
+#define PU_TRACE_PHASE_COMPLETE ('X')   /*!< Span with a known duration          */
+#define PU_TRACE_PHASE_INSTANT  ('i')   /*!< Point in time                       */
+
+/**
+ * Non-zero while the tracer runs. Read it with \ref PU_TRACE_ON, never write it
+ */
+extern int iPuTraceOn;
+
+/**
+ * The trace point test, one load and one branch
+ */
+#define PU_TRACE_ON() __builtin_expect( __atomic_load_n( &iPuTraceOn, __ATOMIC_RELAXED ), 0 )
+
+/**
+ * \brief Application trace points, the arguments are only evaluated while tracing
+ */
+#define PU_TRACE_INSTANT(cat_,name_,arg_) \
+    do { if (PU_TRACE_ON()) pu_trace_event( PU_TRACE_PHASE_INSTANT, (cat_), (name_), 0, 0, (uint64_t)(arg_) ); } while (0)
+#define PU_TRACE_BEGIN(cat_,name_) \
+    do { if (PU_TRACE_ON()) pu_trace_event( PU_TRACE_PHASE_BEGIN, (cat_), (name_), 0, 0, 0 ); } while (0)
+#define PU_TRACE_END(cat_,name_) \
+    do { if (PU_TRACE_ON()) pu_trace_event( PU_TRACE_PHASE_END, (cat_), (name_), 0, 0, 0 ); } while (0)
+
+/**
+ * \brief   Starts recording
+ *
+ * \param[in] uiEvents : Events per thread buffer, 0 for \ref PU_TRACE_DEFAULT_EVENTS. Only
+ *                       applies to buffers allocated from now on
+ * \retval  0 for success
+ * \retval  Non-zero for failure, or already started
+ */
+int pu_trace_start( size_t uiEvents );
+
+/**
+ * \brief   Stops recording, the events are kept
+ *
+ * \retval  0 for success
+ * \retval  Non-zero if not started
+ */
+int pu_trace_stop( void );
+
+/**
+ * \brief   Names the calling thread in the output, done by \ref pu_thread_create for its threads
+ *
+ * \param[in] szName : Thread name, persistent
+ */
+void pu_trace_name_thread( const char* szName );
+
+/**
+ * \brief   Hands the buffer of the exiting thread over to the output, done by \ref pu_thread_create
+ *          for its threads
+ *
+ * \par Description
+ * The buffer of a thread that exits without it is only emptied by \ref pu_trace_reset, never freed.
+ */
+void pu_trace_thread_exit( void );
+
+/**
+ * \brief   Records an event on the calling thread, test \ref PU_TRACE_ON first
+ *
+ * \param[in] cPhase  : PU_TRACE_PHASE_xxx
+ * \param[in] szCat   : Category, persistent
+ * \param[in] szName  : Name, persistent
+ * \param[in] ulTsNs  : Monotonic time stamp, 0 for now
+ * \param[in] ulDurNs : Duration, \ref PU_TRACE_PHASE_COMPLETE only
+ * \param[in] ulArg   : Value shown with the event
+ */
+void pu_trace_event(
+    char        cPhase,
+    const char* szCat,
+    const char* szName,
+    uint64_t    ulTsNs,
+    uint64_t    ulDurNs,
+    uint64_t    ulArg );
+
+/**
+ * \brief   Writes the recorded events in the Chrome trace event format (JSON)
+ *
+ * \param[in] pFile : Output
+ * \retval  0 for success
+ * \retval  Non-zero for failure
+ *
+ * \par Description
+ * May be called while recording, the events recorded meanwhile may or may not be included.
+ */
+int pu_trace_write_json( FILE* pFile );
+
+/**
+ * \brief   Discards the recorded events, and the drop count
+ *
+ * \retval  0 for success
+ * \retval  Non-zero if recording
+ *
+ * \par Description
+ * The buffers of exited threads are freed, the others are emptied.
+ */
+int pu_trace_reset( void );
+
+/**
+ * \brief   Events dropped because a buffer was full
+ *
+ * \retval  The number of events
+ */
+size_t pu_trace_dropped( void );
+
+/**
+ * \}
+ */
+
+PU_API_END
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* _PUTRACE_H_ */
@@ -0,0 +1,243 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     pubarrier.cpp
+ * @brief    Implementation of the barrier and latch
+ */
+
+/**** Includes ***************************************************************/
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include "pubarrier.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+
+/* Spin iterations before a barrier waiter parks, when every participant has a CPU */
+#define PU_BARRIER_SPIN_COUNT (4096)
+
+/**** Macros ****************************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Creates (initialises) a barrier
+ *
+ * @param[in] pBar    : Pointer to a valid barrier
+ * @param[in] uiCount : Number of participating threads
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_barrier_create(
+    pu_barrier_t* pBar,
+    unsigned int  uiCount )
+{
+    long lCpus;
+
+    /* pre-condition */
+    ASSERT( pBar );
+    ASSERT( uiCount > 0 );
+    if ((!pBar) || (0 == uiCount))
+    {
+        return (-1);
+    }
+
+    /* Spinning with more participants than CPUs only delays the thread being waited for */
+    lCpus = sysconf( _SC_NPROCESSORS_ONLN );
+    pBar->stRelease.uiCount    = uiCount;
+    pBar->stRelease.uiSpin     = ((lCpus > 1) && ((long)uiCount <= lCpus)) ? PU_BARRIER_SPIN_COUNT : 0;
+    pBar->stRelease.uiSleepers = 0;
+    pBar->stArrive.uiRemaining = uiCount;
+    __atomic_store_n( &(pBar->stRelease.uiPhase), 0, __ATOMIC_RELEASE );
+    return (0);
+}
+/* pu_barrier_create */
+
+/**
+ * @brief   Waits until all the participants have arrived
+ *
+ * @param[in] pBar : Pointer to a valid barrier
+ * @retval  PU_BARRIER_SERIAL_THREAD for the last arriving thread, 0 for the others
+ */
+int pu_barrier_wait( pu_barrier_t* pBar )
+{
+    unsigned int uiPhase;
+    unsigned int i;
+
+    ASSERT( pBar );
+
+    /* Sampled before arriving, the phase cannot flip until this thread has arrived */
+    uiPhase = __atomic_load_n( &(pBar->stRelease.uiPhase), __ATOMIC_ACQUIRE );
+
+    /* Last arrival: re-arm the counter, then flip the phase to release everybody */
+    if (1 == __atomic_fetch_sub( &(pBar->stArrive.uiRemaining), 1, __ATOMIC_ACQ_REL ))
+    {
+        __atomic_store_n( &(pBar->stArrive.uiRemaining), pBar->stRelease.uiCount, __ATOMIC_RELAXED );
+        __atomic_store_n( &(pBar->stRelease.uiPhase), uiPhase + 1, __ATOMIC_SEQ_CST );
+        if (0 != __atomic_load_n( &(pBar->stRelease.uiSleepers), __ATOMIC_SEQ_CST ))
+        {
+            pu_futex_wake( &(pBar->stRelease.uiPhase), INT_MAX, 0 );
+        }
+        return (PU_BARRIER_SERIAL_THREAD);
+    }
+
+    /* Spin */
+    for (i = 0; i < pBar->stRelease.uiSpin; i++)
+    {
+        if (uiPhase != __atomic_load_n( &(pBar->stRelease.uiPhase), __ATOMIC_ACQUIRE ))
+        {
+            return (0);
+        }
+        PU_CPU_RELAX();
+    }
+
+    /* Then block */
+    __atomic_fetch_add( &(pBar->stRelease.uiSleepers), 1, __ATOMIC_SEQ_CST );
+    while (uiPhase == __atomic_load_n( &(pBar->stRelease.uiPhase), __ATOMIC_SEQ_CST ))
+    {
+        pu_futex_wait( &(pBar->stRelease.uiPhase), uiPhase, nullptr, 0 );
+    }
+    __atomic_fetch_sub( &(pBar->stRelease.uiSleepers), 1, __ATOMIC_RELAXED );
+    return (0);
+}
+/* pu_barrier_wait */
+
+/**
+ * @brief   Destroys a barrier
+ *
+ * @param[in] pBar : Pointer to a valid barrier
+ * @retval  0 for success
+ */
+int pu_barrier_destroy( pu_barrier_t* pBar )
+{
+    ASSERT( pBar );
+    if (!pBar)
+    {
+        return (-1);
+    }
+
+    /* Nothing is allocated, just check that nobody is still parked on it */
+    ASSERT( 0 == __atomic_load_n( &(pBar->stRelease.uiSleepers), __ATOMIC_RELAXED ) );
+    return (0);
+}
+/* pu_barrier_destroy */
+
+/**
+ * @brief   Creates (initialises) a latch
+ *
+ * @param[in] pLatch  : Pointer to a valid latch
+ * @param[in] uiCount : Initial count
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_latch_create(
+    pu_latch_t*  pLatch,
+    unsigned int uiCount )
+{
+    ASSERT( pLatch );
+    if (!pLatch)
+    {
+        return (-1);
+    }
+    __atomic_store_n( &(pLatch->uiWaiters), 0, __ATOMIC_RELAXED );
+    __atomic_store_n( &(pLatch->uiCount), uiCount, __ATOMIC_RELEASE );
+    return (0);
+}
+/* pu_latch_create */
+
+/**
+ * @brief   Decrements the latch, and releases the waiters when it reaches zero
+ *
+ * @param[in] pLatch  : Pointer to a valid latch
+ * @param[in] uiCount : Amount to count down by
+ */
+void pu_latch_count_down(
+    pu_latch_t*  pLatch,
+    unsigned int uiCount )
+{
+    unsigned int uiOld;
+
+    ASSERT( pLatch );
+    uiOld = __atomic_fetch_sub( &(pLatch->uiCount), uiCount, __ATOMIC_SEQ_CST );
+    ASSERT( uiOld >= uiCount );
+    if ((uiOld == uiCount) && (0 != __atomic_load_n( &(pLatch->uiWaiters), __ATOMIC_SEQ_CST )))
+    {
+        pu_futex_wake( &(pLatch->uiCount), INT_MAX, 0 );
+    }
+}
+/* pu_latch_count_down */
+
+/**
+ * @brief   Checks the latch without waiting
+ *
+ * @param[in] pLatch : Pointer to a valid latch
+ * @retval  Non-zero if the latch has reached zero
+ */
+int pu_latch_try_wait( const pu_latch_t* pLatch )
+{
+    ASSERT( pLatch );
+    return (0 == __atomic_load_n( &(pLatch->uiCount), __ATOMIC_ACQUIRE ));
+}
+/* pu_latch_try_wait */
+
+/**
+ * @brief   Waits until the latch reaches zero, or the timeout expires
+ *
+ * @param[in] pLatch      : Pointer to a valid latch
+ * @param[in] uiTimeoutMs : Timeout in ms, or PU_FUTEX_WAIT_FOREVER
+ * @retval  0 the latch reached zero
+ * @retval  ETIMEDOUT the timeout expired
+ */
+int pu_latch_wait(
+    pu_latch_t* pLatch,
+    size_t      uiTimeoutMs )
+{
+    struct timespec        tsDeadline;
+    const struct timespec* pDeadline;
+    unsigned int           uiCount;
+
+    if (pu_latch_try_wait( pLatch ))
+    {
+        return (0);
+    }
+
+    pDeadline = pu_futex_deadline( &tsDeadline, uiTimeoutMs );
+    __atomic_fetch_add( &(pLatch->uiWaiters), 1, __ATOMIC_SEQ_CST );
+    while (0 != (uiCount = __atomic_load_n( &(pLatch->uiCount), __ATOMIC_SEQ_CST )))
+    {
+        if (ETIMEDOUT == pu_futex_wait( &(pLatch->uiCount), uiCount, pDeadline, 0 ))
+        {
+            break;
+        }
+    }
+    __atomic_fetch_sub( &(pLatch->uiWaiters), 1, __ATOMIC_RELAXED );
+    return (pu_latch_try_wait( pLatch ) ? 0 : ETIMEDOUT);
+}
+/* pu_latch_wait */
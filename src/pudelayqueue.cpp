@@ -0,0 +1,487 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     pudelayqueue.cpp
+ * @brief    Implementation of the delay queue
+ */
+
+/**** Includes ***************************************************************/
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include "pudelayqueue.h"
+#include "posutils.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+#define PU_DELAYQUEUE_NS_PER_SEC  (1000000000ULL)
+#define PU_DELAYQUEUE_NS_PER_MS   (1000000ULL)
+#define PU_DELAYQUEUE_MIN_CAPACITY (16)
+
+/**** Macros ****************************************************************/
+
+/**** Static declarations ***************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static inline bool pu_delayqueue_before( const pu_delayqueue_entry_t* pA, const pu_delayqueue_entry_t* pB );
+static void pu_delayqueue_sift_up( pu_delayqueue_t* pQueue, size_t uiPos );
+static void pu_delayqueue_sift_down( pu_delayqueue_t* pQueue, size_t uiPos );
+static void* pu_delayqueue_pop( pu_delayqueue_t* pQueue );
+static void pu_delayqueue_ns_to_timespec( uint64_t ulNs, struct timespec* pTs );
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+/* Heap order, ready time first, then put order so that equal times stay FIFO */
+static inline bool pu_delayqueue_before(
+    const pu_delayqueue_entry_t* pA,
+    const pu_delayqueue_entry_t* pB )
+{
+    return ((pA->ulReadyNs < pB->ulReadyNs) ||
+            ((pA->ulReadyNs == pB->ulReadyNs) && (pA->ulSeq < pB->ulSeq)));
+}
+/* pu_delayqueue_before */
+
+static void pu_delayqueue_sift_up(
+    pu_delayqueue_t* pQueue,
+    size_t           uiPos )
+{
+    pu_delayqueue_entry_t stEntry = pQueue->pHeap[uiPos];
+    size_t                uiParent;
+
+    while (uiPos > 0)
+    {
+        uiParent = (uiPos - 1) / 2;
+        if (!pu_delayqueue_before( &stEntry, &(pQueue->pHeap[uiParent]) ))
+        {
+            break;
+        }
+        pQueue->pHeap[uiPos] = pQueue->pHeap[uiParent];
+        uiPos = uiParent;
+    }
+    pQueue->pHeap[uiPos] = stEntry;
+}
+/* pu_delayqueue_sift_up */
+
+static void pu_delayqueue_sift_down(
+    pu_delayqueue_t* pQueue,
+    size_t           uiPos )
+{
+    pu_delayqueue_entry_t stEntry = pQueue->pHeap[uiPos];
+    size_t                uiChild;
+
+    for (;;)
+    {
+        uiChild = 2 * uiPos + 1;
+        if (uiChild >= pQueue->uiCount)
+        {
+            break;
+        }
+        if (((uiChild + 1) < pQueue->uiCount) &&
+            pu_delayqueue_before( &(pQueue->pHeap[uiChild + 1]), &(pQueue->pHeap[uiChild]) ))
+        {
+            uiChild++;
+        }
+        if (!pu_delayqueue_before( &(pQueue->pHeap[uiChild]), &stEntry ))
+        {
+            break;
+        }
+        pQueue->pHeap[uiPos] = pQueue->pHeap[uiChild];
+        uiPos = uiChild;
+    }
+    pQueue->pHeap[uiPos] = stEntry;
+}
+/* pu_delayqueue_sift_down */
+
+/* Removes the head. Lock held, queue not empty. */
+static void* pu_delayqueue_pop( pu_delayqueue_t* pQueue )
+{
+    void* pItem = pQueue->pHeap[0].pItem;
+
+    pQueue->uiCount--;
+    if (pQueue->uiCount > 0)
+    {
+        pQueue->pHeap[0] = pQueue->pHeap[pQueue->uiCount];
+        pu_delayqueue_sift_down( pQueue, 0 );
+    }
+    return (pItem);
+}
+/* pu_delayqueue_pop */
+
+static void pu_delayqueue_ns_to_timespec(
+    uint64_t         ulNs,
+    struct timespec* pTs )
+{
+    pTs->tv_sec  = (time_t)(ulNs / PU_DELAYQUEUE_NS_PER_SEC);
+    pTs->tv_nsec = (long)(ulNs % PU_DELAYQUEUE_NS_PER_SEC);
+}
+/* pu_delayqueue_ns_to_timespec */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Creates (initialises) a delay queue
+ *
+ * @param[in] pQueue     : Pointer to a valid queue
+ * @param[in] uiCapacity : Initial number of items
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_delayqueue_create(
+    pu_delayqueue_t* pQueue,
+    size_t           uiCapacity )
+{
+    pthread_condattr_t cattr;
+    int                iResult;
+
+    /* pre-condition */
+    ASSERT( pQueue );
+    if (!pQueue)
+    {
+        return (-1);
+    }
+
+    if (uiCapacity < PU_DELAYQUEUE_MIN_CAPACITY)
+    {
+        uiCapacity = PU_DELAYQUEUE_MIN_CAPACITY;
+    }
+    pQueue->pHeap = (pu_delayqueue_entry_t*)malloc( uiCapacity * sizeof(pu_delayqueue_entry_t) );
+    if (!pQueue->pHeap)
+    {
+        LOG_ERROR( "PU_DELAYQUEUE(create): no memory for %zu items\n", uiCapacity );
+        return (-1);
+    }
+    pQueue->uiCount    = 0;
+    pQueue->uiCapacity = uiCapacity;
+    pQueue->ulSeq      = 0;
+    pQueue->uiWaiters  = 0;
+    pQueue->pLeader    = nullptr;
+    pQueue->bClosed    = 0;
+
+    iResult = pu_mutex_create_type( &(pQueue->mtxLock), PU_MUTEX_TYPE_FAST );
+    ASSERT( 0 == iResult );
+    if (0 == iResult)
+    {
+        /* Deadlines come from timespec_now_ns_monotonic, wait on the same clock */
+        pthread_condattr_init( &cattr );
+        pthread_condattr_setclock( &cattr, CLOCK_MONOTONIC );
+        iResult = pthread_cond_init( &(pQueue->cndReady), &cattr );
+        ASSERT( 0 == iResult );
+        pthread_condattr_destroy( &cattr );
+        if (0 != iResult)
+        {
+            pu_mutex_destroy( &(pQueue->mtxLock) );
+        }
+    }
+    if (0 != iResult)
+    {
+        free( pQueue->pHeap );
+        pQueue->pHeap = nullptr;
+        return (-1);
+    }
+    return (0);
+}
+/* pu_delayqueue_create */
+
+/**
+ * @brief   Destroys a delay queue
+ *
+ * @param[in] pQueue : Pointer to a valid queue
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_delayqueue_destroy( pu_delayqueue_t* pQueue )
+{
+    ASSERT( pQueue );
+    if ((!pQueue) || (!pQueue->pHeap))
+    {
+        return (-1);
+    }
+    ASSERT( 0 == pQueue->uiWaiters );
+    pthread_cond_destroy( &(pQueue->cndReady) );
+    pu_mutex_destroy( &(pQueue->mtxLock) );
+    free( pQueue->pHeap );
+    pQueue->pHeap      = nullptr;
+    pQueue->uiCount    = 0;
+    pQueue->uiCapacity = 0;
+    return (0);
+}
+/* pu_delayqueue_destroy */
+
+/**
+ * @brief   Puts an item that becomes available after a delay
+ *
+ * @param[in] pQueue    : Pointer to a valid queue
+ * @param[in] pItem     : Item
+ * @param[in] uiDelayMs : Delay in ms
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_delayqueue_put(
+    pu_delayqueue_t* pQueue,
+    void*            pItem,
+    size_t           uiDelayMs )
+{
+    return (pu_delayqueue_put_at( pQueue, pItem,
+                                  timespec_now_ns_monotonic() + (uint64_t)uiDelayMs * PU_DELAYQUEUE_NS_PER_MS ));
+}
+/* pu_delayqueue_put */
+
+/**
+ * @brief   Puts an item that becomes available at a given time
+ *
+ * @param[in] pQueue    : Pointer to a valid queue
+ * @param[in] pItem     : Item
+ * @param[in] ulReadyNs : Ready time, monotonic ns
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ *
+ * @par Description
+ * Only an item that becomes the new head changes what the consumers wait for, so only then
+ * is one of them signalled.
+ */
+int pu_delayqueue_put_at(
+    pu_delayqueue_t* pQueue,
+    void*            pItem,
+    uint64_t         ulReadyNs )
+{
+    pu_delayqueue_entry_t* pGrown;
+    size_t                 uiPos;
+
+    ASSERT( pQueue );
+    if ((!pQueue) || (!pQueue->pHeap))
+    {
+        return (-1);
+    }
+
+    pu_mutex_lock( &(pQueue->mtxLock) );
+    if (pQueue->bClosed)
+    {
+        pu_mutex_unlock( &(pQueue->mtxLock) );
+        return (-1);
+    }
+    if (pQueue->uiCount == pQueue->uiCapacity)
+    {
+        pGrown = (pu_delayqueue_entry_t*)realloc( pQueue->pHeap, 2 * pQueue->uiCapacity * sizeof(pu_delayqueue_entry_t) );
+        if (!pGrown)
+        {
+            pu_mutex_unlock( &(pQueue->mtxLock) );
+            LOG_ERROR( "PU_DELAYQUEUE(put): no memory for %zu items\n", 2 * pQueue->uiCapacity );
+            return (-1);
+        }
+        pQueue->pHeap       = pGrown;
+        pQueue->uiCapacity *= 2;
+    }
+    uiPos = pQueue->uiCount++;
+    pQueue->pHeap[uiPos].ulReadyNs = ulReadyNs;
+    pQueue->pHeap[uiPos].ulSeq     = pQueue->ulSeq++;
+    pQueue->pHeap[uiPos].pItem     = pItem;
+    pu_delayqueue_sift_up( pQueue, uiPos );
+
+    /* A new head, the leader is waiting for the wrong time. Let a waiter take over. */
+    if (pQueue->pHeap[0].ulSeq == (pQueue->ulSeq - 1))
+    {
+        pQueue->pLeader = nullptr;
+        if (pQueue->uiWaiters > 0)
+        {
+            pthread_cond_signal( &(pQueue->cndReady) );
+        }
+    }
+    pu_mutex_unlock( &(pQueue->mtxLock) );
+    return (0);
+}
+/* pu_delayqueue_put_at */
+
+/**
+ * @brief   Takes the earliest item once it is due, waiting at most the timeout
+ *
+ * @param[in]  pQueue      : Pointer to a valid queue
+ * @param[out] ppItem      : The item
+ * @param[in]  uiTimeoutMs : Timeout in ms, or PU_DELAYQUEUE_WAIT_FOREVER
+ * @retval  0 for success
+ * @retval  ETIMEDOUT no item became due in time
+ * @retval  EPIPE the queue is closed and no item is due
+ *
+ * @par Description
+ * One waiter, the leader, sleeps until the head is due (or its own timeout). The others sleep
+ * until signalled or their timeout, so a due item wakes one consumer and not all of them. A
+ * consumer leaving with items still queued and no leader signals a waiter to take over.
+ */
+int pu_delayqueue_take(
+    pu_delayqueue_t* pQueue,
+    void**           ppItem,
+    size_t           uiTimeoutMs )
+{
+    struct timespec tsWait;
+    uint64_t        ulDeadline = UINT64_MAX;
+    uint64_t        ulNow;
+    uint64_t        ulWake;
+    bool            bLeader;
+    int             iResult;
+
+    ASSERT( pQueue && ppItem );
+    if ((!pQueue) || (!ppItem) || (!pQueue->pHeap))
+    {
+        return (EINVAL);
+    }
+    if (PU_DELAYQUEUE_WAIT_FOREVER != uiTimeoutMs)
+    {
+        ulDeadline = timespec_now_ns_monotonic() + (uint64_t)uiTimeoutMs * PU_DELAYQUEUE_NS_PER_MS;
+    }
+
+    pu_mutex_lock( &(pQueue->mtxLock) );
+    for (;;)
+    {
+        ulNow = timespec_now_ns_monotonic();
+        if ((pQueue->uiCount > 0) && (pQueue->pHeap[0].ulReadyNs <= ulNow))
+        {
+            *ppItem = pu_delayqueue_pop( pQueue );
+            iResult = 0;
+            break;
+        }
+        if (pQueue->bClosed)
+        {
+            iResult = EPIPE;
+            break;
+        }
+        if (ulNow >= ulDeadline)
+        {
+            iResult = ETIMEDOUT;
+            break;
+        }
+
+        /* Lead when nobody waits for the head. The local's address identifies this call. */
+        ulWake  = ulDeadline;
+        bLeader = false;
+        if ((pQueue->uiCount > 0) && (!pQueue->pLeader))
+        {
+            pQueue->pLeader = &tsWait;
+            bLeader         = true;
+            if (pQueue->pHeap[0].ulReadyNs < ulWake)
+            {
+                ulWake = pQueue->pHeap[0].ulReadyNs;
+            }
+        }
+
+        /* Spurious and early wakeups just go round again */
+        pQueue->uiWaiters++;
+        if (UINT64_MAX == ulWake)
+        {
+            pthread_cond_wait( &(pQueue->cndReady), &(pQueue->mtxLock) );
+        }
+        else
+        {
+            pu_delayqueue_ns_to_timespec( ulWake, &tsWait );
+            pthread_cond_timedwait( &(pQueue->cndReady), &(pQueue->mtxLock), &tsWait );
+        }
+        pQueue->uiWaiters--;
+        if (bLeader && (pQueue->pLeader == &tsWait))
+        {
+            pQueue->pLeader = nullptr;
+        }
+    }
+    if ((!pQueue->pLeader) && (pQueue->uiCount > 0) && (pQueue->uiWaiters > 0))
+    {
+        pthread_cond_signal( &(pQueue->cndReady) );
+    }
+    pu_mutex_unlock( &(pQueue->mtxLock) );
+    return (iResult);
+}
+/* pu_delayqueue_take */
+
+/**
+ * @brief   Takes the earliest item if it is due, never waits
+ *
+ * @param[in]  pQueue : Pointer to a valid queue
+ * @param[out] ppItem : The item
+ * @retval  0 for success
+ * @retval  EAGAIN no item is due
+ */
+int pu_delayqueue_poll(
+    pu_delayqueue_t* pQueue,
+    void**           ppItem )
+{
+    int iResult = EAGAIN;
+
+    ASSERT( pQueue && ppItem );
+    if ((!pQueue) || (!ppItem) || (!pQueue->pHeap))
+    {
+        return (EINVAL);
+    }
+
+    pu_mutex_lock( &(pQueue->mtxLock) );
+    if ((pQueue->uiCount > 0) && (pQueue->pHeap[0].ulReadyNs <= timespec_now_ns_monotonic()))
+    {
+        *ppItem = pu_delayqueue_pop( pQueue );
+        if ((!pQueue->pLeader) && (pQueue->uiCount > 0) && (pQueue->uiWaiters > 0))
+        {
+            pthread_cond_signal( &(pQueue->cndReady) );
+        }
+        iResult = 0;
+    }
+    pu_mutex_unlock( &(pQueue->mtxLock) );
+    return (iResult);
+}
+/* pu_delayqueue_poll */
+
+/**
+ * @brief   Number of queued items
+ *
+ * @param[in] pQueue : Pointer to a valid queue
+ * @retval  The number of items
+ */
+size_t pu_delayqueue_size( pu_delayqueue_t* pQueue )
+{
+    size_t uiCount;
+
+    ASSERT( pQueue );
+    if (!pQueue)
+    {
+        return (0);
+    }
+    pu_mutex_lock( &(pQueue->mtxLock) );
+    uiCount = pQueue->uiCount;
+    pu_mutex_unlock( &(pQueue->mtxLock) );
+    return (uiCount);
+}
+/* pu_delayqueue_size */
+
+/**
+ * @brief   Closes the queue, and wakes every waiting consumer
+ *
+ * @param[in] pQueue : Pointer to a valid queue
+ */
+void pu_delayqueue_close( pu_delayqueue_t* pQueue )
+{
+    ASSERT( pQueue );
+    if (!pQueue)
+    {
+        return;
+    }
+    pu_mutex_lock( &(pQueue->mtxLock) );
+    pQueue->bClosed = 1;
+    pthread_cond_broadcast( &(pQueue->cndReady) );
+    pu_mutex_unlock( &(pQueue->mtxLock) );
+}
+/* pu_delayqueue_close */
@@ -0,0 +1,385 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     puebr.cpp
+ * @brief    Implementation of the epoch based reclamation domain
+ */
+
+/**** Includes ***************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include "puebr.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+
+/* Bit 0 of a published epoch flags "inside a section", so the epoch moves in steps of 2 */
+#define PU_EBR_EPOCH_STEP   (2U)
+
+/* A list is safe to free once the epoch has moved two steps past its tag */
+#define PU_EBR_GRACE        (2U * PU_EBR_EPOCH_STEP)
+
+/* One retire list per epoch that can still hold live objects, plus the current one */
+#define PU_EBR_LISTS        (3U)
+
+/* Objects retired during one epoch */
+typedef struct pu_ebr_list_tag
+{
+    pu_ebr_node_t* pHead;         /* Retired objects               */
+    size_t         uiEpoch;       /* Epoch they were retired in    */
+}   pu_ebr_list_t;
+
+/* Per thread record. Records are never freed, an exited thread's record is reused */
+typedef struct pu_ebr_thread_tag pu_ebr_thread_t;
+struct PU_CACHELINE_ALIGNED pu_ebr_thread_tag
+{
+    size_t           uiLocal;             /* Epoch seen | 1 inside a section, 0 outside   */
+    unsigned int     bInUse;              /* Owned by a thread (or by a barrier)          */
+    pu_ebr_thread_t* pNext;               /* Registry link, set once                      */
+    unsigned int     uiNest;              /* Read-side section nesting                    */
+    unsigned int     uiRefs;              /* Registration nesting                         */
+    unsigned int     uiPending;           /* Retires since the last reclaim attempt       */
+    pu_ebr_list_t    stLimbo[PU_EBR_LISTS];
+};
+
+/**** Macros ****************************************************************/
+
+/**** Static declarations ***************************************************/
+static struct
+{
+    struct PU_CACHELINE_ALIGNED
+    {
+        size_t           uiEpoch;         /* Global epoch, always even     */
+    }   stEpoch;
+
+    struct PU_CACHELINE_ALIGNED
+    {
+        pu_ebr_thread_t* pHead;           /* Registry, push only           */
+    }   stRegistry;
+}   stDomain;
+
+static thread_local pu_ebr_thread_t* pEbrSelf = nullptr;
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static void   pu_ebr_free_list( pu_ebr_list_t* pList );
+static void   pu_ebr_reclaim( pu_ebr_thread_t* pThread, size_t uiEpoch );
+static size_t pu_ebr_try_advance( void );
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+/* Detached first, a free function may retire more objects */
+static void pu_ebr_free_list( pu_ebr_list_t* pList )
+{
+    pu_ebr_node_t* pNode = pList->pHead;
+    pu_ebr_node_t* pNext;
+
+    pList->pHead = nullptr;
+    while (pNode)
+    {
+        pNext = pNode->pNext;
+        pNode->fctFree( pNode );
+        pNode = pNext;
+    }
+}
+/* pu_ebr_free_list */
+
+/* Frees the lists of a record that are out of their grace period */
+static void pu_ebr_reclaim(
+    pu_ebr_thread_t* pThread,
+    size_t           uiEpoch )
+{
+    unsigned int i;
+
+    for (i = 0; i < PU_EBR_LISTS; i++)
+    {
+        if ((pThread->stLimbo[i].pHead) && ((uiEpoch - pThread->stLimbo[i].uiEpoch) >= PU_EBR_GRACE))
+        {
+            pu_ebr_free_list( &(pThread->stLimbo[i]) );
+        }
+    }
+}
+/* pu_ebr_reclaim */
+
+/* Advances the epoch if every thread inside a section has seen it. Returns the epoch. */
+static size_t pu_ebr_try_advance( void )
+{
+    size_t           uiEpoch = __atomic_load_n( &(stDomain.stEpoch.uiEpoch), __ATOMIC_SEQ_CST );
+    size_t           uiLocal;
+    pu_ebr_thread_t* pThread;
+
+    for (pThread = __atomic_load_n( &(stDomain.stRegistry.pHead), __ATOMIC_ACQUIRE ); pThread; pThread = pThread->pNext)
+    {
+        uiLocal = __atomic_load_n( &(pThread->uiLocal), __ATOMIC_SEQ_CST );
+        if ((uiLocal & 1) && (uiLocal != (uiEpoch | 1)))
+        {
+            return (uiEpoch);
+        }
+    }
+
+    /* On failure somebody else advanced it, uiEpoch is updated to their value */
+    if (__atomic_compare_exchange_n( &(stDomain.stEpoch.uiEpoch), &uiEpoch, uiEpoch + PU_EBR_EPOCH_STEP, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ))
+    {
+        uiEpoch += PU_EBR_EPOCH_STEP;
+    }
+    return (uiEpoch);
+}
+/* pu_ebr_try_advance */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Registers the calling thread with the EBR domain
+ *
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ *
+ * @par Description
+ * Takes a free record from the registry, or adds a new one. The number of records is the
+ * highest number of threads that were ever registered at the same time.
+ */
+int pu_ebr_register( void )
+{
+    pu_ebr_thread_t* pThread;
+    unsigned int     bFree;
+
+    if (pEbrSelf)
+    {
+        pEbrSelf->uiRefs++;
+        return (0);
+    }
+
+    for (pThread = __atomic_load_n( &(stDomain.stRegistry.pHead), __ATOMIC_ACQUIRE ); pThread; pThread = pThread->pNext)
+    {
+        bFree = 0;
+        if ((!__atomic_load_n( &(pThread->bInUse), __ATOMIC_RELAXED )) &&
+            (__atomic_compare_exchange_n( &(pThread->bInUse), &bFree, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED )))
+        {
+            break;
+        }
+    }
+
+    if (!pThread)
+    {
+        void* pMem = nullptr;
+        if (0 != posix_memalign( &pMem, PU_CACHELINE_SIZE, sizeof(pu_ebr_thread_t) ))
+        {
+            LOG_ERROR( "PU_EBR(register): out of memory, %zu bytes\n", sizeof(pu_ebr_thread_t) );
+            return (-1);
+        }
+        pThread = (pu_ebr_thread_t*)pMem;
+        memset( pThread, 0, sizeof(pu_ebr_thread_t) );
+        pThread->bInUse = 1;
+        pThread->pNext  = __atomic_load_n( &(stDomain.stRegistry.pHead), __ATOMIC_RELAXED );
+        while (!__atomic_compare_exchange_n( &(stDomain.stRegistry.pHead), &(pThread->pNext), pThread, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED ))
+        {
+        }
+    }
+
+    /* Lists left by the previous owner stay, they are freed in the normal way */
+    pThread->uiRefs    = 1;
+    pThread->uiNest    = 0;
+    pThread->uiPending = 0;
+    pEbrSelf = pThread;
+    return (0);
+}
+/* pu_ebr_register */
+
+/**
+ * @brief   Unregisters the calling thread
+ *
+ * @par Description
+ * Frees what it can. The rest stays with the record until it is reused, or until a barrier.
+ */
+void pu_ebr_unregister( void )
+{
+    pu_ebr_thread_t* pThread = pEbrSelf;
+
+    ASSERT( pThread );
+    if (!pThread)
+    {
+        return;
+    }
+    ASSERT( 0 == pThread->uiNest );
+    if (--(pThread->uiRefs) > 0)
+    {
+        return;
+    }
+    pu_ebr_reclaim( pThread, pu_ebr_try_advance() );
+    pEbrSelf = nullptr;
+    __atomic_store_n( &(pThread->bInUse), 0, __ATOMIC_RELEASE );
+}
+/* pu_ebr_unregister */
+
+/**
+ * @brief   Enters a read-side section
+ *
+ * @par Description
+ * Only the outermost call publishes the epoch. The fence orders that store before the loads of
+ * the shared structure, against the fence in the retire path.
+ */
+void pu_ebr_enter( void )
+{
+    pu_ebr_thread_t* pThread = pEbrSelf;
+
+    ASSERT( pThread );
+    if (!pThread)
+    {
+        return;
+    }
+    if (0 == pThread->uiNest++)
+    {
+        __atomic_store_n( &(pThread->uiLocal), __atomic_load_n( &(stDomain.stEpoch.uiEpoch), __ATOMIC_RELAXED ) | 1, __ATOMIC_RELAXED );
+        __atomic_thread_fence( __ATOMIC_SEQ_CST );
+    }
+}
+/* pu_ebr_enter */
+
+/**
+ * @brief   Leaves a read-side section
+ */
+void pu_ebr_exit( void )
+{
+    pu_ebr_thread_t* pThread = pEbrSelf;
+
+    ASSERT( pThread && (pThread->uiNest > 0) );
+    if ((!pThread) || (0 == pThread->uiNest))
+    {
+        return;
+    }
+    if (0 == --(pThread->uiNest))
+    {
+        __atomic_store_n( &(pThread->uiLocal), 0, __ATOMIC_RELEASE );
+    }
+}
+/* pu_ebr_exit */
+
+/**
+ * @brief   Retires an unlinked object
+ *
+ * @param[in] pNode   : Node embedded in the object
+ * @param[in] fctFree : Free function
+ *
+ * @par Description
+ * The fence keeps the epoch load from moving ahead of the caller's unlink, otherwise the object
+ * could be tagged with an epoch older than the last reader that can still reach it.
+ */
+void pu_ebr_retire(
+    pu_ebr_node_t*    pNode,
+    pu_ebr_free_fct_t fctFree )
+{
+    pu_ebr_thread_t* pThread = pEbrSelf;
+    pu_ebr_list_t*   pList;
+    size_t           uiEpoch;
+
+    ASSERT( pThread );
+    ASSERT( pNode && fctFree );
+    if ((!pThread) || (!pNode) || (!fctFree))
+    {
+        return;
+    }
+
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+    uiEpoch = __atomic_load_n( &(stDomain.stEpoch.uiEpoch), __ATOMIC_RELAXED );
+    pList   = &(pThread->stLimbo[(uiEpoch / PU_EBR_EPOCH_STEP) % PU_EBR_LISTS]);
+
+    /* The list in this slot is from three epochs ago. Tagging the merged list with the newer
+     * epoch only delays a free, so it is safe even when the old list is not yet eligible */
+    if ((pList->pHead) && ((uiEpoch - pList->uiEpoch) >= PU_EBR_GRACE))
+    {
+        pu_ebr_free_list( pList );
+    }
+    pNode->fctFree = fctFree;
+    pNode->pNext   = pList->pHead;
+    pList->pHead   = pNode;
+    pList->uiEpoch = uiEpoch;
+
+    if (++(pThread->uiPending) >= PU_EBR_RETIRE_BATCH)
+    {
+        pThread->uiPending = 0;
+        pu_ebr_reclaim( pThread, pu_ebr_try_advance() );
+    }
+}
+/* pu_ebr_retire */
+
+/**
+ * @brief   Quiescent state hook
+ */
+void pu_ebr_quiescent( void )
+{
+    pu_ebr_thread_t* pThread = pEbrSelf;
+
+    ASSERT( pThread );
+    if (!pThread)
+    {
+        return;
+    }
+    ASSERT( 0 == pThread->uiNest );
+    pThread->uiPending = 0;
+    pu_ebr_reclaim( pThread, pu_ebr_try_advance() );
+}
+/* pu_ebr_quiescent */
+
+/**
+ * @brief   Waits for all the current readers, then frees everything retired so far
+ */
+void pu_ebr_barrier( void )
+{
+    pu_ebr_thread_t* pThread;
+    size_t           uiStart;
+    size_t           uiEpoch;
+    unsigned int     bFree;
+
+    ASSERT( (!pEbrSelf) || (0 == pEbrSelf->uiNest) );
+
+    /* Two steps from now every list retired so far is out of its grace period */
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+    uiStart = __atomic_load_n( &(stDomain.stEpoch.uiEpoch), __ATOMIC_RELAXED );
+    uiEpoch = uiStart;
+    while ((uiEpoch - uiStart) < PU_EBR_GRACE)
+    {
+        size_t uiNow = pu_ebr_try_advance();
+        if (uiNow == uiEpoch)
+        {
+            sched_yield();
+        }
+        uiEpoch = uiNow;
+    }
+
+    if (pEbrSelf)
+    {
+        pu_ebr_reclaim( pEbrSelf, uiEpoch );
+    }
+    for (pThread = __atomic_load_n( &(stDomain.stRegistry.pHead), __ATOMIC_ACQUIRE ); pThread; pThread = pThread->pNext)
+    {
+        bFree = 0;
+        if (__atomic_compare_exchange_n( &(pThread->bInUse), &bFree, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED ))
+        {
+            pu_ebr_reclaim( pThread, uiEpoch );
+            __atomic_store_n( &(pThread->bInUse), 0, __ATOMIC_RELEASE );
+        }
+    }
+}
+/* pu_ebr_barrier */
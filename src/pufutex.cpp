@@ -0,0 +1,389 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     pufutex.cpp
+ * @brief    Implementation of the futex wrappers, semaphore and event count
+ */
+
+/**** Includes ***************************************************************/
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <syscall.h>
+#include <linux/futex.h>
+#include "pufutex.h"
+#include "putimer.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+
+/**** Macros ****************************************************************/
+
+/* Private futexes are keyed on the virtual address, which is cheaper than the shared key */
+#define PU_FUTEX_OP(op_, shared_) ((shared_) ? (op_) : ((op_) | FUTEX_PRIVATE_FLAG))
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Waits while a futex word holds the expected value
+ *
+ * @param[in] pWord      : Futex word
+ * @param[in] uiExpected : Expected value
+ * @param[in] pDeadline  : Absolute CLOCK_MONOTONIC deadline, NULL to wait forever
+ * @param[in] bShared    : Non-zero if the word is shared between processes
+ * @retval  0 woken, EAGAIN value changed, ETIMEDOUT, EINTR
+ *
+ * @par Description
+ * FUTEX_WAIT_BITSET is used because, unlike FUTEX_WAIT, it takes an absolute timeout.
+ */
+int pu_futex_wait(
+    unsigned int*          pWord,
+    unsigned int           uiExpected,
+    const struct timespec* pDeadline,
+    int                    bShared )
+{
+    if (0 != syscall( SYS_futex, pWord, PU_FUTEX_OP( FUTEX_WAIT_BITSET, bShared ), uiExpected,
+                      pDeadline, nullptr, FUTEX_BITSET_MATCH_ANY ))
+    {
+        return (errno);
+    }
+    return (0);
+}
+/* pu_futex_wait */
+
+/**
+ * @brief   Wakes threads waiting on a futex word
+ *
+ * @param[in] pWord   : Futex word
+ * @param[in] iCount  : Maximum number of threads to wake
+ * @param[in] bShared : Non-zero if the word is shared between processes
+ * @retval  The number of threads woken
+ */
+int pu_futex_wake(
+    unsigned int* pWord,
+    int           iCount,
+    int           bShared )
+{
+    long lWoken = syscall( SYS_futex, pWord, PU_FUTEX_OP( FUTEX_WAKE, bShared ), iCount, nullptr, nullptr, 0 );
+    return ((lWoken > 0) ? (int)lWoken : 0);
+}
+/* pu_futex_wake */
+
+/**
+ * @brief   Converts a timeout into an absolute CLOCK_MONOTONIC deadline
+ *
+ * @param[out] pTs         : Deadline storage
+ * @param[in]  uiTimeoutMs : Timeout in ms, or PU_FUTEX_WAIT_FOREVER
+ * @retval  pTs, or NULL for an unbounded wait
+ */
+const struct timespec* pu_futex_deadline(
+    struct timespec* pTs,
+    size_t           uiTimeoutMs )
+{
+    if (PU_FUTEX_WAIT_FOREVER == uiTimeoutMs)
+    {
+        return (nullptr);
+    }
+    timespec_now_plus_ms_monotonic( pTs, uiTimeoutMs );
+    return (pTs);
+}
+/* pu_futex_deadline */
+
+/**
+ * @brief   Creates (initialises) a semaphore
+ *
+ * @param[in] pSem      : Pointer to a valid semaphore
+ * @param[in] uiInitial : Initial value
+ * @param[in] bShared   : Non-zero if the semaphore is shared between processes
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_sem_create(
+    pu_sem_t*    pSem,
+    unsigned int uiInitial,
+    int          bShared )
+{
+    ASSERT( pSem );
+    if (!pSem)
+    {
+        return (-1);
+    }
+    pSem->bShared = bShared;
+    __atomic_store_n( &(pSem->uiWaiters), 0, __ATOMIC_RELAXED );
+    __atomic_store_n( &(pSem->uiCount), uiInitial, __ATOMIC_RELEASE );
+    return (0);
+}
+/* pu_sem_create */
+
+/**
+ * @brief   Adds a batch of units to the semaphore, waking up to that many waiters
+ *
+ * @param[in] pSem    : Pointer to a valid semaphore
+ * @param[in] uiCount : Number of units
+ * @retval  0 for success
+ */
+int pu_sem_post_n(
+    pu_sem_t*    pSem,
+    unsigned int uiCount )
+{
+    ASSERT( pSem );
+
+    /* Pairs with the waiter: waiters++ then count check. Both sides are seq_cst, so
+     * either the waiter sees the new count, or this sees the waiter. */
+    __atomic_fetch_add( &(pSem->uiCount), uiCount, __ATOMIC_SEQ_CST );
+    if (0 != __atomic_load_n( &(pSem->uiWaiters), __ATOMIC_SEQ_CST ))
+    {
+        pu_futex_wake( &(pSem->uiCount), (uiCount > INT_MAX) ? INT_MAX : (int)uiCount, pSem->bShared );
+    }
+    return (0);
+}
+/* pu_sem_post_n */
+
+/**
+ * @brief   Increments the semaphore, waking one waiter if there is one
+ *
+ * @param[in] pSem : Pointer to a valid semaphore
+ * @retval  0 for success
+ */
+int pu_sem_post( pu_sem_t* pSem )
+{
+    return (pu_sem_post_n( pSem, 1 ));
+}
+/* pu_sem_post */
+
+/**
+ * @brief   Decrements the semaphore if it is non-zero, never waits
+ *
+ * @param[in] pSem : Pointer to a valid semaphore
+ * @retval  0 for success
+ * @retval  EAGAIN the value was zero
+ */
+int pu_sem_trywait( pu_sem_t* pSem )
+{
+    unsigned int uiCount;
+
+    ASSERT( pSem );
+    uiCount = __atomic_load_n( &(pSem->uiCount), __ATOMIC_RELAXED );
+    while (0 != uiCount)
+    {
+        if (__atomic_compare_exchange_n( &(pSem->uiCount), &uiCount, uiCount - 1, true,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_RELAXED ))
+        {
+            return (0);
+        }
+    }
+    return (EAGAIN);
+}
+/* pu_sem_trywait */
+
+/**
+ * @brief   Decrements the semaphore, waiting at most the timeout
+ *
+ * @param[in] pSem        : Pointer to a valid semaphore
+ * @param[in] uiTimeoutMs : Timeout in ms, or PU_FUTEX_WAIT_FOREVER
+ * @retval  0 for success
+ * @retval  ETIMEDOUT the timeout expired
+ */
+int pu_sem_timedwait(
+    pu_sem_t* pSem,
+    size_t    uiTimeoutMs )
+{
+    struct timespec        tsDeadline;
+    const struct timespec* pDeadline;
+    int                    iResult;
+
+    /* Fast path, no syscall */
+    if (0 == pu_sem_trywait( pSem ))
+    {
+        return (0);
+    }
+
+    pDeadline = pu_futex_deadline( &tsDeadline, uiTimeoutMs );
+    __atomic_fetch_add( &(pSem->uiWaiters), 1, __ATOMIC_SEQ_CST );
+    for (;;)
+    {
+        iResult = pu_sem_trywait( pSem );
+        if (0 == iResult)
+        {
+            break;
+        }
+        if (ETIMEDOUT == pu_futex_wait( &(pSem->uiCount), 0, pDeadline, pSem->bShared ))
+        {
+            iResult = (0 == pu_sem_trywait( pSem )) ? 0 : ETIMEDOUT;
+            break;
+        }
+    }
+    __atomic_fetch_sub( &(pSem->uiWaiters), 1, __ATOMIC_RELAXED );
+    return (iResult);
+}
+/* pu_sem_timedwait */
+
+/**
+ * @brief   Decrements the semaphore, waiting for as long as it takes
+ *
+ * @param[in] pSem : Pointer to a valid semaphore
+ * @retval  0 for success
+ */
+int pu_sem_wait( pu_sem_t* pSem )
+{
+    return (pu_sem_timedwait( pSem, PU_FUTEX_WAIT_FOREVER ));
+}
+/* pu_sem_wait */
+
+/**
+ * @brief   Current value of the semaphore (a snapshot)
+ *
+ * @param[in] pSem : Pointer to a valid semaphore
+ * @retval  The value
+ */
+unsigned int pu_sem_value( const pu_sem_t* pSem )
+{
+    ASSERT( pSem );
+    return (__atomic_load_n( &(pSem->uiCount), __ATOMIC_RELAXED ));
+}
+/* pu_sem_value */
+
+/**
+ * @brief   Creates (initialises) an event count
+ *
+ * @param[in] pEc : Pointer to a valid event count
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_eventcount_create( pu_eventcount_t* pEc )
+{
+    ASSERT( pEc );
+    if (!pEc)
+    {
+        return (-1);
+    }
+    __atomic_store_n( &(pEc->uiEpoch), 0, __ATOMIC_RELEASE );
+    return (0);
+}
+/* pu_eventcount_create */
+
+/**
+ * @brief   Announces an intent to wait
+ *
+ * @param[in] pEc : Pointer to a valid event count
+ * @retval  The key, to pass to pu_eventcount_wait()
+ */
+unsigned int pu_eventcount_prepare_wait( pu_eventcount_t* pEc )
+{
+    ASSERT( pEc );
+
+    /* Flagged in the epoch before the caller re-checks its condition */
+    return (__atomic_fetch_or( &(pEc->uiEpoch), 1, __ATOMIC_SEQ_CST ) | 1);
+}
+/* pu_eventcount_prepare_wait */
+
+/**
+ * @brief   Withdraws an intent to wait
+ *
+ * @param[in] pEc : Pointer to a valid event count
+ *
+ * @par Description
+ * The epoch flag is left alone, other threads may be waiting. At worst the next notify makes
+ * one unnecessary wake syscall.
+ */
+void pu_eventcount_cancel_wait( pu_eventcount_t* pEc )
+{
+    ASSERT( pEc );
+    (void)pEc;
+}
+/* pu_eventcount_cancel_wait */
+
+/**
+ * @brief   Waits until the event count is notified after the key was taken
+ *
+ * @param[in] pEc         : Pointer to a valid event count
+ * @param[in] uiKey       : Value returned by pu_eventcount_prepare_wait()
+ * @param[in] uiTimeoutMs : Timeout in ms, or PU_FUTEX_WAIT_FOREVER
+ * @retval  0 notified
+ * @retval  ETIMEDOUT the timeout expired
+ */
+int pu_eventcount_wait(
+    pu_eventcount_t* pEc,
+    unsigned int     uiKey,
+    size_t           uiTimeoutMs )
+{
+    struct timespec        tsDeadline;
+    const struct timespec* pDeadline;
+
+    ASSERT( pEc );
+    pDeadline = pu_futex_deadline( &tsDeadline, uiTimeoutMs );
+    while (uiKey == __atomic_load_n( &(pEc->uiEpoch), __ATOMIC_ACQUIRE ))
+    {
+        if (ETIMEDOUT == pu_futex_wait( &(pEc->uiEpoch), uiKey, pDeadline, 0 ))
+        {
+            break;
+        }
+    }
+    return ((uiKey != __atomic_load_n( &(pEc->uiEpoch), __ATOMIC_ACQUIRE )) ? 0 : ETIMEDOUT);
+}
+/* pu_eventcount_wait */
+
+/**
+ * @brief   Notifies the waiters, no syscall when nobody waits
+ *
+ * @param[in] pEc : Pointer to a valid event count
+ *
+ * @par Description
+ * The fence orders the caller's condition change before the flag check, against the waiter's
+ * flag before its re-check, so a waiter the notifier does not see has seen the condition.
+ * Clearing the flag means nobody is left asleep on the old epoch, so every sleeper is woken.
+ */
+void pu_eventcount_notify( pu_eventcount_t* pEc )
+{
+    unsigned int uiEpoch;
+
+    ASSERT( pEc );
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+    uiEpoch = __atomic_load_n( &(pEc->uiEpoch), __ATOMIC_RELAXED );
+    while (uiEpoch & 1)
+    {
+        if (__atomic_compare_exchange_n( &(pEc->uiEpoch), &uiEpoch, uiEpoch + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED ))
+        {
+            pu_futex_wake( &(pEc->uiEpoch), INT_MAX, 0 );
+            break;
+        }
+    }
+}
+/* pu_eventcount_notify */
+
+/**
+ * @brief   Notifies all the waiters, no syscall when nobody waits
+ *
+ * @param[in] pEc : Pointer to a valid event count
+ */
+void pu_eventcount_notify_all( pu_eventcount_t* pEc )
+{
+    pu_eventcount_notify( pEc );
+}
+/* pu_eventcount_notify_all */
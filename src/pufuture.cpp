@@ -0,0 +1,935 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     pufuture.cpp
+ * @brief    Implementation of the futures, promises and executors
+ */
+
+/**** Includes ***************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include "pufuture.h"
+#include "putimer.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+
+/* Shared state life cycle, the state word is also the futex word */
+#define PU_FUTURE_PENDING (0U)
+#define PU_FUTURE_BUSY    (1U)   /* A completer is writing the result */
+#define PU_FUTURE_READY   (2U)
+
+/* Continuation list of a completed state, further continuations are dispatched directly */
+#define PU_FUTURE_CLOSED  ((pu_future_cont_t*)1)
+
+typedef struct pu_future_state_tag pu_future_state_t;
+typedef struct pu_future_cont_tag  pu_future_cont_t;
+typedef struct pu_future_group_tag pu_future_group_t;
+
+/* A continuation: runs on its executor once its source has completed */
+struct pu_future_cont_tag
+{
+    pu_future_cont_t*    pNext;       /* Source's continuation list       */
+    pu_task_t            stTask;      /* What the executor runs           */
+    pu_executor_t*       pExec;       /* Where it runs                    */
+    pu_future_state_t*   pSource;     /* Completed future, one reference  */
+    pu_future_state_t*   pTarget;     /* Derived future                   */
+    pu_future_group_t*   pGroup;      /* when_all / when_any bookkeeping  */
+    size_t               uiIndex;     /* Input index, when_any            */
+    pu_future_then_fct_t fctThen;     /* Continuation function, then      */
+    void*                pThenArg;    /* Its argument                     */
+};
+
+/* when_all / when_any: one continuation per input, one allocation */
+struct pu_future_group_tag
+{
+    size_t            uiRemaining;    /* Continuations still to run       */
+    int               iFirstError;    /* First failure, when_all          */
+    bool              bAny;           /* when_any, else when_all          */
+    pu_future_cont_t* pConts;         /* Follows the group header         */
+};
+
+struct pu_future_state_tag
+{
+    unsigned int       uiState;       /* PENDING, BUSY or READY           */
+    unsigned int       uiWaiters;     /* Threads in pu_future_wait        */
+    unsigned int       uiRefs;        /* Handles and continuations        */
+    int                iError;        /* Result                           */
+    void*              pValue;        /* Result                           */
+    pu_future_cont_t*  pConts;        /* Attached continuations           */
+    pu_future_cont_t   stCont;        /* Feeds this state, if derived     */
+    pu_future_state_t* pTmoPrev;      /* Timeout list, by deadline        */
+    pu_future_state_t* pTmoNext;
+    struct timespec    tsDeadline;    /* Timeout deadline, monotonic      */
+    bool               bTmoLinked;    /* On the timeout list              */
+    bool               bPooled;       /* From the pool, not the heap      */
+};
+
+/**** Macros ****************************************************************/
+
+/**** Static declarations ***************************************************/
+static pthread_once_t      onceFuture   = PTHREAD_ONCE_INIT;
+static pu_future_state_t*  pStatePool   = nullptr;
+static pu_queue_t          qFreeStates;
+
+/* Pending timeouts. Not on the fast path, a mutex is fine. */
+static pthread_mutex_t     mtxTimeout   = PTHREAD_MUTEX_INITIALIZER;
+static pu_future_state_t*  pTmoHead     = nullptr;
+static putimer_hnd_t       hTmoTimer    = nullptr;
+
+static pu_task_t           stStopTask   = { nullptr, nullptr };
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static void               pu_future_pool_init( void );
+static pu_future_state_t* pu_future_alloc( unsigned int uiRefs );
+static void               pu_future_put( pu_future_state_t* pState );
+static bool               pu_future_complete( pu_future_state_t* pState, void* pValue, int iError );
+static void               pu_future_dispatch( pu_future_cont_t* pCont );
+static void               pu_future_attach( pu_future_state_t* pSource, pu_future_cont_t* pCont );
+static pu_future_t        pu_future_when( const pu_future_t* pFutures, size_t uiCount, bool bAny );
+static void               pu_future_run_then( void* pArg );
+static void               pu_future_run_group( void* pArg );
+static void               pu_future_run_timeout( void* pArg );
+static int                pu_future_timer_arm( void );
+static void               pu_future_timer_expired( void* pCookie );
+static int                pu_executor_inline_submit( pu_executor_t* pExec, pu_task_t* pTask );
+static int                pu_executor_pool_submit( pu_executor_t* pExec, pu_task_t* pTask );
+static void               pu_executor_pool_worker( pu_thread_group_t* pGroup, size_t uiIndex, void* pArg );
+
+static pu_executor_t       stInlineExec = { pu_executor_inline_submit };
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+/* The pool is one block of states, the free ones are handed out through a lock-free queue */
+static void pu_future_pool_init( void )
+{
+    void*  pMem = nullptr;
+    size_t i;
+
+    if (0 != pu_queue_create( &qFreeStates, PU_QUEUE_TYPE_MPMC, PU_FUTURE_POOL_SIZE ))
+    {
+        return;
+    }
+    if (0 != posix_memalign( &pMem, PU_CACHELINE_SIZE, PU_FUTURE_POOL_SIZE * sizeof(pu_future_state_t) ))
+    {
+        LOG_ERROR( "PU_FUTURE(init): no pool of %d states, heap only\n", PU_FUTURE_POOL_SIZE );
+        return;
+    }
+    pStatePool = (pu_future_state_t*)pMem;
+    for (i = 0; i < PU_FUTURE_POOL_SIZE; i++)
+    {
+        pu_queue_push( &qFreeStates, &(pStatePool[i]) );
+    }
+}
+/* pu_future_pool_init */
+
+static pu_future_state_t* pu_future_alloc( unsigned int uiRefs )
+{
+    pu_future_state_t* pState = nullptr;
+    void*              pItem  = nullptr;
+    bool               bPooled;
+
+    pthread_once( &onceFuture, pu_future_pool_init );
+    bPooled = (pStatePool) && (0 == pu_queue_pop( &qFreeStates, &pItem ));
+    pState  = bPooled ? (pu_future_state_t*)pItem : (pu_future_state_t*)malloc( sizeof(pu_future_state_t) );
+    if (pState)
+    {
+        memset( pState, 0, sizeof(pu_future_state_t) );
+        pState->uiRefs  = uiRefs;
+        pState->bPooled = bPooled;
+    }
+    return (pState);
+}
+/* pu_future_alloc */
+
+/* Drops a reference, the last one returns the state */
+static void pu_future_put( pu_future_state_t* pState )
+{
+    if (1 == __atomic_fetch_sub( &(pState->uiRefs), 1, __ATOMIC_ACQ_REL ))
+    {
+        if (pState->bPooled)
+        {
+            pu_queue_push( &qFreeStates, pState );
+        }
+        else
+        {
+            free( pState );
+        }
+    }
+}
+/* pu_future_put */
+
+/* First completer wins. Wakes blocked waiters, then dispatches the continuations. */
+static bool pu_future_complete(
+    pu_future_state_t* pState,
+    void*              pValue,
+    int                iError )
+{
+    unsigned int      uiExpected = PU_FUTURE_PENDING;
+    pu_future_cont_t* pCont;
+    pu_future_cont_t* pNext;
+    pu_future_cont_t* pOrdered = nullptr;
+
+    if (!__atomic_compare_exchange_n( &(pState->uiState), &uiExpected, PU_FUTURE_BUSY, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED ))
+    {
+        return (false);
+    }
+    pState->pValue = pValue;
+    pState->iError = iError;
+    __atomic_store_n( &(pState->uiState), PU_FUTURE_READY, __ATOMIC_SEQ_CST );
+    if (__atomic_load_n( &(pState->uiWaiters), __ATOMIC_SEQ_CST ))
+    {
+        pu_futex_wake( &(pState->uiState), INT_MAX, 0 );
+    }
+
+    /* The list is a stack, run the continuations in the order they were attached */
+    pCont = __atomic_exchange_n( &(pState->pConts), PU_FUTURE_CLOSED, __ATOMIC_ACQ_REL );
+    while (pCont)
+    {
+        pNext           = pCont->pNext;
+        pCont->pNext    = pOrdered;
+        pOrdered        = pCont;
+        pCont           = pNext;
+    }
+    while (pOrdered)
+    {
+        pNext = pOrdered->pNext;
+        pu_future_dispatch( pOrdered );
+        pOrdered = pNext;
+    }
+    return (true);
+}
+/* pu_future_complete */
+
+/* An executor that refuses the task leaves it to the completing thread */
+static void pu_future_dispatch( pu_future_cont_t* pCont )
+{
+    if (0 != pCont->pExec->fctSubmit( pCont->pExec, &(pCont->stTask) ))
+    {
+        pCont->stTask.fctTask( pCont->stTask.pArg );
+    }
+}
+/* pu_future_dispatch */
+
+/* The continuation holds a reference to its source until it has run */
+static void pu_future_attach(
+    pu_future_state_t* pSource,
+    pu_future_cont_t*  pCont )
+{
+    pu_future_cont_t* pHead = __atomic_load_n( &(pSource->pConts), __ATOMIC_ACQUIRE );
+
+    do
+    {
+        if (PU_FUTURE_CLOSED == pHead)
+        {
+            pu_future_dispatch( pCont );
+            return;
+        }
+        pCont->pNext = pHead;
+    } while (!__atomic_compare_exchange_n( &(pSource->pConts), &pHead, pCont, true, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE ));
+}
+/* pu_future_attach */
+
+static void pu_future_run_then( void* pArg )
+{
+    pu_future_cont_t*  pCont   = (pu_future_cont_t*)pArg;
+    pu_future_state_t* pTarget = pCont->pTarget;
+    void*              pResult = nullptr;
+    int                iError;
+
+    iError = pCont->fctThen( pCont->pSource->pValue, pCont->pSource->iError, pCont->pThenArg, &pResult );
+    pu_future_complete( pTarget, pResult, iError );
+    pu_future_put( pCont->pSource );
+    pu_future_put( pTarget );
+}
+/* pu_future_run_then */
+
+/* when_all and when_any. The last continuation to run frees the group. */
+static void pu_future_run_group( void* pArg )
+{
+    pu_future_cont_t*  pCont   = (pu_future_cont_t*)pArg;
+    pu_future_group_t* pGroup  = pCont->pGroup;
+    pu_future_state_t* pTarget = pCont->pTarget;
+    int                iError  = pCont->pSource->iError;
+    int                iNone   = 0;
+
+    if (pGroup->bAny)
+    {
+        pu_future_complete( pTarget, (void*)(uintptr_t)pCont->uiIndex, iError );
+    }
+    else if (iError)
+    {
+        __atomic_compare_exchange_n( &(pGroup->iFirstError), &iNone, iError, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED );
+    }
+    pu_future_put( pCont->pSource );
+
+    /* Nothing in the group may be touched after the decrement, unless it was the last */
+    if (1 == __atomic_fetch_sub( &(pGroup->uiRemaining), 1, __ATOMIC_ACQ_REL ))
+    {
+        pu_future_complete( pTarget, nullptr, pGroup->iFirstError );
+        pu_future_put( pTarget );
+        free( pGroup );
+    }
+}
+/* pu_future_run_group */
+
+/* Source completed. If the timer has not taken the state off the list, this does. */
+static void pu_future_run_timeout( void* pArg )
+{
+    pu_future_cont_t*  pCont   = (pu_future_cont_t*)pArg;
+    pu_future_state_t* pTarget = pCont->pTarget;
+    bool               bLinked;
+
+    pthread_mutex_lock( &mtxTimeout );
+    bLinked = pTarget->bTmoLinked;
+    if (bLinked)
+    {
+        if (pTarget->pTmoPrev)
+        {
+            pTarget->pTmoPrev->pTmoNext = pTarget->pTmoNext;
+        }
+        else
+        {
+            pTmoHead = pTarget->pTmoNext;
+        }
+        if (pTarget->pTmoNext)
+        {
+            pTarget->pTmoNext->pTmoPrev = pTarget->pTmoPrev;
+        }
+        pTarget->bTmoLinked = false;
+    }
+    pthread_mutex_unlock( &mtxTimeout );
+
+    pu_future_complete( pTarget, pCont->pSource->pValue, pCont->pSource->iError );
+    pu_future_put( pCont->pSource );
+    if (bLinked)
+    {
+        pu_future_put( pTarget );
+    }
+    pu_future_put( pTarget );
+}
+/* pu_future_run_timeout */
+
+/* Called with the timeout lock held. Arms the timer for the earliest deadline. */
+static int pu_future_timer_arm( void )
+{
+    struct timespec tsNow;
+    size_t          uiMs;
+
+    if (!pTmoHead)
+    {
+        return (0);
+    }
+    clock_gettime( CLOCK_MONOTONIC, &tsNow );
+    uiMs = timespec_is_a_after_b( &(pTmoHead->tsDeadline), &tsNow ) ? (timespec_a_sub_b_ms( &(pTmoHead->tsDeadline), &tsNow ) + 1) : 0;
+    uiMs = (uiMs < PUTIMER_MIN_TIMEOUT) ? PUTIMER_MIN_TIMEOUT : uiMs;
+
+    /* The handle goes stale if the timer service was restarted */
+    if ((!hTmoTimer) || (0 != putimer_set_period( hTmoTimer, uiMs )))
+    {
+        hTmoTimer = putimer_create( PUTIMER_TYPE_SINGLESHOT, pu_future_timer_expired, uiMs, nullptr );
+        if (!hTmoTimer)
+        {
+            return (-1);
+        }
+    }
+    return (putimer_start( hTmoTimer ));
+}
+/* pu_future_timer_arm */
+
+/* Timer callback: fails every expired state with ETIMEDOUT, outside the lock */
+static void pu_future_timer_expired( void* pCookie )
+{
+    struct timespec    tsNow;
+    pu_future_state_t* pExpired = nullptr;
+    pu_future_state_t* pState;
+
+    (void)pCookie;
+    clock_gettime( CLOCK_MONOTONIC, &tsNow );
+    pthread_mutex_lock( &mtxTimeout );
+    while ((pTmoHead) && (!timespec_is_a_after_b( &(pTmoHead->tsDeadline), &tsNow )))
+    {
+        pState   = pTmoHead;
+        pTmoHead = pState->pTmoNext;
+        if (pTmoHead)
+        {
+            pTmoHead->pTmoPrev = nullptr;
+        }
+        pState->bTmoLinked = false;
+        pState->pTmoNext   = pExpired;
+        pExpired           = pState;
+    }
+    pu_future_timer_arm();
+    pthread_mutex_unlock( &mtxTimeout );
+
+    while (pExpired)
+    {
+        pState   = pExpired;
+        pExpired = pState->pTmoNext;
+        pu_future_complete( pState, nullptr, ETIMEDOUT );
+        pu_future_put( pState );
+    }
+}
+/* pu_future_timer_expired */
+
+static int pu_executor_inline_submit(
+    pu_executor_t* pExec,
+    pu_task_t*     pTask )
+{
+    (void)pExec;
+    pTask->fctTask( pTask->pArg );
+    return (0);
+}
+/* pu_executor_inline_submit */
+
+/* Never blocks: a worker that dispatches back to its own full pool would wait on itself.
+ * A full queue refuses the task and the dispatcher runs it inline. */
+static int pu_executor_pool_submit(
+    pu_executor_t* pExec,
+    pu_task_t*     pTask )
+{
+    pu_executor_pool_t* pPool = (pu_executor_pool_t*)pExec;
+    return (pu_queue_push( &(pPool->stQueue), pTask ));
+}
+/* pu_executor_pool_submit */
+
+static void pu_executor_pool_worker(
+    pu_thread_group_t* pGroup,
+    size_t             uiIndex,
+    void*              pArg )
+{
+    pu_executor_pool_t* pPool = (pu_executor_pool_t*)pArg;
+    void*               pItem = nullptr;
+    pu_task_t*          pTask;
+
+    (void)pGroup;
+    (void)uiIndex;
+    for (;;)
+    {
+        if (0 != pu_queue_pop_wait( &(pPool->stQueue), &pItem, PU_FUTEX_WAIT_FOREVER ))
+        {
+            continue;
+        }
+        pTask = (pu_task_t*)pItem;
+        if (&stStopTask == pTask)
+        {
+            break;
+        }
+        pTask->fctTask( pTask->pArg );
+    }
+}
+/* pu_executor_pool_worker */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Returns the executor that runs tasks in the calling thread
+ */
+pu_executor_t* pu_executor_inline( void )
+{
+    return (&stInlineExec);
+}
+/* pu_executor_inline */
+
+/**
+ * @brief   Creates a thread pool executor
+ *
+ * @param[in] pPool       : Pointer to a valid pool
+ * @param[in] uiThreads   : Number of worker threads
+ * @param[in] uiQueueSize : Pending tasks before a submit is refused (EAGAIN)
+ * @param[in] szName      : Worker thread name, persistent
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_executor_pool_create(
+    pu_executor_pool_t* pPool,
+    size_t              uiThreads,
+    size_t              uiQueueSize,
+    const char*         szName )
+{
+    /* pre-condition */
+    ASSERT( pPool );
+    ASSERT( uiThreads > 0 );
+    ASSERT( szName );
+    if ((!pPool) || (0 == uiThreads) || (!szName))
+    {
+        return (-1);
+    }
+
+    pPool->stExec.fctSubmit = pu_executor_pool_submit;
+    if (0 != pu_queue_create( &(pPool->stQueue), PU_QUEUE_TYPE_MPMC, uiQueueSize ))
+    {
+        return (-1);
+    }
+    if (0 != pu_thread_group_create( &(pPool->stGroup), uiThreads, pu_executor_pool_worker, pPool, 0, szName ))
+    {
+        pu_queue_destroy( &(pPool->stQueue) );
+        return (-1);
+    }
+    return (0);
+}
+/* pu_executor_pool_create */
+
+/**
+ * @brief   Runs the tasks already submitted, then stops the workers
+ *
+ * @param[in] pPool : Pointer to a valid pool
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ *
+ * @par Description
+ * One stop marker per worker is queued behind the pending tasks.
+ */
+int pu_executor_pool_destroy( pu_executor_pool_t* pPool )
+{
+    size_t i;
+    int    iResult;
+
+    ASSERT( pPool );
+    if (!pPool)
+    {
+        return (-1);
+    }
+    for (i = 0; i < pPool->stGroup.uiThreads; i++)
+    {
+        pu_queue_push_wait( &(pPool->stQueue), &stStopTask, PU_FUTEX_WAIT_FOREVER );
+    }
+    iResult = pu_thread_group_join( &(pPool->stGroup) );
+    pu_queue_destroy( &(pPool->stQueue) );
+    return (iResult);
+}
+/* pu_executor_pool_destroy */
+
+/**
+ * @brief   Creates a promise and its future
+ *
+ * @param[out] pPromise : Promise
+ * @param[out] pFuture  : Future
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_promise_create(
+    pu_promise_t* pPromise,
+    pu_future_t*  pFuture )
+{
+    pu_future_state_t* pState;
+
+    ASSERT( pPromise && pFuture );
+    if ((!pPromise) || (!pFuture))
+    {
+        return (-1);
+    }
+    pState = pu_future_alloc( 2 );
+    if (!pState)
+    {
+        return (-1);
+    }
+    pPromise->hState = pState;
+    *pFuture         = pState;
+    return (0);
+}
+/* pu_promise_create */
+
+/**
+ * @brief   Completes the promise with a value
+ *
+ * @param[in] pPromise : Promise
+ * @param[in] pValue   : Value
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_promise_set_value(
+    pu_promise_t* pPromise,
+    void*         pValue )
+{
+    pu_future_state_t* pState;
+
+    ASSERT( pPromise && pPromise->hState );
+    if ((!pPromise) || (!pPromise->hState))
+    {
+        return (-1);
+    }
+    pState           = pPromise->hState;
+    pPromise->hState = nullptr;
+    pu_future_complete( pState, pValue, 0 );
+    pu_future_put( pState );
+    return (0);
+}
+/* pu_promise_set_value */
+
+/**
+ * @brief   Completes the promise with an error
+ *
+ * @param[in] pPromise : Promise
+ * @param[in] iError   : Error code
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_promise_set_error(
+    pu_promise_t* pPromise,
+    int           iError )
+{
+    pu_future_state_t* pState;
+
+    ASSERT( pPromise && pPromise->hState );
+    ASSERT( 0 != iError );
+    if ((!pPromise) || (!pPromise->hState) || (0 == iError))
+    {
+        return (-1);
+    }
+    pState           = pPromise->hState;
+    pPromise->hState = nullptr;
+    pu_future_complete( pState, nullptr, iError );
+    pu_future_put( pState );
+    return (0);
+}
+/* pu_promise_set_error */
+
+/**
+ * @brief   Releases a promise, an unfulfilled one fails its future with EPIPE
+ *
+ * @param[in] pPromise : Promise
+ */
+void pu_promise_release( pu_promise_t* pPromise )
+{
+    if ((pPromise) && (pPromise->hState))
+    {
+        pu_promise_set_error( pPromise, EPIPE );
+    }
+}
+/* pu_promise_release */
+
+/**
+ * @brief   Checks if a future has completed
+ *
+ * @param[in] hFuture : Future
+ * @retval  Non-zero if it has completed
+ */
+int pu_future_is_ready( pu_future_t hFuture )
+{
+    ASSERT( hFuture );
+    return ((hFuture) && (PU_FUTURE_READY == __atomic_load_n( &(hFuture->uiState), __ATOMIC_ACQUIRE )));
+}
+/* pu_future_is_ready */
+
+/**
+ * @brief   Waits for a future to complete
+ *
+ * @param[in] hFuture     : Future
+ * @param[in] uiTimeoutMs : Timeout in ms
+ * @retval  0 completed
+ * @retval  ETIMEDOUT the timeout expired
+ */
+int pu_future_wait(
+    pu_future_t hFuture,
+    size_t      uiTimeoutMs )
+{
+    struct timespec        tsDeadline;
+    const struct timespec* pDeadline;
+    unsigned int           uiState;
+
+    ASSERT( hFuture );
+    if (!hFuture)
+    {
+        return (EINVAL);
+    }
+    if (PU_FUTURE_READY == __atomic_load_n( &(hFuture->uiState), __ATOMIC_ACQUIRE ))
+    {
+        return (0);
+    }
+
+    pDeadline = pu_futex_deadline( &tsDeadline, uiTimeoutMs );
+    __atomic_fetch_add( &(hFuture->uiWaiters), 1, __ATOMIC_SEQ_CST );
+    while (PU_FUTURE_READY != (uiState = __atomic_load_n( &(hFuture->uiState), __ATOMIC_SEQ_CST )))
+    {
+        if (ETIMEDOUT == pu_futex_wait( &(hFuture->uiState), uiState, pDeadline, 0 ))
+        {
+            break;
+        }
+    }
+    __atomic_fetch_sub( &(hFuture->uiWaiters), 1, __ATOMIC_RELAXED );
+    return ((PU_FUTURE_READY == __atomic_load_n( &(hFuture->uiState), __ATOMIC_ACQUIRE )) ? 0 : ETIMEDOUT);
+}
+/* pu_future_wait */
+
+/**
+ * @brief   Waits for a future to complete, and reads its result
+ *
+ * @param[in]  hFuture     : Future
+ * @param[out] ppValue     : Value, may be NULL
+ * @param[in]  uiTimeoutMs : Timeout in ms
+ * @retval  The error of the future, or ETIMEDOUT
+ */
+int pu_future_get(
+    pu_future_t hFuture,
+    void**      ppValue,
+    size_t      uiTimeoutMs )
+{
+    int iResult = pu_future_wait( hFuture, uiTimeoutMs );
+
+    if (0 != iResult)
+    {
+        return (iResult);
+    }
+    if (ppValue)
+    {
+        *ppValue = hFuture->pValue;
+    }
+    return (hFuture->iError);
+}
+/* pu_future_get */
+
+/**
+ * @brief   Releases a future handle
+ *
+ * @param[in] hFuture : Future
+ */
+void pu_future_release( pu_future_t hFuture )
+{
+    ASSERT( hFuture );
+    if (hFuture)
+    {
+        pu_future_put( hFuture );
+    }
+}
+/* pu_future_release */
+
+/**
+ * @brief   Attaches a continuation
+ *
+ * @param[in] hFuture : Future
+ * @param[in] pExec   : Executor
+ * @param[in] fctThen : Continuation
+ * @param[in] pArg    : Continuation argument
+ * @retval  A new future, or NULL
+ */
+pu_future_t pu_future_then(
+    pu_future_t          hFuture,
+    pu_executor_t*       pExec,
+    pu_future_then_fct_t fctThen,
+    void*                pArg )
+{
+    pu_future_state_t* pTarget;
+    pu_future_cont_t*  pCont;
+
+    ASSERT( hFuture && pExec && fctThen );
+    if ((!hFuture) || (!pExec) || (!fctThen))
+    {
+        return (nullptr);
+    }
+
+    /* The caller's handle, and the continuation's */
+    pTarget = pu_future_alloc( 2 );
+    if (!pTarget)
+    {
+        return (nullptr);
+    }
+    pCont                 = &(pTarget->stCont);
+    pCont->stTask.fctTask = pu_future_run_then;
+    pCont->stTask.pArg    = pCont;
+    pCont->pExec          = pExec;
+    pCont->pSource        = hFuture;
+    pCont->pTarget        = pTarget;
+    pCont->fctThen        = fctThen;
+    pCont->pThenArg       = pArg;
+    __atomic_fetch_add( &(hFuture->uiRefs), 1, __ATOMIC_RELAXED );
+    pu_future_attach( hFuture, pCont );
+    return (pTarget);
+}
+/* pu_future_then */
+
+/* Shared by when_all and when_any */
+static pu_future_t pu_future_when(
+    const pu_future_t* pFutures,
+    size_t             uiCount,
+    bool               bAny )
+{
+    pu_future_state_t* pTarget;
+    pu_future_group_t* pGroup;
+    pu_future_cont_t*  pConts;
+    size_t             i;
+
+    ASSERT( pFutures && (uiCount > 0) );
+    if ((!pFutures) || (0 == uiCount))
+    {
+        return (nullptr);
+    }
+    pGroup = (pu_future_group_t*)malloc( sizeof(pu_future_group_t) + (uiCount * sizeof(pu_future_cont_t)) );
+    if (!pGroup)
+    {
+        return (nullptr);
+    }
+
+    /* The caller's handle, and the group's */
+    pTarget = pu_future_alloc( 2 );
+    if (!pTarget)
+    {
+        free( pGroup );
+        return (nullptr);
+    }
+    pConts              = (pu_future_cont_t*)(pGroup + 1);
+    pGroup->uiRemaining = uiCount;
+    pGroup->iFirstError = 0;
+    pGroup->bAny        = bAny;
+    pGroup->pConts      = pConts;
+
+    /* All filled in before the first attach, which may run straight away */
+    for (i = 0; i < uiCount; i++)
+    {
+        memset( &(pConts[i]), 0, sizeof(pu_future_cont_t) );
+        pConts[i].stTask.fctTask = pu_future_run_group;
+        pConts[i].stTask.pArg    = &(pConts[i]);
+        pConts[i].pExec          = &stInlineExec;
+        pConts[i].pSource        = pFutures[i];
+        pConts[i].pTarget        = pTarget;
+        pConts[i].pGroup         = pGroup;
+        pConts[i].uiIndex        = i;
+        __atomic_fetch_add( &(pFutures[i]->uiRefs), 1, __ATOMIC_RELAXED );
+    }
+    for (i = 0; i < uiCount; i++)
+    {
+        pu_future_attach( pFutures[i], &(pConts[i]) );
+    }
+    return (pTarget);
+}
+/* pu_future_when */
+
+/**
+ * @brief   Combines futures, completes when all of them have
+ *
+ * @param[in] pFutures : Futures
+ * @param[in] uiCount  : Number of futures
+ * @retval  A new future, or NULL
+ */
+pu_future_t pu_future_when_all(
+    const pu_future_t* pFutures,
+    size_t             uiCount )
+{
+    return (pu_future_when( pFutures, uiCount, false ));
+}
+/* pu_future_when_all */
+
+/**
+ * @brief   Combines futures, completes when the first of them does
+ *
+ * @param[in] pFutures : Futures
+ * @param[in] uiCount  : Number of futures
+ * @retval  A new future, or NULL
+ */
+pu_future_t pu_future_when_any(
+    const pu_future_t* pFutures,
+    size_t             uiCount )
+{
+    return (pu_future_when( pFutures, uiCount, true ));
+}
+/* pu_future_when_any */
+
+/**
+ * @brief   Bounds the time a future may take
+ *
+ * @param[in] hFuture     : Future
+ * @param[in] uiTimeoutMs : Timeout in ms
+ * @retval  A new future, or NULL
+ *
+ * @par Description
+ * The new state sits on a list sorted by deadline, served by a single timer. Whichever of the
+ * timer and the source takes it off the list completes it first, the other one finds it
+ * already completed.
+ */
+pu_future_t pu_future_timeout(
+    pu_future_t hFuture,
+    size_t      uiTimeoutMs )
+{
+    pu_future_state_t* pTarget;
+    pu_future_state_t* pPrev = nullptr;
+    pu_future_state_t* pNext;
+    pu_future_cont_t*  pCont;
+    int                iResult = 0;
+
+    ASSERT( hFuture );
+    if (!hFuture)
+    {
+        return (nullptr);
+    }
+
+    /* The caller's handle, the continuation's and the timeout list's */
+    pTarget = pu_future_alloc( 3 );
+    if (!pTarget)
+    {
+        return (nullptr);
+    }
+    timespec_now_plus_ms_monotonic( &(pTarget->tsDeadline), uiTimeoutMs );
+
+    pthread_mutex_lock( &mtxTimeout );
+    for (pNext = pTmoHead; pNext && !timespec_is_a_after_b( &(pNext->tsDeadline), &(pTarget->tsDeadline) ); pNext = pNext->pTmoNext)
+    {
+        pPrev = pNext;
+    }
+    pTarget->pTmoPrev   = pPrev;
+    pTarget->pTmoNext   = pNext;
+    pTarget->bTmoLinked = true;
+    if (pNext)
+    {
+        pNext->pTmoPrev = pTarget;
+    }
+    if (pPrev)
+    {
+        pPrev->pTmoNext = pTarget;
+    }
+    else
+    {
+        pTmoHead = pTarget;
+        iResult  = pu_future_timer_arm();
+    }
+    if (0 != iResult)
+    {
+        pTmoHead = pTarget->pTmoNext;
+        if (pTmoHead)
+        {
+            pTmoHead->pTmoPrev = nullptr;
+        }
+    }
+    pthread_mutex_unlock( &mtxTimeout );
+    if (0 != iResult)
+    {
+        LOG_ERROR( "PU_FUTURE(timeout): cannot arm the timer (%d)\n", iResult );
+        pTarget->uiRefs = 1;
+        pu_future_put( pTarget );
+        return (nullptr);
+    }
+
+    pCont                 = &(pTarget->stCont);
+    pCont->stTask.fctTask = pu_future_run_timeout;
+    pCont->stTask.pArg    = pCont;
+    pCont->pExec          = &stInlineExec;
+    pCont->pSource        = hFuture;
+    pCont->pTarget        = pTarget;
+    __atomic_fetch_add( &(hFuture->uiRefs), 1, __ATOMIC_RELAXED );
+    pu_future_attach( hFuture, pCont );
+    return (pTarget);
+}
+/* pu_future_timeout */
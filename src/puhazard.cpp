@@ -0,0 +1,376 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     puhazard.cpp
+ * @brief    Implementation of the hazard pointer domain
+ */
+
+/**** Includes ***************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "puhazard.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+
+/* Per thread record. Records are never freed, an exited thread's record is reused */
+typedef struct pu_hazard_thread_tag pu_hazard_thread_t;
+struct PU_CACHELINE_ALIGNED pu_hazard_thread_tag
+{
+    void*               pSlots[PU_HAZARD_SLOTS];  /* Published pointers, read by scanners   */
+    unsigned int        bInUse;                   /* Owned by a thread (or by a flush)      */
+    pu_hazard_thread_t* pNext;                    /* Registry link, set once                */
+    unsigned int        uiRefs;                   /* Registration nesting                   */
+    unsigned int        bScanning;                /* No nested scan from a free function    */
+    pu_hazard_node_t*   pRetired;                 /* Retired, not yet freed                 */
+    size_t              uiRetired;                /* Length of the retired list             */
+    void**              pScanBuf;                 /* Snapshot of the published pointers     */
+    size_t              uiScanCap;                /* Capacity of the snapshot buffer        */
+};
+
+/**** Macros ****************************************************************/
+
+/**** Static declarations ***************************************************/
+static struct PU_CACHELINE_ALIGNED
+{
+    pu_hazard_thread_t* pHead;        /* Registry, push only  */
+    size_t              uiRecords;    /* Records in the list  */
+}   stHazardDomain;
+
+static thread_local pu_hazard_thread_t* pHazardSelf = nullptr;
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static size_t pu_hazard_threshold( void );
+static void   pu_hazard_scan_thread( pu_hazard_thread_t* pThread );
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+/* Twice the number of slots, so that a scan frees at least half of the list */
+static inline size_t pu_hazard_threshold( void )
+{
+    size_t uiSlots = __atomic_load_n( &(stHazardDomain.uiRecords), __ATOMIC_RELAXED ) * PU_HAZARD_SLOTS;
+    return (std::max( (size_t)PU_HAZARD_RETIRE_MIN, 2 * uiSlots ));
+}
+/* pu_hazard_threshold */
+
+/* Frees the objects on the retired list of a record the caller owns, that no slot holds */
+static void pu_hazard_scan_thread( pu_hazard_thread_t* pThread )
+{
+    pu_hazard_thread_t* pHead;
+    pu_hazard_thread_t* pOther;
+    pu_hazard_node_t*   pNode;
+    pu_hazard_node_t*   pNext;
+    pu_hazard_node_t*   pKeep   = nullptr;
+    size_t              uiKeep  = 0;
+    size_t              uiCount = 0;
+    size_t              uiMax;
+    unsigned int        i;
+
+    if ((pThread->bScanning) || (!pThread->pRetired))
+    {
+        return;
+    }
+
+    /* Orders the caller's unlinks before the registry and slot loads, against the fence in
+     * pu_hazard_protect. A record pushed after the head load belongs to a thread whose check
+     * sees the unlinks. Records are counted before they are pushed, so the count covers the list. */
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+    pHead = __atomic_load_n( &(stHazardDomain.pHead), __ATOMIC_ACQUIRE );
+    uiMax = __atomic_load_n( &(stHazardDomain.uiRecords), __ATOMIC_RELAXED ) * PU_HAZARD_SLOTS;
+    if (uiMax > pThread->uiScanCap)
+    {
+        void** pBuf = (void**)realloc( pThread->pScanBuf, uiMax * sizeof(void*) );
+        if (!pBuf)
+        {
+            LOG_ERROR( "PU_HAZARD(scan): out of memory, %zu slots\n", uiMax );
+            return;
+        }
+        pThread->pScanBuf  = pBuf;
+        pThread->uiScanCap = uiMax;
+    }
+
+    for (pOther = pHead; pOther && (uiCount < uiMax); pOther = pOther->pNext)
+    {
+        for (i = 0; (i < PU_HAZARD_SLOTS) && (uiCount < uiMax); i++)
+        {
+            void* p = __atomic_load_n( &(pOther->pSlots[i]), __ATOMIC_RELAXED );
+            if (p)
+            {
+                pThread->pScanBuf[uiCount++] = p;
+            }
+        }
+    }
+    std::sort( pThread->pScanBuf, pThread->pScanBuf + uiCount );
+
+    /* Detached first, a free function may retire more objects */
+    pThread->bScanning = 1;
+    pNode = pThread->pRetired;
+    pThread->pRetired  = nullptr;
+    pThread->uiRetired = 0;
+    while (pNode)
+    {
+        pNext = pNode->pNext;
+        if (std::binary_search( pThread->pScanBuf, pThread->pScanBuf + uiCount, pNode->pObj ))
+        {
+            pNode->pNext = pKeep;
+            pKeep        = pNode;
+            uiKeep++;
+        }
+        else
+        {
+            pNode->fctFree( pNode->pObj );
+        }
+        pNode = pNext;
+    }
+    pThread->bScanning = 0;
+
+    /* Put the survivors back, next to anything retired by the free functions */
+    while (pKeep)
+    {
+        pNext              = pKeep->pNext;
+        pKeep->pNext       = pThread->pRetired;
+        pThread->pRetired  = pKeep;
+        pKeep              = pNext;
+    }
+    pThread->uiRetired += uiKeep;
+}
+/* pu_hazard_scan_thread */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Registers the calling thread, and gives it its hazard slots
+ *
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_hazard_register( void )
+{
+    pu_hazard_thread_t* pThread;
+    unsigned int        bFree;
+
+    if (pHazardSelf)
+    {
+        pHazardSelf->uiRefs++;
+        return (0);
+    }
+
+    for (pThread = __atomic_load_n( &(stHazardDomain.pHead), __ATOMIC_ACQUIRE ); pThread; pThread = pThread->pNext)
+    {
+        bFree = 0;
+        if ((!__atomic_load_n( &(pThread->bInUse), __ATOMIC_RELAXED )) &&
+            (__atomic_compare_exchange_n( &(pThread->bInUse), &bFree, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED )))
+        {
+            break;
+        }
+    }
+
+    if (!pThread)
+    {
+        void* pMem = nullptr;
+        if (0 != posix_memalign( &pMem, PU_CACHELINE_SIZE, sizeof(pu_hazard_thread_t) ))
+        {
+            LOG_ERROR( "PU_HAZARD(register): out of memory, %zu bytes\n", sizeof(pu_hazard_thread_t) );
+            return (-1);
+        }
+        pThread = (pu_hazard_thread_t*)pMem;
+        memset( pThread, 0, sizeof(pu_hazard_thread_t) );
+        pThread->bInUse = 1;
+
+        /* Counted before it is reachable, a scanner never finds more records than it counted */
+        __atomic_fetch_add( &(stHazardDomain.uiRecords), 1, __ATOMIC_RELAXED );
+        pThread->pNext  = __atomic_load_n( &(stHazardDomain.pHead), __ATOMIC_RELAXED );
+        while (!__atomic_compare_exchange_n( &(stHazardDomain.pHead), &(pThread->pNext), pThread, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED ))
+        {
+        }
+    }
+
+    /* Objects left by the previous owner stay, they are freed by this thread's scans */
+    pThread->uiRefs = 1;
+    pHazardSelf = pThread;
+    return (0);
+}
+/* pu_hazard_register */
+
+/**
+ * @brief   Unregisters the calling thread, its slots are cleared
+ *
+ * @par Description
+ * Scans once. What is still protected stays with the record, until it is reused or flushed.
+ */
+void pu_hazard_unregister( void )
+{
+    pu_hazard_thread_t* pThread = pHazardSelf;
+    unsigned int        i;
+
+    ASSERT( pThread );
+    if (!pThread)
+    {
+        return;
+    }
+    if (--(pThread->uiRefs) > 0)
+    {
+        return;
+    }
+    for (i = 0; i < PU_HAZARD_SLOTS; i++)
+    {
+        __atomic_store_n( &(pThread->pSlots[i]), nullptr, __ATOMIC_RELEASE );
+    }
+    pu_hazard_scan_thread( pThread );
+    pHazardSelf = nullptr;
+    __atomic_store_n( &(pThread->bInUse), 0, __ATOMIC_RELEASE );
+}
+/* pu_hazard_unregister */
+
+/**
+ * @brief   Loads a shared pointer and protects it
+ *
+ * @param[in] uiSlot : Slot to use
+ * @param[in] ppSrc  : Shared pointer
+ * @retval  The protected pointer
+ *
+ * @par Description
+ * The pointer is published, then the source is read again. If it has not changed, any scan
+ * that started after the fence sees the slot, and any unlink that the scan missed would have
+ * changed the source.
+ */
+void* pu_hazard_protect(
+    unsigned int uiSlot,
+    void* const* ppSrc )
+{
+    pu_hazard_thread_t* pThread = pHazardSelf;
+    void*               p;
+    void*               pCheck;
+
+    ASSERT( pThread );
+    ASSERT( uiSlot < PU_HAZARD_SLOTS );
+    ASSERT( ppSrc );
+    if ((!pThread) || (uiSlot >= PU_HAZARD_SLOTS) || (!ppSrc))
+    {
+        return (nullptr);
+    }
+
+    p = __atomic_load_n( ppSrc, __ATOMIC_RELAXED );
+    for (;;)
+    {
+        __atomic_store_n( &(pThread->pSlots[uiSlot]), p, __ATOMIC_RELAXED );
+        __atomic_thread_fence( __ATOMIC_SEQ_CST );
+        pCheck = __atomic_load_n( ppSrc, __ATOMIC_ACQUIRE );
+        if (pCheck == p)
+        {
+            return (p);
+        }
+        p = pCheck;
+    }
+}
+/* pu_hazard_protect */
+
+/**
+ * @brief   Clears a slot
+ *
+ * @param[in] uiSlot : Slot to clear
+ */
+void pu_hazard_clear( unsigned int uiSlot )
+{
+    pu_hazard_thread_t* pThread = pHazardSelf;
+
+    ASSERT( pThread );
+    ASSERT( uiSlot < PU_HAZARD_SLOTS );
+    if ((!pThread) || (uiSlot >= PU_HAZARD_SLOTS))
+    {
+        return;
+    }
+    __atomic_store_n( &(pThread->pSlots[uiSlot]), nullptr, __ATOMIC_RELEASE );
+}
+/* pu_hazard_clear */
+
+/**
+ * @brief   Retires an unlinked object
+ *
+ * @param[in] pNode   : Retire list link
+ * @param[in] pObj    : The object
+ * @param[in] fctFree : Free function
+ */
+void pu_hazard_retire(
+    pu_hazard_node_t*    pNode,
+    void*                pObj,
+    pu_hazard_free_fct_t fctFree )
+{
+    pu_hazard_thread_t* pThread = pHazardSelf;
+
+    ASSERT( pThread );
+    ASSERT( pNode && pObj && fctFree );
+    if ((!pThread) || (!pNode) || (!pObj) || (!fctFree))
+    {
+        return;
+    }
+    pNode->pObj       = pObj;
+    pNode->fctFree    = fctFree;
+    pNode->pNext      = pThread->pRetired;
+    pThread->pRetired = pNode;
+    if (++(pThread->uiRetired) >= pu_hazard_threshold())
+    {
+        pu_hazard_scan_thread( pThread );
+    }
+}
+/* pu_hazard_retire */
+
+/**
+ * @brief   Scans now
+ */
+void pu_hazard_scan( void )
+{
+    ASSERT( pHazardSelf );
+    if (pHazardSelf)
+    {
+        pu_hazard_scan_thread( pHazardSelf );
+    }
+}
+/* pu_hazard_scan */
+
+/**
+ * @brief   Frees every retired object that is not protected
+ */
+void pu_hazard_flush( void )
+{
+    pu_hazard_thread_t* pThread;
+    unsigned int        bFree;
+
+    if (pHazardSelf)
+    {
+        pu_hazard_scan_thread( pHazardSelf );
+    }
+    for (pThread = __atomic_load_n( &(stHazardDomain.pHead), __ATOMIC_ACQUIRE ); pThread; pThread = pThread->pNext)
+    {
+        bFree = 0;
+        if (__atomic_compare_exchange_n( &(pThread->bInUse), &bFree, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED ))
+        {
+            pu_hazard_scan_thread( pThread );
+            __atomic_store_n( &(pThread->bInUse), 0, __ATOMIC_RELEASE );
+        }
+    }
+}
+/* pu_hazard_flush */
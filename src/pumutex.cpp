@@ -28,23 +28,514 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
 #include "posutils.h"
+#include "puprobes.h"
 #include "logging.h"
 
 /**** Definitions ************************************************************/
 
+/* Registry table size, a power of two with plenty of head room for linear probing */
+#define PU_MUTEX_REG_SIZE   (2 * PU_MUTEX_MAX_INSTRUMENTED)
+#define PU_MUTEX_REG_MASK   (PU_MUTEX_REG_SIZE - 1)
+
+/* A lock that returns EOWNERDEAD is held by the caller, just like a successful one */
+#define PU_MUTEX_ACQUIRED(res_)  ((0 == (res_)) || (EOWNERDEAD == (res_)))
+
+/* Spinlock backoff, in pause instructions. Roughly the cost of a cache miss at the top end */
+#define PU_SPINLOCK_MAX_BACKOFF (1024U)
+
+/* Key values for a registry slot that is free, or that held a now destroyed mutex */
+#define PU_MUTEX_KEY_EMPTY  ((pthread_mutex_t*)0)
+#define PU_MUTEX_KEY_DEAD   ((pthread_mutex_t*)1)
+
+/**
+ * Per instrumented mutex record. The statistics are only written by the lock owner, i.e.
+ * they are protected by the instrumented mutex itself. They are accessed atomically (relaxed)
+ * so that the report can read them without taking the lock.
+ */
+typedef struct pu_mutex_rec_tag
+{
+    pthread_mutex_t* pMtx;             /* Key                               */
+    const char*      szLabel;          /* Creation site                     */
+    unsigned int     uiFlags;          /* PU_MUTEX_ATTR_xxx                 */
+    uint64_t         uiAcquisitions;
+    uint64_t         uiContended;
+    uint64_t         uiWaitTotalNs;
+    uint64_t         uiWaitMaxNs;
+    uint64_t         uiHoldMaxNs;
+    uint64_t         uiHoldStartNs;    /* Owner only, start of the current hold */
+    int              iClass;           /* Lock order class, -1 if not checked   */
+}   pu_mutex_rec_t;
+
+/* Lock order checker: one bit per class in each dependency row */
+#define PU_LOCKDEP_WORDS    ((PU_LOCKDEP_MAX_CLASSES + 63) / 64)
+
+/* One lock held by the current thread */
+typedef struct pu_lockdep_held_tag
+{
+    pthread_mutex_t* pMtx;
+    int              iClass;
+}   pu_lockdep_held_t;
+
 /**** Macros ****************************************************************/
+#define PU_MUTEX_STAT_GET(field_)       __atomic_load_n( &(field_), __ATOMIC_RELAXED )
+#define PU_MUTEX_STAT_SET(field_,val_)  __atomic_store_n( &(field_), (val_), __ATOMIC_RELAXED )
 
 /**** Static declarations ***************************************************/
+static pthread_mutex_t  mtxRegistry = PTHREAD_MUTEX_INITIALIZER;
+static pu_mutex_rec_t   pRegistry[PU_MUTEX_REG_SIZE];
+static unsigned int     uiInstrumented = 0;
+
+/* Lock order checker. Classes are only added under mtxRegistry, the dependency graph
+ * (pDeps[A] has bit B set if B was acquired while holding A) is updated lock-free.
+ */
+static const char*              pClassName[PU_LOCKDEP_MAX_CLASSES];
+static int                      iClassCount = 0;
+static uint64_t                 pDeps[PU_LOCKDEP_MAX_CLASSES][PU_LOCKDEP_WORDS];
+static size_t                   uiViolations = 0;
+static pu_lockdep_report_fct_t  fctLockdepReport = nullptr;
+static thread_local pu_lockdep_held_t pHeld[PU_LOCKDEP_MAX_DEPTH];
+static thread_local int               iHeldDepth = 0;
+
+/* Spinlock owner checks (debug), cached Linux thread ID */
+static thread_local int               iSelfTid = 0;
 
 /**** Globals and externs ***************************************************/
 
 /**** Local function prototypes (NB Use static modifier) ********************/
+static int             pu_mutex_init_type( pthread_mutex_t* pMtx, pu_mutex_type enType, unsigned int uiFlags );
+static inline uint64_t pu_mutex_now_ns( void );
+static inline size_t   pu_mutex_hash( const pthread_mutex_t* pMtx );
+static pu_mutex_rec_t* pu_mutex_lookup( const pthread_mutex_t* pMtx );
+static int             pu_mutex_register( pthread_mutex_t* pMtx, const pu_mutex_attr_t* pAttr );
+static void            pu_mutex_unregister( pthread_mutex_t* pMtx );
+static int             pu_mutex_stats_compare( const void* pA, const void* pB );
+static int             pu_lockdep_class( const char* szLabel );
+static bool            pu_lockdep_reaches( int iFrom, int iTo );
+static void            pu_lockdep_report( int iHeld, int iAcquired, const char* szReason );
+static void            pu_lockdep_acquire( pthread_mutex_t* pMtx, int iClass );
+static void            pu_lockdep_push( pthread_mutex_t* pMtx, int iClass );
+static void            pu_lockdep_pop( pthread_mutex_t* pMtx );
+static inline int      pu_spinlock_self( void );
+static inline int      pu_mutex_lock_plain( pthread_mutex_t* pMtx, const char* szLabel );
+static int             pu_mutex_lock_traced( pthread_mutex_t* pMtx, const char* szLabel );
 
 /****************************************************************************/
 /* LOCAL FUNCTION DEFINITIONS                                               */
 /****************************************************************************/
 
+/* Initialise the pthread mutex itself */
+static int pu_mutex_init_type(
+    pthread_mutex_t* pMtx,
+    pu_mutex_type    enType,
+    unsigned int     uiFlags )
+{
+    pthread_mutexattr_t attr;
+    int                 iResult;
+
+    iResult = pthread_mutexattr_init( &attr );
+    if (0 != iResult)
+    {
+        return (iResult);
+    }
+
+    /* Default - fast mutex, nothing to add */
+
+    /* Error mutex */
+    if (PU_MUTEX_TYPE_ERROR == enType)
+    {
+        iResult = pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_ERRORCHECK );
+    }
+
+    /* Priority inheritance mutex */
+    else if (PU_MUTEX_TYPE_PRIO_INHERIT == enType)
+    {
+        iResult = pthread_mutexattr_setprotocol( &attr, PTHREAD_PRIO_INHERIT );
+    }
+
+    /* Robust mutex */
+    else if (PU_MUTEX_TYPE_ROBUST == enType)
+    {
+        iResult = pthread_mutexattr_setrobust( &attr, PTHREAD_MUTEX_ROBUST );
+    }
+
+// Removed recursive mutexes, They are (relatively) slow and using them is bad practice.
+// The use of a recursive mutex typically means one the author is not clear about the
+// execution paths in their code.
+// The code block remains both as a caution not to add them back in, and in the possible case
+// where using a recursive in an engineering/experimental build may have discovery value..
+#if 0
+    /* Recursive mutex */
+    else if (PU_MUTEX_TYPE_RECURSIVE == enType)
+    {
+        iResult = pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
+    }
+#endif
+
+    /* Any type can live in memory shared between processes */
+    if ((0 == iResult) && (uiFlags & PU_MUTEX_ATTR_PSHARED))
+    {
+        iResult = pthread_mutexattr_setpshared( &attr, PTHREAD_PROCESS_SHARED );
+    }
+    if (0 == iResult)
+    {
+        iResult = pthread_mutex_init( pMtx, &attr );
+    }
+    pthread_mutexattr_destroy( &attr );
+    return (iResult);
+}
+/* pu_mutex_init_type */
+
+static inline uint64_t pu_mutex_now_ns( void )
+{
+    struct timespec tsNow;
+    clock_gettime( CLOCK_MONOTONIC, &tsNow );
+    return (((uint64_t)tsNow.tv_sec * 1000000000ULL) + (uint64_t)tsNow.tv_nsec);
+}
+/* pu_mutex_now_ns */
+
+/* Fibonacci hash of the mutex address */
+static inline size_t pu_mutex_hash( const pthread_mutex_t* pMtx )
+{
+    uint64_t uiKey = (uint64_t)(uintptr_t)pMtx;
+    return ((size_t)((uiKey * 0x9E3779B97F4A7C15ULL) >> 32) & PU_MUTEX_REG_MASK);
+}
+/* pu_mutex_hash */
+
+/* Lock-free lookup, linear probe until the key or an empty slot is found */
+static pu_mutex_rec_t* pu_mutex_lookup( const pthread_mutex_t* pMtx )
+{
+    size_t           uiIdx = pu_mutex_hash( pMtx );
+    size_t           i;
+    pthread_mutex_t* pKey;
+
+    for (i = 0; i < PU_MUTEX_REG_SIZE; i++)
+    {
+        pKey = __atomic_load_n( &(pRegistry[uiIdx].pMtx), __ATOMIC_ACQUIRE );
+        if (pKey == pMtx)
+        {
+            return (&(pRegistry[uiIdx]));
+        }
+        if (PU_MUTEX_KEY_EMPTY == pKey)
+        {
+            break;
+        }
+        uiIdx = (uiIdx + 1) & PU_MUTEX_REG_MASK;
+    }
+    return (nullptr);
+}
+/* pu_mutex_lookup */
+
+/* Add a mutex to the registry. Insertion is rare, so it is serialised */
+static int pu_mutex_register(
+    pthread_mutex_t*       pMtx,
+    const pu_mutex_attr_t* pAttr )
+{
+    pu_mutex_rec_t* pRec;
+    size_t          uiIdx;
+    size_t          i;
+    int             iResult = -1;
+
+    pthread_mutex_lock( &mtxRegistry );
+
+    /* Re-use the record if a mutex at this address was never destroyed through the factory */
+    pRec = pu_mutex_lookup( pMtx );
+    if (nullptr == pRec)
+    {
+        uiIdx = pu_mutex_hash( pMtx );
+        for (i = 0; (i < PU_MUTEX_REG_SIZE) && (uiInstrumented < PU_MUTEX_MAX_INSTRUMENTED); i++)
+        {
+            if ((PU_MUTEX_KEY_EMPTY == pRegistry[uiIdx].pMtx) ||
+                (PU_MUTEX_KEY_DEAD  == pRegistry[uiIdx].pMtx))
+            {
+                pRec = &(pRegistry[uiIdx]);
+                __atomic_add_fetch( &uiInstrumented, 1, __ATOMIC_SEQ_CST );
+                break;
+            }
+            uiIdx = (uiIdx + 1) & PU_MUTEX_REG_MASK;
+        }
+    }
+
+    WARN( nullptr != pRec );
+    if (pRec)
+    {
+        PU_MUTEX_STAT_SET( pRec->uiAcquisitions, 0 );
+        PU_MUTEX_STAT_SET( pRec->uiContended,    0 );
+        PU_MUTEX_STAT_SET( pRec->uiWaitTotalNs,  0 );
+        PU_MUTEX_STAT_SET( pRec->uiWaitMaxNs,    0 );
+        PU_MUTEX_STAT_SET( pRec->uiHoldMaxNs,    0 );
+        pRec->uiHoldStartNs = 0;
+        pRec->szLabel       = (pAttr->szLabel) ? pAttr->szLabel : "unlabelled";
+        pRec->uiFlags       = pAttr->uiFlags;
+        pRec->iClass        = (pAttr->uiFlags & PU_MUTEX_ATTR_LOCKDEP) ? pu_lockdep_class( pRec->szLabel ) : -1;
+
+        /* Publish the key last, the lock-free lookup must see a complete record */
+        __atomic_store_n( &(pRec->pMtx), pMtx, __ATOMIC_RELEASE );
+        iResult = 0;
+    }
+    pthread_mutex_unlock( &mtxRegistry );
+    return (iResult);
+}
+/* pu_mutex_register */
+
+/* Remove a mutex from the registry, the slot becomes a tombstone so probing still works */
+static void pu_mutex_unregister( pthread_mutex_t* pMtx )
+{
+    pu_mutex_rec_t* pRec;
+
+    pthread_mutex_lock( &mtxRegistry );
+    pRec = pu_mutex_lookup( pMtx );
+    if (pRec)
+    {
+        __atomic_store_n( &(pRec->pMtx), PU_MUTEX_KEY_DEAD, __ATOMIC_RELEASE );
+        __atomic_sub_fetch( &uiInstrumented, 1, __ATOMIC_SEQ_CST );
+    }
+    pthread_mutex_unlock( &mtxRegistry );
+}
+/* pu_mutex_unregister */
+
+/* Find or add the class for a label. The caller holds mtxRegistry */
+static int pu_lockdep_class( const char* szLabel )
+{
+    int i;
+
+    for (i = 0; i < iClassCount; i++)
+    {
+        if ((pClassName[i] == szLabel) || (0 == strcmp( pClassName[i], szLabel )))
+        {
+            return (i);
+        }
+    }
+    WARN( iClassCount < PU_LOCKDEP_MAX_CLASSES );
+    if (iClassCount < PU_LOCKDEP_MAX_CLASSES)
+    {
+        pClassName[iClassCount] = szLabel;
+        __atomic_store_n( &iClassCount, iClassCount + 1, __ATOMIC_RELEASE );
+        return (iClassCount - 1);
+    }
+    return (-1);
+}
+/* pu_lockdep_class */
+
+/* Depth first search of the dependency graph, is there a path iFrom ->* iTo */
+static bool pu_lockdep_reaches( int iFrom, int iTo )
+{
+    uint64_t pVisited[PU_LOCKDEP_WORDS];
+    int      pStack[PU_LOCKDEP_MAX_CLASSES];
+    size_t   uiTop = 0;
+    int      iCurr;
+    int      iNext;
+    uint64_t uiRow;
+    int      w;
+
+    memset( pVisited, 0, sizeof(pVisited) );
+    pStack[uiTop++] = iFrom;
+    pVisited[iFrom / 64] |= (1ULL << (iFrom % 64));
+    while (uiTop > 0)
+    {
+        iCurr = pStack[--uiTop];
+        if (iCurr == iTo)
+        {
+            return (true);
+        }
+        for (w = 0; w < PU_LOCKDEP_WORDS; w++)
+        {
+            uiRow = __atomic_load_n( &(pDeps[iCurr][w]), __ATOMIC_ACQUIRE ) & ~pVisited[w];
+            while (uiRow)
+            {
+                iNext  = (w * 64) + __builtin_ctzll( uiRow );
+                uiRow &= (uiRow - 1);
+                pVisited[w] |= (1ULL << (iNext % 64));
+                pStack[uiTop++] = iNext;
+            }
+        }
+    }
+    return (false);
+}
+/* pu_lockdep_reaches */
+
+/* Count, then pass on to the user callback, or print */
+static void pu_lockdep_report(
+    int         iHeld,
+    int         iAcquired,
+    const char* szReason )
+{
+    pu_lockdep_report_fct_t fctReport = __atomic_load_n( &fctLockdepReport, __ATOMIC_ACQUIRE );
+
+    __atomic_add_fetch( &uiViolations, 1, __ATOMIC_RELAXED );
+    if (fctReport)
+    {
+        fctReport( pClassName[iHeld], pClassName[iAcquired], szReason );
+    }
+    else
+    {
+        fprintf( stderr, "LOCKDEP: %s: holding %s, acquiring %s\n",
+            szReason, pClassName[iHeld], pClassName[iAcquired] );
+    }
+}
+/* pu_lockdep_report */
+
+/* Check the new lock against every lock the thread holds, before blocking on it */
+static void pu_lockdep_acquire(
+    pthread_mutex_t* pMtx,
+    int              iClass )
+{
+    uint64_t uiBit = 1ULL << (iClass % 64);
+    int      iHeldClass;
+    int      i;
+
+    for (i = 0; i < iHeldDepth; i++)
+    {
+        iHeldClass = pHeld[i].iClass;
+        if (pHeld[i].pMtx == pMtx)
+        {
+            pu_lockdep_report( iHeldClass, iClass, "recursive locking, certain deadlock" );
+            LOG_FATAL( "LOCKDEP: MUTEX DEADLOCK (0x%zx)\n", (size_t)(pMtx) );
+            continue;
+        }
+
+        /* Already known dependency, the common case is one load */
+        if (__atomic_load_n( &(pDeps[iHeldClass][iClass / 64]), __ATOMIC_RELAXED ) & uiBit)
+        {
+            continue;
+        }
+
+        /* New dependency. Only the thread that sets the bit checks and reports it, so each
+         * problem is reported exactly once
+         */
+        if (0 == (__atomic_fetch_or( &(pDeps[iHeldClass][iClass / 64]), uiBit, __ATOMIC_ACQ_REL ) & uiBit))
+        {
+            if (iHeldClass == iClass)
+            {
+                pu_lockdep_report( iHeldClass, iClass, "nested locking of the same class" );
+            }
+            else if (pu_lockdep_reaches( iClass, iHeldClass ))
+            {
+                pu_lockdep_report( iHeldClass, iClass, "lock order inversion (possible deadlock)" );
+            }
+        }
+    }
+}
+/* pu_lockdep_acquire */
+
+static void pu_lockdep_push(
+    pthread_mutex_t* pMtx,
+    int              iClass )
+{
+    WARN( iHeldDepth < PU_LOCKDEP_MAX_DEPTH );
+    if (iHeldDepth < PU_LOCKDEP_MAX_DEPTH)
+    {
+        pHeld[iHeldDepth].pMtx   = pMtx;
+        pHeld[iHeldDepth].iClass = iClass;
+        iHeldDepth++;
+    }
+}
+/* pu_lockdep_push */
+
+/* Locks are not always released in reverse order, find the most recent entry */
+static void pu_lockdep_pop( pthread_mutex_t* pMtx )
+{
+    int iFound = -1;
+    int i;
+
+    for (i = 0; i < iHeldDepth; i++)
+    {
+        if (pHeld[i].pMtx == pMtx)
+        {
+            iFound = i;
+        }
+    }
+    if (iFound >= 0)
+    {
+        for (i = iFound + 1; i < iHeldDepth; i++)
+        {
+            pHeld[i - 1] = pHeld[i];
+        }
+        iHeldDepth--;
+    }
+}
+/* pu_lockdep_pop */
+
+/* Sort worst first: total wait, then contended count */
+static int pu_mutex_stats_compare( const void* pA, const void* pB )
+{
+    const pu_mutex_stats_t* pStatA = (const pu_mutex_stats_t*)pA;
+    const pu_mutex_stats_t* pStatB = (const pu_mutex_stats_t*)pB;
+
+    if (pStatA->uiWaitTotalNs != pStatB->uiWaitTotalNs)
+    {
+        return ((pStatA->uiWaitTotalNs > pStatB->uiWaitTotalNs) ? -1 : 1);
+    }
+    if (pStatA->uiContended != pStatB->uiContended)
+    {
+        return ((pStatA->uiContended > pStatB->uiContended) ? -1 : 1);
+    }
+    return (0);
+}
+/* pu_mutex_stats_compare */
+
+static inline int pu_spinlock_self( void )
+{
+    if (0 == iSelfTid)
+    {
+        iSelfTid = (int)syscall( SYS_gettid );
+    }
+    return (iSelfTid);
+}
+/* pu_spinlock_self */
+
+/* Plain lock. With the static probes built in, a trylock first tells a contended lock apart */
+static inline int pu_mutex_lock_plain(
+    pthread_mutex_t* pMtx,
+    const char*      szLabel )
+{
+#if defined(PU_PROBES_ENABLED)
+    int iResult = pthread_mutex_trylock( pMtx );
+    if (EBUSY == iResult)
+    {
+        PU_PROBE2( mutex__contended, pMtx, szLabel );
+        iResult = pthread_mutex_lock( pMtx );
+        PU_PROBE2( mutex__acquired, pMtx, szLabel );
+    }
+    return (iResult);
+#else
+    (void)szLabel;
+    return (pthread_mutex_lock( pMtx ));
+#endif
+}
+/* pu_mutex_lock_plain */
+
+/* Lock, and trace the wait when contended and the tracer runs */
+static int pu_mutex_lock_traced(
+    pthread_mutex_t* pMtx,
+    const char*      szLabel )
+{
+    uint64_t uiStartNs;
+    int      iResult;
+
+    if (!PU_TRACE_ON())
+    {
+        return (pu_mutex_lock_plain( pMtx, szLabel ));
+    }
+    iResult = pthread_mutex_trylock( pMtx );
+    if (EBUSY == iResult)
+    {
+        PU_PROBE2( mutex__contended, pMtx, szLabel );
+        uiStartNs = pu_mutex_now_ns();
+        iResult   = pthread_mutex_lock( pMtx );
+        PU_PROBE2( mutex__acquired, pMtx, szLabel );
+        pu_trace_event( PU_TRACE_PHASE_COMPLETE, "mutex", szLabel ? szLabel : "mutex wait",
+            uiStartNs, pu_mutex_now_ns() - uiStartNs, (uint64_t)(uintptr_t)pMtx );
+    }
+    return (iResult);
+}
+/* pu_mutex_lock_traced */
+
 /****************************************************************************/
 /* PUBLIC FUNCTION DEFINITIONS                                              */
 /****************************************************************************/
@@ -71,8 +562,31 @@ int pu_mutex_create_type(
     pthread_mutex_t* pMtx,
     pu_mutex_type    enType )
 {
-    pthread_mutexattr_t attr;
-    int                 iResult = -1;
+    return (pu_mutex_create_attr( pMtx, enType, NULL ));
+}
+/* pu_mutex_create_type */
+
+/**
+ * @brief   Creates (initialises) a mutex of the specified type with additional attributes
+ *
+ * @param[in] pMtx   : Pointer to a valid mutex
+ * @param[in] enType : Mutex type
+ * @param[in] pAttr  : Attributes, may be NULL
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ *
+ * @pre     The mutex pointer is non-null
+ * @post    The mutex is initialised
+ *
+ * @par Description
+ * If the instrumentation table is full the mutex is still created, just not instrumented.
+ */
+int pu_mutex_create_attr(
+    pthread_mutex_t*       pMtx,
+    pu_mutex_type          enType,
+    const pu_mutex_attr_t* pAttr )
+{
+    int iResult = -1;
 
     /* pre-condition */
     ASSERT( pMtx );
@@ -81,53 +595,419 @@ int pu_mutex_create_type(
         (enType >= PU_MUTEX_TYPE_FAST) &&
         (enType < PU_MUTEX_TYPE_ENDDEF) )
     {
-        /* Default - fast mutex (default) */
-        if (PU_MUTEX_TYPE_FAST == enType)
+        iResult = pu_mutex_init_type( pMtx, enType, (pAttr) ? pAttr->uiFlags : 0 );
+        if ((0 == iResult) && (pAttr) && (0 != (pAttr->uiFlags & PU_MUTEX_ATTR_INSTRUMENT)))
         {
-            iResult = pthread_mutex_init( pMtx, NULL );
+            pu_mutex_register( pMtx, pAttr );
         }
+    }
+
+    /* post-condition */
+    ASSERT( 0 == iResult);
+    return( iResult );
+}
+/* pu_mutex_create_attr */
+
+/**
+ * @brief   Destroys a mutex created by the factory
+ *
+ * @param[in] pMtx : Pointer to a valid mutex
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_mutex_destroy( pthread_mutex_t* pMtx )
+{
+    ASSERT( pMtx );
+    if (0 != __atomic_load_n( &uiInstrumented, __ATOMIC_RELAXED ))
+    {
+        pu_mutex_unregister( pMtx );
+    }
+    return (pthread_mutex_destroy( pMtx ));
+}
+/* pu_mutex_destroy */
+
+/**
+ * @brief   Locks a mutex created by the factory
+ *
+ * @param[in] pMtx : Pointer to a valid mutex
+ * @retval  The pthread_mutex_lock() result
+ *
+ * @par Description
+ * Fast path: nothing is instrumented and the tracer is stopped, two loads and a branch. Otherwise
+ * the mutex is looked up. When profiled, a trylock separates the uncontended from the contended case, and only a
+ * contended acquisition pays for the wait measurement.
+ */
+int pu_mutex_lock( pthread_mutex_t* pMtx )
+{
+    pu_mutex_rec_t* pRec;
+    uint64_t        uiStartNs;
+    uint64_t        uiNowNs;
+    uint64_t        uiWaitNs;
+    int             iResult;
+
+    if (__builtin_expect( 0 == (__atomic_load_n( &uiInstrumented, __ATOMIC_RELAXED ) |
+                                (unsigned int)__atomic_load_n( &iPuTraceOn, __ATOMIC_RELAXED )), 1 ))
+    {
+        return (pu_mutex_lock_plain( pMtx, nullptr ));
+    }
+    pRec = __atomic_load_n( &uiInstrumented, __ATOMIC_RELAXED ) ? pu_mutex_lookup( pMtx ) : nullptr;
+    if (nullptr == pRec)
+    {
+        return (pu_mutex_lock_traced( pMtx, nullptr ));
+    }
+
+    /* Lock order check happens before blocking, so a real deadlock is still reported */
+    if (pRec->iClass >= 0)
+    {
+        pu_lockdep_acquire( pMtx, pRec->iClass );
+    }
+
+    if (0 == (pRec->uiFlags & PU_MUTEX_ATTR_PROFILE))
+    {
+        iResult = pu_mutex_lock_traced( pMtx, pRec->szLabel );
+    }
+
+    /* Uncontended */
+    else if (PU_MUTEX_ACQUIRED( iResult = pthread_mutex_trylock( pMtx ) ))
+    {
+        PU_MUTEX_STAT_SET( pRec->uiAcquisitions, PU_MUTEX_STAT_GET( pRec->uiAcquisitions ) + 1 );
+        pRec->uiHoldStartNs = pu_mutex_now_ns();
+    }
 
-        /* Error mutex */
-        else if (PU_MUTEX_TYPE_ERROR == enType)
+    /* Contended, time the wait */
+    else
+    {
+        PU_PROBE2( mutex__contended, pMtx, pRec->szLabel );
+        uiStartNs = pu_mutex_now_ns();
+        iResult   = pthread_mutex_lock( pMtx );
+        PU_PROBE2( mutex__acquired, pMtx, pRec->szLabel );
+        if (PU_MUTEX_ACQUIRED( iResult ))
         {
-            iResult = pthread_mutexattr_init( &attr );
-            if (0 == iResult)
+            uiNowNs  = pu_mutex_now_ns();
+            uiWaitNs = uiNowNs - uiStartNs;
+            PU_MUTEX_STAT_SET( pRec->uiAcquisitions, PU_MUTEX_STAT_GET( pRec->uiAcquisitions ) + 1 );
+            PU_MUTEX_STAT_SET( pRec->uiContended,    PU_MUTEX_STAT_GET( pRec->uiContended ) + 1 );
+            PU_MUTEX_STAT_SET( pRec->uiWaitTotalNs,  PU_MUTEX_STAT_GET( pRec->uiWaitTotalNs ) + uiWaitNs );
+            if (uiWaitNs > PU_MUTEX_STAT_GET( pRec->uiWaitMaxNs ))
             {
-                iResult = pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_ERRORCHECK );
+                PU_MUTEX_STAT_SET( pRec->uiWaitMaxNs, uiWaitNs );
             }
-            if (0 == iResult)
+            pRec->uiHoldStartNs = uiNowNs;
+            if (PU_TRACE_ON())
             {
-                iResult = pthread_mutex_init( pMtx, &attr );
+                pu_trace_event( PU_TRACE_PHASE_COMPLETE, "mutex", pRec->szLabel ? pRec->szLabel : "mutex wait",
+                    uiStartNs, uiWaitNs, (uint64_t)(uintptr_t)pMtx );
             }
-            pthread_mutexattr_destroy( &attr );
         }
+    }
 
-// Removed recursive mutexes, They are (relatively) slow and using them is bad practice.
-// The use of a recursive mutex typically means one the author is not clear about the
-// execution paths in their code.
-// The code block remains both as a caution not to add them back in, and in the possible case
-// where using a recursive in an engineering/experimental build may have discovery value..
-#if 0
-        /* Recursive mutex */
-        else if (PU_MUTEX_TYPE_RECURSIVE == enType)
+    if (PU_MUTEX_ACQUIRED( iResult ) && (pRec->iClass >= 0))
+    {
+        pu_lockdep_push( pMtx, pRec->iClass );
+    }
+    return (iResult);
+}
+/* pu_mutex_lock */
+
+/**
+ * @brief   Unlocks a mutex created by the factory
+ *
+ * @param[in] pMtx : Pointer to a valid mutex
+ * @retval  The pthread_mutex_unlock() result
+ */
+int pu_mutex_unlock( pthread_mutex_t* pMtx )
+{
+    pu_mutex_rec_t* pRec;
+    uint64_t        uiHoldNs;
+
+    if (0 != __atomic_load_n( &uiInstrumented, __ATOMIC_RELAXED ))
+    {
+        pRec = pu_mutex_lookup( pMtx );
+        if ((pRec) && (pRec->iClass >= 0))
+        {
+            pu_lockdep_pop( pMtx );
+        }
+        if ((pRec) && (0 != pRec->uiHoldStartNs))
+        {
+            uiHoldNs = pu_mutex_now_ns() - pRec->uiHoldStartNs;
+            pRec->uiHoldStartNs = 0;
+            if (uiHoldNs > PU_MUTEX_STAT_GET( pRec->uiHoldMaxNs ))
+            {
+                PU_MUTEX_STAT_SET( pRec->uiHoldMaxNs, uiHoldNs );
+            }
+        }
+    }
+    return (pthread_mutex_unlock( pMtx ));
+}
+/* pu_mutex_unlock */
+
+/**
+ * @brief   Locks a robust mutex, and recovers it if the previous owner died
+ *
+ * @param[in] pMtx       : Pointer to a valid robust mutex
+ * @param[in] fctRecover : Recovery function, may be NULL
+ * @param[in] pArg       : Recovery argument
+ * @retval  0 the mutex is held, and consistent
+ * @retval  ENOTRECOVERABLE the state could not be repaired
+ * @retval  Other pthread_mutex_lock() errors
+ */
+int pu_mutex_lock_robust(
+    pthread_mutex_t*       pMtx,
+    pu_mutex_recover_fct_t fctRecover,
+    void*                  pArg )
+{
+    int iResult;
+
+    ASSERT( pMtx );
+    iResult = pu_mutex_lock( pMtx );
+    if (EOWNERDEAD == iResult)
+    {
+        LOG_TRACE( "MUTEX OWNER DIED (0x%zx), recovering\n", (size_t)(pMtx) );
+        if ((nullptr == fctRecover) || (0 == fctRecover( pMtx, pArg )))
+        {
+            iResult = pthread_mutex_consistent( pMtx );
+        }
+        else
+        {
+            /* Unlocking without marking it consistent makes it permanently unrecoverable */
+            pu_mutex_unlock( pMtx );
+            iResult = ENOTRECOVERABLE;
+        }
+    }
+    return (iResult);
+}
+/* pu_mutex_lock_robust */
+
+/**
+ * @brief   Reports the most contended instrumented mutexes
+ *
+ * @param[out] pStats : Array to fill
+ * @param[in]  uiMax  : Number of entries in the array
+ * @retval  Number of entries filled
+ */
+size_t pu_mutex_profile_report(
+    pu_mutex_stats_t* pStats,
+    size_t            uiMax )
+{
+    pu_mutex_stats_t* pAll;
+    pthread_mutex_t*  pKey;
+    size_t            uiCount = 0;
+    size_t            i;
+
+    ASSERT( pStats || (0 == uiMax) );
+    pAll = (pu_mutex_stats_t*)malloc( PU_MUTEX_MAX_INSTRUMENTED * sizeof(pu_mutex_stats_t) );
+    if ((nullptr == pAll) || (nullptr == pStats))
+    {
+        free( pAll );
+        return (0);
+    }
+
+    /* Collect under the registry lock so that records are not recycled while being read */
+    pthread_mutex_lock( &mtxRegistry );
+    for (i = 0; (i < PU_MUTEX_REG_SIZE) && (uiCount < PU_MUTEX_MAX_INSTRUMENTED); i++)
+    {
+        pKey = __atomic_load_n( &(pRegistry[i].pMtx), __ATOMIC_ACQUIRE );
+        if ((PU_MUTEX_KEY_EMPTY != pKey) &&
+            (PU_MUTEX_KEY_DEAD  != pKey) &&
+            (pRegistry[i].uiFlags & PU_MUTEX_ATTR_PROFILE))
+        {
+            pAll[uiCount].szLabel        = pRegistry[i].szLabel;
+            pAll[uiCount].pMtx           = pKey;
+            pAll[uiCount].uiAcquisitions = PU_MUTEX_STAT_GET( pRegistry[i].uiAcquisitions );
+            pAll[uiCount].uiContended    = PU_MUTEX_STAT_GET( pRegistry[i].uiContended );
+            pAll[uiCount].uiWaitTotalNs  = PU_MUTEX_STAT_GET( pRegistry[i].uiWaitTotalNs );
+            pAll[uiCount].uiWaitMaxNs    = PU_MUTEX_STAT_GET( pRegistry[i].uiWaitMaxNs );
+            pAll[uiCount].uiHoldMaxNs    = PU_MUTEX_STAT_GET( pRegistry[i].uiHoldMaxNs );
+            uiCount++;
+        }
+    }
+    pthread_mutex_unlock( &mtxRegistry );
+
+    /* Worst first, then keep as many as the caller wants */
+    qsort( pAll, uiCount, sizeof(pu_mutex_stats_t), pu_mutex_stats_compare );
+    uiCount = (uiCount < uiMax) ? uiCount : uiMax;
+    memcpy( pStats, pAll, uiCount * sizeof(pu_mutex_stats_t) );
+    free( pAll );
+    return (uiCount);
+}
+/* pu_mutex_profile_report */
+
+/**
+ * @brief   Prints the most contended instrumented mutexes
+ *
+ * @param[in] pFile : Output stream, e.g. stderr
+ * @param[in] uiTop : Maximum number of locks to list
+ */
+void pu_mutex_profile_print(
+    FILE*  pFile,
+    size_t uiTop )
+{
+    pu_mutex_stats_t* pStats;
+    size_t            uiCount;
+    size_t            i;
+
+    ASSERT( pFile );
+    pStats = (pu_mutex_stats_t*)malloc( uiTop * sizeof(pu_mutex_stats_t) );
+    if ((pFile) && (pStats))
+    {
+        uiCount = pu_mutex_profile_report( pStats, uiTop );
+        fprintf( pFile, "%-40s %12s %12s %14s %12s %12s\n",
+            "lock", "acquired", "contended", "wait_total_us", "wait_max_us", "hold_max_us" );
+        for (i = 0; i < uiCount; i++)
+        {
+            fprintf( pFile, "%-40s %12llu %12llu %14llu %12llu %12llu\n",
+                pStats[i].szLabel,
+                (unsigned long long)pStats[i].uiAcquisitions,
+                (unsigned long long)pStats[i].uiContended,
+                (unsigned long long)(pStats[i].uiWaitTotalNs / 1000),
+                (unsigned long long)(pStats[i].uiWaitMaxNs / 1000),
+                (unsigned long long)(pStats[i].uiHoldMaxNs / 1000) );
+        }
+    }
+    free( pStats );
+}
+/* pu_mutex_profile_print */
+
+/**
+ * @brief   Clears the statistics of all the instrumented mutexes
+ *
+ * @par Description
+ * The hold start time is left alone, a lock held across the reset still closes its hold properly.
+ */
+void pu_mutex_profile_reset( void )
+{
+    size_t i;
+
+    pthread_mutex_lock( &mtxRegistry );
+    for (i = 0; i < PU_MUTEX_REG_SIZE; i++)
+    {
+        PU_MUTEX_STAT_SET( pRegistry[i].uiAcquisitions, 0 );
+        PU_MUTEX_STAT_SET( pRegistry[i].uiContended,    0 );
+        PU_MUTEX_STAT_SET( pRegistry[i].uiWaitTotalNs,  0 );
+        PU_MUTEX_STAT_SET( pRegistry[i].uiWaitMaxNs,    0 );
+        PU_MUTEX_STAT_SET( pRegistry[i].uiHoldMaxNs,    0 );
+    }
+    pthread_mutex_unlock( &mtxRegistry );
+}
+/* pu_mutex_profile_reset */
+
+/**
+ * @brief   Replaces the lock order violation callback
+ *
+ * @param[in] fctReport : New callback, NULL restores the default (print to stderr)
+ */
+void pu_lockdep_set_report( pu_lockdep_report_fct_t fctReport )
+{
+    __atomic_store_n( &fctLockdepReport, fctReport, __ATOMIC_RELEASE );
+}
+/* pu_lockdep_set_report */
+
+/**
+ * @brief   Number of lock order violations reported so far
+ *
+ * @retval  Violation count
+ */
+size_t pu_lockdep_violations( void )
+{
+    return (__atomic_load_n( &uiViolations, __ATOMIC_RELAXED ));
+}
+/* pu_lockdep_violations */
+
+
+/**
+ * @brief   Creates (initialises) a spinlock
+ *
+ * @param[in] pLock        : Pointer to a valid spinlock
+ * @param[in] uiYieldAfter : Backoff rounds before yielding, 0 to never yield
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_spinlock_create(
+    pu_spinlock_t* pLock,
+    unsigned int   uiYieldAfter )
+{
+    ASSERT( pLock );
+    if (!pLock)
+    {
+        return (-1);
+    }
+    pLock->uiYieldAfter = uiYieldAfter;
+    pLock->iOwner       = 0;
+    __atomic_store_n( &(pLock->uiLocked), 0, __ATOMIC_RELEASE );
+    return (0);
+}
+/* pu_spinlock_create */
+
+/**
+ * @brief   Contended path of pu_spinlock_lock()
+ *
+ * @param[in] pLock : Pointer to a valid spinlock
+ *
+ * @par Description
+ * Test-and-test-and-set. Wait on a plain load, backing off exponentially, and only retry the
+ * exchange once the lock has been seen free. Once at the maximum backoff, count the rounds and
+ * start yielding after the configured threshold (the owner has probably been preempted).
+ */
+void pu_spinlock_lock_slow( pu_spinlock_t* pLock )
+{
+    unsigned int uiBackoff = 1;
+    unsigned int uiRounds  = 0;
+    unsigned int i;
+
+    ASSERT( pLock );
+#if !defined(NDEBUG)
+    /* A recursive lock would spin forever */
+    ASSERT( pu_spinlock_self() != __atomic_load_n( &(pLock->iOwner), __ATOMIC_RELAXED ) );
+#endif
+    do
+    {
+        while (0 != __atomic_load_n( &(pLock->uiLocked), __ATOMIC_RELAXED ))
         {
-            iResult = pthread_mutexattr_init( &attr );
-            if (0 == iResult)
+            if (uiBackoff < PU_SPINLOCK_MAX_BACKOFF)
+            {
+                for (i = 0; i < uiBackoff; i++)
+                {
+                    PU_CPU_RELAX();
+                }
+                uiBackoff <<= 1;
+            }
+            else if ((0 != pLock->uiYieldAfter) && (uiRounds >= pLock->uiYieldAfter))
             {
-                iResult = pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
+                sched_yield();
             }
-            if (0 == iResult)
+            else
             {
-                iResult = pthread_mutex_init( pMtx, &attr );
+                for (i = 0; i < uiBackoff; i++)
+                {
+                    PU_CPU_RELAX();
+                }
+                uiRounds++;
             }
-            pthread_mutexattr_destroy( &attr );
         }
-#endif
-    }
+    } while (0 != __atomic_exchange_n( &(pLock->uiLocked), 1, __ATOMIC_ACQUIRE ));
+}
+/* pu_spinlock_lock_slow */
 
-    /* post-condition */
-    ASSERT( 0 == iResult);
-    return( iResult );
+/**
+ * @brief   Debug owner tracking, records the new owner
+ * @param[in] pLock : Pointer to a spinlock just acquired by the caller
+ */
+void pu_spinlock_debug_acquired( pu_spinlock_t* pLock )
+{
+    __atomic_store_n( &(pLock->iOwner), pu_spinlock_self(), __ATOMIC_RELAXED );
 }
-/* pu_mutex_create_type */
+/* pu_spinlock_debug_acquired */
 
+/**
+ * @brief   Debug owner tracking, checks that the caller owns the lock it releases
+ * @param[in] pLock : Pointer to a spinlock held by the caller
+ */
+void pu_spinlock_debug_releasing( pu_spinlock_t* pLock )
+{
+    if (pu_spinlock_self() != __atomic_load_n( &(pLock->iOwner), __ATOMIC_RELAXED ))
+    {
+        LOG_FATAL( "SPINLOCK UNLOCK, NOT OWNER (0x%zx)\n", (size_t)(pLock) );
+    }
+    __atomic_store_n( &(pLock->iOwner), 0, __ATOMIC_RELAXED );
+}
+/* pu_spinlock_debug_releasing */
@@ -0,0 +1,376 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     puperf.cpp
+ * @brief    Implementation of the per-thread performance counters
+ */
+
+/**** Includes ***************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "puperf.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+
+/* Per thread record */
+typedef struct pu_perf_thread_tag
+{
+    int                                 pFds[PU_PERF_UNDEF];    /* -1 when not open       */
+    struct perf_event_mmap_page*        pPages[PU_PERF_UNDEF];  /* rdpmc, hardware only   */
+    const char*                         szName;
+    int                                 iTid;
+    struct pu_perf_thread_tag*          pPrev;                  /* Registry, under the lock */
+    struct pu_perf_thread_tag*          pNext;
+}   pu_perf_thread_t;
+
+/* read() layout for PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING */
+typedef struct pu_perf_value_tag
+{
+    uint64_t ulValue;
+    uint64_t ulEnabled;
+    uint64_t ulRunning;
+}   pu_perf_value_t;
+
+/**** Macros ****************************************************************/
+
+/**** Static declarations ***************************************************/
+static thread_local pu_perf_thread_t* pPerfSelf = nullptr;
+static pthread_mutex_t   mtxPerf      = PTHREAD_MUTEX_INITIALIZER;
+static pu_perf_thread_t* pPerfList    = nullptr;
+static unsigned int      uiPerfEvents = 0;
+
+/* Type and config of each counter, in pu_perf_event_t order */
+static const uint32_t pPerfTypes[PU_PERF_UNDEF] =
+{
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE
+};
+static const uint64_t pPerfConfigs[PU_PERF_UNDEF] =
+{
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_SW_CONTEXT_SWITCHES
+};
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static int pu_perf_open( pu_perf_event_t enEvent );
+static bool pu_perf_read_fd( int iFd, uint64_t* pulValue );
+static bool pu_perf_read_user( struct perf_event_mmap_page* pPage, uint64_t* pulValue );
+static void pu_perf_snapshot( const pu_perf_thread_t* pThread, pu_perf_counters_t* pCounters, bool bSelf );
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+/* Opens one counter on the calling thread, with kernel time if permitted */
+static int pu_perf_open( pu_perf_event_t enEvent )
+{
+    struct perf_event_attr stAttr;
+    int                    iFd;
+
+    memset( &stAttr, 0, sizeof(stAttr) );
+    stAttr.size        = sizeof(stAttr);
+    stAttr.type        = pPerfTypes[enEvent];
+    stAttr.config      = pPerfConfigs[enEvent];
+    stAttr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    stAttr.exclude_hv  = 1;
+    iFd = (int)syscall( SYS_perf_event_open, &stAttr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC );
+    if ((iFd < 0) && ((EACCES == errno) || (EPERM == errno)))
+    {
+        stAttr.exclude_kernel = 1;
+        iFd = (int)syscall( SYS_perf_event_open, &stAttr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC );
+    }
+    return (iFd);
+}
+/* pu_perf_open */
+
+/* read() path, scaled up when the counter was multiplexed */
+static bool pu_perf_read_fd(
+    int       iFd,
+    uint64_t* pulValue )
+{
+    pu_perf_value_t stValue;
+
+    if (sizeof(stValue) != read( iFd, &stValue, sizeof(stValue) ))
+    {
+        return (false);
+    }
+    if ((stValue.ulRunning > 0) && (stValue.ulRunning < stValue.ulEnabled))
+    {
+        stValue.ulValue = (uint64_t)((double)stValue.ulValue * ((double)stValue.ulEnabled / (double)stValue.ulRunning));
+    }
+    *pulValue = stValue.ulValue;
+    return (true);
+}
+/* pu_perf_read_fd */
+
+/* rdpmc path, own thread only. The page is a seqlock written by the kernel. Gives up (and the
+ * caller uses read()) when the counter is not on the PMU, or has been multiplexed.
+ */
+static bool pu_perf_read_user(
+    struct perf_event_mmap_page* pPage,
+    uint64_t*                    pulValue )
+{
+#if defined(__x86_64__) || defined(__i386__)
+    uint64_t ulCount;
+    int64_t  iOffset;
+    uint32_t uiSeq;
+    uint32_t uiIndex;
+    uint32_t uiLow;
+    uint32_t uiHigh;
+    uint16_t usWidth;
+    bool     bUser;
+
+    do
+    {
+        uiSeq = __atomic_load_n( &(pPage->lock), __ATOMIC_ACQUIRE );
+        uiIndex = pPage->index;
+        iOffset = pPage->offset;
+        usWidth = pPage->pmc_width;
+        bUser   = pPage->cap_user_rdpmc && (0 != uiIndex) && (pPage->time_running == pPage->time_enabled);
+        ulCount = 0;
+        if (bUser)
+        {
+            __asm__ __volatile__( "rdpmc" : "=a"(uiLow), "=d"(uiHigh) : "c"(uiIndex - 1) );
+            ulCount   = ((uint64_t)uiHigh << 32) | uiLow;
+            ulCount <<= (64 - usWidth);
+            ulCount   = (uint64_t)((int64_t)ulCount >> (64 - usWidth));
+        }
+        __atomic_thread_fence( __ATOMIC_ACQUIRE );
+    }   while (__atomic_load_n( &(pPage->lock), __ATOMIC_RELAXED ) != uiSeq);
+    if (bUser)
+    {
+        *pulValue = (uint64_t)iOffset + ulCount;
+    }
+    return (bUser);
+#else
+    (void)pPage;
+    (void)pulValue;
+    return (false);
+#endif
+}
+/* pu_perf_read_user */
+
+static void pu_perf_snapshot(
+    const pu_perf_thread_t* pThread,
+    pu_perf_counters_t*     pCounters,
+    bool                    bSelf )
+{
+    unsigned int i;
+
+    memset( pCounters, 0, sizeof(*pCounters) );
+    pCounters->szName = pThread->szName;
+    pCounters->iTid   = pThread->iTid;
+    for (i = 0; i < PU_PERF_UNDEF; i++)
+    {
+        if (pThread->pFds[i] < 0)
+        {
+            continue;
+        }
+        if ((bSelf && pThread->pPages[i] && pu_perf_read_user( pThread->pPages[i], &(pCounters->pValues[i]) )) ||
+            pu_perf_read_fd( pThread->pFds[i], &(pCounters->pValues[i]) ))
+        {
+            pCounters->uiValid |= PU_PERF_MASK(i);
+        }
+    }
+}
+/* pu_perf_snapshot */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Selects the counters of threads created from now on
+ *
+ * @param[in] uiEvents : PU_PERF_MASK combination, 0 to stop opening counters
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_perf_enable( unsigned int uiEvents )
+{
+    ASSERT( 0 == (uiEvents & ~PU_PERF_ALL) );
+    if (0 != (uiEvents & ~PU_PERF_ALL))
+    {
+        return (-1);
+    }
+    __atomic_store_n( &uiPerfEvents, uiEvents, __ATOMIC_RELEASE );
+    return (0);
+}
+/* pu_perf_enable */
+
+/**
+ * @brief   Opens the counters of the calling thread
+ *
+ * @param[in] szName : Thread name, persistent
+ * @retval  0 for success
+ * @retval  Non-zero when counters are not enabled, or none could be opened
+ *
+ * @par Description
+ * Hardware counters are also mapped, the mapping is what allows \c rdpmc.
+ */
+int pu_perf_register( const char* szName )
+{
+    pu_perf_thread_t* pThread;
+    unsigned int      uiEvents = __atomic_load_n( &uiPerfEvents, __ATOMIC_ACQUIRE );
+    unsigned int      uiOpen   = 0;
+    unsigned int      i;
+    void*             pPage;
+
+    if ((0 == uiEvents) || (pPerfSelf))
+    {
+        return (-1);
+    }
+    pThread = (pu_perf_thread_t*)calloc( 1, sizeof(pu_perf_thread_t) );
+    if (!pThread)
+    {
+        return (-1);
+    }
+    pThread->szName = szName ? szName : "thread";
+    pThread->iTid   = (int)syscall( SYS_gettid );
+    for (i = 0; i < PU_PERF_UNDEF; i++)
+    {
+        pThread->pFds[i] = (uiEvents & PU_PERF_MASK(i)) ? pu_perf_open( (pu_perf_event_t)i ) : -1;
+        if (pThread->pFds[i] < 0)
+        {
+            continue;
+        }
+        uiOpen++;
+        if (PERF_TYPE_HARDWARE == pPerfTypes[i])
+        {
+            pPage = mmap( nullptr, (size_t)sysconf( _SC_PAGESIZE ), PROT_READ, MAP_SHARED, pThread->pFds[i], 0 );
+            pThread->pPages[i] = (MAP_FAILED == pPage) ? nullptr : (struct perf_event_mmap_page*)pPage;
+        }
+    }
+    if (0 == uiOpen)
+    {
+        LOG_TRACE( "PU_PERF(register): no counters for %s\n", pThread->szName );
+        free( pThread );
+        return (-1);
+    }
+    pPerfSelf = pThread;
+
+    pthread_mutex_lock( &mtxPerf );
+    pThread->pNext = pPerfList;
+    if (pPerfList)
+    {
+        pPerfList->pPrev = pThread;
+    }
+    pPerfList = pThread;
+    pthread_mutex_unlock( &mtxPerf );
+    return (0);
+}
+/* pu_perf_register */
+
+/**
+ * @brief   Closes the counters of the calling thread
+ */
+void pu_perf_unregister( void )
+{
+    pu_perf_thread_t* pThread = pPerfSelf;
+    unsigned int      i;
+
+    if (!pThread)
+    {
+        return;
+    }
+    pthread_mutex_lock( &mtxPerf );
+    if (pThread->pPrev)
+    {
+        pThread->pPrev->pNext = pThread->pNext;
+    }
+    else
+    {
+        pPerfList = pThread->pNext;
+    }
+    if (pThread->pNext)
+    {
+        pThread->pNext->pPrev = pThread->pPrev;
+    }
+    pthread_mutex_unlock( &mtxPerf );
+
+    pPerfSelf = nullptr;
+    for (i = 0; i < PU_PERF_UNDEF; i++)
+    {
+        if (pThread->pPages[i])
+        {
+            munmap( pThread->pPages[i], (size_t)sysconf( _SC_PAGESIZE ) );
+        }
+        if (pThread->pFds[i] >= 0)
+        {
+            close( pThread->pFds[i] );
+        }
+    }
+    free( pThread );
+}
+/* pu_perf_unregister */
+
+/**
+ * @brief   Reads the counters of the calling thread
+ *
+ * @param[out] pCounters : Snapshot
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_perf_read( pu_perf_counters_t* pCounters )
+{
+    ASSERT( pCounters );
+    if ((!pCounters) || (!pPerfSelf))
+    {
+        return (-1);
+    }
+    pu_perf_snapshot( pPerfSelf, pCounters, true );
+    return (0);
+}
+/* pu_perf_read */
+
+/**
+ * @brief   Reads the counters of every registered thread
+ *
+ * @param[out] pCounters : Snapshots
+ * @param[in]  uiMax     : Size of the array
+ * @retval  The number of snapshots written
+ */
+size_t pu_perf_read_all(
+    pu_perf_counters_t* pCounters,
+    size_t              uiMax )
+{
+    pu_perf_thread_t* pThread;
+    size_t            uiCount = 0;
+
+    ASSERT( pCounters || (0 == uiMax) );
+    if (!pCounters)
+    {
+        return (0);
+    }
+    pthread_mutex_lock( &mtxPerf );
+    for (pThread = pPerfList; pThread && (uiCount < uiMax); pThread = pThread->pNext)
+    {
+        pu_perf_snapshot( pThread, &(pCounters[uiCount++]), (pThread == pPerfSelf) );
+    }
+    pthread_mutex_unlock( &mtxPerf );
+    return (uiCount);
+}
+/* pu_perf_read_all */
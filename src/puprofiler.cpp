@@ -0,0 +1,610 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     puprofiler.cpp
+ * @brief    Implementation of the sampling profiler
+ */
+
+/**** Includes ***************************************************************/
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <ucontext.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <cxxabi.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "puprofiler.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+#define PU_PROFILER_NS_PER_SEC (1000000000L)
+
+/* Older C libraries only have the union member */
+#if !defined(sigev_notify_thread_id)
+    #define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+/* backtrace() from the handler also returns the handler and the signal trampoline */
+#define PU_PROFILER_HANDLER_FRAMES (2)
+
+/* One recorded stack, innermost frame first */
+typedef struct pu_profiler_sample_tag
+{
+    unsigned int uiDepth;
+    void*        pFrames[PU_PROFILER_MAX_DEPTH];
+}   pu_profiler_sample_t;
+
+/* Per thread record. The ring is single producer (the handler), single consumer (collect). */
+typedef struct pu_profiler_thread_tag
+{
+    pu_profiler_sample_t           pRing[PU_PROFILER_RING_SAMPLES];
+    size_t                         uiHead;      /* Written by the handler            */
+    size_t                         uiTail;      /* Written by collect, under the lock */
+    size_t                         uiDropped;   /* Written by the handler            */
+    timer_t                        tmrCpu;      /* Thread CPU time timer             */
+    const char*                    szName;
+    uintptr_t                      ulStackLo;   /* Stack bounds, frame pointer walk  */
+    uintptr_t                      ulStackHi;
+    struct pu_profiler_thread_tag* pPrev;       /* Registry, under the lock          */
+    struct pu_profiler_thread_tag* pNext;
+}   pu_profiler_thread_t;
+
+/* Profile: stack (thread name first, then the frames innermost first) to sample count */
+typedef std::map<std::vector<void*>, size_t> pu_profiler_stacks_t;
+
+/**** Macros ****************************************************************/
+
+/**** Static declarations ***************************************************/
+static thread_local pu_profiler_thread_t* pProfilerSelf = nullptr;
+static pthread_mutex_t       mtxProfiler    = PTHREAD_MUTEX_INITIALIZER;
+static pu_profiler_thread_t* pProfilerList  = nullptr;
+static pu_profiler_stacks_t  mapStacks;
+static size_t                uiDroppedGone  = 0;   /* Dropped by unregistered threads */
+static unsigned int          uiProfilerHz   = 0;
+static unsigned int          uiProfilerFlags = 0;
+static int                   bProfilerOn    = 0;
+static bool                  bHandlerSet    = false;
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static unsigned int pu_profiler_walk( void* pContext, const pu_profiler_thread_t* pThread, void** ppFrames );
+static void pu_profiler_handler( int iSignal, siginfo_t* pInfo, void* pContext );
+static void pu_profiler_arm( pu_profiler_thread_t* pThread, unsigned int uiHz );
+static size_t pu_profiler_drain( pu_profiler_thread_t* pThread );
+static std::string pu_profiler_symbol( void* pAddr );
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+/* Frame pointer walk from the interrupted context. Every frame is checked against the stack
+ * bounds before it is read, a frame without a frame pointer ends the walk. Returns 0 where
+ * the registers are not known, the caller then falls back to backtrace().
+ */
+static unsigned int pu_profiler_walk(
+    void*                       pContext,
+    const pu_profiler_thread_t* pThread,
+    void**                      ppFrames )
+{
+    const ucontext_t* pUc = (const ucontext_t*)pContext;
+    uintptr_t         ulPc;
+    uintptr_t         ulFp;
+    uintptr_t         ulNext;
+    uintptr_t         ulRet;
+    unsigned int      uiDepth = 0;
+
+#if defined(__x86_64__)
+    ulPc = (uintptr_t)pUc->uc_mcontext.gregs[REG_RIP];
+    ulFp = (uintptr_t)pUc->uc_mcontext.gregs[REG_RBP];
+#elif defined(__aarch64__)
+    ulPc = (uintptr_t)pUc->uc_mcontext.pc;
+    ulFp = (uintptr_t)pUc->uc_mcontext.regs[29];
+#else
+    (void)pUc;
+    (void)pThread;
+    (void)ppFrames;
+    return (0);
+#endif
+
+    ppFrames[uiDepth++] = (void*)ulPc;
+    while ((uiDepth < PU_PROFILER_MAX_DEPTH) &&
+           (ulFp >= pThread->ulStackLo) && (ulFp <= (pThread->ulStackHi - 2 * sizeof(uintptr_t))) &&
+           (0 == (ulFp & (sizeof(uintptr_t) - 1))))
+    {
+        ulNext = ((const uintptr_t*)ulFp)[0];
+        ulRet  = ((const uintptr_t*)ulFp)[1];
+        if (0 == ulRet)
+        {
+            break;
+        }
+        ppFrames[uiDepth++] = (void*)ulRet;
+        if (ulNext <= ulFp)
+        {
+            break;
+        }
+        ulFp = ulNext;
+    }
+    return (uiDepth);
+}
+/* pu_profiler_walk */
+
+/* Runs on the sampled thread. No locks and no allocation. */
+static void pu_profiler_handler(
+    int        iSignal,
+    siginfo_t* pInfo,
+    void*      pContext )
+{
+    pu_profiler_thread_t* pThread = pProfilerSelf;
+    pu_profiler_sample_t* pSample;
+    void*                 pFrames[PU_PROFILER_MAX_DEPTH + PU_PROFILER_HANDLER_FRAMES];
+    size_t                uiHead;
+    unsigned int          uiDepth = 0;
+    int                   iFrames;
+    int                   iErrno  = errno;
+
+    (void)iSignal;
+    (void)pInfo;
+    if (!pThread)
+    {
+        return;
+    }
+    uiHead = pThread->uiHead;
+    if ((uiHead - __atomic_load_n( &(pThread->uiTail), __ATOMIC_ACQUIRE )) >= PU_PROFILER_RING_SAMPLES)
+    {
+        __atomic_store_n( &(pThread->uiDropped), pThread->uiDropped + 1, __ATOMIC_RELAXED );
+        return;
+    }
+
+    pSample = &(pThread->pRing[uiHead % PU_PROFILER_RING_SAMPLES]);
+    if (uiProfilerFlags & PU_PROFILER_FLAG_FRAME_POINTERS)
+    {
+        uiDepth = pu_profiler_walk( pContext, pThread, pSample->pFrames );
+    }
+    if (0 == uiDepth)
+    {
+        iFrames = backtrace( pFrames, PU_PROFILER_MAX_DEPTH + PU_PROFILER_HANDLER_FRAMES );
+        if (iFrames > PU_PROFILER_HANDLER_FRAMES)
+        {
+            uiDepth = (unsigned int)(iFrames - PU_PROFILER_HANDLER_FRAMES);
+            memcpy( pSample->pFrames, &(pFrames[PU_PROFILER_HANDLER_FRAMES]), uiDepth * sizeof(void*) );
+        }
+    }
+    pSample->uiDepth = uiDepth;
+    __atomic_store_n( &(pThread->uiHead), uiHead + 1, __ATOMIC_RELEASE );
+    errno = iErrno;
+}
+/* pu_profiler_handler */
+
+/* (Re)arms the CPU time timer of a thread, 0 disarms it. Lock held. */
+static void pu_profiler_arm(
+    pu_profiler_thread_t* pThread,
+    unsigned int          uiHz )
+{
+    struct itimerspec itsPeriod;
+
+    memset( &itsPeriod, 0, sizeof(itsPeriod) );
+    if (uiHz > 0)
+    {
+        itsPeriod.it_interval.tv_sec  = (time_t)(1 / uiHz);
+        itsPeriod.it_interval.tv_nsec = (1 == uiHz) ? 0 : (PU_PROFILER_NS_PER_SEC / (long)uiHz);
+        itsPeriod.it_value            = itsPeriod.it_interval;
+    }
+    timer_settime( pThread->tmrCpu, 0, &itsPeriod, nullptr );
+}
+/* pu_profiler_arm */
+
+/* Moves the ring contents into the profile. Lock held. */
+static size_t pu_profiler_drain( pu_profiler_thread_t* pThread )
+{
+    std::vector<void*>          vecKey;
+    const pu_profiler_sample_t* pSample;
+    size_t                      uiHead = __atomic_load_n( &(pThread->uiHead), __ATOMIC_ACQUIRE );
+    size_t                      uiTail = pThread->uiTail;
+    size_t                      uiMoved = uiHead - uiTail;
+
+    for (; uiTail != uiHead; uiTail++)
+    {
+        pSample = &(pThread->pRing[uiTail % PU_PROFILER_RING_SAMPLES]);
+        vecKey.assign( 1, const_cast<char*>( pThread->szName ) );
+        vecKey.insert( vecKey.end(), pSample->pFrames, pSample->pFrames + pSample->uiDepth );
+        mapStacks[vecKey]++;
+    }
+    __atomic_store_n( &(pThread->uiTail), uiTail, __ATOMIC_RELEASE );
+    return (uiMoved);
+}
+/* pu_profiler_drain */
+
+/* Names a code address: demangled symbol, else module+offset, else the address */
+static std::string pu_profiler_symbol( void* pAddr )
+{
+    Dl_info     stInfo;
+    char        szText[64];
+    char*       szDemangled;
+    const char* szModule;
+    std::string strName;
+    int         iStatus = -1;
+
+    if (0 == dladdr( pAddr, &stInfo ))
+    {
+        snprintf( szText, sizeof(szText), "0x%zx", (size_t)pAddr );
+        return (std::string( szText ));
+    }
+    if (stInfo.dli_sname)
+    {
+        szDemangled = abi::__cxa_demangle( stInfo.dli_sname, nullptr, nullptr, &iStatus );
+        strName     = (0 == iStatus) ? szDemangled : stInfo.dli_sname;
+        free( szDemangled );
+        return (strName);
+    }
+    szModule = stInfo.dli_fname ? strrchr( stInfo.dli_fname, '/' ) : nullptr;
+    szModule = szModule ? (szModule + 1) : (stInfo.dli_fname ? stInfo.dli_fname : "?");
+    snprintf( szText, sizeof(szText), "+0x%zx", (size_t)((const char*)pAddr - (const char*)stInfo.dli_fbase) );
+    return (std::string( szModule ) + szText);
+}
+/* pu_profiler_symbol */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Starts sampling threads created from now on
+ *
+ * @param[in] uiHz    : Samples per second of thread CPU time
+ * @param[in] uiFlags : PU_PROFILER_FLAG_FRAME_POINTERS, or 0
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ *
+ * @par Description
+ * backtrace() loads its unwinder on first use, which allocates. It is called once here so that
+ * the signal handler never does.
+ */
+int pu_profiler_start(
+    unsigned int uiHz,
+    unsigned int uiFlags )
+{
+    struct sigaction      saProfile;
+    pu_profiler_thread_t* pThread;
+    void*                 pFrame;
+    int                   iResult = 0;
+
+    ASSERT( (uiHz > 0) && (uiHz <= PU_PROFILER_MAX_HZ) );
+    if ((0 == uiHz) || (uiHz > PU_PROFILER_MAX_HZ))
+    {
+        return (-1);
+    }
+    backtrace( &pFrame, 1 );
+
+    pthread_mutex_lock( &mtxProfiler );
+    if (bProfilerOn)
+    {
+        iResult = -1;
+    }
+    else if (!bHandlerSet)
+    {
+        memset( &saProfile, 0, sizeof(saProfile) );
+        saProfile.sa_sigaction = pu_profiler_handler;
+        saProfile.sa_flags     = SA_SIGINFO | SA_RESTART;
+        sigemptyset( &(saProfile.sa_mask) );
+        if (0 == sigaction( PU_PROFILER_SIGNAL, &saProfile, nullptr ))
+        {
+            bHandlerSet = true;
+        }
+        else
+        {
+            LOG_ERROR( "PU_PROFILER(start): cannot install signal %d\n", PU_PROFILER_SIGNAL );
+            iResult = -1;
+        }
+    }
+    if (0 == iResult)
+    {
+        uiProfilerHz    = uiHz;
+        uiProfilerFlags = uiFlags;
+        __atomic_store_n( &bProfilerOn, 1, __ATOMIC_RELEASE );
+        for (pThread = pProfilerList; pThread; pThread = pThread->pNext)
+        {
+            pu_profiler_arm( pThread, uiHz );
+        }
+    }
+    pthread_mutex_unlock( &mtxProfiler );
+    return (iResult);
+}
+/* pu_profiler_start */
+
+/**
+ * @brief   Changes the sampling rate of every registered thread
+ *
+ * @param[in] uiHz : Samples per second, 0 pauses sampling
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_profiler_set_rate( unsigned int uiHz )
+{
+    pu_profiler_thread_t* pThread;
+    int                   iResult = -1;
+
+    if (uiHz > PU_PROFILER_MAX_HZ)
+    {
+        return (-1);
+    }
+    pthread_mutex_lock( &mtxProfiler );
+    if (bProfilerOn)
+    {
+        uiProfilerHz = uiHz;
+        for (pThread = pProfilerList; pThread; pThread = pThread->pNext)
+        {
+            pu_profiler_arm( pThread, uiHz );
+        }
+        iResult = 0;
+    }
+    pthread_mutex_unlock( &mtxProfiler );
+    return (iResult);
+}
+/* pu_profiler_set_rate */
+
+/**
+ * @brief   Stops sampling, the samples are kept
+ *
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_profiler_stop( void )
+{
+    pu_profiler_thread_t* pThread;
+    int                   iResult = -1;
+
+    pthread_mutex_lock( &mtxProfiler );
+    if (bProfilerOn)
+    {
+        __atomic_store_n( &bProfilerOn, 0, __ATOMIC_RELEASE );
+        for (pThread = pProfilerList; pThread; pThread = pThread->pNext)
+        {
+            pu_profiler_arm( pThread, 0 );
+        }
+        iResult = 0;
+    }
+    pthread_mutex_unlock( &mtxProfiler );
+    return (iResult);
+}
+/* pu_profiler_stop */
+
+/**
+ * @brief   Samples the calling thread
+ *
+ * @param[in] szName : Thread name, persistent
+ * @retval  0 for success
+ * @retval  Non-zero when the profiler is not started, or on failure
+ *
+ * @par Description
+ * The timer has to be created by the thread itself, \c CLOCK_THREAD_CPUTIME_ID is the clock of
+ * the calling thread.
+ */
+int pu_profiler_register( const char* szName )
+{
+    pu_profiler_thread_t* pThread;
+    pthread_attr_t        attr;
+    struct sigevent       sevCpu;
+    void*                 pStack = nullptr;
+    size_t                uiStack = 0;
+
+    if ((!__atomic_load_n( &bProfilerOn, __ATOMIC_ACQUIRE )) || (pProfilerSelf))
+    {
+        return (-1);
+    }
+    pThread = (pu_profiler_thread_t*)calloc( 1, sizeof(pu_profiler_thread_t) );
+    if (!pThread)
+    {
+        LOG_ERROR( "PU_PROFILER(register): no memory for %s\n", szName ? szName : "thread" );
+        return (-1);
+    }
+    pThread->szName = szName ? szName : "thread";
+
+    /* Bounds for the frame pointer walk */
+    if (0 == pthread_getattr_np( pthread_self(), &attr ))
+    {
+        pthread_attr_getstack( &attr, &pStack, &uiStack );
+        pthread_attr_destroy( &attr );
+    }
+    pThread->ulStackLo = (uintptr_t)pStack;
+    pThread->ulStackHi = (uintptr_t)pStack + uiStack;
+
+    memset( &sevCpu, 0, sizeof(sevCpu) );
+    sevCpu.sigev_notify           = SIGEV_THREAD_ID;
+    sevCpu.sigev_signo            = PU_PROFILER_SIGNAL;
+    sevCpu.sigev_notify_thread_id = (pid_t)syscall( SYS_gettid );
+    if (0 != timer_create( CLOCK_THREAD_CPUTIME_ID, &sevCpu, &(pThread->tmrCpu) ))
+    {
+        LOG_ERROR( "PU_PROFILER(register): no timer for %s, errno %d\n", pThread->szName, errno );
+        free( pThread );
+        return (-1);
+    }
+    pProfilerSelf = pThread;
+
+    pthread_mutex_lock( &mtxProfiler );
+    pThread->pNext = pProfilerList;
+    if (pProfilerList)
+    {
+        pProfilerList->pPrev = pThread;
+    }
+    pProfilerList = pThread;
+    pu_profiler_arm( pThread, bProfilerOn ? uiProfilerHz : 0 );
+    pthread_mutex_unlock( &mtxProfiler );
+    return (0);
+}
+/* pu_profiler_register */
+
+/**
+ * @brief   Stops sampling the calling thread, and keeps its samples
+ *
+ * @par Description
+ * Deleting the timer also discards a signal it has pending, so the record can be freed.
+ */
+void pu_profiler_unregister( void )
+{
+    pu_profiler_thread_t* pThread = pProfilerSelf;
+
+    if (!pThread)
+    {
+        return;
+    }
+    pthread_mutex_lock( &mtxProfiler );
+    timer_delete( pThread->tmrCpu );
+    pProfilerSelf = nullptr;
+    pu_profiler_drain( pThread );
+    uiDroppedGone += pThread->uiDropped;
+    if (pThread->pPrev)
+    {
+        pThread->pPrev->pNext = pThread->pNext;
+    }
+    else
+    {
+        pProfilerList = pThread->pNext;
+    }
+    if (pThread->pNext)
+    {
+        pThread->pNext->pPrev = pThread->pPrev;
+    }
+    pthread_mutex_unlock( &mtxProfiler );
+    free( pThread );
+}
+/* pu_profiler_unregister */
+
+/**
+ * @brief   Moves the samples out of the thread rings into the profile
+ *
+ * @retval  The number of samples moved
+ */
+size_t pu_profiler_collect( void )
+{
+    pu_profiler_thread_t* pThread;
+    size_t                uiMoved = 0;
+
+    pthread_mutex_lock( &mtxProfiler );
+    for (pThread = pProfilerList; pThread; pThread = pThread->pNext)
+    {
+        uiMoved += pu_profiler_drain( pThread );
+    }
+    pthread_mutex_unlock( &mtxProfiler );
+    return (uiMoved);
+}
+/* pu_profiler_collect */
+
+/**
+ * @brief   Writes the profile as folded stacks
+ *
+ * @param[in] pFile : Output
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ *
+ * @par Description
+ * Return addresses point after the call, they are looked up one byte back so that a call at the
+ * end of a function is not named after the next one.
+ */
+int pu_profiler_dump( FILE* pFile )
+{
+    std::map<void*, std::string> mapNames;
+    std::string                  strLine;
+    void*                        pAddr;
+    size_t                       i;
+    int                          iResult = 0;
+
+    ASSERT( pFile );
+    if (!pFile)
+    {
+        return (-1);
+    }
+    pu_profiler_collect();
+
+    pthread_mutex_lock( &mtxProfiler );
+    for (pu_profiler_stacks_t::const_iterator it = mapStacks.begin(); it != mapStacks.end(); ++it)
+    {
+        strLine = (const char*)(it->first[0]);
+        for (i = it->first.size() - 1; i > 0; i--)
+        {
+            pAddr = (1 == i) ? it->first[i] : (void*)((char*)it->first[i] - 1);
+            std::map<void*, std::string>::iterator itName = mapNames.find( pAddr );
+            if (itName == mapNames.end())
+            {
+                itName = mapNames.insert( std::make_pair( pAddr, pu_profiler_symbol( pAddr ) ) ).first;
+            }
+            strLine += ';';
+            strLine += itName->second;
+        }
+        if (fprintf( pFile, "%s %zu\n", strLine.c_str(), it->second ) < 0)
+        {
+            iResult = -1;
+            break;
+        }
+    }
+    pthread_mutex_unlock( &mtxProfiler );
+    return (iResult);
+}
+/* pu_profiler_dump */
+
+/**
+ * @brief   Discards the profile, and the drop count
+ */
+void pu_profiler_reset( void )
+{
+    pu_profiler_thread_t* pThread;
+
+    pu_profiler_collect();
+    pthread_mutex_lock( &mtxProfiler );
+    mapStacks.clear();
+
+    /* The live counters keep counting, start from minus their current sum (modulo 2^64) */
+    uiDroppedGone = 0;
+    for (pThread = pProfilerList; pThread; pThread = pThread->pNext)
+    {
+        uiDroppedGone -= __atomic_load_n( &(pThread->uiDropped), __ATOMIC_RELAXED );
+    }
+    pthread_mutex_unlock( &mtxProfiler );
+}
+/* pu_profiler_reset */
+
+/**
+ * @brief   Samples dropped because a ring was full
+ *
+ * @retval  The number of samples
+ */
+size_t pu_profiler_dropped( void )
+{
+    pu_profiler_thread_t* pThread;
+    size_t                uiDropped;
+
+    pthread_mutex_lock( &mtxProfiler );
+    uiDropped = uiDroppedGone;
+    for (pThread = pProfilerList; pThread; pThread = pThread->pNext)
+    {
+        uiDropped += __atomic_load_n( &(pThread->uiDropped), __ATOMIC_RELAXED );
+    }
+    pthread_mutex_unlock( &mtxProfiler );
+    return (uiDropped);
+}
+/* pu_profiler_dropped */
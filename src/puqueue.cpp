@@ -0,0 +1,304 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     puqueue.cpp
+ * @brief    C API of the bounded queue, over the templates in puqueue.h
+ */
+
+/**** Includes ***************************************************************/
+#include <stdlib.h>
+#include <errno.h>
+#include "puqueue.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+typedef pu::detail::queue_slot<void*> pu_queue_slot_t;
+
+/**** Macros ****************************************************************/
+#define PU_QUEUE_SLOTS(queue_) ((pu_queue_slot_t*)((queue_)->stConst.pSlots))
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static size_t pu_queue_enqueue( pu_queue_t* pQueue, void* const* ppItems, size_t uiCount );
+static size_t pu_queue_dequeue( pu_queue_t* pQueue, void** ppItems, size_t uiMax );
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+/* Only the SPSC type has a single producer */
+static size_t pu_queue_enqueue(
+    pu_queue_t*  pQueue,
+    void* const* ppItems,
+    size_t       uiCount )
+{
+    size_t uiDone;
+
+    if (PU_QUEUE_TYPE_SPSC == pQueue->stConst.enType)
+    {
+        uiDone = pu::detail::queue_enqueue<void*, false>(
+            &(pQueue->stEnq.uiPos), PU_QUEUE_SLOTS( pQueue ), pQueue->stConst.uiMask, ppItems, uiCount );
+    }
+    else
+    {
+        uiDone = pu::detail::queue_enqueue<void*, true>(
+            &(pQueue->stEnq.uiPos), PU_QUEUE_SLOTS( pQueue ), pQueue->stConst.uiMask, ppItems, uiCount );
+    }
+    if (uiDone > 0)
+    {
+        pu_eventcount_notify( &(pQueue->stWait.ecNotEmpty) );
+    }
+    return (uiDone);
+}
+/* pu_queue_enqueue */
+
+/* Only the MPMC type has multiple consumers */
+static size_t pu_queue_dequeue(
+    pu_queue_t* pQueue,
+    void**      ppItems,
+    size_t      uiMax )
+{
+    size_t uiDone;
+
+    if (PU_QUEUE_TYPE_MPMC == pQueue->stConst.enType)
+    {
+        uiDone = pu::detail::queue_dequeue<void*, true>(
+            &(pQueue->stDeq.uiPos), PU_QUEUE_SLOTS( pQueue ), pQueue->stConst.uiMask, ppItems, uiMax );
+    }
+    else
+    {
+        uiDone = pu::detail::queue_dequeue<void*, false>(
+            &(pQueue->stDeq.uiPos), PU_QUEUE_SLOTS( pQueue ), pQueue->stConst.uiMask, ppItems, uiMax );
+    }
+    if (uiDone > 0)
+    {
+        pu_eventcount_notify( &(pQueue->stWait.ecNotFull) );
+    }
+    return (uiDone);
+}
+/* pu_queue_dequeue */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Creates (initialises) a queue
+ *
+ * @param[in] pQueue     : Pointer to a valid queue
+ * @param[in] enType     : Producer/consumer model
+ * @param[in] uiCapacity : Number of items, rounded up to a power of two
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_queue_create(
+    pu_queue_t*   pQueue,
+    pu_queue_type enType,
+    size_t        uiCapacity )
+{
+    pu_queue_slot_t* pSlots  = nullptr;
+    size_t           uiSize;
+    int              iResult = -1;
+
+    /* pre-condition */
+    ASSERT( pQueue );
+    ASSERT( (enType >= PU_QUEUE_TYPE_MPMC) && (enType < PU_QUEUE_TYPE_ENDDEF) );
+    if ((pQueue)                         &&
+        (enType >= PU_QUEUE_TYPE_MPMC)   &&
+        (enType < PU_QUEUE_TYPE_ENDDEF)  &&
+        (uiCapacity <= ((size_t)1 << 30)) )
+    {
+        uiSize  = pu::detail::queue_capacity( uiCapacity );
+        iResult = posix_memalign( (void**)&pSlots, PU_CACHELINE_SIZE, uiSize * sizeof(pu_queue_slot_t) );
+        ASSERT( 0 == iResult );
+        if (0 == iResult)
+        {
+            for (size_t i = 0; i < uiSize; i++)
+            {
+                pSlots[i].uiSeq = i;
+                pSlots[i].value = nullptr;
+            }
+            pQueue->stConst.pSlots = pSlots;
+            pQueue->stConst.uiMask = uiSize - 1;
+            pQueue->stConst.enType = enType;
+            pQueue->stEnq.uiPos    = 0;
+            pQueue->stDeq.uiPos    = 0;
+            pu_eventcount_create( &(pQueue->stWait.ecNotEmpty) );
+            pu_eventcount_create( &(pQueue->stWait.ecNotFull) );
+        }
+    }
+
+    /* post-condition */
+    ASSERT( 0 == iResult );
+    return (iResult);
+}
+/* pu_queue_create */
+
+/**
+ * @brief   Destroys a queue
+ *
+ * @param[in] pQueue : Pointer to a valid queue
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_queue_destroy( pu_queue_t* pQueue )
+{
+    ASSERT( pQueue );
+    if ((!pQueue) || (!pQueue->stConst.pSlots))
+    {
+        return (-1);
+    }
+    free( pQueue->stConst.pSlots );
+    pQueue->stConst.pSlots = nullptr;
+    return (0);
+}
+/* pu_queue_destroy */
+
+/**
+ * @brief   Adds an item, never blocks
+ *
+ * @param[in] pQueue : Pointer to a valid queue
+ * @param[in] pItem  : Item
+ * @retval  0 for success
+ * @retval  EAGAIN the queue is full
+ */
+int pu_queue_push(
+    pu_queue_t* pQueue,
+    void*       pItem )
+{
+    ASSERT( pQueue );
+    return ((1 == pu_queue_enqueue( pQueue, &pItem, 1 )) ? 0 : EAGAIN);
+}
+/* pu_queue_push */
+
+/**
+ * @brief   Removes the oldest item, never blocks
+ *
+ * @param[in]  pQueue : Pointer to a valid queue
+ * @param[out] ppItem : Item
+ * @retval  0 for success
+ * @retval  EAGAIN the queue is empty
+ */
+int pu_queue_pop(
+    pu_queue_t* pQueue,
+    void**      ppItem )
+{
+    ASSERT( pQueue );
+    ASSERT( ppItem );
+    return ((1 == pu_queue_dequeue( pQueue, ppItem, 1 )) ? 0 : EAGAIN);
+}
+/* pu_queue_pop */
+
+/**
+ * @brief   Adds as many items from an array as fit, never blocks
+ *
+ * @param[in] pQueue  : Pointer to a valid queue
+ * @param[in] ppItems : Items
+ * @param[in] uiCount : Number of items
+ * @retval  The number added
+ */
+size_t pu_queue_push_batch(
+    pu_queue_t*  pQueue,
+    void* const* ppItems,
+    size_t       uiCount )
+{
+    ASSERT( pQueue );
+    ASSERT( ppItems || (0 == uiCount) );
+    return (pu_queue_enqueue( pQueue, ppItems, uiCount ));
+}
+/* pu_queue_push_batch */
+
+/**
+ * @brief   Removes up to uiMax items, never blocks
+ *
+ * @param[in]  pQueue  : Pointer to a valid queue
+ * @param[out] ppItems : Items, oldest first
+ * @param[in]  uiMax   : Array size
+ * @retval  The number removed
+ */
+size_t pu_queue_pop_batch(
+    pu_queue_t* pQueue,
+    void**      ppItems,
+    size_t      uiMax )
+{
+    ASSERT( pQueue );
+    ASSERT( ppItems || (0 == uiMax) );
+    return (pu_queue_dequeue( pQueue, ppItems, uiMax ));
+}
+/* pu_queue_pop_batch */
+
+/**
+ * @brief   Adds an item, waiting for room if the queue is full
+ *
+ * @param[in] pQueue      : Pointer to a valid queue
+ * @param[in] pItem       : Item
+ * @param[in] uiTimeoutMs : Timeout in ms, or PU_FUTEX_WAIT_FOREVER
+ * @retval  0 for success
+ * @retval  ETIMEDOUT the timeout expired
+ */
+int pu_queue_push_wait(
+    pu_queue_t* pQueue,
+    void*       pItem,
+    size_t      uiTimeoutMs )
+{
+    ASSERT( pQueue );
+    return (pu::detail::queue_wait( &(pQueue->stWait.ecNotFull), uiTimeoutMs,
+                [&]() { return (1 == pu_queue_enqueue( pQueue, &pItem, 1 )); } ) ? 0 : ETIMEDOUT);
+}
+/* pu_queue_push_wait */
+
+/**
+ * @brief   Removes the oldest item, waiting for one if the queue is empty
+ *
+ * @param[in]  pQueue      : Pointer to a valid queue
+ * @param[out] ppItem      : Item
+ * @param[in]  uiTimeoutMs : Timeout in ms, or PU_FUTEX_WAIT_FOREVER
+ * @retval  0 for success
+ * @retval  ETIMEDOUT the timeout expired
+ */
+int pu_queue_pop_wait(
+    pu_queue_t* pQueue,
+    void**      ppItem,
+    size_t      uiTimeoutMs )
+{
+    ASSERT( pQueue );
+    ASSERT( ppItem );
+    return (pu::detail::queue_wait( &(pQueue->stWait.ecNotEmpty), uiTimeoutMs,
+                [&]() { return (1 == pu_queue_dequeue( pQueue, ppItem, 1 )); } ) ? 0 : ETIMEDOUT);
+}
+/* pu_queue_pop_wait */
+
+/**
+ * @brief   Approximate number of items in the queue
+ *
+ * @param[in] pQueue : Pointer to a valid queue
+ * @retval  The number of items, a snapshot
+ */
+size_t pu_queue_size( const pu_queue_t* pQueue )
+{
+    size_t uiDeq;
+    size_t uiEnq;
+
+    ASSERT( pQueue );
+    uiDeq = __atomic_load_n( &(pQueue->stDeq.uiPos), __ATOMIC_RELAXED );
+    uiEnq = __atomic_load_n( &(pQueue->stEnq.uiPos), __ATOMIC_RELAXED );
+    return ((uiEnq > uiDeq) ? (uiEnq - uiDeq) : 0);
+}
+/* pu_queue_size */
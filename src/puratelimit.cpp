@@ -0,0 +1,441 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     puratelimit.cpp
+ * @brief    Implementation of the token bucket rate limiter
+ */
+
+/**** Includes ***************************************************************/
+#include <stdlib.h>
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include "puratelimit.h"
+#include "putimer.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+#define PU_RATELIMIT_NS_PER_SEC (1000000000ULL)
+
+/**** Macros ****************************************************************/
+
+/**** Static declarations ***************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static bool pu_ratelimit_refill( pu_ratelimit_t* pLimit );
+static void pu_ratelimit_credit( pu_ratelimit_t* pLimit, int64_t iAdd );
+static void pu_ratelimit_sleep_until( uint64_t ulWakeNs );
+static pu_ratelimit_t* pu_ratelimit_local( pu_ratelimit_sharded_t* pSharded, unsigned int* puiIndex );
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+/* Credits the time since the last top up. Returns false when there was nothing to credit. */
+static bool pu_ratelimit_refill( pu_ratelimit_t* pLimit )
+{
+    uint64_t ulNow  = timespec_now_ns_monotonic();
+    uint64_t ulLast = __atomic_load_n( &(pLimit->ulLastNs), __ATOMIC_ACQUIRE );
+    uint64_t ulCredit;
+    uint64_t ulNewLast;
+    int64_t  iRoom;
+    int64_t  iAdd;
+
+    if (ulNow <= ulLast)
+    {
+        return (false);
+    }
+    ulCredit = (ulNow - ulLast) / pLimit->ulNsPerToken;
+    if (0 == ulCredit)
+    {
+        return (false);
+    }
+
+    /* Someone else topped it up already, try again */
+    iRoom = pLimit->iBurst - __atomic_load_n( &(pLimit->iTokens), __ATOMIC_RELAXED );
+    if (iRoom <= 0)
+    {
+        return (true);
+    }
+
+    /* A full bucket drops the rest of the credit, a partial one keeps the fraction of a token */
+    if (ulCredit >= (uint64_t)iRoom)
+    {
+        iAdd      = iRoom;
+        ulNewLast = ulNow;
+    }
+    else
+    {
+        iAdd      = (int64_t)ulCredit;
+        ulNewLast = ulLast + ulCredit * pLimit->ulNsPerToken;
+    }
+    if (__atomic_compare_exchange_n( &(pLimit->ulLastNs), &ulLast, ulNewLast, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ))
+    {
+        pu_ratelimit_credit( pLimit, iAdd );
+    }
+    return (true);
+}
+/* pu_ratelimit_refill */
+
+/* Adds tokens, never above the bucket size. The count may be low while takers back out,
+ * so both the refill and the give back are capped, or the bucket ends up above iBurst. */
+static void pu_ratelimit_credit(
+    pu_ratelimit_t* pLimit,
+    int64_t         iAdd )
+{
+    int64_t iOld = __atomic_load_n( &(pLimit->iTokens), __ATOMIC_RELAXED );
+    int64_t iNew;
+
+    do
+    {
+        iNew = (iOld + iAdd > pLimit->iBurst) ? pLimit->iBurst : (iOld + iAdd);
+        if (iNew <= iOld)
+        {
+            return;
+        }
+    } while (!__atomic_compare_exchange_n( &(pLimit->iTokens), &iOld, iNew, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED ));
+}
+/* pu_ratelimit_credit */
+
+static void pu_ratelimit_sleep_until( uint64_t ulWakeNs )
+{
+    struct timespec tsWake;
+
+    tsWake.tv_sec  = (time_t)(ulWakeNs / PU_RATELIMIT_NS_PER_SEC);
+    tsWake.tv_nsec = (long)(ulWakeNs % PU_RATELIMIT_NS_PER_SEC);
+    while (EINTR == clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &tsWake, nullptr ))
+    {
+    }
+}
+/* pu_ratelimit_sleep_until */
+
+/* sched_getcpu is a vDSO call, or a read of the rseq area, it does not enter the kernel */
+static pu_ratelimit_t* pu_ratelimit_local(
+    pu_ratelimit_sharded_t* pSharded,
+    unsigned int*           puiIndex )
+{
+    int iCpu = sched_getcpu();
+
+    *puiIndex = (iCpu < 0) ? 0 : ((unsigned int)iCpu % pSharded->uiShards);
+    return (&(pSharded->pShards[*puiIndex]));
+}
+/* pu_ratelimit_local */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Initialises a full bucket
+ *
+ * @param[in] pLimit  : Pointer to a valid bucket
+ * @param[in] uiRate  : Tokens per second
+ * @param[in] uiBurst : Bucket size
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_ratelimit_init(
+    pu_ratelimit_t* pLimit,
+    size_t          uiRate,
+    size_t          uiBurst )
+{
+    /* pre-condition */
+    ASSERT( pLimit );
+    ASSERT( (uiRate > 0) && (uiRate <= PU_RATELIMIT_NS_PER_SEC) );
+    ASSERT( uiBurst > 0 );
+    if ((!pLimit) || (0 == uiRate) || (uiRate > PU_RATELIMIT_NS_PER_SEC) || (0 == uiBurst))
+    {
+        return (-1);
+    }
+
+    pLimit->ulNsPerToken = PU_RATELIMIT_NS_PER_SEC / uiRate;
+    pLimit->iBurst       = (int64_t)uiBurst;
+    pLimit->ulLastNs     = timespec_now_ns_monotonic();
+    __atomic_store_n( &(pLimit->iTokens), (int64_t)uiBurst, __ATOMIC_RELEASE );
+    return (0);
+}
+/* pu_ratelimit_init */
+
+/**
+ * @brief   Takes tokens if there are enough, never waits
+ *
+ * @param[in] pLimit   : Pointer to a valid bucket
+ * @param[in] uiTokens : Tokens to take
+ * @retval  0 for success
+ * @retval  EAGAIN not enough tokens
+ * @retval  EINVAL more tokens than the bucket holds
+ *
+ * @par Description
+ * The fast path is the subtraction. The clock is only read to top the bucket up, or when the
+ * bucket was full, to restart the refill clock.
+ */
+int pu_ratelimit_try_acquire(
+    pu_ratelimit_t* pLimit,
+    size_t          uiTokens )
+{
+    int64_t iWant = (int64_t)uiTokens;
+    int64_t iOld;
+
+    ASSERT( pLimit );
+    if ((!pLimit) || (iWant > pLimit->iBurst))
+    {
+        return (EINVAL);
+    }
+
+    for (;;)
+    {
+        iOld = __atomic_fetch_sub( &(pLimit->iTokens), iWant, __ATOMIC_ACQUIRE );
+        if (iOld >= iWant)
+        {
+            if (iOld >= pLimit->iBurst)
+            {
+                __atomic_store_n( &(pLimit->ulLastNs), timespec_now_ns_monotonic(), __ATOMIC_RELEASE );
+            }
+            return (0);
+        }
+        pu_ratelimit_credit( pLimit, iWant );
+        if (!pu_ratelimit_refill( pLimit ))
+        {
+            return (EAGAIN);
+        }
+    }
+}
+/* pu_ratelimit_try_acquire */
+
+/**
+ * @brief   Takes tokens, waiting at most the timeout for them
+ *
+ * @param[in] pLimit      : Pointer to a valid bucket
+ * @param[in] uiTokens    : Tokens to take
+ * @param[in] uiTimeoutMs : Timeout in ms, or PU_RATELIMIT_WAIT_FOREVER
+ * @retval  0 for success
+ * @retval  ETIMEDOUT the timeout expired
+ * @retval  EINVAL more tokens than the bucket holds
+ */
+int pu_ratelimit_acquire(
+    pu_ratelimit_t* pLimit,
+    size_t          uiTokens,
+    size_t          uiTimeoutMs )
+{
+    uint64_t ulDeadline = UINT64_MAX;
+    uint64_t ulNow;
+    uint64_t ulDue;
+    int64_t  iHave;
+    int      iResult;
+
+    if (PU_RATELIMIT_WAIT_FOREVER != uiTimeoutMs)
+    {
+        ulDeadline = timespec_now_ns_monotonic() + (uint64_t)uiTimeoutMs * 1000000ULL;
+    }
+    for (;;)
+    {
+        iResult = pu_ratelimit_try_acquire( pLimit, uiTokens );
+        if (EAGAIN != iResult)
+        {
+            return (iResult);
+        }
+        ulNow = timespec_now_ns_monotonic();
+        if (ulNow >= ulDeadline)
+        {
+            return (ETIMEDOUT);
+        }
+
+        /* When the missing tokens are due. If they already are, somebody else took them. */
+        iHave = __atomic_load_n( &(pLimit->iTokens), __ATOMIC_RELAXED );
+        iHave = (iHave < 0) ? 0 : iHave;
+        ulDue = __atomic_load_n( &(pLimit->ulLastNs), __ATOMIC_RELAXED ) +
+                (uint64_t)((int64_t)uiTokens - iHave) * pLimit->ulNsPerToken;
+        if (ulDue <= ulNow)
+        {
+            ulDue = ulNow + pLimit->ulNsPerToken;
+        }
+        pu_ratelimit_sleep_until( (ulDue < ulDeadline) ? ulDue : ulDeadline );
+    }
+}
+/* pu_ratelimit_acquire */
+
+/**
+ * @brief   Tokens available now
+ *
+ * @param[in] pLimit : Pointer to a valid bucket
+ * @retval  The number of tokens
+ */
+size_t pu_ratelimit_available( pu_ratelimit_t* pLimit )
+{
+    int64_t iTokens;
+
+    ASSERT( pLimit );
+    if (!pLimit)
+    {
+        return (0);
+    }
+    pu_ratelimit_refill( pLimit );
+    iTokens = __atomic_load_n( &(pLimit->iTokens), __ATOMIC_ACQUIRE );
+    return ((iTokens < 0) ? 0 : (size_t)iTokens);
+}
+/* pu_ratelimit_available */
+
+/**
+ * @brief   Creates per-CPU buckets sharing a rate
+ *
+ * @param[in] pSharded : Pointer to a valid sharded limiter
+ * @param[in] uiRate   : Tokens per second, in total
+ * @param[in] uiBurst  : Bucket size, in total
+ * @param[in] uiShards : Number of buckets, 0 for one per configured CPU. At most uiRate and uiBurst.
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_ratelimit_sharded_create(
+    pu_ratelimit_sharded_t* pSharded,
+    size_t                  uiRate,
+    size_t                  uiBurst,
+    unsigned int            uiShards )
+{
+    void*        pMem = nullptr;
+    long         lCpus;
+    unsigned int i;
+
+    /* pre-condition */
+    ASSERT( pSharded );
+    ASSERT( uiRate > 0 );
+    ASSERT( uiBurst > 0 );
+    if ((!pSharded) || (0 == uiRate) || (0 == uiBurst))
+    {
+        return (-1);
+    }
+
+    if (0 == uiShards)
+    {
+        lCpus    = sysconf( _SC_NPROCESSORS_CONF );
+        uiShards = (lCpus > 0) ? (unsigned int)lCpus : 1;
+    }
+
+    /* Every bucket needs at least one token of rate and of burst, or the total goes above the limit */
+    if (uiShards > uiRate)
+    {
+        uiShards = (unsigned int)uiRate;
+    }
+    if (uiShards > uiBurst)
+    {
+        uiShards = (unsigned int)uiBurst;
+    }
+    if (0 != posix_memalign( &pMem, PU_CACHELINE_SIZE, uiShards * sizeof(pu_ratelimit_t) ))
+    {
+        LOG_ERROR( "PU_RATELIMIT(create): no memory for %u buckets\n", uiShards );
+        return (-1);
+    }
+    pSharded->pShards  = (pu_ratelimit_t*)pMem;
+    pSharded->uiShards = uiShards;
+    /* The remainders go to the first buckets, so the buckets add up to the rate and the burst */
+    for (i = 0; i < uiShards; i++)
+    {
+        if (0 != pu_ratelimit_init( &(pSharded->pShards[i]),
+                                    (uiRate  / uiShards) + ((i < (uiRate  % uiShards)) ? 1 : 0),
+                                    (uiBurst / uiShards) + ((i < (uiBurst % uiShards)) ? 1 : 0) ))
+        {
+            free( pMem );
+            pSharded->pShards = nullptr;
+            return (-1);
+        }
+    }
+    return (0);
+}
+/* pu_ratelimit_sharded_create */
+
+/**
+ * @brief   Frees the buckets
+ *
+ * @param[in] pSharded : Pointer to a valid sharded limiter
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_ratelimit_sharded_destroy( pu_ratelimit_sharded_t* pSharded )
+{
+    ASSERT( pSharded );
+    if (!pSharded)
+    {
+        return (-1);
+    }
+    free( pSharded->pShards );
+    pSharded->pShards  = nullptr;
+    pSharded->uiShards = 0;
+    return (0);
+}
+/* pu_ratelimit_sharded_destroy */
+
+/**
+ * @brief   Takes tokens from the bucket of the calling CPU, or from another one, never waits
+ *
+ * @param[in] pSharded : Pointer to a valid sharded limiter
+ * @param[in] uiTokens : Tokens to take
+ * @retval  0 for success
+ * @retval  EAGAIN not enough tokens in any bucket
+ * @retval  EINVAL more tokens than a bucket holds
+ */
+int pu_ratelimit_sharded_try_acquire(
+    pu_ratelimit_sharded_t* pSharded,
+    size_t                  uiTokens )
+{
+    unsigned int uiLocal;
+    unsigned int i;
+    int          iResult;
+
+    ASSERT( pSharded );
+    if ((!pSharded) || (!pSharded->pShards))
+    {
+        return (EINVAL);
+    }
+    iResult = pu_ratelimit_try_acquire( pu_ratelimit_local( pSharded, &uiLocal ), uiTokens );
+    for (i = 1; (EAGAIN == iResult) && (i < pSharded->uiShards); i++)
+    {
+        iResult = pu_ratelimit_try_acquire( &(pSharded->pShards[(uiLocal + i) % pSharded->uiShards]), uiTokens );
+    }
+    return (iResult);
+}
+/* pu_ratelimit_sharded_try_acquire */
+
+/**
+ * @brief   Takes tokens from the bucket of the calling CPU, waiting at most the timeout
+ *
+ * @param[in] pSharded    : Pointer to a valid sharded limiter
+ * @param[in] uiTokens    : Tokens to take
+ * @param[in] uiTimeoutMs : Timeout in ms, or PU_RATELIMIT_WAIT_FOREVER
+ * @retval  0 for success
+ * @retval  ETIMEDOUT the timeout expired
+ * @retval  EINVAL more tokens than a bucket holds
+ */
+int pu_ratelimit_sharded_acquire(
+    pu_ratelimit_sharded_t* pSharded,
+    size_t                  uiTokens,
+    size_t                  uiTimeoutMs )
+{
+    unsigned int uiLocal;
+    int          iResult;
+
+    iResult = pu_ratelimit_sharded_try_acquire( pSharded, uiTokens );
+    if (EAGAIN != iResult)
+    {
+        return (iResult);
+    }
+    return (pu_ratelimit_acquire( pu_ratelimit_local( pSharded, &uiLocal ), uiTokens, uiTimeoutMs ));
+}
+/* pu_ratelimit_sharded_acquire */
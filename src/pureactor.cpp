@@ -0,0 +1,973 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     pureactor.cpp
+ * @brief    Implementation of the I/O reactor, io_uring through the raw system calls, and epoll
+ */
+
+/**** Includes ***************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "pureactor.h"
+#include "putimer.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+
+/* user_data tags. Operations are pointer aligned, the low bits are free. */
+#define PU_REACTOR_TAG_WAKE  ((uint64_t)0)    /* Eventfd read                     */
+#define PU_REACTOR_TAG_LINK  ((uint64_t)1)    /* Linked timeout, ORed with the op */
+
+#define PU_REACTOR_STACK     (64*1024)
+#define PU_REACTOR_EVENTS    (64)
+
+/* The ring, as mapped from the kernel */
+typedef struct pu_reactor_ring_tag
+{
+    int                  iFd;
+    void*                pSqMap;
+    size_t               uiSqMapSize;
+    void*                pCqMap;
+    size_t               uiCqMapSize;
+    struct io_uring_sqe* pSqes;
+    size_t               uiSqesSize;
+    unsigned int*        puiSqHead;
+    unsigned int*        puiSqTail;
+    unsigned int*        puiSqArray;
+    unsigned int         uiSqMask;
+    unsigned int         uiSqEntries;
+    unsigned int*        puiCqHead;
+    unsigned int*        puiCqTail;
+    struct io_uring_cqe* pCqes;
+    unsigned int         uiCqMask;
+}   pu_reactor_ring_t;
+
+struct pu_reactor_tag
+{
+    pu_reactor_backend_t enBackend;
+    pthread_t            tidThread;
+    int                  iEventFd;     /* Wakes the reactor thread          */
+    int                  bStop;
+    pu_reactor_op_t*     pIncoming;    /* Submitted, newest first           */
+    pu_reactor_op_t*     pBacklog;     /* Taken, waiting for SQ space       */
+    pu_reactor_op_t*     pBacklogTail;
+    int*                 piFiles;      /* Registered files, epoll mapping   */
+    unsigned int         uiFiles;
+    uint64_t             ulWakeValue;  /* Eventfd read buffer               */
+    int                  bWakeArmed;   /* Eventfd read in the ring          */
+    pu_reactor_ring_t    stRing;       /* io_uring                          */
+    int                  iEpollFd;     /* epoll                             */
+    pu_reactor_op_t*     pTmoHead;     /* epoll deadlines, earliest first   */
+};
+
+/**** Macros ****************************************************************/
+
+/**** Static declarations ***************************************************/
+static thread_local pu_reactor_t pSelf = nullptr;
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static void  pu_reactor_wake( pu_reactor_t pReactor );
+static void  pu_reactor_take( pu_reactor_t pReactor );
+static void  pu_reactor_complete( pu_reactor_op_t* pOp, int iResult );
+static int   pu_uring_setup( pu_reactor_t pReactor, const pu_reactor_config_t* pConfig );
+static void  pu_uring_teardown( pu_reactor_ring_t* pRing );
+static struct io_uring_sqe* pu_uring_get_sqe( pu_reactor_ring_t* pRing );
+static bool  pu_uring_prep( pu_reactor_t pReactor, pu_reactor_op_t* pOp );
+static void  pu_uring_reap( pu_reactor_t pReactor );
+static void  pu_uring_loop( pu_reactor_t pReactor );
+static int   pu_epoll_setup( pu_reactor_t pReactor );
+static void  pu_epoll_tmo_link( pu_reactor_t pReactor, pu_reactor_op_t* pOp );
+static void  pu_epoll_tmo_unlink( pu_reactor_t pReactor, pu_reactor_op_t* pOp );
+static int   pu_epoll_perform( pu_reactor_t pReactor, pu_reactor_op_t* pOp, uint32_t uiReady );
+static void  pu_epoll_start( pu_reactor_t pReactor, pu_reactor_op_t* pOp );
+static void  pu_epoll_loop( pu_reactor_t pReactor );
+static void* pu_reactor_thread( void* pArg );
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+static void pu_reactor_wake( pu_reactor_t pReactor )
+{
+    uint64_t ulOne = 1;
+    ssize_t  iRet;
+
+    iRet = write( pReactor->iEventFd, &ulOne, sizeof(ulOne) );
+    (void)iRet;
+}
+/* pu_reactor_wake */
+
+/* Moves the submitted operations to the end of the backlog, in submission order */
+static void pu_reactor_take( pu_reactor_t pReactor )
+{
+    pu_reactor_op_t* pOp;
+    pu_reactor_op_t* pNext;
+    pu_reactor_op_t* pOrdered = nullptr;
+    pu_reactor_op_t* pLast;
+
+    pOp = __atomic_exchange_n( &(pReactor->pIncoming), nullptr, __ATOMIC_ACQUIRE );
+    if (!pOp)
+    {
+        return;
+    }
+    pLast = pOp;
+    while (pOp)
+    {
+        pNext       = pOp->pNext;
+        pOp->pNext  = pOrdered;
+        pOrdered    = pOp;
+        pOp         = pNext;
+    }
+    if (pReactor->pBacklogTail)
+    {
+        pReactor->pBacklogTail->pNext = pOrdered;
+    }
+    else
+    {
+        pReactor->pBacklog = pOrdered;
+    }
+    pReactor->pBacklogTail = pLast;
+}
+/* pu_reactor_take */
+
+static void pu_reactor_complete(
+    pu_reactor_op_t* pOp,
+    int              iResult )
+{
+    pOp->fctDone( pOp, iResult );
+}
+/* pu_reactor_complete */
+
+//=============================================================================
+// io_uring, without liburing: the rings are mapped and driven directly
+//=============================================================================
+
+static int pu_uring_setup(
+    pu_reactor_t               pReactor,
+    const pu_reactor_config_t* pConfig )
+{
+    struct io_uring_params stParams;
+    pu_reactor_ring_t*     pRing = &(pReactor->stRing);
+    unsigned int           uiDepth;
+    char*                  pSq;
+    char*                  pCq;
+
+    uiDepth = (pConfig && pConfig->uiDepth) ? pConfig->uiDepth : PU_REACTOR_DEPTH;
+    memset( &stParams, 0, sizeof(stParams) );
+    stParams.flags      = IORING_SETUP_CQSIZE;
+    stParams.cq_entries = 2 * uiDepth;
+    pRing->iFd = (int)syscall( __NR_io_uring_setup, uiDepth, &stParams );
+    if (pRing->iFd < 0)
+    {
+        return (-1);
+    }
+
+    /* Read and write at the current position came with 5.6, as did most of what is used here */
+    if ((0 == (stParams.features & IORING_FEAT_SINGLE_MMAP)) ||
+        (0 == (stParams.features & IORING_FEAT_NODROP)) ||
+        (0 == (stParams.features & IORING_FEAT_RW_CUR_POS)))
+    {
+        close( pRing->iFd );
+        return (-1);
+    }
+
+    pRing->uiSqMapSize = stParams.sq_off.array + stParams.sq_entries * sizeof(unsigned int);
+    pRing->uiCqMapSize = stParams.cq_off.cqes + stParams.cq_entries * sizeof(struct io_uring_cqe);
+    if (pRing->uiCqMapSize > pRing->uiSqMapSize)
+    {
+        pRing->uiSqMapSize = pRing->uiCqMapSize;
+    }
+    pRing->pSqMap = mmap( nullptr, pRing->uiSqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          pRing->iFd, IORING_OFF_SQ_RING );
+    if (MAP_FAILED == pRing->pSqMap)
+    {
+        close( pRing->iFd );
+        return (-1);
+    }
+    pRing->pCqMap      = pRing->pSqMap;
+    pRing->uiCqMapSize = 0;
+    pRing->uiSqesSize  = stParams.sq_entries * sizeof(struct io_uring_sqe);
+    pRing->pSqes = (struct io_uring_sqe*)mmap( nullptr, pRing->uiSqesSize, PROT_READ | PROT_WRITE,
+                                               MAP_SHARED | MAP_POPULATE, pRing->iFd, IORING_OFF_SQES );
+    if (MAP_FAILED == (void*)pRing->pSqes)
+    {
+        munmap( pRing->pSqMap, pRing->uiSqMapSize );
+        close( pRing->iFd );
+        return (-1);
+    }
+
+    pSq = (char*)pRing->pSqMap;
+    pCq = (char*)pRing->pCqMap;
+    pRing->puiSqHead   = (unsigned int*)(void*)(pSq + stParams.sq_off.head);
+    pRing->puiSqTail   = (unsigned int*)(void*)(pSq + stParams.sq_off.tail);
+    pRing->puiSqArray  = (unsigned int*)(void*)(pSq + stParams.sq_off.array);
+    pRing->uiSqMask    = *(unsigned int*)(void*)(pSq + stParams.sq_off.ring_mask);
+    pRing->uiSqEntries = stParams.sq_entries;
+    pRing->puiCqHead   = (unsigned int*)(void*)(pCq + stParams.cq_off.head);
+    pRing->puiCqTail   = (unsigned int*)(void*)(pCq + stParams.cq_off.tail);
+    pRing->pCqes       = (struct io_uring_cqe*)(void*)(pCq + stParams.cq_off.cqes);
+    pRing->uiCqMask    = *(unsigned int*)(void*)(pCq + stParams.cq_off.ring_mask);
+
+    /* Registration happens once, before the reactor thread is running */
+    if ((pConfig) && (pConfig->uiFiles) &&
+        (0 != syscall( __NR_io_uring_register, pRing->iFd, IORING_REGISTER_FILES, pConfig->piFiles, pConfig->uiFiles )))
+    {
+        LOG_ERROR( "PU_REACTOR(uring): registering %u files failed, errno=%d\n", pConfig->uiFiles, errno );
+        pu_uring_teardown( pRing );
+        return (-1);
+    }
+    if ((pConfig) && (pConfig->uiBuffers) &&
+        (0 != syscall( __NR_io_uring_register, pRing->iFd, IORING_REGISTER_BUFFERS, pConfig->pBuffers, pConfig->uiBuffers )))
+    {
+        LOG_ERROR( "PU_REACTOR(uring): registering %u buffers failed, errno=%d\n", pConfig->uiBuffers, errno );
+        pu_uring_teardown( pRing );
+        return (-1);
+    }
+    return (0);
+}
+/* pu_uring_setup */
+
+static void pu_uring_teardown( pu_reactor_ring_t* pRing )
+{
+    munmap( pRing->pSqes, pRing->uiSqesSize );
+    munmap( pRing->pSqMap, pRing->uiSqMapSize );
+    close( pRing->iFd );
+}
+/* pu_uring_teardown */
+
+/* Returns a zeroed entry, queued but not yet submitted. NULL if the SQ is full.
+ * Without SQPOLL the kernel only reads the ring in io_uring_enter, from this same thread,
+ * so the entry may be filled in after the tail has moved.
+ */
+static struct io_uring_sqe* pu_uring_get_sqe( pu_reactor_ring_t* pRing )
+{
+    unsigned int         uiHead = __atomic_load_n( pRing->puiSqHead, __ATOMIC_ACQUIRE );
+    unsigned int         uiTail = *(pRing->puiSqTail);
+    unsigned int         uiIdx;
+    struct io_uring_sqe* pSqe;
+
+    if (uiTail - uiHead >= pRing->uiSqEntries)
+    {
+        return (nullptr);
+    }
+    uiIdx = uiTail & pRing->uiSqMask;
+    pSqe  = &(pRing->pSqes[uiIdx]);
+    memset( pSqe, 0, sizeof(*pSqe) );
+    pRing->puiSqArray[uiIdx] = uiIdx;
+    __atomic_store_n( pRing->puiSqTail, uiTail + 1, __ATOMIC_RELEASE );
+    return (pSqe);
+}
+/* pu_uring_get_sqe */
+
+/* Queues an operation, and its linked timeout. False if the SQ has no room for it. */
+static bool pu_uring_prep(
+    pu_reactor_t     pReactor,
+    pu_reactor_op_t* pOp )
+{
+    pu_reactor_ring_t*   pRing = &(pReactor->stRing);
+    struct io_uring_sqe* pSqe;
+    unsigned int         uiNeeded;
+    unsigned int         uiUsed;
+
+    uiNeeded = ((PU_REACTOR_OP_TIMEOUT != pOp->enOpcode) && (pOp->uiTimeoutMs)) ? 2 : 1;
+    uiUsed   = *(pRing->puiSqTail) - __atomic_load_n( pRing->puiSqHead, __ATOMIC_ACQUIRE );
+    if (uiUsed + uiNeeded > pRing->uiSqEntries)
+    {
+        return (false);
+    }
+
+    pOp->pTmo[0] = (int64_t)(pOp->uiTimeoutMs / 1000);
+    pOp->pTmo[1] = (int64_t)(pOp->uiTimeoutMs % 1000) * 1000000;
+    pSqe = pu_uring_get_sqe( pRing );
+    pSqe->user_data = (uint64_t)(uintptr_t)pOp;
+    pSqe->fd        = pOp->iFd;
+    if (pOp->uiFlags & PU_REACTOR_FLAG_FIXED_FILE)
+    {
+        pSqe->flags |= IOSQE_FIXED_FILE;
+    }
+    switch (pOp->enOpcode)
+    {
+        case PU_REACTOR_OP_READ:
+        case PU_REACTOR_OP_WRITE:
+            if (pOp->uiFlags & PU_REACTOR_FLAG_FIXED_BUF)
+            {
+                pSqe->opcode    = (PU_REACTOR_OP_READ == pOp->enOpcode) ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+                pSqe->buf_index = (uint16_t)pOp->uiBufIndex;
+            }
+            else
+            {
+                pSqe->opcode    = (PU_REACTOR_OP_READ == pOp->enOpcode) ? IORING_OP_READ : IORING_OP_WRITE;
+            }
+            pSqe->addr = (uint64_t)(uintptr_t)pOp->pBuf;
+            pSqe->len  = (uint32_t)pOp->uiLen;
+            pSqe->off  = pOp->ulOffset;
+            break;
+        case PU_REACTOR_OP_POLL:
+            pSqe->opcode        = IORING_OP_POLL_ADD;
+            pSqe->poll32_events = pOp->uiEvents;
+            break;
+        case PU_REACTOR_OP_TIMEOUT:
+        default:
+            pSqe->opcode = IORING_OP_TIMEOUT;
+            pSqe->fd     = -1;
+            pSqe->flags  = 0;
+            pSqe->addr   = (uint64_t)(uintptr_t)pOp->pTmo;
+            pSqe->len    = 1;
+            break;
+    }
+
+    /* The kernel copies the timespec when the entry is consumed, the op field only has to last until then */
+    if (2 == uiNeeded)
+    {
+        pSqe->flags |= IOSQE_IO_LINK;
+        pSqe = pu_uring_get_sqe( pRing );
+        pSqe->opcode    = IORING_OP_LINK_TIMEOUT;
+        pSqe->fd        = -1;
+        pSqe->addr      = (uint64_t)(uintptr_t)pOp->pTmo;
+        pSqe->len       = 1;
+        pSqe->user_data = (uint64_t)(uintptr_t)pOp | PU_REACTOR_TAG_LINK;
+    }
+    return (true);
+}
+/* pu_uring_prep */
+
+static void pu_uring_reap( pu_reactor_t pReactor )
+{
+    pu_reactor_ring_t*   pRing  = &(pReactor->stRing);
+    unsigned int         uiHead = *(pRing->puiCqHead);
+    unsigned int         uiTail = __atomic_load_n( pRing->puiCqTail, __ATOMIC_ACQUIRE );
+    struct io_uring_cqe* pCqe;
+    pu_reactor_op_t*     pOp;
+    uint64_t             ulData;
+    int                  iResult;
+
+    while (uiHead != uiTail)
+    {
+        pCqe    = &(pRing->pCqes[uiHead & pRing->uiCqMask]);
+        ulData  = pCqe->user_data;
+        iResult = pCqe->res;
+        uiHead++;
+
+        /* Free the slot before the callback, which may submit more */
+        __atomic_store_n( pRing->puiCqHead, uiHead, __ATOMIC_RELEASE );
+        if (PU_REACTOR_TAG_WAKE == ulData)
+        {
+            pReactor->bWakeArmed = 0;
+        }
+        else if (0 == (ulData & PU_REACTOR_TAG_LINK))
+        {
+            pOp = (pu_reactor_op_t*)(uintptr_t)ulData;
+            if (PU_REACTOR_OP_TIMEOUT == pOp->enOpcode)
+            {
+                iResult = (-ETIME == iResult) ? 0 : iResult;
+            }
+            else if ((pOp->uiTimeoutMs) && (-ECANCELED == iResult))
+            {
+                iResult = -ETIMEDOUT;
+            }
+            pu_reactor_complete( pOp, iResult );
+        }
+        uiTail = __atomic_load_n( pRing->puiCqTail, __ATOMIC_ACQUIRE );
+    }
+}
+/* pu_uring_reap */
+
+/* One system call per turn: submit everything gathered, and wait for at least one completion */
+static void pu_uring_loop( pu_reactor_t pReactor )
+{
+    pu_reactor_ring_t*   pRing = &(pReactor->stRing);
+    struct io_uring_sqe* pSqe;
+    unsigned int         uiToSubmit;
+    unsigned int         uiFlags;
+    unsigned int         uiWait;
+    int                  iRet;
+
+    while (!__atomic_load_n( &(pReactor->bStop), __ATOMIC_ACQUIRE ))
+    {
+        if (!pReactor->bWakeArmed)
+        {
+            pSqe = pu_uring_get_sqe( pRing );
+            if (pSqe)
+            {
+                pSqe->opcode    = IORING_OP_READ;
+                pSqe->fd        = pReactor->iEventFd;
+                pSqe->addr      = (uint64_t)(uintptr_t)&(pReactor->ulWakeValue);
+                pSqe->len       = sizeof(pReactor->ulWakeValue);
+                pSqe->user_data = PU_REACTOR_TAG_WAKE;
+                pReactor->bWakeArmed = 1;
+            }
+        }
+
+        pu_reactor_take( pReactor );
+        while ((pReactor->pBacklog) && (pu_uring_prep( pReactor, pReactor->pBacklog )))
+        {
+            pReactor->pBacklog = pReactor->pBacklog->pNext;
+        }
+        if (!pReactor->pBacklog)
+        {
+            pReactor->pBacklogTail = nullptr;
+        }
+
+        /* Only block when nothing is left over for the next turn */
+        uiToSubmit = *(pRing->puiSqTail) - __atomic_load_n( pRing->puiSqHead, __ATOMIC_ACQUIRE );
+        uiWait     = ((pReactor->pBacklog) || (pReactor->pIncoming)) ? 0 : 1;
+        uiFlags    = uiWait ? IORING_ENTER_GETEVENTS : 0;
+        iRet = (int)syscall( __NR_io_uring_enter, pRing->iFd, uiToSubmit, uiWait, uiFlags, nullptr, 0 );
+        if ((iRet < 0) && (EINTR != errno) && (EBUSY != errno) && (EAGAIN != errno))
+        {
+            LOG_ERROR( "PU_REACTOR(uring): io_uring_enter failed, errno=%d\n", errno );
+        }
+        pu_uring_reap( pReactor );
+    }
+}
+/* pu_uring_loop */
+
+//=============================================================================
+// epoll: readiness, then the I/O in the reactor thread. Deadlines in a sorted list.
+//=============================================================================
+
+static int pu_epoll_setup( pu_reactor_t pReactor )
+{
+    struct epoll_event stEvent;
+
+    pReactor->iEpollFd = epoll_create1( EPOLL_CLOEXEC );
+    if (pReactor->iEpollFd < 0)
+    {
+        return (-1);
+    }
+    memset( &stEvent, 0, sizeof(stEvent) );
+    stEvent.events   = EPOLLIN;
+    stEvent.data.ptr = nullptr;
+    if (0 != epoll_ctl( pReactor->iEpollFd, EPOLL_CTL_ADD, pReactor->iEventFd, &stEvent ))
+    {
+        close( pReactor->iEpollFd );
+        return (-1);
+    }
+    return (0);
+}
+/* pu_epoll_setup */
+
+static void pu_epoll_tmo_link(
+    pu_reactor_t     pReactor,
+    pu_reactor_op_t* pOp )
+{
+    pu_reactor_op_t* pPrev = nullptr;
+    pu_reactor_op_t* pCurr = pReactor->pTmoHead;
+
+    timespec_now_plus_ms_monotonic( &(pOp->tsDeadline), pOp->uiTimeoutMs );
+    while ((pCurr) && (!timespec_is_a_after_b( &(pCurr->tsDeadline), &(pOp->tsDeadline) )))
+    {
+        pPrev = pCurr;
+        pCurr = pCurr->pTmoNext;
+    }
+    pOp->pTmoPrev = pPrev;
+    pOp->pTmoNext = pCurr;
+    if (pCurr)
+    {
+        pCurr->pTmoPrev = pOp;
+    }
+    if (pPrev)
+    {
+        pPrev->pTmoNext = pOp;
+    }
+    else
+    {
+        pReactor->pTmoHead = pOp;
+    }
+    pOp->bTmoLinked = 1;
+}
+/* pu_epoll_tmo_link */
+
+static void pu_epoll_tmo_unlink(
+    pu_reactor_t     pReactor,
+    pu_reactor_op_t* pOp )
+{
+    if (!pOp->bTmoLinked)
+    {
+        return;
+    }
+    if (pOp->pTmoPrev)
+    {
+        pOp->pTmoPrev->pTmoNext = pOp->pTmoNext;
+    }
+    else
+    {
+        pReactor->pTmoHead = pOp->pTmoNext;
+    }
+    if (pOp->pTmoNext)
+    {
+        pOp->pTmoNext->pTmoPrev = pOp->pTmoPrev;
+    }
+    pOp->bTmoLinked = 0;
+}
+/* pu_epoll_tmo_unlink */
+
+/* The descriptor is ready (or never blocks): does the I/O, returns the completion result */
+static int pu_epoll_perform(
+    pu_reactor_t     pReactor,
+    pu_reactor_op_t* pOp,
+    uint32_t         uiReady )
+{
+    int     iFd = pOp->iFd;
+    ssize_t iRet;
+
+    if (pOp->uiFlags & PU_REACTOR_FLAG_FIXED_FILE)
+    {
+        iFd = ((unsigned int)iFd < pReactor->uiFiles) ? pReactor->piFiles[iFd] : -1;
+    }
+    switch (pOp->enOpcode)
+    {
+        case PU_REACTOR_OP_READ:
+            iRet = (PU_REACTOR_OFFSET_NONE == pOp->ulOffset) ?
+                read( iFd, pOp->pBuf, pOp->uiLen ) :
+                pread( iFd, pOp->pBuf, pOp->uiLen, (off_t)pOp->ulOffset );
+            break;
+        case PU_REACTOR_OP_WRITE:
+            iRet = (PU_REACTOR_OFFSET_NONE == pOp->ulOffset) ?
+                write( iFd, pOp->pBuf, pOp->uiLen ) :
+                pwrite( iFd, pOp->pBuf, pOp->uiLen, (off_t)pOp->ulOffset );
+            break;
+        case PU_REACTOR_OP_POLL:
+            return ((int)uiReady);
+        case PU_REACTOR_OP_TIMEOUT:
+        default:
+            return (0);
+    }
+    return ((iRet < 0) ? -errno : (int)iRet);
+}
+/* pu_epoll_perform */
+
+static void pu_epoll_start(
+    pu_reactor_t     pReactor,
+    pu_reactor_op_t* pOp )
+{
+    struct epoll_event stEvent;
+    int                iFd = pOp->iFd;
+
+    pOp->bTmoLinked = 0;
+    if (PU_REACTOR_OP_TIMEOUT == pOp->enOpcode)
+    {
+        pu_epoll_tmo_link( pReactor, pOp );
+        return;
+    }
+    if (pOp->uiFlags & PU_REACTOR_FLAG_FIXED_FILE)
+    {
+        if ((unsigned int)iFd >= pReactor->uiFiles)
+        {
+            pu_reactor_complete( pOp, -EBADF );
+            return;
+        }
+        iFd = pReactor->piFiles[iFd];
+    }
+
+    memset( &stEvent, 0, sizeof(stEvent) );
+    stEvent.data.ptr = pOp;
+    stEvent.events   = EPOLLONESHOT;
+    stEvent.events  |= (PU_REACTOR_OP_READ  == pOp->enOpcode) ? (uint32_t)EPOLLIN  :
+                       (PU_REACTOR_OP_WRITE == pOp->enOpcode) ? (uint32_t)EPOLLOUT : pOp->uiEvents;
+    if (0 != epoll_ctl( pReactor->iEpollFd, EPOLL_CTL_ADD, iFd, &stEvent ))
+    {
+        /* Regular files are always ready, and not pollable */
+        if (EPERM == errno)
+        {
+            pu_reactor_complete( pOp, pu_epoll_perform( pReactor, pOp, stEvent.events & (EPOLLIN | EPOLLOUT) ) );
+        }
+        else
+        {
+            pu_reactor_complete( pOp, (EEXIST == errno) ? -EBUSY : -errno );
+        }
+        return;
+    }
+    if (pOp->uiTimeoutMs)
+    {
+        pu_epoll_tmo_link( pReactor, pOp );
+    }
+}
+/* pu_epoll_start */
+
+static void pu_epoll_loop( pu_reactor_t pReactor )
+{
+    struct epoll_event pEvents[PU_REACTOR_EVENTS];
+    struct timespec    tsNow;
+    pu_reactor_op_t*   pOp;
+    int                iTimeoutMs;
+    int                iCount;
+    int                iFd;
+    int                i;
+
+    while (!__atomic_load_n( &(pReactor->bStop), __ATOMIC_ACQUIRE ))
+    {
+        pu_reactor_take( pReactor );
+        while (pReactor->pBacklog)
+        {
+            pOp = pReactor->pBacklog;
+            pReactor->pBacklog = pOp->pNext;
+            pu_epoll_start( pReactor, pOp );
+        }
+        pReactor->pBacklogTail = nullptr;
+
+        /* Sleep until the earliest deadline, rounded up so that it has passed on wake up */
+        iTimeoutMs = -1;
+        if (__atomic_load_n( &(pReactor->pIncoming), __ATOMIC_ACQUIRE ))
+        {
+            iTimeoutMs = 0;
+        }
+        else if (pReactor->pTmoHead)
+        {
+            clock_gettime( CLOCK_MONOTONIC, &tsNow );
+            iTimeoutMs = timespec_is_a_after_b( &(pReactor->pTmoHead->tsDeadline), &tsNow ) ?
+                (int)((timespec_a_sub_b_us( &(pReactor->pTmoHead->tsDeadline), &tsNow ) + 999) / 1000) : 0;
+        }
+
+        iCount = epoll_wait( pReactor->iEpollFd, pEvents, PU_REACTOR_EVENTS, iTimeoutMs );
+        for (i = 0; i < iCount; i++)
+        {
+            pOp = (pu_reactor_op_t*)pEvents[i].data.ptr;
+            if (!pOp)
+            {
+                if (read( pReactor->iEventFd, &(pReactor->ulWakeValue), sizeof(pReactor->ulWakeValue) ) < 0)
+                {
+                    pReactor->ulWakeValue = 0;
+                }
+                continue;
+            }
+            iFd = ((pOp->uiFlags & PU_REACTOR_FLAG_FIXED_FILE) && ((unsigned int)pOp->iFd < pReactor->uiFiles)) ?
+                pReactor->piFiles[pOp->iFd] : pOp->iFd;
+            epoll_ctl( pReactor->iEpollFd, EPOLL_CTL_DEL, iFd, nullptr );
+            pu_epoll_tmo_unlink( pReactor, pOp );
+            pu_reactor_complete( pOp, pu_epoll_perform( pReactor, pOp, pEvents[i].events ) );
+        }
+
+        /* Expired deadlines: timers complete, I/O is abandoned */
+        clock_gettime( CLOCK_MONOTONIC, &tsNow );
+        while ((pReactor->pTmoHead) && (!timespec_is_a_after_b( &(pReactor->pTmoHead->tsDeadline), &tsNow )))
+        {
+            pOp = pReactor->pTmoHead;
+            pu_epoll_tmo_unlink( pReactor, pOp );
+            if (PU_REACTOR_OP_TIMEOUT == pOp->enOpcode)
+            {
+                pu_reactor_complete( pOp, 0 );
+            }
+            else
+            {
+                iFd = ((pOp->uiFlags & PU_REACTOR_FLAG_FIXED_FILE) && ((unsigned int)pOp->iFd < pReactor->uiFiles)) ?
+                    pReactor->piFiles[pOp->iFd] : pOp->iFd;
+                epoll_ctl( pReactor->iEpollFd, EPOLL_CTL_DEL, iFd, nullptr );
+                pu_reactor_complete( pOp, -ETIMEDOUT );
+            }
+        }
+    }
+}
+/* pu_epoll_loop */
+
+static void* pu_reactor_thread( void* pArg )
+{
+    pu_reactor_t pReactor = (pu_reactor_t)pArg;
+
+    pSelf = pReactor;
+    if (PU_REACTOR_BACKEND_URING == pReactor->enBackend)
+    {
+        pu_uring_loop( pReactor );
+    }
+    else
+    {
+        pu_epoll_loop( pReactor );
+    }
+    pSelf = nullptr;
+    return (nullptr);
+}
+/* pu_reactor_thread */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Creates a reactor and starts its thread
+ *
+ * @param[out] phReactor : Reactor handle
+ * @param[in]  pConfig   : Configuration, NULL for the defaults
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_reactor_create(
+    pu_reactor_t*              phReactor,
+    const pu_reactor_config_t* pConfig )
+{
+    pu_reactor_t         pReactor;
+    pu_reactor_backend_t enWanted = pConfig ? pConfig->enBackend : PU_REACTOR_BACKEND_AUTO;
+
+    /* pre-condition */
+    ASSERT( phReactor );
+    ASSERT( enWanted < PU_REACTOR_BACKEND_UNDEF );
+    if ((!phReactor) || (enWanted >= PU_REACTOR_BACKEND_UNDEF))
+    {
+        return (-1);
+    }
+
+    pReactor = (pu_reactor_t)calloc( 1, sizeof(struct pu_reactor_tag) );
+    if (!pReactor)
+    {
+        return (-1);
+    }
+    pReactor->iEventFd = eventfd( 0, EFD_CLOEXEC );
+    if (pReactor->iEventFd < 0)
+    {
+        free( pReactor );
+        return (-1);
+    }
+    if ((pConfig) && (pConfig->uiFiles))
+    {
+        pReactor->piFiles = (int*)malloc( pConfig->uiFiles * sizeof(int) );
+        if (!pReactor->piFiles)
+        {
+            close( pReactor->iEventFd );
+            free( pReactor );
+            return (-1);
+        }
+        memcpy( pReactor->piFiles, pConfig->piFiles, pConfig->uiFiles * sizeof(int) );
+        pReactor->uiFiles = pConfig->uiFiles;
+    }
+
+    /* io_uring when it is there, epoll otherwise */
+    pReactor->enBackend = PU_REACTOR_BACKEND_UNDEF;
+    if ((PU_REACTOR_BACKEND_EPOLL != enWanted) && (0 == pu_uring_setup( pReactor, pConfig )))
+    {
+        pReactor->enBackend = PU_REACTOR_BACKEND_URING;
+    }
+    else if ((PU_REACTOR_BACKEND_URING != enWanted) && (0 == pu_epoll_setup( pReactor )))
+    {
+        pReactor->enBackend = PU_REACTOR_BACKEND_EPOLL;
+    }
+    if (PU_REACTOR_BACKEND_UNDEF == pReactor->enBackend)
+    {
+        free( pReactor->piFiles );
+        close( pReactor->iEventFd );
+        free( pReactor );
+        return (-1);
+    }
+
+    pReactor->tidThread = pu_thread_create( pu_reactor_thread, pReactor, PU_REACTOR_STACK,
+                                            (pConfig && pConfig->szName) ? pConfig->szName : "pu_reactor" );
+    if (0 == pReactor->tidThread)
+    {
+        if (PU_REACTOR_BACKEND_URING == pReactor->enBackend)
+        {
+            pu_uring_teardown( &(pReactor->stRing) );
+        }
+        else
+        {
+            close( pReactor->iEpollFd );
+        }
+        free( pReactor->piFiles );
+        close( pReactor->iEventFd );
+        free( pReactor );
+        return (-1);
+    }
+    *phReactor = pReactor;
+    return (0);
+}
+/* pu_reactor_create */
+
+/**
+ * @brief   Stops the reactor thread and frees the reactor
+ *
+ * @param[in] hReactor : Reactor
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_reactor_destroy( pu_reactor_t hReactor )
+{
+    ASSERT( hReactor );
+    ASSERT( pSelf != hReactor );
+    if ((!hReactor) || (pSelf == hReactor))
+    {
+        return (-1);
+    }
+    __atomic_store_n( &(hReactor->bStop), 1, __ATOMIC_RELEASE );
+    pu_reactor_wake( hReactor );
+    pthread_join( hReactor->tidThread, nullptr );
+    if (PU_REACTOR_BACKEND_URING == hReactor->enBackend)
+    {
+        pu_uring_teardown( &(hReactor->stRing) );
+    }
+    else
+    {
+        close( hReactor->iEpollFd );
+    }
+    free( hReactor->piFiles );
+    close( hReactor->iEventFd );
+    free( hReactor );
+    return (0);
+}
+/* pu_reactor_destroy */
+
+/**
+ * @brief   Returns the backend in use
+ */
+pu_reactor_backend_t pu_reactor_backend( pu_reactor_t hReactor )
+{
+    ASSERT( hReactor );
+    return (hReactor ? hReactor->enBackend : PU_REACTOR_BACKEND_UNDEF);
+}
+/* pu_reactor_backend */
+
+/**
+ * @brief   Prepares a read
+ */
+void pu_reactor_prep_read(
+    pu_reactor_op_t*      pOp,
+    int                   iFd,
+    void*                 pBuf,
+    size_t                uiLen,
+    uint64_t              ulOffset,
+    pu_reactor_done_fct_t fctDone,
+    void*                 pArg )
+{
+    ASSERT( pOp );
+    if (pOp)
+    {
+        memset( pOp, 0, sizeof(*pOp) );
+        pOp->enOpcode = PU_REACTOR_OP_READ;
+        pOp->iFd      = iFd;
+        pOp->pBuf     = pBuf;
+        pOp->uiLen    = uiLen;
+        pOp->ulOffset = ulOffset;
+        pOp->fctDone  = fctDone;
+        pOp->pArg     = pArg;
+    }
+}
+/* pu_reactor_prep_read */
+
+/**
+ * @brief   Prepares a write
+ */
+void pu_reactor_prep_write(
+    pu_reactor_op_t*      pOp,
+    int                   iFd,
+    const void*           pBuf,
+    size_t                uiLen,
+    uint64_t              ulOffset,
+    pu_reactor_done_fct_t fctDone,
+    void*                 pArg )
+{
+    /* Shares the read layout, the buffer is only read from */
+    pu_reactor_prep_read( pOp, iFd, const_cast<void*>( pBuf ), uiLen, ulOffset, fctDone, pArg );
+    if (pOp)
+    {
+        pOp->enOpcode = PU_REACTOR_OP_WRITE;
+    }
+}
+/* pu_reactor_prep_write */
+
+/**
+ * @brief   Prepares a readiness wait
+ */
+void pu_reactor_prep_poll(
+    pu_reactor_op_t*      pOp,
+    int                   iFd,
+    uint32_t              uiEvents,
+    pu_reactor_done_fct_t fctDone,
+    void*                 pArg )
+{
+    ASSERT( pOp );
+    if (pOp)
+    {
+        memset( pOp, 0, sizeof(*pOp) );
+        pOp->enOpcode = PU_REACTOR_OP_POLL;
+        pOp->iFd      = iFd;
+        pOp->uiEvents = uiEvents;
+        pOp->fctDone  = fctDone;
+        pOp->pArg     = pArg;
+    }
+}
+/* pu_reactor_prep_poll */
+
+/**
+ * @brief   Prepares a timer
+ */
+void pu_reactor_prep_timeout(
+    pu_reactor_op_t*      pOp,
+    size_t                uiMs,
+    pu_reactor_done_fct_t fctDone,
+    void*                 pArg )
+{
+    ASSERT( pOp );
+    if (pOp)
+    {
+        memset( pOp, 0, sizeof(*pOp) );
+        pOp->enOpcode    = PU_REACTOR_OP_TIMEOUT;
+        pOp->iFd         = -1;
+        pOp->uiTimeoutMs = uiMs;
+        pOp->fctDone     = fctDone;
+        pOp->pArg        = pArg;
+    }
+}
+/* pu_reactor_prep_timeout */
+
+/**
+ * @brief   Hands an operation to the reactor
+ *
+ * @param[in] hReactor : Reactor
+ * @param[in] pOp      : Prepared operation
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ *
+ * @par Description
+ * Only the push that finds the list empty wakes the reactor. The reactor thread itself never
+ * needs waking, it takes the list before it waits again.
+ */
+int pu_reactor_submit(
+    pu_reactor_t     hReactor,
+    pu_reactor_op_t* pOp )
+{
+    pu_reactor_op_t* pHead;
+
+    /* pre-condition */
+    ASSERT( hReactor );
+    ASSERT( pOp );
+    ASSERT( pOp->fctDone );
+    ASSERT( pOp->enOpcode < PU_REACTOR_OP_UNDEF );
+    if ((!hReactor) || (!pOp) || (!pOp->fctDone) || (pOp->enOpcode >= PU_REACTOR_OP_UNDEF))
+    {
+        return (-1);
+    }
+
+    pHead = __atomic_load_n( &(hReactor->pIncoming), __ATOMIC_RELAXED );
+    do
+    {
+        pOp->pNext = pHead;
+    } while (!__atomic_compare_exchange_n( &(hReactor->pIncoming), &pHead, pOp, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED ));
+    if ((!pHead) && (pSelf != hReactor))
+    {
+        pu_reactor_wake( hReactor );
+    }
+    return (0);
+}
+/* pu_reactor_submit */
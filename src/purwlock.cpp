@@ -0,0 +1,367 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     purwlock.cpp
+ * @brief    Implementation of the distributed reader-writer lock
+ */
+
+/**** Includes ***************************************************************/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <unistd.h>
+#include <atomic>
+#include "posutils.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+
+/* Limits on the number of reader indicators */
+#define PU_RWLOCK_MIN_SLOTS  (4)
+#define PU_RWLOCK_MAX_SLOTS  (64)
+
+/* Busy-wait iterations before a reader parks, or a writer yields */
+#define PU_RWLOCK_SPIN_COUNT (128)
+
+/* One reader indicator, padded out to a full cache line */
+typedef struct pu_rwlock_slot_tag
+{
+    unsigned int uiReaders;
+    char         cPad[PU_CACHELINE_SIZE - sizeof(unsigned int)];
+}   pu_rwlock_slot_t;
+
+/**** Macros ****************************************************************/
+
+/**** Static declarations ***************************************************/
+static std::atomic<unsigned int>  uiNextSlot{ 0 };
+static thread_local unsigned int  uiThreadSlot = 0;  /* slot + 1, 0 means unassigned */
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static unsigned int      pu_rwlock_slot_count( void );
+static pu_rwlock_slot_t* pu_rwlock_my_slot( pu_rwlock_t* pLock );
+static void              pu_rwlock_wait_writer( pu_rwlock_t* pLock );
+static void              pu_rwlock_wait_readers( pu_rwlock_t* pLock );
+static bool              pu_rwlock_readers_present( pu_rwlock_t* pLock );
+static void              pu_rwlock_release_writer( pu_rwlock_t* pLock );
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+/* One slot per configured CPU, rounded up to a power of two */
+static unsigned int pu_rwlock_slot_count( void )
+{
+    long         lCpus   = sysconf( _SC_NPROCESSORS_CONF );
+    unsigned int uiSlots = PU_RWLOCK_MIN_SLOTS;
+
+    while ((uiSlots < PU_RWLOCK_MAX_SLOTS) && ((long)uiSlots < lCpus))
+    {
+        uiSlots <<= 1;
+    }
+    return (uiSlots);
+}
+/* pu_rwlock_slot_count */
+
+/* Each thread is bound (round robin) to a slot the first time it reads */
+static inline pu_rwlock_slot_t* pu_rwlock_my_slot( pu_rwlock_t* pLock )
+{
+    if (0 == uiThreadSlot)
+    {
+        uiThreadSlot = uiNextSlot.fetch_add( 1, std::memory_order_relaxed ) + 1;
+    }
+    return (((pu_rwlock_slot_t*)pLock->pSlots) + ((uiThreadSlot - 1) & pLock->uiSlotMask));
+}
+/* pu_rwlock_my_slot */
+
+/* Reader slow path: spin for a while, then park on the writer word */
+static void pu_rwlock_wait_writer( pu_rwlock_t* pLock )
+{
+    int i;
+
+    for (i = 0; i < PU_RWLOCK_SPIN_COUNT; i++)
+    {
+        if (0 == __atomic_load_n( &(pLock->uiWriter), __ATOMIC_ACQUIRE ))
+        {
+            return;
+        }
+        PU_CPU_RELAX();
+    }
+
+    __atomic_add_fetch( &(pLock->uiWaiters), 1, __ATOMIC_SEQ_CST );
+    while (0 != __atomic_load_n( &(pLock->uiWriter), __ATOMIC_SEQ_CST ))
+    {
+        pu_futex_wait( &(pLock->uiWriter), 1, nullptr, 0 );
+    }
+    __atomic_sub_fetch( &(pLock->uiWaiters), 1, __ATOMIC_SEQ_CST );
+}
+/* pu_rwlock_wait_writer */
+
+/* Scan every reader indicator */
+static bool pu_rwlock_readers_present( pu_rwlock_t* pLock )
+{
+    pu_rwlock_slot_t* pSlots = (pu_rwlock_slot_t*)pLock->pSlots;
+    unsigned int      i;
+
+    for (i = 0; i <= pLock->uiSlotMask; i++)
+    {
+        if (0 != __atomic_load_n( &(pSlots[i].uiReaders), __ATOMIC_SEQ_CST ))
+        {
+            return (true);
+        }
+    }
+    return (false);
+}
+/* pu_rwlock_readers_present */
+
+/* Writer slow path: readers are short, spin and then yield until they drain */
+static void pu_rwlock_wait_readers( pu_rwlock_t* pLock )
+{
+    int i = 0;
+
+    while (pu_rwlock_readers_present( pLock ))
+    {
+        if (i < PU_RWLOCK_SPIN_COUNT)
+        {
+            PU_CPU_RELAX();
+            i++;
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+}
+/* pu_rwlock_wait_readers */
+
+/* Clear the writer word, only enter the kernel if somebody is parked */
+static void pu_rwlock_release_writer( pu_rwlock_t* pLock )
+{
+    __atomic_store_n( &(pLock->uiWriter), 0, __ATOMIC_SEQ_CST );
+    if (0 != __atomic_load_n( &(pLock->uiWaiters), __ATOMIC_SEQ_CST ))
+    {
+        pu_futex_wake( &(pLock->uiWriter), INT_MAX, 0 );
+    }
+}
+/* pu_rwlock_release_writer */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Creates (initialises) a reader-writer lock of the specified type
+ *
+ * @param[in] pLock  : Pointer to a valid lock
+ * @param[in] enType : Lock type
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ *
+ * @pre     The lock pointer is non-null
+ * @post    The lock is initialised
+ */
+int pu_rwlock_create_type(
+    pu_rwlock_t*   pLock,
+    pu_rwlock_type enType )
+{
+    int          iResult = -1;
+    unsigned int uiSlots;
+    void*        pSlots  = nullptr;
+
+    /* pre-condition */
+    ASSERT( pLock );
+    ASSERT( (enType >= PU_RWLOCK_TYPE_WRITER_PREF) && (enType < PU_RWLOCK_TYPE_ENDDEF) );
+    if ((pLock)                                &&
+        (enType >= PU_RWLOCK_TYPE_WRITER_PREF) &&
+        (enType < PU_RWLOCK_TYPE_ENDDEF) )
+    {
+        uiSlots = pu_rwlock_slot_count();
+        iResult = posix_memalign( &pSlots, PU_CACHELINE_SIZE, uiSlots * sizeof(pu_rwlock_slot_t) );
+        ASSERT( 0 == iResult );
+        if (0 == iResult)
+        {
+            memset( pSlots, 0, uiSlots * sizeof(pu_rwlock_slot_t) );
+            iResult = pu_mutex_create_type( &(pLock->mtxWriter), PU_MUTEX_TYPE_FAST );
+            if (0 == iResult)
+            {
+                pLock->pSlots     = pSlots;
+                pLock->uiSlotMask = uiSlots - 1;
+                pLock->uiWriter   = 0;
+                pLock->uiWaiters  = 0;
+                pLock->enType     = enType;
+            }
+            else
+            {
+                free( pSlots );
+            }
+        }
+    }
+
+    /* post-condition */
+    ASSERT( 0 == iResult );
+    return (iResult);
+}
+/* pu_rwlock_create_type */
+
+/**
+ * @brief   Destroys a reader-writer lock
+ *
+ * @param[in] pLock : Pointer to a valid lock
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_rwlock_destroy( pu_rwlock_t* pLock )
+{
+    int iResult = -1;
+
+    ASSERT( pLock );
+    if ((pLock) && (pLock->pSlots))
+    {
+        ASSERT( !pu_rwlock_readers_present( pLock ) );
+        iResult = pthread_mutex_destroy( &(pLock->mtxWriter) );
+        free( pLock->pSlots );
+        pLock->pSlots = nullptr;
+    }
+    return (iResult);
+}
+/* pu_rwlock_destroy */
+
+/**
+ * @brief   Acquires the lock for reading
+ *
+ * @param[in] pLock : Pointer to a valid lock
+ * @retval  0 for success
+ *
+ * @par Description
+ * Announce the reader first, then check for a writer. The writer does the mirror image
+ * (announce, then check the readers), so with sequentially consistent ordering at least
+ * one side always sees the other.
+ */
+int pu_rwlock_rdlock( pu_rwlock_t* pLock )
+{
+    pu_rwlock_slot_t* pSlot = pu_rwlock_my_slot( pLock );
+
+    for (;;)
+    {
+        __atomic_add_fetch( &(pSlot->uiReaders), 1, __ATOMIC_SEQ_CST );
+        if (0 == __atomic_load_n( &(pLock->uiWriter), __ATOMIC_SEQ_CST ))
+        {
+            return (0);
+        }
+
+        /* Writer active or waiting, back off so that it can drain the readers */
+        __atomic_sub_fetch( &(pSlot->uiReaders), 1, __ATOMIC_SEQ_CST );
+        pu_rwlock_wait_writer( pLock );
+    }
+}
+/* pu_rwlock_rdlock */
+
+/**
+ * @brief   Tries to acquire the lock for reading, without blocking
+ *
+ * @param[in] pLock : Pointer to a valid lock
+ * @retval  0 for success
+ * @retval  EBUSY if a writer holds (or is waiting for) the lock
+ */
+int pu_rwlock_tryrdlock( pu_rwlock_t* pLock )
+{
+    pu_rwlock_slot_t* pSlot = pu_rwlock_my_slot( pLock );
+
+    __atomic_add_fetch( &(pSlot->uiReaders), 1, __ATOMIC_SEQ_CST );
+    if (0 == __atomic_load_n( &(pLock->uiWriter), __ATOMIC_SEQ_CST ))
+    {
+        return (0);
+    }
+    __atomic_sub_fetch( &(pSlot->uiReaders), 1, __ATOMIC_SEQ_CST );
+    return (EBUSY);
+}
+/* pu_rwlock_tryrdlock */
+
+/**
+ * @brief   Releases a read lock
+ *
+ * @param[in] pLock : Pointer to a valid lock
+ * @retval  0 for success
+ */
+int pu_rwlock_rdunlock( pu_rwlock_t* pLock )
+{
+    pu_rwlock_slot_t* pSlot = pu_rwlock_my_slot( pLock );
+
+    ASSERT( 0 != pSlot->uiReaders );
+    __atomic_sub_fetch( &(pSlot->uiReaders), 1, __ATOMIC_RELEASE );
+    return (0);
+}
+/* pu_rwlock_rdunlock */
+
+/**
+ * @brief   Acquires the lock for writing
+ *
+ * @param[in] pLock : Pointer to a valid lock
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ *
+ * @par Description
+ * Writer preference: the writer word stays set while the readers drain, so new readers
+ * back off. Reader preference: if readers are present the writer clears the word again,
+ * lets them run, and retries once they have gone.
+ */
+int pu_rwlock_wrlock( pu_rwlock_t* pLock )
+{
+    int iResult = pthread_mutex_lock( &(pLock->mtxWriter) );
+
+    ASSERT( 0 == iResult );
+    if (0 == iResult)
+    {
+        for (;;)
+        {
+            __atomic_store_n( &(pLock->uiWriter), 1, __ATOMIC_SEQ_CST );
+            if (PU_RWLOCK_TYPE_WRITER_PREF == pLock->enType)
+            {
+                pu_rwlock_wait_readers( pLock );
+                break;
+            }
+            if (!pu_rwlock_readers_present( pLock ))
+            {
+                break;
+            }
+            pu_rwlock_release_writer( pLock );
+            pu_rwlock_wait_readers( pLock );
+        }
+    }
+    return (iResult);
+}
+/* pu_rwlock_wrlock */
+
+/**
+ * @brief   Releases a write lock
+ *
+ * @param[in] pLock : Pointer to a valid lock
+ * @retval  0 for success
+ */
+int pu_rwlock_wrunlock( pu_rwlock_t* pLock )
+{
+    ASSERT( 0 != pLock->uiWriter );
+    pu_rwlock_release_writer( pLock );
+    return (pthread_mutex_unlock( &(pLock->mtxWriter) ));
+}
+/* pu_rwlock_wrunlock */
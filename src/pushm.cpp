@@ -0,0 +1,452 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     pushm.cpp
+ * @brief    Implementation of the process-shared synchronisation objects
+ */
+
+/**** Includes ***************************************************************/
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "pushm.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+
+/* Identifies an initialised ring, written last by the creator */
+#define PU_SHM_RING_MAGIC  (0x50555247U)
+
+/* Slots are rounded up to this, so that every message is suitably aligned */
+#define PU_SHM_RING_ALIGN  ((size_t)16)
+
+/**
+ * Ring header, at the start of the shared block. The consumer and producer indices are on
+ * separate cache lines. Each side also keeps a cached copy of the other side's index on its
+ * own line, so that the shared line is only read when the cached value says full/empty.
+ */
+struct pu_shm_ring_tag
+{
+    /* Read only after creation */
+    struct PU_CACHELINE_ALIGNED
+    {
+        unsigned int uiMagic;
+        unsigned int uiSlotSize;
+        unsigned int uiSlotMask;
+    }   stConst;
+
+    /* Written by the consumer */
+    struct PU_CACHELINE_ALIGNED
+    {
+        unsigned int uiHead;          /* Futex word, next slot to read      */
+        unsigned int uiTailCache;     /* Consumer's copy of uiTail          */
+        unsigned int uiDataWaiters;   /* Non-zero while the consumer sleeps */
+    }   stCons;
+
+    /* Written by the producer */
+    struct PU_CACHELINE_ALIGNED
+    {
+        unsigned int uiTail;          /* Futex word, next slot to write     */
+        unsigned int uiHeadCache;     /* Producer's copy of uiHead          */
+        unsigned int uiSpaceWaiters;  /* Non-zero while the producer sleeps */
+    }   stProd;
+};
+
+/**** Macros ****************************************************************/
+#define PU_SHM_SLOT_SIZE(size_) (((size_) + PU_SHM_RING_ALIGN - 1) & ~(PU_SHM_RING_ALIGN - 1))
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static inline unsigned char* pu_shm_ring_slot( pu_shm_ring_t* pRing, unsigned int uiIndex );
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+static inline unsigned char* pu_shm_ring_slot(
+    pu_shm_ring_t* pRing,
+    unsigned int   uiIndex )
+{
+    return ((unsigned char*)pRing + sizeof(pu_shm_ring_t) +
+            ((size_t)(uiIndex & pRing->stConst.uiSlotMask) * pRing->stConst.uiSlotSize));
+}
+/* pu_shm_ring_slot */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Creates a process-shared mutex
+ *
+ * @param[in] pMtx   : Pointer to a mutex inside the shared segment
+ * @param[in] enType : Mutex type
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_shm_mutex_create(
+    pthread_mutex_t* pMtx,
+    pu_mutex_type    enType )
+{
+    pu_mutex_attr_t stAttr = { PU_MUTEX_ATTR_PSHARED, nullptr };
+    return (pu_mutex_create_attr( pMtx, enType, &stAttr ));
+}
+/* pu_shm_mutex_create */
+
+/**
+ * @brief   Creates a process-shared condition variable, timed against CLOCK_MONOTONIC
+ *
+ * @param[in] pCond : Pointer to a condition variable inside the shared segment
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_shm_cond_create( pthread_cond_t* pCond )
+{
+    pthread_condattr_t attr;
+    int                iResult = -1;
+
+    /* pre-condition */
+    ASSERT( pCond );
+    if (pCond)
+    {
+        iResult = pthread_condattr_init( &attr );
+        if (0 == iResult)
+        {
+            iResult = pthread_condattr_setpshared( &attr, PTHREAD_PROCESS_SHARED );
+            if (0 == iResult)
+            {
+                iResult = pthread_condattr_setclock( &attr, CLOCK_MONOTONIC );
+            }
+            if (0 == iResult)
+            {
+                iResult = pthread_cond_init( pCond, &attr );
+            }
+            pthread_condattr_destroy( &attr );
+        }
+    }
+
+    /* post-condition */
+    ASSERT( 0 == iResult );
+    return (iResult);
+}
+/* pu_shm_cond_create */
+
+/**
+ * @brief   Creates a process-shared semaphore
+ *
+ * @param[in] pSem      : Pointer to a semaphore inside the shared segment
+ * @param[in] uiInitial : Initial value
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_shm_sem_create(
+    pu_shm_sem_t* pSem,
+    unsigned int  uiInitial )
+{
+    return (pu_sem_create( pSem, uiInitial, 1 ));
+}
+/* pu_shm_sem_create */
+
+/**
+ * @brief   Increments the semaphore, and wakes one waiter if there is one
+ *
+ * @param[in] pSem : Pointer to a valid semaphore
+ * @retval  0 for success
+ */
+int pu_shm_sem_post( pu_shm_sem_t* pSem )
+{
+    return (pu_sem_post( pSem ));
+}
+/* pu_shm_sem_post */
+
+/**
+ * @brief   Decrements the semaphore if it is non-zero, never waits
+ *
+ * @param[in] pSem : Pointer to a valid semaphore
+ * @retval  0 for success
+ * @retval  EAGAIN the value was zero
+ */
+int pu_shm_sem_trywait( pu_shm_sem_t* pSem )
+{
+    return (pu_sem_trywait( pSem ));
+}
+/* pu_shm_sem_trywait */
+
+/**
+ * @brief   Decrements the semaphore, waiting at most the timeout
+ *
+ * @param[in] pSem        : Pointer to a valid semaphore
+ * @param[in] uiTimeoutMs : Timeout in ms, or PU_SHM_WAIT_FOREVER
+ * @retval  0 for success
+ * @retval  ETIMEDOUT the timeout expired
+ */
+int pu_shm_sem_timedwait(
+    pu_shm_sem_t* pSem,
+    size_t        uiTimeoutMs )
+{
+    return (pu_sem_timedwait( pSem, uiTimeoutMs ));
+}
+/* pu_shm_sem_timedwait */
+
+/**
+ * @brief   Decrements the semaphore, waiting for as long as it takes
+ *
+ * @param[in] pSem : Pointer to a valid semaphore
+ * @retval  0 for success
+ */
+int pu_shm_sem_wait( pu_shm_sem_t* pSem )
+{
+    return (pu_sem_wait( pSem ));
+}
+/* pu_shm_sem_wait */
+
+/**
+ * @brief   Bytes of shared memory needed for a ring
+ *
+ * @param[in] uiSlotSize : Size of one message
+ * @param[in] uiSlots    : Number of slots, a power of two
+ * @retval  The size in bytes, including the ring header
+ */
+size_t pu_shm_ring_size(
+    size_t uiSlotSize,
+    size_t uiSlots )
+{
+    return (sizeof(pu_shm_ring_t) + (PU_SHM_SLOT_SIZE( uiSlotSize ) * uiSlots));
+}
+/* pu_shm_ring_size */
+
+/**
+ * @brief   Creates a ring at the start of a block of shared memory
+ *
+ * @param[in] pMem       : Start of the block, cache line aligned
+ * @param[in] uiMemSize  : Size of the block
+ * @param[in] uiSlotSize : Size of one message
+ * @param[in] uiSlots    : Number of slots, a power of two
+ * @retval  The ring, or NULL if the parameters are invalid
+ */
+pu_shm_ring_t* pu_shm_ring_create(
+    void*  pMem,
+    size_t uiMemSize,
+    size_t uiSlotSize,
+    size_t uiSlots )
+{
+    pu_shm_ring_t* pRing = (pu_shm_ring_t*)pMem;
+
+    /* pre-condition */
+    ASSERT( pMem );
+    ASSERT( 0 == ((uintptr_t)pMem & (PU_CACHELINE_SIZE - 1)) );
+    ASSERT( (uiSlots > 0) && (0 == (uiSlots & (uiSlots - 1))) );
+    ASSERT( uiMemSize >= pu_shm_ring_size( uiSlotSize, uiSlots ) );
+    if ((!pMem)                                              ||
+        (0 != ((uintptr_t)pMem & (PU_CACHELINE_SIZE - 1)))   ||
+        (0 == uiSlotSize) || (uiSlotSize > 0xFFFF0000U)      ||
+        (0 == uiSlots) || (0 != (uiSlots & (uiSlots - 1)))   ||
+        (uiSlots > 0x80000000U)                              ||
+        (uiMemSize < pu_shm_ring_size( uiSlotSize, uiSlots )) )
+    {
+        return (nullptr);
+    }
+
+    memset( pRing, 0, sizeof(pu_shm_ring_t) );
+    pRing->stConst.uiSlotSize = (unsigned int)PU_SHM_SLOT_SIZE( uiSlotSize );
+    pRing->stConst.uiSlotMask = (unsigned int)(uiSlots - 1);
+    __atomic_store_n( &(pRing->stConst.uiMagic), PU_SHM_RING_MAGIC, __ATOMIC_RELEASE );
+    return (pRing);
+}
+/* pu_shm_ring_create */
+
+/**
+ * @brief   Attaches to a ring created by another process
+ *
+ * @param[in] pMem : Start of the block, as mapped in this process
+ * @retval  The ring, or NULL if the block does not hold a ring
+ */
+pu_shm_ring_t* pu_shm_ring_attach( void* pMem )
+{
+    pu_shm_ring_t* pRing = (pu_shm_ring_t*)pMem;
+
+    ASSERT( pMem );
+    if ((!pMem) || (PU_SHM_RING_MAGIC != __atomic_load_n( &(pRing->stConst.uiMagic), __ATOMIC_ACQUIRE )))
+    {
+        return (nullptr);
+    }
+    return (pRing);
+}
+/* pu_shm_ring_attach */
+
+/**
+ * @brief   Producer: gets the next free slot
+ *
+ * @param[in] pRing : Pointer to a valid ring
+ * @retval  Pointer to the slot, or NULL if the ring is full
+ */
+void* pu_shm_ring_reserve( pu_shm_ring_t* pRing )
+{
+    unsigned int uiTail = __atomic_load_n( &(pRing->stProd.uiTail), __ATOMIC_RELAXED );
+
+    /* Only read the consumer's line when the cached head says the ring is full */
+    if ((uiTail - pRing->stProd.uiHeadCache) > pRing->stConst.uiSlotMask)
+    {
+        pRing->stProd.uiHeadCache = __atomic_load_n( &(pRing->stCons.uiHead), __ATOMIC_ACQUIRE );
+        if ((uiTail - pRing->stProd.uiHeadCache) > pRing->stConst.uiSlotMask)
+        {
+            return (nullptr);
+        }
+    }
+    return (pu_shm_ring_slot( pRing, uiTail ));
+}
+/* pu_shm_ring_reserve */
+
+/**
+ * @brief   Producer: publishes the reserved slot
+ *
+ * @param[in] pRing : Pointer to a valid ring
+ */
+void pu_shm_ring_commit( pu_shm_ring_t* pRing )
+{
+    unsigned int uiTail = __atomic_load_n( &(pRing->stProd.uiTail), __ATOMIC_RELAXED );
+
+    /* seq_cst store, then check for a sleeping consumer (see pu_shm_ring_wait_data) */
+    __atomic_store_n( &(pRing->stProd.uiTail), uiTail + 1, __ATOMIC_SEQ_CST );
+    if (0 != __atomic_load_n( &(pRing->stCons.uiDataWaiters), __ATOMIC_SEQ_CST ))
+    {
+        pu_futex_wake( &(pRing->stProd.uiTail), 1, 1 );
+    }
+}
+/* pu_shm_ring_commit */
+
+/**
+ * @brief   Consumer: gets the oldest message
+ *
+ * @param[in] pRing : Pointer to a valid ring
+ * @retval  Pointer to the message, or NULL if the ring is empty
+ */
+const void* pu_shm_ring_peek( pu_shm_ring_t* pRing )
+{
+    unsigned int uiHead = __atomic_load_n( &(pRing->stCons.uiHead), __ATOMIC_RELAXED );
+
+    /* Only read the producer's line when the cached tail says the ring is empty */
+    if (uiHead == pRing->stCons.uiTailCache)
+    {
+        pRing->stCons.uiTailCache = __atomic_load_n( &(pRing->stProd.uiTail), __ATOMIC_ACQUIRE );
+        if (uiHead == pRing->stCons.uiTailCache)
+        {
+            return (nullptr);
+        }
+    }
+    return (pu_shm_ring_slot( pRing, uiHead ));
+}
+/* pu_shm_ring_peek */
+
+/**
+ * @brief   Consumer: frees the slot returned by pu_shm_ring_peek()
+ *
+ * @param[in] pRing : Pointer to a valid ring
+ */
+void pu_shm_ring_release( pu_shm_ring_t* pRing )
+{
+    unsigned int uiHead = __atomic_load_n( &(pRing->stCons.uiHead), __ATOMIC_RELAXED );
+
+    __atomic_store_n( &(pRing->stCons.uiHead), uiHead + 1, __ATOMIC_SEQ_CST );
+    if (0 != __atomic_load_n( &(pRing->stProd.uiSpaceWaiters), __ATOMIC_SEQ_CST ))
+    {
+        pu_futex_wake( &(pRing->stCons.uiHead), 1, 1 );
+    }
+}
+/* pu_shm_ring_release */
+
+/**
+ * @brief   Consumer: waits until there is at least one message
+ *
+ * @param[in] pRing       : Pointer to a valid ring
+ * @param[in] uiTimeoutMs : Timeout in ms, or PU_SHM_WAIT_FOREVER
+ * @retval  0 a message is available
+ * @retval  ETIMEDOUT the timeout expired
+ */
+int pu_shm_ring_wait_data(
+    pu_shm_ring_t* pRing,
+    size_t         uiTimeoutMs )
+{
+    struct timespec        tsDeadline;
+    const struct timespec* pDeadline;
+    unsigned int           uiHead;
+    unsigned int           uiTail;
+    int                    iResult = 0;
+
+    if (pu_shm_ring_peek( pRing ))
+    {
+        return (0);
+    }
+
+    pDeadline = pu_futex_deadline( &tsDeadline, uiTimeoutMs );
+    uiHead    = __atomic_load_n( &(pRing->stCons.uiHead), __ATOMIC_RELAXED );
+    __atomic_store_n( &(pRing->stCons.uiDataWaiters), 1, __ATOMIC_SEQ_CST );
+    while (uiHead == (uiTail = __atomic_load_n( &(pRing->stProd.uiTail), __ATOMIC_SEQ_CST )))
+    {
+        if (ETIMEDOUT == pu_futex_wait( &(pRing->stProd.uiTail), uiTail, pDeadline, 1 ))
+        {
+            iResult = ETIMEDOUT;
+            break;
+        }
+    }
+    __atomic_store_n( &(pRing->stCons.uiDataWaiters), 0, __ATOMIC_RELAXED );
+    return ((pu_shm_ring_peek( pRing )) ? 0 : iResult);
+}
+/* pu_shm_ring_wait_data */
+
+/**
+ * @brief   Producer: waits until there is at least one free slot
+ *
+ * @param[in] pRing       : Pointer to a valid ring
+ * @param[in] uiTimeoutMs : Timeout in ms, or PU_SHM_WAIT_FOREVER
+ * @retval  0 a slot is free
+ * @retval  ETIMEDOUT the timeout expired
+ */
+int pu_shm_ring_wait_space(
+    pu_shm_ring_t* pRing,
+    size_t         uiTimeoutMs )
+{
+    struct timespec        tsDeadline;
+    const struct timespec* pDeadline;
+    unsigned int           uiHead;
+    unsigned int           uiTail;
+    int                    iResult = 0;
+
+    if (pu_shm_ring_reserve( pRing ))
+    {
+        return (0);
+    }
+
+    pDeadline = pu_futex_deadline( &tsDeadline, uiTimeoutMs );
+    uiTail    = __atomic_load_n( &(pRing->stProd.uiTail), __ATOMIC_RELAXED );
+    __atomic_store_n( &(pRing->stProd.uiSpaceWaiters), 1, __ATOMIC_SEQ_CST );
+    while ((uiTail - (uiHead = __atomic_load_n( &(pRing->stCons.uiHead), __ATOMIC_SEQ_CST ))) > pRing->stConst.uiSlotMask)
+    {
+        if (ETIMEDOUT == pu_futex_wait( &(pRing->stCons.uiHead), uiHead, pDeadline, 1 ))
+        {
+            iResult = ETIMEDOUT;
+            break;
+        }
+    }
+    __atomic_store_n( &(pRing->stProd.uiSpaceWaiters), 0, __ATOMIC_RELAXED );
+    return ((pu_shm_ring_reserve( pRing )) ? 0 : iResult);
+}
+/* pu_shm_ring_wait_space */
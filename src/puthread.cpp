@@ -37,9 +37,14 @@
 #include <sys/types.h>
 #include <sched.h>
 #include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <time.h>
+#include <execinfo.h>
 #include <atomic>
 
 #include "posutils.h"
+#include "puprobes.h"
 #include "logging.h"
 
 /**** Definitions ************************************************************/
@@ -57,6 +62,19 @@ typedef struct pu_thread_context_tag
     pthread_t       pid;                     /* Posix thread ID                    */
     pid_t           tid;                     /* Linux thread ID                    */
     const char*     szName;                  /* Thread name                        */
+    bool            bEbr;                    /* Registered with the EBR domain     */
+    bool            bHazard;                 /* Owns a set of hazard slots         */
+    bool            bProfiler;               /* Sampled by the profiler            */
+    bool            bPerf;                   /* Owns performance counters          */
+
+    /* Hang monitor, the heartbeat is written by the thread only */
+    uint64_t        ulBeat;                  /* Heartbeat count                    */
+    uint64_t        ulBudgetNs;              /* Watched if non-zero                */
+    uint64_t        ulSeenBeat;              /* Heartbeat at the last change seen  */
+    uint64_t        ulSeenNs;                /* Time of the last change seen       */
+    bool            bReported;               /* Current stall has been reported    */
+    struct pu_thread_context_tag* pWatchPrev;/* Watch list, under mtxLock          */
+    struct pu_thread_context_tag* pWatchNext;
 }   pu_thread_context_t;
 
 #if defined(PUTHREAD_DEBUGGING)
@@ -66,6 +84,24 @@ typedef struct pu_thread_context_tag
 
 #define PU_THREAD_STUPID_STACKSIZE (1024*1024)
 
+/* Hang reports gathered per scan, the rest wait for the next scan */
+#define PU_THREAD_MONITOR_REPORTS (16)
+
+/* A hang report, taken under the lock and delivered outside it */
+typedef struct pu_thread_hang_tag
+{
+    const char* szName;
+    int         iTid;
+    size_t      uiStalledMs;
+}   pu_thread_hang_t;
+
+/* Thread group member start record */
+typedef struct pu_thread_member_tag
+{
+    pu_thread_group_t* pGroup;               /* Owning group                       */
+    size_t             uiIndex;              /* Member index                       */
+}   pu_thread_member_t;
+
 /**** Macros ****************************************************************/
 
 /**** Static declarations ***************************************************/
@@ -73,11 +109,26 @@ static std::atomic<int>     iIsInit{ 0 };
 static pthread_mutex_t      mtxLock;
 static size_t               uiPageSize   = 0;
 static size_t               uiThreadCount = 0;
+static pu_spinlock_t        lckThreadCount = PU_SPINLOCK_INITIALIZER;
+static thread_local pu_thread_context_t* pSelf = nullptr;
+static pu_thread_context_t* pWatchList   = nullptr;
+static putimer_hnd_t        hMonitor     = nullptr;
+static pu_thread_hang_fct_t fctMonitorHang = nullptr;
+static unsigned int         uiMonitorFlags = 0;
+static bool                 bMonitorOn     = false;   /* Under mtxLock, scans bail out once cleared */
+static size_t               uiMonitorScans = 0;       /* Under mtxLock, scans in progress            */
+static pu_eventcount_t      ecMonitorIdle  = PU_EVENTCOUNT_INITIALIZER;
+static bool                 bBacktraceSet  = false;   /* Installed once, never restored           */
 
 /**** Local function prototypes (NB Use static modifier) ********************/
 static size_t               pu_thread_stacksize_fix( size_t uiStackSize );
 static void*                pu_thread_entry_handler( void* pArg );
 static void                 pu_thread_exit_handler( void* pArg );
+static void*                pu_thread_group_entry( void* pArg );
+static void                 pu_thread_watch_unlink( pu_thread_context_t* pNode );
+static void                 pu_thread_monitor_scan( void* pCookie );
+static void                 pu_thread_monitor_report( const char* szName, int iTid, size_t uiStalledMs );
+static void                 pu_thread_backtrace_handler( int iSignal );
 
 /****************************************************************************/
 /* LOCAL FUNCTION DEFINITIONS                                               */
@@ -131,6 +182,8 @@ static void* pu_thread_entry_handler( void* pArg )
 
     /* Get the system thread ID */
     pNode->tid = (pid_t)syscall( SYS_gettid );
+    pSelf      = pNode;
+    PU_PROBE2( thread__start, pNode->szName, pNode->tid );
 
     /* Trace thread creation */
     PUTHREAD_DEBUG(
@@ -138,6 +191,15 @@ static void* pu_thread_entry_handler( void* pArg )
         pNode->szName,
         (int)pNode->tid );
 
+    /* Every pu thread can use lock-free structures, whichever way they reclaim memory */
+    pNode->bEbr    = (0 == pu_ebr_register());
+    pNode->bHazard = (0 == pu_hazard_register());
+
+    /* Sampled from the start, when the profiler runs */
+    pNode->bProfiler = (0 == pu_profiler_register( pNode->szName ));
+    pNode->bPerf     = (0 == pu_perf_register( pNode->szName ));
+    pu_trace_name_thread( pNode->szName );
+
     /* register the exit handler */
     pthread_cleanup_push( pu_thread_exit_handler, pNode );
 
@@ -154,9 +216,38 @@ static void pu_thread_exit_handler( void* pArg )
 {
     pu_thread_context_t* pNode = (pu_thread_context_t*)pArg;
     ASSERT( pNode );
-    pthread_mutex_lock( &mtxLock );
     PUTHREAD_DEBUG( "PU_THREAD(exit_handler): thrd=%s\n", pNode->szName );
+    if (pNode->bEbr)
+    {
+        pu_ebr_unregister();
+    }
+    if (pNode->bHazard)
+    {
+        pu_hazard_unregister();
+    }
+    if (pNode->bProfiler)
+    {
+        pu_profiler_unregister();
+    }
+    if (pNode->bPerf)
+    {
+        pu_perf_unregister();
+    }
+    if (PU_TRACE_ON())
+    {
+        pu_trace_event( PU_TRACE_PHASE_INSTANT, "thread_exit", pNode->szName, 0, 0, (uint64_t)pNode->tid );
+    }
+    pu_trace_thread_exit();
+    PU_PROBE2( thread__exit, pNode->szName, pNode->tid );
+    if (pNode->ulBudgetNs)
+    {
+        pthread_mutex_lock( &mtxLock );
+        pu_thread_watch_unlink( pNode );
+        pthread_mutex_unlock( &mtxLock );
+    }
+    pSelf = nullptr;
 #if defined(PUTHREAD_DEBUGGING)
+    pthread_mutex_lock( &mtxLock );
     for (auto it = vecCtxt.begin(); it != vecCtxt.end(); ) {
         if (*it == pNode) {
             vecCtxt.erase(it);
@@ -165,15 +256,143 @@ static void pu_thread_exit_handler( void* pArg )
             ++it;
         }
     }
+    pthread_mutex_unlock( &mtxLock );
 #endif // defined(PUTHREAD_DEBUGGING)
     free( pNode );
     pNode = nullptr;
+
+    /* A few instructions, a spinlock is enough */
+    pu_spinlock_lock( &lckThreadCount );
     ASSERT(uiThreadCount > 0);
     uiThreadCount--;
-    pthread_mutex_unlock( &mtxLock );
+    pu_spinlock_unlock( &lckThreadCount );
 }
 /* pu_thread_exit_handler */
 
+/* Thread group member: held until the whole group exists */
+static void* pu_thread_group_entry( void* pArg )
+{
+    pu_thread_member_t* pMember = (pu_thread_member_t*)pArg;
+    pu_thread_group_t*  pGroup  = pMember->pGroup;
+
+    pu_latch_wait( &(pGroup->latStart), PU_FUTEX_WAIT_FOREVER );
+    if (!__atomic_load_n( &(pGroup->bAbort), __ATOMIC_ACQUIRE ))
+    {
+        pGroup->fctMain( pGroup, pMember->uiIndex, pGroup->pArg );
+    }
+    return (nullptr);
+}
+/* pu_thread_group_entry */
+
+/* Takes a thread off the watch list. Lock held. */
+static void pu_thread_watch_unlink( pu_thread_context_t* pNode )
+{
+    if (pNode->pWatchPrev)
+    {
+        pNode->pWatchPrev->pWatchNext = pNode->pWatchNext;
+    }
+    else
+    {
+        pWatchList = pNode->pWatchNext;
+    }
+    if (pNode->pWatchNext)
+    {
+        pNode->pWatchNext->pWatchPrev = pNode->pWatchPrev;
+    }
+    pNode->pWatchPrev = nullptr;
+    pNode->pWatchNext = nullptr;
+    pNode->ulBudgetNs = 0;
+}
+/* pu_thread_watch_unlink */
+
+/* Monitor timer callback. A thread on the list has not run its exit handler, so it can be signalled. */
+static void pu_thread_monitor_scan( void* pCookie )
+{
+    pu_thread_hang_t     pHangs[PU_THREAD_MONITOR_REPORTS];
+    size_t               uiHangs = 0;
+    pu_thread_context_t* pNode;
+    uint64_t             ulNow = timespec_now_ns_monotonic();
+    uint64_t             ulBeat;
+    size_t               i;
+
+    (void)pCookie;
+    pthread_mutex_lock( &mtxLock );
+    if (!bMonitorOn)
+    {
+        pthread_mutex_unlock( &mtxLock );
+        return;
+    }
+    uiMonitorScans++;
+    for (pNode = pWatchList; pNode; pNode = pNode->pWatchNext)
+    {
+        ulBeat = __atomic_load_n( &(pNode->ulBeat), __ATOMIC_RELAXED );
+        if (ulBeat != pNode->ulSeenBeat)
+        {
+            pNode->ulSeenBeat = ulBeat;
+            pNode->ulSeenNs   = ulNow;
+            pNode->bReported  = false;
+        }
+        else if ((!pNode->bReported) && ((ulNow - pNode->ulSeenNs) > pNode->ulBudgetNs) &&
+                 (uiHangs < PU_THREAD_MONITOR_REPORTS))
+        {
+            pNode->bReported = true;
+            pHangs[uiHangs].szName      = pNode->szName;
+            pHangs[uiHangs].iTid        = (int)pNode->tid;
+            pHangs[uiHangs].uiStalledMs = (size_t)((ulNow - pNode->ulSeenNs) / 1000000ULL);
+            uiHangs++;
+            if (uiMonitorFlags & PU_THREAD_MONITOR_BACKTRACE)
+            {
+                syscall( SYS_tgkill, getpid(), pNode->tid, PU_THREAD_BACKTRACE_SIGNAL );
+            }
+        }
+    }
+    pthread_mutex_unlock( &mtxLock );
+
+    /* Outside the lock, the report may take its time */
+    for (i = 0; i < uiHangs; i++)
+    {
+        fctMonitorHang( pHangs[i].szName, pHangs[i].iTid, pHangs[i].uiStalledMs );
+    }
+
+    /* The timer does not wait for a running callback, pu_thread_monitor_stop waits for this */
+    pthread_mutex_lock( &mtxLock );
+    uiMonitorScans--;
+    pthread_mutex_unlock( &mtxLock );
+    pu_eventcount_notify_all( &ecMonitorIdle );
+}
+/* pu_thread_monitor_scan */
+
+/* Default hang report. LOG_ERROR is compiled out of release builds, hangs are not. */
+static void pu_thread_monitor_report(
+    const char* szName,
+    int         iTid,
+    size_t      uiStalledMs )
+{
+    fprintf( stderr, "PU_THREAD(monitor): %s (tid %d) no heartbeat for %zu ms\n", szName, iTid, uiStalledMs );
+}
+/* pu_thread_monitor_report */
+
+/* Runs on the hung thread. Only write() and backtrace_symbols_fd(), which do not allocate. */
+static void pu_thread_backtrace_handler( int iSignal )
+{
+    static const char szHeader[] = "PU_THREAD(backtrace): ";
+    void*             pFrames[64];
+    int               iFrames;
+    int               iErrno = errno;
+
+    (void)iSignal;
+    if (write( STDERR_FILENO, szHeader, sizeof(szHeader) - 1 ) < 0) {}
+    if (pSelf && pSelf->szName)
+    {
+        if (write( STDERR_FILENO, pSelf->szName, strlen( pSelf->szName ) ) < 0) {}
+    }
+    if (write( STDERR_FILENO, "\n", 1 ) < 0) {}
+    iFrames = backtrace( pFrames, 64 );
+    backtrace_symbols_fd( pFrames, iFrames, STDERR_FILENO );
+    errno = iErrno;
+}
+/* pu_thread_backtrace_handler */
+
 /****************************************************************************/
 /* PUBLIC FUNCTION DEFINITIONS                                              */
 /****************************************************************************/
@@ -271,7 +490,16 @@ pthread_t pu_thread_create(
                     // simply copy the name pointer. This is constant and persistent,
                     // it does not need a separate allocation
                     pNode->szName = szName;
+
+                    // Counted before the thread exists, it may exit (and uncount itself)
+                    // before pthread_create() even returns
+                    pu_spinlock_lock( &lckThreadCount );
+                    uiThreadCount++;
+                    pu_spinlock_unlock( &lckThreadCount );
+#if defined(PUTHREAD_DEBUGGING)
+                    // Held across the creation, so the exit handler cannot run before the push
                     pthread_mutex_lock( &mtxLock );
+#endif // defined(PUTHREAD_DEBUGGING)
                     iResult = pthread_create(
                         &(pNode->pid),
                         &attr,
@@ -281,6 +509,9 @@ pthread_t pu_thread_create(
                     if (0 != iResult)
                     {
                         free( pNode );
+                        pu_spinlock_lock( &lckThreadCount );
+                        uiThreadCount--;
+                        pu_spinlock_unlock( &lckThreadCount );
                     }
 
                     // Store the PID, set the system thread name. This name is 15+null long,
@@ -293,12 +524,18 @@ pthread_t pu_thread_create(
                         strncpy( szSysName, szName, 16 );
                         szSysName[15] = 0;
                         pthread_setname_np( iPid, szSysName );
-                        uiThreadCount++;
+                        if (PU_TRACE_ON())
+                        {
+                            pu_trace_event( PU_TRACE_PHASE_INSTANT, "thread_create", szName, 0, 0, 0 );
+                        }
+                        PU_PROBE2( thread__create, szName, iPid );
 #if defined(PUTHREAD_DEBUGGING)
                         vecCtxt.push_back( pNode );
 #endif // defined(PUTHREAD_DEBUGGING)
                     }
+#if defined(PUTHREAD_DEBUGGING)
                     pthread_mutex_unlock( &mtxLock );
+#endif // defined(PUTHREAD_DEBUGGING)
                 }
             }
             pthread_attr_destroy( &attr );
@@ -315,6 +552,307 @@ pthread_t pu_thread_create(
 }
 /* pu_thread_create */
 
+/**
+ * @brief   Creates a group of threads that share a barrier
+ *
+ * @param[in] pGroup      : Pointer to a valid group
+ * @param[in] uiThreads   : Number of threads
+ * @param[in] fctMain     : Member entry point
+ * @param[in] pArg        : Member argument
+ * @param[in] uiStackSize : Stack size of every member
+ * @param[in] szName      : Thread name, persistent
+ * @retval  0 for success
+ * @retval  Non-zero for failure, no member has run
+ */
+int pu_thread_group_create(
+    pu_thread_group_t*    pGroup,
+    size_t                uiThreads,
+    pu_thread_group_fct_t fctMain,
+    void*                 pArg,
+    size_t                uiStackSize,
+    const char*           szName )
+{
+    pu_thread_member_t* pMembers;
+    size_t              uiCreated = 0;
+
+    /* pre-condition */
+    ASSERT( pGroup );
+    ASSERT( (uiThreads > 0) && (uiThreads <= UINT_MAX) );
+    ASSERT( fctMain );
+    if ((!pGroup) || (0 == uiThreads) || (uiThreads > UINT_MAX) || (!fctMain))
+    {
+        return (-1);
+    }
+
+    /* One block: the start records, then the thread IDs */
+    pMembers = (pu_thread_member_t*)malloc( uiThreads * (sizeof(pu_thread_member_t) + sizeof(pthread_t)) );
+    ASSERT( nullptr != pMembers );
+    if (nullptr == pMembers)
+    {
+        return (-1);
+    }
+    pGroup->pMembers  = pMembers;
+    pGroup->pThreads  = (pthread_t*)(pMembers + uiThreads);
+    pGroup->uiThreads = uiThreads;
+    pGroup->fctMain   = fctMain;
+    pGroup->pArg      = pArg;
+    pGroup->bAbort    = 0;
+
+    /* No member may start before the barrier and the start latch are set up */
+    if (0 != pu_barrier_create( &(pGroup->barPhase), (unsigned int)uiThreads ))
+    {
+        free( pMembers );
+        pGroup->pMembers = nullptr;
+        return (-1);
+    }
+    if (0 != pu_latch_create( &(pGroup->latStart), 1 ))
+    {
+        pu_barrier_destroy( &(pGroup->barPhase) );
+        free( pMembers );
+        pGroup->pMembers = nullptr;
+        return (-1);
+    }
+
+    for (uiCreated = 0; uiCreated < uiThreads; uiCreated++)
+    {
+        pMembers[uiCreated].pGroup  = pGroup;
+        pMembers[uiCreated].uiIndex = uiCreated;
+        pGroup->pThreads[uiCreated] = pu_thread_create( pu_thread_group_entry, &(pMembers[uiCreated]), uiStackSize, szName );
+        if (0 == pGroup->pThreads[uiCreated])
+        {
+            break;
+        }
+    }
+
+    /* Release the members. If one could not be created they all exit without running */
+    if (uiCreated < uiThreads)
+    {
+        __atomic_store_n( &(pGroup->bAbort), 1, __ATOMIC_RELEASE );
+    }
+    pu_latch_count_down( &(pGroup->latStart), 1 );
+    if (uiCreated < uiThreads)
+    {
+        pGroup->uiThreads = uiCreated;
+        pu_thread_group_join( pGroup );
+        return (-1);
+    }
+    return (0);
+}
+/* pu_thread_group_create */
+
+/**
+ * @brief   Waits at the group barrier, called by a member
+ *
+ * @param[in] pGroup : Pointer to a valid group
+ * @retval  PU_BARRIER_SERIAL_THREAD for one member per phase, 0 for the others
+ */
+int pu_thread_group_barrier( pu_thread_group_t* pGroup )
+{
+    ASSERT( pGroup );
+    return (pu_barrier_wait( &(pGroup->barPhase) ));
+}
+/* pu_thread_group_barrier */
+
+/**
+ * @brief   Waits for all the members to exit, and releases the group
+ *
+ * @param[in] pGroup : Pointer to a valid group
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_thread_group_join( pu_thread_group_t* pGroup )
+{
+    int    iResult = 0;
+    size_t i;
+
+    ASSERT( pGroup );
+    if ((!pGroup) || (!pGroup->pMembers))
+    {
+        return (-1);
+    }
+    for (i = 0; i < pGroup->uiThreads; i++)
+    {
+        if (0 != pthread_join( pGroup->pThreads[i], nullptr ))
+        {
+            iResult = -1;
+        }
+    }
+    pu_barrier_destroy( &(pGroup->barPhase) );
+    free( pGroup->pMembers );
+    pGroup->pMembers  = nullptr;
+    pGroup->pThreads  = nullptr;
+    pGroup->uiThreads = 0;
+    return (iResult);
+}
+/* pu_thread_group_join */
+
+/**
+ * @brief   Records progress of the calling thread
+ */
+void pu_thread_heartbeat( void )
+{
+    pu_thread_context_t* pNode = pSelf;
+
+    /* Single writer, so no read-modify-write is needed */
+    if (pNode)
+    {
+        __atomic_store_n( &(pNode->ulBeat), pNode->ulBeat + 1, __ATOMIC_RELAXED );
+    }
+}
+/* pu_thread_heartbeat */
+
+/**
+ * @brief   Puts the calling thread under watch, or takes it off
+ *
+ * @param[in] uiBudgetMs : Longest expected gap between heartbeats, 0 to stop watching
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_thread_watch( size_t uiBudgetMs )
+{
+    pu_thread_context_t* pNode = pSelf;
+
+    if (!pNode)
+    {
+        return (-1);
+    }
+    pu_thread_heartbeat();
+    pthread_mutex_lock( &mtxLock );
+    if (0 == uiBudgetMs)
+    {
+        if (pNode->ulBudgetNs)
+        {
+            pu_thread_watch_unlink( pNode );
+        }
+    }
+    else
+    {
+        if (!pNode->ulBudgetNs)
+        {
+            pNode->pWatchPrev = nullptr;
+            pNode->pWatchNext = pWatchList;
+            if (pWatchList)
+            {
+                pWatchList->pWatchPrev = pNode;
+            }
+            pWatchList = pNode;
+        }
+        pNode->ulBudgetNs = (uint64_t)uiBudgetMs * 1000000ULL;
+        pNode->ulSeenBeat = pNode->ulBeat;
+        pNode->ulSeenNs   = timespec_now_ns_monotonic();
+        pNode->bReported  = false;
+    }
+    pthread_mutex_unlock( &mtxLock );
+    return (0);
+}
+/* pu_thread_watch */
+
+/**
+ * @brief   Starts the hang monitor
+ *
+ * @param[in] uiPeriodMs : Scan period
+ * @param[in] fctHang    : Hang report, nullptr for the default
+ * @param[in] uiFlags    : PU_THREAD_MONITOR_BACKTRACE, or 0
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ *
+ * @par Description
+ * backtrace() loads its unwinder on first use, which allocates. It is called once here so that
+ * the signal handler never does.
+ */
+int pu_thread_monitor_start(
+    size_t               uiPeriodMs,
+    pu_thread_hang_fct_t fctHang,
+    unsigned int         uiFlags )
+{
+    struct sigaction saBacktrace;
+    void*            pFrame;
+
+    if ((hMonitor) || (0 != pu_thread_init()))
+    {
+        return (-1);
+    }
+    fctMonitorHang = fctHang ? fctHang : pu_thread_monitor_report;
+    uiMonitorFlags = uiFlags;
+    if ((uiFlags & PU_THREAD_MONITOR_BACKTRACE) && (!bBacktraceSet))
+    {
+        backtrace( &pFrame, 1 );
+        memset( &saBacktrace, 0, sizeof(saBacktrace) );
+        saBacktrace.sa_handler = pu_thread_backtrace_handler;
+        saBacktrace.sa_flags   = SA_RESTART;
+        sigemptyset( &(saBacktrace.sa_mask) );
+        if (0 != sigaction( PU_THREAD_BACKTRACE_SIGNAL, &saBacktrace, nullptr ))
+        {
+            LOG_ERROR( "PU_THREAD(monitor): cannot install signal %d\n", PU_THREAD_BACKTRACE_SIGNAL );
+            return (-1);
+        }
+        bBacktraceSet = true;
+    }
+    pthread_mutex_lock( &mtxLock );
+    bMonitorOn = true;
+    pthread_mutex_unlock( &mtxLock );
+    hMonitor = putimer_create( PUTIMER_TYPE_PERIODIC, pu_thread_monitor_scan, uiPeriodMs, nullptr );
+    if ((!hMonitor) || (0 != putimer_start( hMonitor )))
+    {
+        LOG_ERROR( "PU_THREAD(monitor): no timer for a %zu ms period\n", uiPeriodMs );
+        pthread_mutex_lock( &mtxLock );
+        bMonitorOn = false;
+        pthread_mutex_unlock( &mtxLock );
+        if (hMonitor)
+        {
+            putimer_delete( hMonitor );
+            hMonitor = nullptr;
+        }
+        return (-1);
+    }
+    return (0);
+}
+/* pu_thread_monitor_start */
+
+/**
+ * @brief   Stops the hang monitor
+ *
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ *
+ * @par Description
+ * The scan runs outside the timer lock, so deleting the timer does not wait for one that is
+ * running. Wait for it here, after that no report is made. The backtrace handler stays: a
+ * signal a scan has already sent may still be on its way, and the default action would kill
+ * the process.
+ */
+int pu_thread_monitor_stop( void )
+{
+    unsigned int uiKey;
+    size_t       uiScans;
+
+    if (!hMonitor)
+    {
+        return (-1);
+    }
+    pthread_mutex_lock( &mtxLock );
+    bMonitorOn = false;
+    pthread_mutex_unlock( &mtxLock );
+    putimer_delete( hMonitor );
+    hMonitor = nullptr;
+
+    for (;;)
+    {
+        uiKey = pu_eventcount_prepare_wait( &ecMonitorIdle );
+        pthread_mutex_lock( &mtxLock );
+        uiScans = uiMonitorScans;
+        pthread_mutex_unlock( &mtxLock );
+        if (0 == uiScans)
+        {
+            pu_eventcount_cancel_wait( &ecMonitorIdle );
+            break;
+        }
+        pu_eventcount_wait( &ecMonitorIdle, uiKey, PU_FUTEX_WAIT_FOREVER );
+    }
+    return (0);
+}
+/* pu_thread_monitor_stop */
+
 /**
  * \brief   Init all the posix utilities
  *
@@ -30,6 +30,8 @@
 #include <string.h>
 #include "putimer.h"
 #include "posutils.h"
+#include "puseqlock.h"
+#include "puprobes.h"
 #include "logging.h"
 
 /**** Definitions ************************************************************/
@@ -39,10 +41,21 @@
     #define PUTIMER_DEBUG(...)
 #endif
 
+/* Debug builds run the timer mutexes through the lock order checker, which traps self
+ * deadlocks (e.g. deleting a lock-able timer from its own callback) and any lock order
+ * inversion. Release builds use plain fast mutexes.
+ */
+#if !defined(NDEBUG)
+    #define PUTIMER_MUTEX_ATTR PU_MUTEX_ATTR_LOCKDEP
+#else
+    #define PUTIMER_MUTEX_ATTR 0
+#endif
+
 /* Handle macros */
 #define PUTIMER_HND_CREATE(idx,tag) (putimer_hnd_t)((((size_t)(idx)) << 16) + tag)
 #define PUTIMER_HND_GET_IDX(hnd)    (uint16_t)(((size_t)(hnd)) >> 16)
 #define PUTIMER_HND_GET_TAG(hnd)    (uint16_t)(((size_t)(hnd)) &  0x000ffff)
+#define PUTIMER_TS_NS(ts)           ((((uint64_t)(ts).tv_sec) * 1000000000ULL) + (uint64_t)(ts).tv_nsec)
 
 /**
  * A simple limit is imposed for a few reasons. If the system is using too many
@@ -93,6 +106,10 @@ typedef struct putimer_tmr_tag
     int                     iUseAbsTime;
     void*                   pCookie;
     bool                   bLockable;
+    bool                    bInplace;
+
+    /* Callback data copied in by putimer_create_inplace, pCookie points at it */
+    uint64_t                aulData[PUTIMER_INPLACE_SIZE / sizeof(uint64_t)];
 
     /* Pointer for list */
     struct putimer_tmr_tag* pNext;
@@ -113,6 +130,8 @@ static pthread_mutex_t  mtxWake;
 static pthread_cond_t   cndWake;
 static size_t           uiAllocatedTimers = 0;
 static putimer_tmr_t    pTimerList[PUTIMER_MAX_RESOURCES];
+static pu_seqlock_t     seqInfo = PU_SEQLOCK_INITIALIZER;
+static putimer_info_t   stInfo;
 
 /**** Local function prototypes (NB Use static modifier) ********************/
 static uint16_t putimer_alloc_id( void );
@@ -123,150 +142,24 @@ static int      putimer_remove(
     int*           pWasActive,
     size_t*        pRemainingMs );
 static int      putimer_add( putimer_tmr_t* pTmr );
+static void     putimer_publish( size_t uiFired );
 putimer_hnd_t      putimer_create_local(
     putimer_type_t         enType,
     putimer_callback_fct_t fctCallback,
     size_t                 uiPeriodMs,
     void*                  pCookie,
-    bool                  bLockable );
+    bool                  bLockable,
+    const void*            pData,
+    size_t                 uiSize );
 
 /****************************************************************************/
 /* TIMESPEC FUNCTION DEFINITIONS                                            */
 /****************************************************************************/
 
-/* is A after B */
-int timespec_is_a_after_b(
-    struct timespec* pA,
-    struct timespec* pB )
-{
-    /* test seconds first - easy */
-    int iIsAfter = (pA->tv_sec > pB->tv_sec) ? 1 : 0;
-
-    /* test case where seconds are the same */
-    if ((!iIsAfter) && (pA->tv_sec == pB->tv_sec))
-    {
-        iIsAfter = (pA->tv_nsec > pB->tv_nsec) ? 1 : 0;
-    }
-
-    /* all cases covered */
-    return (iIsAfter);
-}
-/* timespec_is_a_after_b */
-
-/* subtract b from a (a is definitely after b) */
-void timespec_a_sub_b(
-    struct timespec* pA,
-    struct timespec* pB,
-    struct timespec* pRes )
-{
-    pRes->tv_sec = pA->tv_sec - pB->tv_sec;
-    if (pA->tv_nsec >= pB->tv_nsec)
-    {
-        pRes->tv_nsec = (pA->tv_nsec - pB->tv_nsec);
-    }
-    else
-    {
-        pRes->tv_nsec = (1000000000 - pB->tv_nsec) + pA->tv_nsec;
-        pRes->tv_sec -= 1;
-    }
-}
-/* timespec_a_sub_b */
-
-/* Difference between A and B in milliseconds */
-size_t timespec_a_sub_b_ms(
-    struct timespec* pA,
-    struct timespec* pB )
-{
-    struct timespec tsDiff;
-    size_t          lMs;
-    timespec_a_sub_b( pA, pB, &tsDiff );
-    lMs  = (size_t)(tsDiff.tv_sec * 1000);
-    lMs += (size_t)(tsDiff.tv_nsec / 1000000);
-    return (lMs);
-}
-/* timespec_a_sub_b_ms */
-
-/* Difference between A and B in microseconds */
-size_t timespec_a_sub_b_us(
-    struct timespec* pA,
-    struct timespec* pB )
-{
-    struct timespec tsDiff;
-    size_t          lUs;
-    timespec_a_sub_b( pA, pB, &tsDiff );
-    lUs  = (size_t)(tsDiff.tv_sec * 1000000);
-    lUs += (size_t)(tsDiff.tv_nsec / 1000);
-    return (lUs);
-
-}
-/* timespec_a_sub_b_us */
-
-/* subtract b from a (a is definitely after b) */
-void timespec_add_ms( struct timespec* pTs, size_t ulMs )
-{
-    long lNs;
-
-    pTs->tv_sec += (time_t)(ulMs / 1000);
-    ulMs -= ((ulMs / 1000) * 1000);
-    lNs = (long)(ulMs * 1000000);
-    pTs->tv_nsec += lNs;
-    if (pTs->tv_nsec > 1000000000)
-    {
-        pTs->tv_sec += 1;
-        pTs->tv_nsec -= 1000000000;
-    }
-}
-/* timespec_add_ms */
-
-/**
- * @brief  Create a timespec = ("now" + ms) - using CLOCK_REALTIME
- *
- * @param[out] pTs : Pointer to timespec
- * @param[in]  lMs : Millisecond value
- *
- * @pre     none
- * @post    none
- *
- * @par Description
- * Populates the time spec with the current ("now") time plus the specified
- * number of milliseconds. This is typically used in "wait until" timeout calculations.
- *
- * @note
- * Uses CLOCK_REALTIME
- */
-void timespec_now_plus_ms(
-    struct timespec* pTs,
-    size_t           ulMs )
-{
-    clock_gettime( CLOCK_REALTIME, pTs );
-    timespec_add_ms( pTs, ulMs );
-}
-/* timespec_now_plus_ms */
-
-/**
- * @brief  Create a timespec = ("now" + ms) - using CLOCK_MONOTONIC
- *
- * @param[out] pTs : Pointer to timespec
- * @param[in]  lMs : Millisecond value
- *
- * @pre     none
- * @post    none
- *
- * @par Description
- * Populates the time spec with the current ("now") time plus the specified
- * number of milliseconds. This is typically used in "wait until" timeout calculations.
- *
- * @note
- * Uses CLOCK_MONOTONIC
- */
-void timespec_now_plus_ms_monotonic(
-    struct timespec* pTs,
-    size_t           ulMs )
-{
-    clock_gettime( CLOCK_MONOTONIC, pTs );
-    timespec_add_ms( pTs, ulMs );
-}
-/* timespec_now_plus_ms_monotonic */
+/* The small hot ones, unless the build inlines them in the header */
+#if !defined(PU_INLINE)
+    #include "putimer_inline.h"
+#endif
 
 /**
  * @brief Converts a timespec clock base
@@ -413,6 +306,10 @@ void* putimer_thread( void* pArg )
     size_t                 uiCalled;
     putimer_callback_fct_t pFct;
     void*                  pCookie;
+    uint64_t               aulData[PUTIMER_INPLACE_SIZE / sizeof(uint64_t)];
+    uint64_t               ulStartNs;
+    uint16_t               usId;
+    putimer_hnd_t          hndTmr;
 
     // Kill compiler warning
     (void)pArg;
@@ -426,7 +323,7 @@ void* putimer_thread( void* pArg )
         /* Take the wake lock - all queue head modification is done under this lock 
          * check for next to expire, calculate the time to sleep 
          */
-        pthread_mutex_lock( &mtxWake );
+        pu_mutex_lock( &mtxWake );
         if (pQueue)
         {
             clock_gettime( CLOCK_MONOTONIC, &tsNow );
@@ -465,23 +362,33 @@ void* putimer_thread( void* pArg )
                 /* Move the state to "fired", and add to call list */
                 pCurr->enState = PUTIMER_STATE_FIRED;
                 pCallList[uiToCall++] = pCurr;
+                if (PU_TRACE_ON())
+                {
+                    pu_trace_event( PU_TRACE_PHASE_INSTANT, "timer", "timer fire", 0, 0, pCurr->usID );
+                }
+                PU_PROBE3(
+                    timer__fire,
+                    PUTIMER_HND_CREATE( pCurr->usID, pCurr->usTag ),
+                    PUTIMER_TS_NS( pCurr->tsEnd ),
+                    PUTIMER_TS_NS( tsNow ) - PUTIMER_TS_NS( pCurr->tsEnd ) );
                 pPrev = pCurr;
             }
             if (pPrev)
             {
                 pPrev->pNext = nullptr;
                 pQueue       = pCurr;
+                putimer_publish( uiToCall );
             }
         }
 
         /* Now release the wake lock */
-        pthread_mutex_unlock( &mtxWake );
+        pu_mutex_unlock( &mtxWake );
 
         /* thread not killed, and there are timers to notify (uiToCall > 0) */
         if ((!iKillThread) && (uiToCall > 0))
         {
             /* Lock, check for deadlock */
-            PU_MUTEX_LOCK_ERROR( &mtxLock );
+            pu_mutex_lock( &mtxLock );
 
             /* Manage the callbacks */
             for (uiCalled = 0; uiCalled < uiToCall; uiCalled++)
@@ -499,28 +406,46 @@ void* putimer_thread( void* pArg )
                     pCallList[uiCalled]->enState = PUTIMER_STATE_IDLE;
                     if (PUTIMER_TYPE_PERIODIC == (pCallList[uiCalled])->enType)
                     {
+                        pu_mutex_lock( &mtxWake );
                         putimer_add( pCallList[uiCalled] );
+                        pu_mutex_unlock( &mtxWake );
                     }
 
                     /* Now call:
                      * - inside the lock if lockable
                      * - else outside the lock
                      */
+                    usId      = (pCallList[uiCalled])->usID;
+                    hndTmr    = PUTIMER_HND_CREATE( usId, (pCallList[uiCalled])->usTag );
+                    ulStartNs = PU_TRACE_ON() ? timespec_now_ns_monotonic() : 0;
+                    PU_PROBE2( timer__callback__entry, hndTmr, (pCallList[uiCalled])->pFct );
+                    pFct = (pCallList[uiCalled])->pFct;
                     if (pCallList[uiCalled]->bLockable)
                     {
-                        (pCallList[uiCalled])->pFct( (pCallList[uiCalled])->pCookie );
+                        pFct( (pCallList[uiCalled])->pCookie );
                     }
                     else
                     {
-                        pFct    = (pCallList[uiCalled])->pFct;
+                        /* Outside the lock the slot can be deleted and reused, call on a copy */
                         pCookie = (pCallList[uiCalled])->pCookie;
+                        if ((pCallList[uiCalled])->bInplace)
+                        {
+                            memcpy( aulData, (pCallList[uiCalled])->aulData, sizeof(aulData) );
+                            pCookie = aulData;
+                        }
                         if (pFct)
                         {
-                            pthread_mutex_unlock( &mtxLock );
+                            pu_mutex_unlock( &mtxLock );
                             pFct( pCookie );
-                            PU_MUTEX_LOCK_ERROR( &mtxLock );
+                            pu_mutex_lock( &mtxLock );
                         }
                     }
+                    PU_PROBE2( timer__callback__return, hndTmr, pFct );
+                    if (ulStartNs)
+                    {
+                        pu_trace_event( PU_TRACE_PHASE_COMPLETE, "timer", "timer callback",
+                            ulStartNs, timespec_now_ns_monotonic() - ulStartNs, usId );
+                    }
                 }
 
 #if !defined(NDEBUG)
@@ -542,7 +467,7 @@ void* putimer_thread( void* pArg )
             }
 
             /* Done, unlock */
-            pthread_mutex_unlock( &mtxLock );
+            pu_mutex_unlock( &mtxLock );
         }
     }
 
@@ -606,6 +531,7 @@ int putimer_remove(
                 {
                     pQueue = pCurr->pNext;
                     iHeadUpdated = 1;
+                    putimer_publish( 0 );
                 }
 
                 /* Check if the end time is AFTER the current time. If it is then subtract the
@@ -643,7 +569,7 @@ int putimer_remove(
  * retval  0 if the head is unchanged
  * retval  non-zero if the head was updated
  *
- * pre     The caller holds the mtxLock mutex
+ * pre     The caller holds the mtxLock and mtxWake mutexes
  * post    none
  *
  * Description
@@ -691,11 +617,49 @@ int putimer_add( putimer_tmr_t* pTmr )
         }
         pTmr->pNext   = pCurr;
         pTmr->enState = PUTIMER_STATE_WAITING;
+        if (PU_TRACE_ON())
+        {
+            pu_trace_event( PU_TRACE_PHASE_INSTANT, "timer", "timer arm", 0, 0, pTmr->usID );
+        }
+        PU_PROBE3( timer__start, PUTIMER_HND_CREATE( pTmr->usID, pTmr->usTag ), PUTIMER_TS_NS( pTmr->tsEnd ), pTmr->uiPeriodMs );
+        if (iHeadUpdated)
+        {
+            putimer_publish( 0 );
+        }
     }
     return (iHeadUpdated);
 }
 /* putimer_add */
 
+/**
+ * putimer_publish
+ *
+ * param   uiFired: number of timers just taken off the queue
+ * retval  none
+ *
+ * pre     The caller holds the mtxWake mutex. This makes it the single seqlock writer.
+ * post    none
+ *
+ * Description
+ * Publishes the queue head (next deadline) and the statistics to lock-free readers
+ */
+void putimer_publish( size_t uiFired )
+{
+    pu_seqlock_write_begin( &seqInfo );
+    if (pQueue)
+    {
+        stInfo.tsNextDeadline = pQueue->tsEnd;
+        stInfo.iHasDeadline   = 1;
+    }
+    else
+    {
+        stInfo.iHasDeadline   = 0;
+    }
+    stInfo.uiFiredCount += uiFired;
+    pu_seqlock_write_end( &seqInfo );
+}
+/* putimer_publish */
+
 /**
  * Local timer create function
  * @param   enType      :timer type
@@ -703,6 +667,8 @@ int putimer_add( putimer_tmr_t* pTmr )
  * @param   uiPeriodMs  :timeout period in ms
  * @param   pCookie     :optional user data
  * @param   bLockable   :lockable or not
+ * @param   pData       :data to copy into the timer, NULL for none (pCookie is used)
+ * @param   uiSize      :size of pData, up to PUTIMER_INPLACE_SIZE
  *
  * @retval  Valid handle or nullptr
  *
@@ -714,7 +680,9 @@ putimer_hnd_t putimer_create_local(
     putimer_callback_fct_t fctCallback,
     size_t                 uiPeriodMs,
     void*                  pCookie,
-    bool                  bLockable )
+    bool                  bLockable,
+    const void*            pData,
+    size_t                 uiSize )
 {
     putimer_tmr_t* pTmr;
     uint16_t       usID;
@@ -725,15 +693,16 @@ putimer_hnd_t putimer_create_local(
     ASSERT(
         (PUTIMER_TYPE_SINGLESHOT == enType) ||
         (PUTIMER_TYPE_PERIODIC   == enType) );
+    ASSERT( uiSize <= PUTIMER_INPLACE_SIZE );
 
     /* adjust timeout */
     uiPeriodMs = (uiPeriodMs < PUTIMER_MIN_TIMEOUT) ? PUTIMER_MIN_TIMEOUT : uiPeriodMs;
 
     /* only create it everything is OK */
-    if ((iIsInit) && (fctCallback) &&
+    if ((iIsInit) && (fctCallback) && (uiSize <= PUTIMER_INPLACE_SIZE) &&
         ((PUTIMER_TYPE_SINGLESHOT == enType) || (PUTIMER_TYPE_PERIODIC   == enType)))
     {
-        PU_MUTEX_LOCK_ERROR( &mtxLock );
+        pu_mutex_lock( &mtxLock );
         WARN( uiAllocatedTimers < PUTIMER_MAX_RESOURCES );
         if (uiAllocatedTimers < PUTIMER_MAX_RESOURCES)
         {
@@ -761,17 +730,24 @@ putimer_hnd_t putimer_create_local(
             pTmr->iUseAbsTime = 0;
             pTmr->pNext       = nullptr;
             pTmr->bLockable   = bLockable;
+            pTmr->bInplace    = (nullptr != pData);
+            if (pTmr->bInplace)
+            {
+                memcpy( pTmr->aulData, pData, uiSize );
+                pTmr->pCookie = pTmr->aulData;
+            }
             uiAllocatedTimers++;
 
             /* Build the handle */
             hndTmr = PUTIMER_HND_CREATE( usID, usRollingTag );
+            PU_PROBE4( timer__create, hndTmr, enType, uiPeriodMs, fctCallback );
             PUTIMER_DEBUG(
                 "Created: t=%d, %s, hnd=%zx\n",
                 enType,
                 ((true == bLockable) ? "lockable" : "reentrant"),
                 ((size_t)hndTmr) );
         }
-        pthread_mutex_unlock( &mtxLock );
+        pu_mutex_unlock( &mtxLock );
     }
     return (hndTmr);
 }
@@ -796,15 +772,16 @@ putimer_hnd_t putimer_create_local(
 int putimer_init( void )
 {
     int                 iResult = 0;
-    pthread_mutexattr_t mattr;
     pthread_condattr_t  cattr;
+    pu_mutex_attr_t     stLockAttr = PU_MUTEX_ATTR_INITIALIZER( PUTIMER_MUTEX_ATTR );
+    pu_mutex_attr_t     stWakeAttr = PU_MUTEX_ATTR_INITIALIZER( PUTIMER_MUTEX_ATTR );
 
     /* simple initialisation test, could use glib atomics if ther is a concern... */
     if (!iIsInit)
     {
-        /* Use an error mutex to trap deadlocks */
+        /* Fast mutex, deadlocks are trapped by the lock order checker in debug builds */
         iIsInit = 1;
-        iResult = pu_mutex_create_type( &mtxLock, PU_MUTEX_TYPE_ERROR );
+        iResult = pu_mutex_create_attr( &mtxLock, PU_MUTEX_TYPE_FAST, &stLockAttr );
         ASSERT( 0 == iResult );
 
         /* condition, set to use the monotonic clock */
@@ -820,16 +797,17 @@ int putimer_init( void )
         /* mutex - in the condition is OK */
         if (0 == iResult)
         {
-            pthread_mutexattr_init( &mattr );
-            iResult = pthread_mutex_init( &mtxWake, &mattr );
+            iResult = pu_mutex_create_attr( &mtxWake, PU_MUTEX_TYPE_FAST, &stWakeAttr );
             ASSERT( 0 == iResult );
-            pthread_mutexattr_destroy( &mattr );
         }
 
         /* clear the ID array and timer list */
         memset( pTimerId, 0, PUTIMER_RES_MULTIPLIER * sizeof(uint32_t) );
         memset( pTimerList, 0, PUTIMER_MAX_RESOURCES * sizeof(putimer_tmr_t) );
         uiAllocatedTimers = 0;
+        pQueue = nullptr;
+        memset( &stInfo, 0, sizeof(stInfo) );
+        pu_seqlock_init( &seqInfo );
 
         /* Create the thread */
         if (0 == iResult)
@@ -870,17 +848,19 @@ int putimer_exit( void )
 
         /* wait for thread to exit, then kill all timer resources */
         pthread_join( pidTmrThread, nullptr );
-        PU_MUTEX_LOCK_ERROR( &mtxLock );
+        pu_mutex_lock( &mtxLock );
         memset( pTimerId, 0, PUTIMER_RES_MULTIPLIER * sizeof(uint32_t) );
         memset( pTimerList, 0, PUTIMER_MAX_RESOURCES * sizeof(putimer_tmr_t) );
         uiAllocatedTimers = 0;
+        pQueue = nullptr;
+        putimer_publish( 0 );
 
         /* kill the wake mutex and condition */
-        pthread_mutex_destroy( &mtxWake );
+        pu_mutex_destroy( &mtxWake );
         pthread_cond_destroy( &cndWake );
 
         /* No need to destroy the simple lock mutex */
-        pthread_mutex_unlock( &mtxLock );
+        pu_mutex_unlock( &mtxLock );
     }
     return (0);
 }
@@ -910,7 +890,7 @@ putimer_hnd_t putimer_create(
     void*              pCookie )
 {
     /* Create non-lockable */
-    return (putimer_create_local( enType, fctCallback, uiPeriodMs, pCookie, false ));
+    return (putimer_create_local( enType, fctCallback, uiPeriodMs, pCookie, false, nullptr, 0 ));
 }
 /* putimer_create */
 
@@ -944,10 +924,37 @@ putimer_hnd_t putimer_create_lockable(
     void*                  pCookie )
 {
     /* Create lockable */
-    return (putimer_create_local( enType, fctCallback, uiPeriodMs, pCookie, true ));
+    return (putimer_create_local( enType, fctCallback, uiPeriodMs, pCookie, true, nullptr, 0 ));
 }
 /* putimer_create_lockable */
 
+/**
+ * @brief   Creates a timer resource that holds its callback data
+ *
+ * @param   enType      :timer type
+ * @param   fctCallback :function to call on expiration
+ * @param   uiPeriodMs  :timeout period in ms
+ * @param   pData       :callback data, copied into the timer
+ * @param   uiSize      :size of the data, up to PUTIMER_INPLACE_SIZE
+ * @param   bLockable   :lock-able (see putimer_create_lockable) or not (see putimer_create)
+ * @retval  non-NULL    : Valid handle
+ * @retval  NULL        : Failure
+ */
+putimer_hnd_t putimer_create_inplace(
+    putimer_type_t         enType,
+    putimer_callback_fct_t fctCallback,
+    size_t                 uiPeriodMs,
+    const void*            pData,
+    size_t                 uiSize,
+    bool                   bLockable )
+{
+    ASSERT( pData );
+    return ((pData) ?
+        putimer_create_local( enType, fctCallback, uiPeriodMs, nullptr, bLockable, pData, uiSize ) :
+        nullptr);
+}
+/* putimer_create_inplace */
+
 /**
  * @brief   Delete a timer resource
  *
@@ -976,7 +983,7 @@ int putimer_delete( putimer_hnd_t hndTimer )
     if (usIdx < PUTIMER_MAX_RESOURCES)
     {
         /* Lock, check tag. Valid (non-stale) handle, do good things */
-        PU_MUTEX_LOCK_ERROR( &mtxLock );
+        pu_mutex_lock( &mtxLock );
         usTag = PUTIMER_HND_GET_TAG( hndTimer );
         if (usTag == pTimerList[usIdx].usTag)
         {
@@ -986,9 +993,9 @@ int putimer_delete( putimer_hnd_t hndTimer )
                 pTmr = &(pTimerList[usIdx]);
 
                 /* This may update pQueue, do it under wake lock */
-                pthread_mutex_lock( &mtxWake );
+                pu_mutex_lock( &mtxWake );
                 iUpdateQ = putimer_remove( pTmr, &iActive, &uiMsLeft );
-                pthread_mutex_unlock( &mtxWake );
+                pu_mutex_unlock( &mtxWake );
 
                 /* Release the resources */
                 putimer_free_id( pTmr->usID );
@@ -1011,7 +1018,7 @@ int putimer_delete( putimer_hnd_t hndTimer )
 #endif /* !defined(NDEBUG) */
 
         /* unlock */
-        pthread_mutex_unlock( &mtxLock );
+        pu_mutex_unlock( &mtxLock );
     }
     return (iRet);
 }
@@ -1056,15 +1063,15 @@ int putimer_set_period(
         uiPeriodMs = (uiPeriodMs < PUTIMER_MIN_TIMEOUT) ? PUTIMER_MIN_TIMEOUT : uiPeriodMs;
 
         /* Lock, check tag. Valid (non-stale) handle, do good things */
-        PU_MUTEX_LOCK_ERROR( &mtxLock );
+        pu_mutex_lock( &mtxLock );
         usTag = PUTIMER_HND_GET_TAG( hndTimer );
         if (usTag == pTimerList[usIdx].usTag)
         {
             /* Stop timer */
             pTmr = &(pTimerList[usIdx]);
-            pthread_mutex_lock( &mtxWake );
+            pu_mutex_lock( &mtxWake );
             iUpdateQ = putimer_remove( pTmr, &iActive, &uiRemainingMs );
-            pthread_mutex_unlock( &mtxWake );
+            pu_mutex_unlock( &mtxWake );
 
             pTmr->uiPeriodMs = uiPeriodMs;
             if (iUpdateQ)
@@ -1082,7 +1089,7 @@ int putimer_set_period(
 #endif /* !defined(NDEBUG) */
 
         /* unlock */
-        pthread_mutex_unlock( &mtxLock );
+        pu_mutex_unlock( &mtxLock );
     }
     return (iRet);
 }
@@ -1125,7 +1132,7 @@ int putimer_set_wake_time(
     if (usIdx < PUTIMER_MAX_RESOURCES)
     {
         /* Lock, check tag. Valid (non-stale) handle, do good things */
-        PU_MUTEX_LOCK_ERROR( &mtxLock );
+        pu_mutex_lock( &mtxLock );
         usTag = PUTIMER_HND_GET_TAG( hndTimer );
         if (usTag == pTimerList[usIdx].usTag)
         {
@@ -1136,9 +1143,9 @@ int putimer_set_wake_time(
                 /* use absolute time for this. This will modify the queue so
                  * we have to do it under the condition lock
                  */
-                pthread_mutex_lock( &mtxWake );
+                pu_mutex_lock( &mtxWake );
                 iUpdateQ = putimer_remove( pTmr, &iActive, &uiRemainingMs );
-                pthread_mutex_unlock( &mtxWake );
+                pu_mutex_unlock( &mtxWake );
 
                 /* Convert from monotonic to realtime */
                 pTmr->tsEnd       = *pWake;
@@ -1160,7 +1167,7 @@ int putimer_set_wake_time(
 #endif /* !defined(NDEBUG) */
 
         /* unlock */
-        pthread_mutex_unlock( &mtxLock );
+        pu_mutex_unlock( &mtxLock );
     }
     return (iRet);
 }
@@ -1194,16 +1201,16 @@ int putimer_start( putimer_hnd_t hndTimer )
     if (usIdx < PUTIMER_MAX_RESOURCES)
     {
         /* Lock, check tag. Valid (non-stale) handle, do good things */
-        PU_MUTEX_LOCK_ERROR( &mtxLock );
+        pu_mutex_lock( &mtxLock );
         usTag = PUTIMER_HND_GET_TAG( hndTimer );
         if (usTag == pTimerList[usIdx].usTag)
         {
             /* This modifies pQueue, do it under mtxWake lock
              * If the queue is modified, wake the timer
              */
-            pthread_mutex_lock( &mtxWake );
+            pu_mutex_lock( &mtxWake );
             iUpdatedQ = putimer_add( &(pTimerList[usIdx]) );
-            pthread_mutex_unlock( &mtxWake );
+            pu_mutex_unlock( &mtxWake );
             if (iUpdatedQ)
             {
                 pthread_cond_signal( &cndWake );
@@ -1219,7 +1226,7 @@ int putimer_start( putimer_hnd_t hndTimer )
 #endif /* !defined(NDEBUG) */
 
         /* unlock */
-        pthread_mutex_unlock( &mtxLock );
+        pu_mutex_unlock( &mtxLock );
     }
     return (iRet);
 }
@@ -1255,7 +1262,7 @@ int putimer_is_active(
     if (usIdx < PUTIMER_MAX_RESOURCES)
     {
         /* Lock, check tag. Valid (non-stale) handle, do good things */
-        PU_MUTEX_LOCK_ERROR( &mtxLock );
+        pu_mutex_lock( &mtxLock );
         usTag = PUTIMER_HND_GET_TAG( hndTimer );
         if (usTag == pTimerList[usIdx].usTag)
         {
@@ -1271,7 +1278,7 @@ int putimer_is_active(
 #endif /* !defined(NDEBUG) */
 
         /* unlock */
-        pthread_mutex_unlock( &mtxLock );
+        pu_mutex_unlock( &mtxLock );
     }
     return (iRet);
 }
@@ -1310,17 +1317,18 @@ int putimer_stop(
     if (usIdx < PUTIMER_MAX_RESOURCES)
     {
         /* Lock, check tag. Valid (non-stale) handle, do good things */
-        PU_MUTEX_LOCK_ERROR( &mtxLock );
+        pu_mutex_lock( &mtxLock );
         usTag = PUTIMER_HND_GET_TAG( hndTimer );
         if (usTag == pTimerList[usIdx].usTag)
         {
             /* This modifies pQueue, do it under mtxWake lock
              * If the queue is modified, wake the timer
              */
-            pthread_mutex_lock( &mtxWake );
+            pu_mutex_lock( &mtxWake );
             uiMsLeft = 0;
             iUpdateQ = putimer_remove( &(pTimerList[usIdx]), &iActive, &uiMsLeft );
-            pthread_mutex_unlock( &mtxWake );
+            pu_mutex_unlock( &mtxWake );
+            PU_PROBE3( timer__stop, hndTimer, iActive, uiMsLeft );
             if (iUpdateQ)
             {
                 pthread_cond_signal( &cndWake );
@@ -1341,7 +1349,7 @@ int putimer_stop(
 #endif /* !defined(NDEBUG) */
 
         /* unlock */
-        pthread_mutex_unlock( &mtxLock );
+        pu_mutex_unlock( &mtxLock );
     }
 
     /* pass back the result */
@@ -1349,3 +1357,25 @@ int putimer_stop(
 }
 /* putimer_stop */
 
+/**
+ * @brief   Reads the timer service information
+ *
+ * @param[out] pInfo : Pointer to the information structure
+ * @retval  0  If successful
+ * @retval -1  On failure
+ *
+ * @par Description
+ * Lock-free, takes a consistent copy of the data published by \ref putimer_publish
+ */
+int putimer_get_info( putimer_info_t* pInfo )
+{
+    ASSERT( pInfo );
+    if (pInfo)
+    {
+        pu_seqlock_read( &seqInfo, &stInfo, pInfo, sizeof(putimer_info_t) );
+        return (0);
+    }
+    return (-1);
+}
+/* putimer_get_info */
+
@@ -0,0 +1,386 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     putrace.cpp
+ * @brief    Implementation of the event tracer
+ */
+
+/**** Includes ***************************************************************/
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include "posutils.h"
+#include "putrace.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+
+/* One event */
+typedef struct pu_trace_record_tag
+{
+    uint64_t    ulTsNs;
+    uint64_t    ulDurNs;
+    uint64_t    ulArg;
+    const char* szCat;
+    const char* szName;
+    char        cPhase;
+}   pu_trace_record_t;
+
+/* Per thread buffer. The owner is the only writer, it publishes uiCount with a release store. */
+typedef struct pu_trace_buffer_tag
+{
+    pu_trace_record_t*          pRecords;
+    size_t                      uiCapacity;
+    size_t                      uiCount;     /* Published records                     */
+    size_t                      uiDropped;   /* Written by the owner                  */
+    const char*                 szThread;    /* May be null                           */
+    int                         iTid;
+    bool                        bExited;     /* Under the lock, freed by the reset    */
+    struct pu_trace_buffer_tag* pNext;       /* Registry, under the lock              */
+}   pu_trace_buffer_t;
+
+/**** Macros ****************************************************************/
+
+/**** Static declarations ***************************************************/
+static thread_local pu_trace_buffer_t* pTraceSelf      = nullptr;
+static thread_local const char*        szTraceSelfName = nullptr;
+static pthread_mutex_t                 mtxTrace        = PTHREAD_MUTEX_INITIALIZER;
+static pu_trace_buffer_t*              pTraceList      = nullptr;
+static size_t                          uiTraceEvents   = PU_TRACE_DEFAULT_EVENTS;
+
+/**** Globals and externs ***************************************************/
+int iPuTraceOn = 0;
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static pu_trace_buffer_t* pu_trace_buffer( void );
+static void pu_trace_string( FILE* pFile, const char* szText );
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+/* The buffer of the calling thread, allocated on its first event */
+static pu_trace_buffer_t* pu_trace_buffer( void )
+{
+    pu_trace_buffer_t* pBuffer = pTraceSelf;
+
+    if (pBuffer)
+    {
+        return (pBuffer);
+    }
+    pBuffer = (pu_trace_buffer_t*)calloc( 1, sizeof(pu_trace_buffer_t) );
+    if (!pBuffer)
+    {
+        return (nullptr);
+    }
+    pBuffer->iTid     = (int)syscall( SYS_gettid );
+    pBuffer->szThread = szTraceSelfName;
+
+    pthread_mutex_lock( &mtxTrace );
+    pBuffer->uiCapacity = uiTraceEvents;
+    pBuffer->pRecords   = (pu_trace_record_t*)malloc( pBuffer->uiCapacity * sizeof(pu_trace_record_t) );
+    if (pBuffer->pRecords)
+    {
+        pBuffer->pNext = pTraceList;
+        pTraceList     = pBuffer;
+    }
+    pthread_mutex_unlock( &mtxTrace );
+
+    if (!pBuffer->pRecords)
+    {
+        free( pBuffer );
+        return (nullptr);
+    }
+    pTraceSelf = pBuffer;
+    return (pBuffer);
+}
+/* pu_trace_buffer */
+
+/* JSON string, names are normally identifiers or file:line so escaping is rare */
+static void pu_trace_string(
+    FILE*       pFile,
+    const char* szText )
+{
+    const char* pChar;
+
+    fputc( '"', pFile );
+    for (pChar = szText ? szText : ""; *pChar; pChar++)
+    {
+        if (('"' == *pChar) || ('\\' == *pChar))
+        {
+            fputc( '\\', pFile );
+            fputc( *pChar, pFile );
+        }
+        else if ((unsigned char)*pChar < 0x20)
+        {
+            fprintf( pFile, "\\u%04x", (unsigned int)(unsigned char)*pChar );
+        }
+        else
+        {
+            fputc( *pChar, pFile );
+        }
+    }
+    fputc( '"', pFile );
+}
+/* pu_trace_string */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Starts recording
+ *
+ * @param[in] uiEvents : Events per thread buffer, 0 for the default
+ * @retval  0 for success
+ * @retval  Non-zero for failure, or already started
+ */
+int pu_trace_start( size_t uiEvents )
+{
+    int iResult = -1;
+
+    pthread_mutex_lock( &mtxTrace );
+    if (0 == __atomic_load_n( &iPuTraceOn, __ATOMIC_RELAXED ))
+    {
+        uiTraceEvents = uiEvents ? uiEvents : PU_TRACE_DEFAULT_EVENTS;
+        __atomic_store_n( &iPuTraceOn, 1, __ATOMIC_RELEASE );
+        iResult = 0;
+    }
+    pthread_mutex_unlock( &mtxTrace );
+    return (iResult);
+}
+/* pu_trace_start */
+
+/**
+ * @brief   Stops recording, the events are kept
+ *
+ * @retval  0 for success
+ * @retval  Non-zero if not started
+ */
+int pu_trace_stop( void )
+{
+    return ((1 == __atomic_exchange_n( &iPuTraceOn, 0, __ATOMIC_ACQ_REL )) ? 0 : -1);
+}
+/* pu_trace_stop */
+
+/**
+ * @brief   Names the calling thread in the output
+ *
+ * @param[in] szName : Thread name, persistent
+ *
+ * @par Description
+ * Cheap enough for every thread start, the buffer is only allocated by the first event.
+ */
+void pu_trace_name_thread( const char* szName )
+{
+    pu_trace_buffer_t* pBuffer = pTraceSelf;
+
+    szTraceSelfName = szName;
+    if (pBuffer)
+    {
+        pthread_mutex_lock( &mtxTrace );
+        pBuffer->szThread = szName;
+        pthread_mutex_unlock( &mtxTrace );
+    }
+}
+/* pu_trace_name_thread */
+
+/**
+ * @brief   Hands the buffer of the exiting thread over to the output
+ */
+void pu_trace_thread_exit( void )
+{
+    pu_trace_buffer_t* pBuffer = pTraceSelf;
+
+    if (pBuffer)
+    {
+        pthread_mutex_lock( &mtxTrace );
+        pBuffer->bExited = true;
+        pthread_mutex_unlock( &mtxTrace );
+        pTraceSelf = nullptr;
+    }
+}
+/* pu_trace_thread_exit */
+
+/**
+ * @brief   Records an event on the calling thread
+ *
+ * @param[in] cPhase  : PU_TRACE_PHASE_xxx
+ * @param[in] szCat   : Category, persistent
+ * @param[in] szName  : Name, persistent
+ * @param[in] ulTsNs  : Monotonic time stamp, 0 for now
+ * @param[in] ulDurNs : Duration, complete events only
+ * @param[in] ulArg   : Value shown with the event
+ */
+void pu_trace_event(
+    char        cPhase,
+    const char* szCat,
+    const char* szName,
+    uint64_t    ulTsNs,
+    uint64_t    ulDurNs,
+    uint64_t    ulArg )
+{
+    pu_trace_buffer_t* pBuffer = pu_trace_buffer();
+    pu_trace_record_t* pRecord;
+    size_t             uiCount;
+
+    if (!pBuffer)
+    {
+        return;
+    }
+    uiCount = pBuffer->uiCount;
+    if (uiCount >= pBuffer->uiCapacity)
+    {
+        __atomic_store_n( &(pBuffer->uiDropped), pBuffer->uiDropped + 1, __ATOMIC_RELAXED );
+        return;
+    }
+    pRecord = &(pBuffer->pRecords[uiCount]);
+    pRecord->ulTsNs  = ulTsNs ? ulTsNs : timespec_now_ns_monotonic();
+    pRecord->ulDurNs = ulDurNs;
+    pRecord->ulArg   = ulArg;
+    pRecord->szCat   = szCat;
+    pRecord->szName  = szName;
+    pRecord->cPhase  = cPhase;
+    __atomic_store_n( &(pBuffer->uiCount), uiCount + 1, __ATOMIC_RELEASE );
+}
+/* pu_trace_event */
+
+/**
+ * @brief   Writes the recorded events in the Chrome trace event format
+ *
+ * @param[in] pFile : Output
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_trace_write_json( FILE* pFile )
+{
+    pu_trace_buffer_t* pBuffer;
+    pu_trace_record_t* pRecord;
+    size_t             uiCount;
+    size_t             i;
+    const char*        szSep = "\n";
+    int                iPid  = (int)getpid();
+
+    ASSERT( pFile );
+    if (!pFile)
+    {
+        return (-1);
+    }
+    fprintf( pFile, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" );
+    pthread_mutex_lock( &mtxTrace );
+    for (pBuffer = pTraceList; pBuffer; pBuffer = pBuffer->pNext)
+    {
+        if (pBuffer->szThread)
+        {
+            fprintf( pFile, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+                szSep, iPid, pBuffer->iTid );
+            pu_trace_string( pFile, pBuffer->szThread );
+            fprintf( pFile, "}}" );
+            szSep = ",\n";
+        }
+        uiCount = __atomic_load_n( &(pBuffer->uiCount), __ATOMIC_ACQUIRE );
+        for (i = 0; i < uiCount; i++)
+        {
+            pRecord = &(pBuffer->pRecords[i]);
+            fprintf( pFile, "%s{\"ph\":\"%c\",\"cat\":", szSep, pRecord->cPhase );
+            pu_trace_string( pFile, pRecord->szCat );
+            fprintf( pFile, ",\"name\":" );
+            pu_trace_string( pFile, pRecord->szName );
+            fprintf( pFile, ",\"pid\":%d,\"tid\":%d,\"ts\":%llu.%03u", iPid, pBuffer->iTid,
+                (unsigned long long)(pRecord->ulTsNs / 1000), (unsigned int)(pRecord->ulTsNs % 1000) );
+            if (PU_TRACE_PHASE_COMPLETE == pRecord->cPhase)
+            {
+                fprintf( pFile, ",\"dur\":%llu.%03u",
+                    (unsigned long long)(pRecord->ulDurNs / 1000), (unsigned int)(pRecord->ulDurNs % 1000) );
+            }
+            else if (PU_TRACE_PHASE_INSTANT == pRecord->cPhase)
+            {
+                fprintf( pFile, ",\"s\":\"t\"" );
+            }
+            fprintf( pFile, ",\"args\":{\"arg\":%llu}}", (unsigned long long)pRecord->ulArg );
+            szSep = ",\n";
+        }
+    }
+    pthread_mutex_unlock( &mtxTrace );
+    fprintf( pFile, "\n]}\n" );
+    return (ferror( pFile ) ? -1 : 0);
+}
+/* pu_trace_write_json */
+
+/**
+ * @brief   Discards the recorded events, and the drop count
+ *
+ * @retval  0 for success
+ * @retval  Non-zero if recording
+ */
+int pu_trace_reset( void )
+{
+    pu_trace_buffer_t** ppLink;
+    pu_trace_buffer_t*  pBuffer;
+
+    if (__atomic_load_n( &iPuTraceOn, __ATOMIC_ACQUIRE ))
+    {
+        return (-1);
+    }
+    pthread_mutex_lock( &mtxTrace );
+    ppLink = &pTraceList;
+    while (nullptr != (pBuffer = *ppLink))
+    {
+        if (pBuffer->bExited)
+        {
+            *ppLink = pBuffer->pNext;
+            free( pBuffer->pRecords );
+            free( pBuffer );
+        }
+        else
+        {
+            __atomic_store_n( &(pBuffer->uiCount), 0, __ATOMIC_RELAXED );
+            __atomic_store_n( &(pBuffer->uiDropped), 0, __ATOMIC_RELAXED );
+            ppLink = &(pBuffer->pNext);
+        }
+    }
+    pthread_mutex_unlock( &mtxTrace );
+    return (0);
+}
+/* pu_trace_reset */
+
+/**
+ * @brief   Events dropped because a buffer was full
+ *
+ * @retval  The number of events
+ */
+size_t pu_trace_dropped( void )
+{
+    pu_trace_buffer_t* pBuffer;
+    size_t             uiDropped = 0;
+
+    pthread_mutex_lock( &mtxTrace );
+    for (pBuffer = pTraceList; pBuffer; pBuffer = pBuffer->pNext)
+    {
+        uiDropped += __atomic_load_n( &(pBuffer->uiDropped), __ATOMIC_RELAXED );
+    }
+    pthread_mutex_unlock( &mtxTrace );
+    return (uiDropped);
+}
+/* pu_trace_dropped */
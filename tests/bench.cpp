@@ -0,0 +1,1044 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * \file     bench.cpp
+ * \brief    Micro benchmarks, comparing the posutils primitives against the
+ *           plain Posix equivalents
+ */
+
+/**** System includes, namespaces, then local includes  *********************/
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <assert.h>
+#include "posutils.h"
+#include "putimer.h"
+#include "pushm.h"
+#include "puqueue.h"
+#include "pureactor.h"
+
+// start anonymous namespace
+namespace {
+
+/**** Definitions ************************************************************/
+#define UNUSED(parameter) (void)parameter
+#define MAX_THREADS       ((size_t)64)
+
+// A benchmark body, run by every thread
+typedef void (*bench_fct_t)( size_t uiThread );
+
+/**** Macros ****************************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+void* bench_thread( void* pArg );
+double bench_run( const char* szName, size_t uiThreads, size_t uiOps, bench_fct_t fctBody );
+void  bench_rwlock( void );
+void  bench_mutex_hooks( void );
+void  bench_mutex_pi( void );
+void  bench_shm_ring( void );
+void  bench_sem( void );
+void  bench_barrier( void );
+void  bench_spinlock( void );
+void  bench_queue( void );
+void  bench_reclaim( void );
+void  bench_ratelimit( void );
+void  bench_reactor( void );
+void  bench_delayqueue( void );
+void  bench_heartbeat( void );
+void  bench_profiler( void );
+void  bench_perf( void );
+void  bench_trace( void );
+void  bench_timespec( void );
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+// Common harness. The threads are released together so that creation cost is not measured.
+bench_fct_t       fctCurrent = NULL;
+pthread_barrier_t barStart;
+
+void* bench_thread( void* pArg ) {
+    pthread_barrier_wait(&barStart);
+    fctCurrent((size_t)pArg);
+    return (NULL);
+}
+
+double bench_run( const char* szName, size_t uiThreads, size_t uiOps, bench_fct_t fctBody ) {
+    pthread_t       pThreadList[MAX_THREADS];
+    struct timespec tsStart;
+    struct timespec tsEnd;
+
+    assert(uiThreads <= MAX_THREADS);
+    fctCurrent = fctBody;
+    pthread_barrier_init(&barStart, NULL, (unsigned)(uiThreads + 1));
+    for (size_t i = 0; i < uiThreads; i++) {
+        pThreadList[i] = PU_THREAD_CREATE(bench_thread, (void*)i, 64*1024);
+        assert(0 != pThreadList[i]);
+    }
+    TIME_GET_HW_TICK(tsStart);
+    pthread_barrier_wait(&barStart);
+    for (size_t i = 0; i < uiThreads; i++) {
+        pthread_join(pThreadList[i], NULL);
+    }
+    TIME_GET_HW_TICK(tsEnd);
+    pthread_barrier_destroy(&barStart);
+
+    double dNsPerOp = (double)timespec_a_sub_b_us(&tsEnd, &tsStart) * 1000.0 / (double)(uiOps * uiThreads);
+    std::cout << std::left << std::setw(40) << szName
+              << " threads=" << std::setw(3) << uiThreads
+              << " ns/op=" << std::fixed << std::setprecision(1) << dNsPerOp << std::endl;
+    return (dNsPerOp);
+}
+
+//=============================================================================
+// Reader-writer lock: read-mostly, one write per RW_WRITE_RATIO reads on thread 0
+//=============================================================================
+#define RW_OPS          ((size_t)200000)
+#define RW_WRITE_RATIO  ((size_t)1000)
+
+pu_rwlock_t      lckPu;
+pthread_rwlock_t lckPosix;
+volatile size_t  uiRwData = 0;
+
+void bench_rwlock_pu( size_t uiThread ) {
+    for (size_t i = 0; i < RW_OPS; i++) {
+        if ((0 == uiThread) && (0 == (i % RW_WRITE_RATIO))) {
+            pu_rwlock_wrlock(&lckPu);
+            uiRwData = uiRwData + 1;
+            pu_rwlock_wrunlock(&lckPu);
+        } else {
+            pu_rwlock_rdlock(&lckPu);
+            (void)uiRwData;
+            pu_rwlock_rdunlock(&lckPu);
+        }
+    }
+}
+
+void bench_rwlock_posix( size_t uiThread ) {
+    for (size_t i = 0; i < RW_OPS; i++) {
+        if ((0 == uiThread) && (0 == (i % RW_WRITE_RATIO))) {
+            pthread_rwlock_wrlock(&lckPosix);
+            uiRwData = uiRwData + 1;
+            pthread_rwlock_unlock(&lckPosix);
+        } else {
+            pthread_rwlock_rdlock(&lckPosix);
+            (void)uiRwData;
+            pthread_rwlock_unlock(&lckPosix);
+        }
+    }
+}
+
+void bench_rwlock( void ) {
+    pu_rwlock_create_type(&lckPu, PU_RWLOCK_TYPE_WRITER_PREF);
+    pthread_rwlock_init(&lckPosix, NULL);
+    for (size_t uiThreads = 1; uiThreads <= 8; uiThreads *= 2) {
+        bench_run("pu_rwlock (writer pref)", uiThreads, RW_OPS, bench_rwlock_pu);
+        bench_run("pthread_rwlock_t", uiThreads, RW_OPS, bench_rwlock_posix);
+    }
+    pthread_rwlock_destroy(&lckPosix);
+    pu_rwlock_destroy(&lckPu);
+}
+
+//=============================================================================
+// Mutex factory hooks: plain pthread calls, pu_mutex_lock with nothing
+// instrumented, and pu_mutex_lock on a profiled mutex
+//=============================================================================
+#define MTX_OPS ((size_t)1000000)
+
+pthread_mutex_t mtxBench;
+
+void bench_mutex_posix( size_t uiThread ) {
+    UNUSED(uiThread);
+    for (size_t i = 0; i < MTX_OPS; i++) {
+        pthread_mutex_lock(&mtxBench);
+        pthread_mutex_unlock(&mtxBench);
+    }
+}
+
+void bench_mutex_pu( size_t uiThread ) {
+    UNUSED(uiThread);
+    for (size_t i = 0; i < MTX_OPS; i++) {
+        pu_mutex_lock(&mtxBench);
+        pu_mutex_unlock(&mtxBench);
+    }
+}
+
+void bench_mutex_hooks( void ) {
+    pu_mutex_attr_t stAttr = PU_MUTEX_ATTR_INITIALIZER(PU_MUTEX_ATTR_PROFILE);
+
+    pu_mutex_create_type(&mtxBench, PU_MUTEX_TYPE_FAST);
+    bench_run("pthread_mutex_lock/unlock", 1, MTX_OPS, bench_mutex_posix);
+    bench_run("pu_mutex_lock/unlock (no hooks)", 1, MTX_OPS, bench_mutex_pu);
+    pu_mutex_destroy(&mtxBench);
+
+    pu_mutex_create_attr(&mtxBench, PU_MUTEX_TYPE_FAST, &stAttr);
+    bench_run("pu_mutex_lock/unlock (profiled)", 1, MTX_OPS, bench_mutex_pu);
+    pu_mutex_destroy(&mtxBench);
+}
+
+//=============================================================================
+// Priority inheritance: uncontended PI stays in user space, contended PI always
+// goes through the kernel (FUTEX_LOCK_PI), unlike a fast mutex
+//=============================================================================
+void bench_mutex_pi( void ) {
+    pu_mutex_create_type(&mtxBench, PU_MUTEX_TYPE_FAST);
+    bench_run("pu_mutex fast", 1, MTX_OPS, bench_mutex_pu);
+    bench_run("pu_mutex fast", 2, MTX_OPS, bench_mutex_pu);
+    pu_mutex_destroy(&mtxBench);
+
+    pu_mutex_create_type(&mtxBench, PU_MUTEX_TYPE_PRIO_INHERIT);
+    bench_run("pu_mutex priority inheritance", 1, MTX_OPS, bench_mutex_pu);
+    bench_run("pu_mutex priority inheritance", 2, MTX_OPS, bench_mutex_pu);
+    pu_mutex_destroy(&mtxBench);
+}
+
+//=============================================================================
+// Message passing, 64 byte messages from thread 0 to thread 1: the shared memory
+// ring (zero copy) against a unix socket pair (the IPC it replaces)
+//=============================================================================
+#define MSG_OPS   ((size_t)200000)
+#define MSG_SIZE  ((size_t)64)
+#define MSG_SLOTS ((size_t)256)
+
+unsigned char  pRingMem[64 * 1024] __attribute__((aligned(64)));
+pu_shm_ring_t* pBenchRing = NULL;
+int            pSockets[2];
+
+void bench_shm_ring_body( size_t uiThread ) {
+    for (size_t i = 0; i < MSG_OPS; i++) {
+        if (0 == uiThread) {
+            pu_shm_ring_wait_space(pBenchRing, PU_SHM_WAIT_FOREVER);
+            memset(pu_shm_ring_reserve(pBenchRing), (int)i, MSG_SIZE);
+            pu_shm_ring_commit(pBenchRing);
+        } else {
+            pu_shm_ring_wait_data(pBenchRing, PU_SHM_WAIT_FOREVER);
+            (void)*(const volatile unsigned char*)pu_shm_ring_peek(pBenchRing);
+            pu_shm_ring_release(pBenchRing);
+        }
+    }
+}
+
+void bench_socket_body( size_t uiThread ) {
+    unsigned char pMsg[MSG_SIZE];
+    for (size_t i = 0; i < MSG_OPS; i++) {
+        if (0 == uiThread) {
+            memset(pMsg, (int)i, MSG_SIZE);
+            ssize_t iWritten = write(pSockets[0], pMsg, MSG_SIZE);
+            UNUSED(iWritten);
+        } else {
+            ssize_t iRead = read(pSockets[1], pMsg, MSG_SIZE);
+            UNUSED(iRead);
+        }
+    }
+}
+
+void bench_shm_ring( void ) {
+    assert(sizeof(pRingMem) >= pu_shm_ring_size(MSG_SIZE, MSG_SLOTS));
+    pBenchRing = pu_shm_ring_create(pRingMem, sizeof(pRingMem), MSG_SIZE, MSG_SLOTS);
+    bench_run("pu_shm_ring (64 byte messages)", 2, MSG_OPS, bench_shm_ring_body);
+
+    if (0 != socketpair(AF_UNIX, SOCK_SEQPACKET, 0, pSockets)) {
+        return;
+    }
+    bench_run("socketpair (64 byte messages)", 2, MSG_OPS, bench_socket_body);
+    close(pSockets[0]);
+    close(pSockets[1]);
+}
+
+//=============================================================================
+// Semaphores: uncontended post/wait on one thread, and a two thread ping-pong
+// where every post has a sleeping waiter
+//=============================================================================
+#define SEM_OPS ((size_t)200000)
+
+pu_sem_t semPu[2];
+sem_t    semPosix[2];
+
+void bench_sem_pu( size_t uiThread ) {
+    for (size_t i = 0; i < SEM_OPS; i++) {
+        pu_sem_post(&semPu[uiThread]);
+        pu_sem_wait(&semPu[uiThread]);
+    }
+}
+
+void bench_sem_posix( size_t uiThread ) {
+    for (size_t i = 0; i < SEM_OPS; i++) {
+        sem_post(&semPosix[uiThread]);
+        sem_wait(&semPosix[uiThread]);
+    }
+}
+
+void bench_sem_pu_pingpong( size_t uiThread ) {
+    for (size_t i = 0; i < SEM_OPS; i++) {
+        if (0 == uiThread) {
+            pu_sem_post(&semPu[1]);
+            pu_sem_wait(&semPu[0]);
+        } else {
+            pu_sem_wait(&semPu[1]);
+            pu_sem_post(&semPu[0]);
+        }
+    }
+}
+
+void bench_sem_posix_pingpong( size_t uiThread ) {
+    for (size_t i = 0; i < SEM_OPS; i++) {
+        if (0 == uiThread) {
+            sem_post(&semPosix[1]);
+            sem_wait(&semPosix[0]);
+        } else {
+            sem_wait(&semPosix[1]);
+            sem_post(&semPosix[0]);
+        }
+    }
+}
+
+void bench_sem( void ) {
+    for (size_t i = 0; i < 2; i++) {
+        pu_sem_create(&semPu[i], 0, 0);
+        sem_init(&semPosix[i], 0, 0);
+    }
+    bench_run("pu_sem post/wait", 1, SEM_OPS, bench_sem_pu);
+    bench_run("sem_t post/wait", 1, SEM_OPS, bench_sem_posix);
+    bench_run("pu_sem ping-pong", 2, SEM_OPS, bench_sem_pu_pingpong);
+    bench_run("sem_t ping-pong", 2, SEM_OPS, bench_sem_posix_pingpong);
+    for (size_t i = 0; i < 2; i++) {
+        sem_destroy(&semPosix[i]);
+    }
+}
+
+//=============================================================================
+// Barriers: every thread crosses the barrier BAR_OPS times
+//=============================================================================
+#define BAR_OPS ((size_t)1000)
+
+pu_barrier_t      barPu;
+pthread_barrier_t barPosix;
+
+void bench_barrier_pu( size_t uiThread ) {
+    UNUSED(uiThread);
+    for (size_t i = 0; i < BAR_OPS; i++) {
+        pu_barrier_wait(&barPu);
+    }
+}
+
+void bench_barrier_posix( size_t uiThread ) {
+    UNUSED(uiThread);
+    for (size_t i = 0; i < BAR_OPS; i++) {
+        pthread_barrier_wait(&barPosix);
+    }
+}
+
+void bench_barrier( void ) {
+    for (size_t uiThreads = 8; uiThreads <= MAX_THREADS; uiThreads *= 2) {
+        pu_barrier_create(&barPu, (unsigned)uiThreads);
+        pthread_barrier_init(&barPosix, NULL, (unsigned)uiThreads);
+        bench_run("pu_barrier_wait", uiThreads, BAR_OPS, bench_barrier_pu);
+        bench_run("pthread_barrier_wait", uiThreads, BAR_OPS, bench_barrier_posix);
+        pthread_barrier_destroy(&barPosix);
+        pu_barrier_destroy(&barPu);
+    }
+}
+
+//=============================================================================
+// Spinlock against a fast mutex, for a critical section that is one increment
+//=============================================================================
+pu_spinlock_t lckBenchSpin = PU_SPINLOCK_INITIALIZER;
+size_t        uiShortData  = 0;
+
+void bench_spinlock_body( size_t uiThread ) {
+    UNUSED(uiThread);
+    for (size_t i = 0; i < MTX_OPS; i++) {
+        pu_spinlock_lock(&lckBenchSpin);
+        uiShortData++;
+        pu_spinlock_unlock(&lckBenchSpin);
+    }
+}
+
+void bench_short_mutex_body( size_t uiThread ) {
+    UNUSED(uiThread);
+    for (size_t i = 0; i < MTX_OPS; i++) {
+        pthread_mutex_lock(&mtxBench);
+        uiShortData++;
+        pthread_mutex_unlock(&mtxBench);
+    }
+}
+
+void bench_spinlock( void ) {
+    pu_mutex_create_type(&mtxBench, PU_MUTEX_TYPE_FAST);
+    for (size_t uiThreads = 1; uiThreads <= 4; uiThreads *= 2) {
+        bench_run("pu_spinlock", uiThreads, MTX_OPS, bench_spinlock_body);
+        bench_run("pthread_mutex (fast)", uiThreads, MTX_OPS, bench_short_mutex_body);
+    }
+    pu_mutex_destroy(&mtxBench);
+}
+
+//=============================================================================
+// Queues: even threads produce, odd threads consume. The lock-free MPMC queue
+// against a mutex + condvar protected ring of the same size
+//=============================================================================
+#define Q_OPS   ((size_t)200000)
+#define Q_SIZE  ((size_t)1024)
+
+pu_queue_t      qBench;
+pthread_mutex_t mtxQueue;
+pthread_cond_t  cndNotEmpty;
+pthread_cond_t  cndNotFull;
+void*           pRing[Q_SIZE];
+size_t          uiRingHead = 0;
+size_t          uiRingTail = 0;
+
+void bench_queue_pu( size_t uiThread ) {
+    void* pItem = NULL;
+    for (size_t i = 0; i < Q_OPS; i++) {
+        if (0 == (uiThread & 1)) {
+            pu_queue_push_wait(&qBench, (void*)(i + 1), PU_FUTEX_WAIT_FOREVER);
+        } else {
+            pu_queue_pop_wait(&qBench, &pItem, PU_FUTEX_WAIT_FOREVER);
+        }
+    }
+}
+
+void bench_queue_mutex( size_t uiThread ) {
+    for (size_t i = 0; i < Q_OPS; i++) {
+        pthread_mutex_lock(&mtxQueue);
+        if (0 == (uiThread & 1)) {
+            while ((uiRingTail - uiRingHead) == Q_SIZE) {
+                pthread_cond_wait(&cndNotFull, &mtxQueue);
+            }
+            pRing[uiRingTail++ % Q_SIZE] = (void*)(i + 1);
+            pthread_cond_signal(&cndNotEmpty);
+        } else {
+            while (uiRingTail == uiRingHead) {
+                pthread_cond_wait(&cndNotEmpty, &mtxQueue);
+            }
+            (void)pRing[uiRingHead++ % Q_SIZE];
+            pthread_cond_signal(&cndNotFull);
+        }
+        pthread_mutex_unlock(&mtxQueue);
+    }
+}
+
+void bench_queue( void ) {
+    pu_queue_create(&qBench, PU_QUEUE_TYPE_MPMC, Q_SIZE);
+    pu_mutex_create_type(&mtxQueue, PU_MUTEX_TYPE_FAST);
+    pthread_cond_init(&cndNotEmpty, NULL);
+    pthread_cond_init(&cndNotFull, NULL);
+    for (size_t uiThreads = 2; uiThreads <= 8; uiThreads *= 2) {
+        bench_run("pu_queue (MPMC)", uiThreads, Q_OPS, bench_queue_pu);
+        bench_run("mutex + condvar ring", uiThreads, Q_OPS, bench_queue_mutex);
+    }
+    pthread_cond_destroy(&cndNotFull);
+    pthread_cond_destroy(&cndNotEmpty);
+    pu_mutex_destroy(&mtxQueue);
+    pu_queue_destroy(&qBench);
+}
+
+//=============================================================================
+// Read-side lookup of a shared object: hazard pointer and EBR against a mutex.
+// Thread 0 replaces the object once every LOOKUP_WRITE_RATIO lookups.
+//=============================================================================
+#define LOOKUP_OPS         ((size_t)1000000)
+#define LOOKUP_WRITE_RATIO ((size_t)1000)
+
+struct lookup_obj_t {
+    pu_hazard_node_t stHazard;
+    pu_ebr_node_t    stEbr;
+    size_t           uiValue;
+};
+
+lookup_obj_t*   pLookup = NULL;
+pthread_mutex_t mtxLookup;
+size_t          uiLookupSink = 0;
+
+void lookup_hazard_free( void* pObj ) {
+    delete (lookup_obj_t*)pObj;
+}
+
+void lookup_ebr_free( pu_ebr_node_t* pNode ) {
+    delete (lookup_obj_t*)((char*)pNode - offsetof(lookup_obj_t, stEbr));
+}
+
+void bench_lookup_hazard( size_t uiThread ) {
+    size_t uiSum = 0;
+    for (size_t i = 0; i < LOOKUP_OPS; i++) {
+        if ((0 == uiThread) && (0 == (i % LOOKUP_WRITE_RATIO))) {
+            lookup_obj_t* pOld = __atomic_exchange_n(&pLookup, new lookup_obj_t(), __ATOMIC_ACQ_REL);
+            pu_hazard_retire(&(pOld->stHazard), pOld, lookup_hazard_free);
+        }
+        lookup_obj_t* pObj = (lookup_obj_t*)pu_hazard_protect(0, (void* const*)&pLookup);
+        uiSum += pObj->uiValue;
+        pu_hazard_clear(0);
+    }
+    __atomic_fetch_add(&uiLookupSink, uiSum, __ATOMIC_RELAXED);
+}
+
+void bench_lookup_ebr( size_t uiThread ) {
+    size_t uiSum = 0;
+    for (size_t i = 0; i < LOOKUP_OPS; i++) {
+        if ((0 == uiThread) && (0 == (i % LOOKUP_WRITE_RATIO))) {
+            lookup_obj_t* pOld = __atomic_exchange_n(&pLookup, new lookup_obj_t(), __ATOMIC_ACQ_REL);
+            pu_ebr_retire(&(pOld->stEbr), lookup_ebr_free);
+        }
+        pu_ebr_enter();
+        uiSum += __atomic_load_n(&pLookup, __ATOMIC_ACQUIRE)->uiValue;
+        pu_ebr_exit();
+    }
+    __atomic_fetch_add(&uiLookupSink, uiSum, __ATOMIC_RELAXED);
+}
+
+void bench_lookup_mutex( size_t uiThread ) {
+    size_t uiSum = 0;
+    for (size_t i = 0; i < LOOKUP_OPS; i++) {
+        pthread_mutex_lock(&mtxLookup);
+        if ((0 == uiThread) && (0 == (i % LOOKUP_WRITE_RATIO))) {
+            delete pLookup;
+            pLookup = new lookup_obj_t();
+        }
+        uiSum += pLookup->uiValue;
+        pthread_mutex_unlock(&mtxLookup);
+    }
+    __atomic_fetch_add(&uiLookupSink, uiSum, __ATOMIC_RELAXED);
+}
+
+void bench_reclaim( void ) {
+    pLookup = new lookup_obj_t();
+    pu_mutex_create_type(&mtxLookup, PU_MUTEX_TYPE_FAST);
+    for (size_t uiThreads = 1; uiThreads <= 4; uiThreads *= 2) {
+        bench_run("hazard pointer lookup", uiThreads, LOOKUP_OPS, bench_lookup_hazard);
+        bench_run("EBR lookup", uiThreads, LOOKUP_OPS, bench_lookup_ebr);
+        bench_run("mutex lookup", uiThreads, LOOKUP_OPS, bench_lookup_mutex);
+    }
+    pu_hazard_flush();
+    pu_ebr_barrier();
+    pu_mutex_destroy(&mtxLookup);
+    delete pLookup;
+}
+
+//=============================================================================
+// Rate limiter: the cost of taking a token while there are plenty, against a mutex protected
+// bucket that tops itself up from the clock on every take
+//=============================================================================
+#define RATE_OPS ((size_t)1000000)
+
+pu_ratelimit_t         stRateLimit;
+pu_ratelimit_sharded_t stRateSharded;
+pthread_mutex_t        mtxRate;
+double                 dRateTokens;
+struct timespec        tsRateLast;
+
+void bench_ratelimit_pu( size_t uiThread ) {
+    UNUSED(uiThread);
+    for (size_t i = 0; i < RATE_OPS; i++) {
+        pu_ratelimit_try_acquire(&stRateLimit, 1);
+    }
+}
+
+void bench_ratelimit_sharded( size_t uiThread ) {
+    UNUSED(uiThread);
+    for (size_t i = 0; i < RATE_OPS; i++) {
+        pu_ratelimit_sharded_try_acquire(&stRateSharded, 1);
+    }
+}
+
+void bench_ratelimit_mutex( size_t uiThread ) {
+    struct timespec tsNow;
+    UNUSED(uiThread);
+    for (size_t i = 0; i < RATE_OPS; i++) {
+        pthread_mutex_lock(&mtxRate);
+        TIME_GET_HW_TICK(tsNow);
+        dRateTokens += (double)timespec_a_sub_b_us(&tsNow, &tsRateLast);
+        dRateTokens  = (dRateTokens > 1e9) ? 1e9 : dRateTokens;
+        tsRateLast   = tsNow;
+        if (dRateTokens >= 1.0) {
+            dRateTokens -= 1.0;
+        }
+        pthread_mutex_unlock(&mtxRate);
+    }
+}
+
+void bench_ratelimit( void ) {
+    pu_ratelimit_init(&stRateLimit, 1000000000, 1000000000);
+    pu_ratelimit_sharded_create(&stRateSharded, 1000000000, 1000000000, 0);
+    pu_mutex_create_type(&mtxRate, PU_MUTEX_TYPE_FAST);
+    dRateTokens = 1e9;
+    TIME_GET_HW_TICK(tsRateLast);
+    for (size_t uiThreads = 1; uiThreads <= 4; uiThreads *= 2) {
+        bench_run("pu_ratelimit try_acquire", uiThreads, RATE_OPS, bench_ratelimit_pu);
+        bench_run("pu_ratelimit sharded try_acquire", uiThreads, RATE_OPS, bench_ratelimit_sharded);
+        bench_run("mutex + clock bucket", uiThreads, RATE_OPS, bench_ratelimit_mutex);
+    }
+    pu_mutex_destroy(&mtxRate);
+    pu_ratelimit_sharded_destroy(&stRateSharded);
+}
+
+//=============================================================================
+// I/O wake-up round trip through a pipe, and how late a 10ms timer is seen by the I/O thread.
+// The reactors wait for both in one call. The baseline is an epoll loop, with the timers on the
+// putimer thread handing each expiry over through an eventfd.
+//=============================================================================
+#define REACTOR_OPS    ((size_t)20000)
+#define REACTOR_TIMERS ((size_t)20)
+#define REACTOR_TMO_MS ((size_t)10)
+
+int             pReactorPipe[2];
+int             iReactorEventFd;
+pu_sem_t        semReactor;
+size_t          uiReactorReads = 0;
+char            pReactorBuf[64];
+struct timespec tsReactorFired;
+int             bReactorStop = 0;
+
+void reactor_read_done( pu_reactor_op_t* pOp, int iResult ) {
+    UNUSED(iResult);
+    if (++uiReactorReads < REACTOR_OPS) {
+        pu_reactor_submit((pu_reactor_t)pOp->pArg, pOp);
+    }
+    pu_sem_post(&semReactor);
+}
+
+void reactor_timer_done( pu_reactor_op_t* pOp, int iResult ) {
+    UNUSED(pOp);
+    UNUSED(iResult);
+    TIME_GET_HW_TICK(tsReactorFired);
+    pu_sem_post(&semReactor);
+}
+
+void reactor_putimer_expired( void* pCookie ) {
+    uint64_t ulOne = 1;
+    UNUSED(pCookie);
+    if (write(iReactorEventFd, &ulOne, sizeof(ulOne)) < 0) {
+        assert(0);
+    }
+}
+
+void* reactor_epoll_thread( void* pArg ) {
+    struct epoll_event pEvents[2];
+    int                iEpollFd = *(int*)pArg;
+    uint64_t           ulValue;
+    while (!__atomic_load_n(&bReactorStop, __ATOMIC_ACQUIRE)) {
+        int iCount = epoll_wait(iEpollFd, pEvents, 2, -1);
+        for (int i = 0; i < iCount; i++) {
+            if (pEvents[i].data.fd == iReactorEventFd) {
+                TIME_GET_HW_TICK(tsReactorFired);
+                if (read(iReactorEventFd, &ulValue, sizeof(ulValue)) < 0) {
+                    assert(0);
+                }
+            }
+            else if (read(pReactorPipe[0], pReactorBuf, sizeof(pReactorBuf)) < 0) {
+                assert(0);
+            }
+            pu_sem_post(&semReactor);
+        }
+    }
+    return (NULL);
+}
+
+void reactor_report( const char* szName, const char* szUnit, double dValue ) {
+    std::cout << std::left << std::setw(40) << szName
+              << " threads=" << std::setw(3) << 1
+              << " " << szUnit << "=" << std::fixed << std::setprecision(1) << dValue << std::endl;
+}
+
+double reactor_round_trips( void ) {
+    struct timespec tsStart;
+    struct timespec tsEnd;
+    TIME_GET_HW_TICK(tsStart);
+    for (size_t i = 0; i < REACTOR_OPS; i++) {
+        if (1 != write(pReactorPipe[1], "x", 1)) {
+            assert(0);
+        }
+        pu_sem_wait(&semReactor);
+    }
+    TIME_GET_HW_TICK(tsEnd);
+    return ((double)timespec_a_sub_b_us(&tsEnd, &tsStart) * 1000.0 / (double)REACTOR_OPS);
+}
+
+// Average lateness in us. fctArm starts one timer of REACTOR_TMO_MS.
+template <typename F>
+double reactor_timer_lateness( F fctArm ) {
+    struct timespec tsStart;
+    double          dLateUs = 0.0;
+    for (size_t i = 0; i < REACTOR_TIMERS; i++) {
+        TIME_GET_HW_TICK(tsStart);
+        fctArm();
+        pu_sem_wait(&semReactor);
+        dLateUs += (double)timespec_a_sub_b_us(&tsReactorFired, &tsStart) - (double)(REACTOR_TMO_MS * 1000);
+    }
+    return (dLateUs / (double)REACTOR_TIMERS);
+}
+
+void bench_reactor_backend( pu_reactor_backend_t enBackend, const char* szIo, const char* szTimer ) {
+    pu_reactor_config_t stConfig;
+    pu_reactor_t        hReactor;
+    pu_reactor_op_t     stRead;
+    pu_reactor_op_t     stTimer;
+
+    memset(&stConfig, 0, sizeof(stConfig));
+    stConfig.enBackend = enBackend;
+    if (0 != pu_reactor_create(&hReactor, &stConfig)) {
+        std::cout << szIo << ": not available" << std::endl;
+        return;
+    }
+    uiReactorReads = 0;
+    pu_reactor_prep_read(&stRead, pReactorPipe[0], pReactorBuf, 1, PU_REACTOR_OFFSET_NONE, reactor_read_done, hReactor);
+    pu_reactor_submit(hReactor, &stRead);
+    reactor_report(szIo, "ns/op", reactor_round_trips());
+    reactor_report(szTimer, "us late", reactor_timer_lateness([&]() {
+        pu_reactor_prep_timeout(&stTimer, REACTOR_TMO_MS, reactor_timer_done, NULL);
+        pu_reactor_submit(hReactor, &stTimer);
+    }));
+    pu_reactor_destroy(hReactor);
+}
+
+void bench_reactor( void ) {
+    struct epoll_event stEvent;
+    int                iEpollFd;
+    uint64_t           ulOne = 1;
+
+    if (0 != pipe(pReactorPipe)) {
+        std::cout << "reactor: no pipe" << std::endl;
+        return;
+    }
+    pu_sem_create(&semReactor, 0, 0);
+    bench_reactor_backend(PU_REACTOR_BACKEND_URING, "reactor io_uring pipe wake-up", "reactor io_uring 10ms timer");
+    bench_reactor_backend(PU_REACTOR_BACKEND_EPOLL, "reactor epoll pipe wake-up", "reactor epoll 10ms timer");
+
+    // Baseline: epoll loop for the I/O, putimer thread for the timers
+    iReactorEventFd = eventfd(0, 0);
+    iEpollFd = epoll_create1(0);
+    memset(&stEvent, 0, sizeof(stEvent));
+    stEvent.events  = EPOLLIN;
+    stEvent.data.fd = pReactorPipe[0];
+    epoll_ctl(iEpollFd, EPOLL_CTL_ADD, pReactorPipe[0], &stEvent);
+    stEvent.data.fd = iReactorEventFd;
+    epoll_ctl(iEpollFd, EPOLL_CTL_ADD, iReactorEventFd, &stEvent);
+    pthread_t pid = PU_THREAD_CREATE(reactor_epoll_thread, &iEpollFd, 64*1024);
+    putimer_hnd_t hTimer = putimer_create(PUTIMER_TYPE_SINGLESHOT, reactor_putimer_expired, REACTOR_TMO_MS, NULL);
+    reactor_report("epoll + timer thread pipe wake-up", "ns/op", reactor_round_trips());
+    reactor_report("epoll + timer thread 10ms timer", "us late", reactor_timer_lateness([&]() {
+        putimer_start(hTimer);
+    }));
+    putimer_delete(hTimer);
+    __atomic_store_n(&bReactorStop, 1, __ATOMIC_RELEASE);
+    if (write(iReactorEventFd, &ulOne, sizeof(ulOne)) < 0) {
+        assert(0);
+    }
+    pthread_join(pid, NULL);
+    close(iEpollFd);
+    close(iReactorEventFd);
+    close(pReactorPipe[0]);
+    close(pReactorPipe[1]);
+}
+
+//=============================================================================
+// Retry pipeline: DQ_ITEMS items scheduled 10ms to 110ms ahead, out of order, and handed to
+// one consumer thread. Cost to schedule an item, and how late the consumer gets it. The
+// baseline is a timer per item, whose callback pushes the item onto a queue.
+//=============================================================================
+#define DQ_ITEMS ((size_t)100)
+
+pu_delayqueue_t dqBench;
+pu_queue_t      qDqBench;
+putimer_hnd_t   pDqTimers[DQ_ITEMS];
+uint64_t        pDqDue[DQ_ITEMS];
+double          dDqLateUs;
+
+void dq_timer_expired( void* pCookie ) {
+    while (EAGAIN == pu_queue_push(&qDqBench, pCookie)) {
+        sched_yield();
+    }
+}
+
+void* dq_delayqueue_consumer( void* pArg ) {
+    void* pItem;
+    UNUSED(pArg);
+    for (size_t i = 0; (i < DQ_ITEMS) && (0 == pu_delayqueue_take(&dqBench, &pItem, 1000)); i++) {
+        dDqLateUs += (double)(timespec_now_ns_monotonic() - pDqDue[(size_t)pItem - 1]) / 1000.0;
+    }
+    return (NULL);
+}
+
+void* dq_timer_consumer( void* pArg ) {
+    void* pItem;
+    UNUSED(pArg);
+    for (size_t i = 0; (i < DQ_ITEMS) && (0 == pu_queue_pop_wait(&qDqBench, &pItem, 1000)); i++) {
+        dDqLateUs += (double)(timespec_now_ns_monotonic() - pDqDue[(size_t)pItem - 1]) / 1000.0;
+    }
+    return (NULL);
+}
+
+// Runs one pipeline. fctSchedule schedules item i+1 to be due after uiMs.
+template <typename F>
+void dq_pipeline( const char* szSchedule, const char* szLate, void* (*fctConsumer)( void* ), F fctSchedule ) {
+    uint64_t ulStart;
+    uint64_t ulEnd;
+    size_t   uiMs;
+
+    dDqLateUs = 0.0;
+    pthread_t pid = PU_THREAD_CREATE(fctConsumer, NULL, 64*1024);
+    ulStart = timespec_now_ns_monotonic();
+    for (size_t i = 0; i < DQ_ITEMS; i++) {
+        uiMs      = 10 + ((i * 37) % DQ_ITEMS);
+        pDqDue[i] = timespec_now_ns_monotonic() + (uint64_t)uiMs * 1000000ULL;
+        fctSchedule(i, uiMs);
+    }
+    ulEnd = timespec_now_ns_monotonic();
+    pthread_join(pid, NULL);
+    reactor_report(szSchedule, "ns/op", (double)(ulEnd - ulStart) / (double)DQ_ITEMS);
+    reactor_report(szLate, "us late", dDqLateUs / (double)DQ_ITEMS);
+}
+
+void bench_delayqueue( void ) {
+    if ((0 != pu_delayqueue_create(&dqBench, DQ_ITEMS)) ||
+        (0 != pu_queue_create(&qDqBench, PU_QUEUE_TYPE_MPSC, DQ_ITEMS))) {
+        std::cout << "delay queue: no memory" << std::endl;
+        return;
+    }
+    dq_pipeline("pu_delayqueue schedule", "pu_delayqueue delivery", dq_delayqueue_consumer,
+        [](size_t i, size_t uiMs) {
+            pu_delayqueue_put(&dqBench, (void*)(i + 1), uiMs);
+        });
+    dq_pipeline("timer per item schedule", "timer per item delivery", dq_timer_consumer,
+        [](size_t i, size_t uiMs) {
+            pDqTimers[i] = putimer_create(PUTIMER_TYPE_SINGLESHOT, dq_timer_expired, uiMs, (void*)(i + 1));
+            putimer_start(pDqTimers[i]);
+        });
+    for (size_t i = 0; i < DQ_ITEMS; i++) {
+        putimer_delete(pDqTimers[i]);
+    }
+    pu_queue_destroy(&qDqBench);
+    pu_delayqueue_destroy(&dqBench);
+}
+
+//=============================================================================
+// Heartbeat in a worker loop: the heartbeat counter, against storing a clock reading
+//=============================================================================
+#define HEARTBEAT_OPS ((size_t)10000000)
+
+uint64_t pHeartbeatNs[MAX_THREADS * 8];
+
+void bench_heartbeat_pu( size_t uiThread ) {
+    UNUSED(uiThread);
+    pu_thread_watch(1000);
+    for (size_t i = 0; i < HEARTBEAT_OPS; i++) {
+        pu_thread_heartbeat();
+    }
+    pu_thread_watch(0);
+}
+
+void bench_heartbeat_clock( size_t uiThread ) {
+    for (size_t i = 0; i < HEARTBEAT_OPS; i++) {
+        __atomic_store_n(&pHeartbeatNs[uiThread * 8], timespec_now_ns_monotonic(), __ATOMIC_RELAXED);
+    }
+}
+
+void bench_heartbeat( void ) {
+    pu_thread_monitor_start(100, NULL, 0);
+    for (size_t uiThreads = 1; uiThreads <= 4; uiThreads *= 2) {
+        bench_run("pu_thread_heartbeat", uiThreads, HEARTBEAT_OPS, bench_heartbeat_pu);
+        bench_run("clock timestamp heartbeat", uiThreads, HEARTBEAT_OPS, bench_heartbeat_clock);
+    }
+    pu_thread_monitor_stop();
+}
+
+//=============================================================================
+// Profiler overhead on a CPU bound loop, with either stack walk
+//=============================================================================
+#define PROFILE_OPS ((size_t)20000000)
+
+volatile uint64_t ulProfileSink = 0;
+
+void bench_profile_body( size_t uiThread ) {
+    uint64_t ulValue = uiThread + 1;
+    for (size_t i = 0; i < PROFILE_OPS; i++) {
+        ulValue = ulValue * 6364136223846793005ULL + 1442695040888963407ULL;
+    }
+    ulProfileSink = ulProfileSink + ulValue;
+}
+
+void bench_profiler( void ) {
+    bench_run("cpu loop, profiler off", 1, PROFILE_OPS, bench_profile_body);
+    pu_profiler_start(1000, 0);
+    bench_run("cpu loop, profiler 1kHz backtrace", 1, PROFILE_OPS, bench_profile_body);
+    pu_profiler_stop();
+    pu_profiler_start(1000, PU_PROFILER_FLAG_FRAME_POINTERS);
+    bench_run("cpu loop, profiler 1kHz frame pointers", 1, PROFILE_OPS, bench_profile_body);
+    pu_profiler_stop();
+    pu_profiler_reset();
+}
+
+//=============================================================================
+// Counter snapshot cost, against the thread CPU clock as the cheapest per-thread measure
+//=============================================================================
+#define PERF_OPS ((size_t)200000)
+
+volatile uint64_t ulPerfSink = 0;
+
+void bench_perf_read( size_t uiThread ) {
+    UNUSED(uiThread);
+    pu_perf_counters_t stCounters;
+    for (size_t i = 0; i < PERF_OPS; i++) {
+        if (0 == pu_perf_read(&stCounters)) {
+            ulPerfSink = ulPerfSink + stCounters.pValues[PU_PERF_CYCLES];
+        }
+    }
+}
+
+void bench_perf_clock( size_t uiThread ) {
+    UNUSED(uiThread);
+    struct timespec tsNow;
+    for (size_t i = 0; i < PERF_OPS; i++) {
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &tsNow);
+        ulPerfSink = ulPerfSink + (uint64_t)tsNow.tv_nsec;
+    }
+}
+
+void bench_perf( void ) {
+    pu_perf_enable(PU_PERF_ALL);
+    bench_run("pu_perf_read, every counter", 1, PERF_OPS, bench_perf_read);
+    pu_perf_enable(PU_PERF_MASK(PU_PERF_CYCLES) | PU_PERF_MASK(PU_PERF_INSTRUCTIONS));
+    bench_run("pu_perf_read, cycles and instructions", 1, PERF_OPS, bench_perf_read);
+    pu_perf_enable(0);
+    bench_run("clock_gettime thread cputime", 1, PERF_OPS, bench_perf_clock);
+}
+
+//=============================================================================
+// Tracer: the cost of the disabled trace points, and of recording
+//=============================================================================
+#define TRACE_OPS ((size_t)1000000)
+
+pthread_mutex_t mtxTraceBench;
+
+void bench_trace_mutex( size_t uiThread ) {
+    UNUSED(uiThread);
+    for (size_t i = 0; i < TRACE_OPS; i++) {
+        pu_mutex_lock(&mtxTraceBench);
+        pu_mutex_unlock(&mtxTraceBench);
+    }
+}
+
+void bench_trace_instant( size_t uiThread ) {
+    for (size_t i = 0; i < TRACE_OPS; i++) {
+        PU_TRACE_INSTANT("bench", "instant", uiThread);
+    }
+}
+
+void bench_trace( void ) {
+    pu_mutex_create_type(&mtxTraceBench, PU_MUTEX_TYPE_FAST);
+    bench_run("pu_mutex_lock/unlock, tracer off", 1, TRACE_OPS, bench_trace_mutex);
+    bench_run("PU_TRACE_INSTANT, tracer off", 1, TRACE_OPS, bench_trace_instant);
+    pu_trace_start(TRACE_OPS);
+    bench_run("pu_mutex_lock/unlock, tracer on", 1, TRACE_OPS, bench_trace_mutex);
+    bench_run("PU_TRACE_INSTANT, tracer on", 1, TRACE_OPS, bench_trace_instant);
+    pu_trace_stop();
+    pu_trace_reset();
+    pu_mutex_destroy(&mtxTraceBench);
+}
+
+//=============================================================================
+// Call overhead of the small timespec helpers: library calls, or inlined (PU_INLINE, LTO)
+//=============================================================================
+#define TIMESPEC_OPS ((size_t)20000000)
+
+volatile size_t uiTimespecSink = 0;
+
+void bench_timespec_compare( size_t uiThread ) {
+    struct timespec tsA = { 1, (long)uiThread };
+    struct timespec tsB = { 1, 500 };
+    size_t          uiAfter = 0;
+    for (size_t i = 0; i < TIMESPEC_OPS; i++) {
+        tsA.tv_nsec = (long)(i & 1023);
+        uiAfter += (size_t)timespec_is_a_after_b(&tsA, &tsB);
+    }
+    uiTimespecSink = uiAfter;
+}
+
+void bench_timespec_diff( size_t uiThread ) {
+    struct timespec tsA = { 2, (long)uiThread };
+    struct timespec tsB = { 1, 500 };
+    size_t          uiUs = 0;
+    for (size_t i = 0; i < TIMESPEC_OPS; i++) {
+        tsA.tv_nsec = (long)(i & 0xfffff);
+        uiUs += timespec_a_sub_b_us(&tsA, &tsB);
+    }
+    uiTimespecSink = uiUs;
+}
+
+void bench_timespec( void ) {
+#if defined(PU_INLINE)
+    std::cout << "timespec helpers: inline (PU_INLINE)" << std::endl;
+#else
+    std::cout << "timespec helpers: library functions (inlined with LTO only)" << std::endl;
+#endif
+    bench_run("timespec_is_a_after_b", 1, TIMESPEC_OPS, bench_timespec_compare);
+    bench_run("timespec_a_sub_b_us", 1, TIMESPEC_OPS, bench_timespec_diff);
+}
+
+} // End anonymous namespace
+
+/****************************************************************************/
+/* PUBLIC FUNCTION OR METHOD DEFINITIONS                                    */
+/****************************************************************************/
+
+/**
+ * Main
+ * @param argc: unused
+ * @param argv: unused
+ * @return 0
+ * Runs all the benchmarks in turn
+ */
+int main( int argc, char *argv[] )
+{
+    UNUSED(argc);
+    UNUSED(argv);
+
+    std::cout << "Posix Utilities: benchmarks" << std::endl;
+    POSUTILS_INIT;
+
+    bench_rwlock();
+    bench_mutex_hooks();
+    bench_mutex_pi();
+    bench_shm_ring();
+    bench_sem();
+    bench_barrier();
+    bench_spinlock();
+    bench_queue();
+    bench_reclaim();
+    bench_ratelimit();
+    bench_reactor();
+    bench_delayqueue();
+    bench_heartbeat();
+    bench_profiler();
+    bench_perf();
+    bench_trace();
+    bench_timespec();
+
+    POSUTILS_EXIT;
+    return (0);
+}
+/* main */
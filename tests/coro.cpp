@@ -0,0 +1,211 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * \file     coro.cpp
+ * \brief    Tests of the C++20 coroutine awaitables, built only when the compiler supports them
+ */
+
+/**** System includes, namespaces, then local includes  *********************/
+#include <iostream>
+#include <pthread.h>
+#include <unistd.h>
+#include <assert.h>
+#include "posutils.h"
+#include "putimer.h"
+#include "pufuture.h"
+#include "pucoro.h"
+
+#if !defined(PU_HAS_COROUTINES)
+#error "coro.cpp must be compiled as C++20 with coroutine support"
+#endif
+
+// start anonymous namespace
+namespace {
+
+/**** Definitions ************************************************************/
+#define UNUSED(parameter) (void)parameter
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+pu::coro_task coro_sleep( pu_executor_pool_t& stPool );
+pu::coro_task coro_ticks( pu_executor_pool_t& stPool );
+void          coro_block_task( void* pArg );
+void          coro_noop_task( void* pArg );
+pu::coro_task coro_refused( pu_executor_pool_t& stPool );
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+// What the coroutines saw, checked by main once they are done
+pthread_t pidMain;
+pu_sem_t  semDone;
+int       bOnPool      = 0;
+int       iSleepResult = -1;
+size_t    uiSleptMs    = 0;
+int       bSleepOnPool = 0;
+size_t    uiTicks      = 0;
+int       bTicksOnPool = 0;
+
+// resume_on, then sleep_for: both must come back on a pool worker, the sleep no earlier than asked
+pu::coro_task coro_sleep( pu_executor_pool_t& stPool ) {
+    struct timespec tsStart;
+    struct timespec tsEnd;
+
+    co_await pu::resume_on(stPool);
+    bOnPool = !pthread_equal(pidMain, pthread_self());
+
+    TIME_GET_HW_TICK(tsStart);
+    iSleepResult = co_await pu::sleep_for(20, &(stPool.stExec));
+    TIME_GET_HW_TICK(tsEnd);
+    uiSleptMs = timespec_a_sub_b_ms(&tsEnd, &tsStart);
+    bSleepOnPool = !pthread_equal(pidMain, pthread_self());
+
+    // 0 only goes through the executor
+    int iResult = co_await pu::sleep_for(0, &(stPool.stExec));
+    assert(0 == iResult);
+    UNUSED(iResult);
+    pu_sem_post(&semDone);
+}
+
+// A periodic timer awaited a few times, every tick is counted
+pu::coro_task coro_ticks( pu_executor_pool_t& stPool ) {
+    pu::coro_timer tmrTick(10, &(stPool.stExec));
+    assert(tmrTick.valid());
+    while (uiTicks < 3) {
+        uiTicks += co_await tmrTick.tick();
+        bTicksOnPool = !pthread_equal(pidMain, pthread_self());
+    }
+    pu_sem_post(&semDone);
+}
+
+// A full pool: the timer must not resume the coroutine inline, under the timer lock
+pu_sem_t semBlock;
+int      bRefusedDone   = 0;
+size_t   uiRefusedTicks = 0;
+int      bRefusedOnPool = 0;
+
+void coro_block_task( void* pArg ) {
+    UNUSED(pArg);
+    pu_sem_post(&semDone);
+    int iResult = pu_sem_timedwait(&semBlock, 5000);
+    assert(0 == iResult);
+    UNUSED(iResult);
+}
+
+void coro_noop_task( void* pArg ) {
+    UNUSED(pArg);
+}
+
+pu::coro_task coro_refused( pu_executor_pool_t& stPool ) {
+    pu::coro_timer tmrTick(10, &(stPool.stExec));
+    assert(tmrTick.valid());
+    uiRefusedTicks = co_await tmrTick.tick();
+    bRefusedOnPool = !pthread_equal(pidMain, pthread_self());
+    __atomic_store_n(&bRefusedDone, 1, __ATOMIC_RELEASE);
+    pu_sem_post(&semDone);
+}   // ~coro_timer deletes the timer, which deadlocks if this runs in the timer thread
+
+} // End anonymous namespace
+
+/****************************************************************************/
+/* PUBLIC FUNCTION OR METHOD DEFINITIONS                                    */
+/****************************************************************************/
+
+/**
+ * Main
+ * @param argc: unused
+ * @param argv: unused
+ * @return 0
+ */
+int main( int argc, char *argv[] )
+{
+    pu_executor_pool_t stPool;
+
+    UNUSED(argc);
+    UNUSED(argv);
+    std::cout << "Posix Utilities: coroutine tests" << std::endl;
+    POSUTILS_INIT;
+
+    pidMain = pthread_self();
+    int iResult = pu_sem_create(&semDone, 0, 0);
+    assert(0 == iResult);
+    iResult = pu_executor_pool_create(&stPool, 2, 16, "coro_pool");
+    assert(0 == iResult);
+
+    // Both start in main and suspend straight away
+    coro_sleep(stPool);
+    coro_ticks(stPool);
+    for (int i = 0; i < 2; i++) {
+        iResult = pu_sem_timedwait(&semDone, 5000);
+        assert(0 == iResult);
+    }
+
+    std::cout << "resume_on and sleep_for" << std::endl;
+    assert(bOnPool);
+    assert(0 == iSleepResult);
+    assert(uiSleptMs >= 20);
+    assert(bSleepOnPool);
+    std::cout << "coro_timer" << std::endl;
+    assert(uiTicks >= 3);
+    assert(bTicksOnPool);
+
+    iResult = pu_executor_pool_destroy(&stPool);
+    assert(0 == iResult);
+
+    // One worker, blocked once it has taken its task, and its queue full: every submit is refused
+    pu_executor_pool_t stTiny;
+    pu_task_t          stBlock = { coro_block_task, NULL };
+    pu_task_t          pFill[8];
+    iResult = pu_sem_create(&semBlock, 0, 0);
+    assert(0 == iResult);
+    iResult = pu_executor_pool_create(&stTiny, 1, 1, "coro_tiny");
+    assert(0 == iResult);
+    iResult = stTiny.stExec.fctSubmit(&(stTiny.stExec), &stBlock);
+    assert(0 == iResult);
+    iResult = pu_sem_timedwait(&semDone, 5000);
+    assert(0 == iResult);
+    size_t uiFilled = 0;
+    for (; uiFilled < 8; uiFilled++) {
+        pFill[uiFilled].fctTask = coro_noop_task;
+        pFill[uiFilled].pArg    = NULL;
+        if (0 != stTiny.stExec.fctSubmit(&(stTiny.stExec), &(pFill[uiFilled]))) {
+            break;
+        }
+    }
+    assert(uiFilled < 8);
+
+    coro_refused(stTiny);
+    usleep(100*1000);
+    std::cout << "coro_timer on a full pool" << std::endl;
+    assert(0 == __atomic_load_n(&bRefusedDone, __ATOMIC_ACQUIRE));
+    pu_sem_post(&semBlock);
+    iResult = pu_sem_timedwait(&semDone, 5000);
+    assert(0 == iResult);
+    assert(uiRefusedTicks > 1);
+    assert(bRefusedOnPool);
+    iResult = pu_executor_pool_destroy(&stTiny);
+    assert(0 == iResult);
+    UNUSED(iResult);
+    UNUSED(uiFilled);
+    POSUTILS_EXIT;
+    return (0);
+}
+/* main */
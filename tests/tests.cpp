@@ -26,12 +26,21 @@
 /**** System includes, namespaces, then local includes  *********************/
 #include <iostream>
 #include <cstring>
+#include <string>
 #include <unistd.h>
 #include <signal.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
 #include <pthread.h>
 #include <assert.h>
 #include "posutils.h"
 #include "putimer.h"
+#include "pushm.h"
+#include "puqueue.h"
+#include "pufuture.h"
+#include "pureactor.h"
 
 // start anonymous namespace
 namespace {
@@ -46,6 +55,59 @@ namespace {
 int   sighandler_install( void );
 void  sighandler_handler( int signo, siginfo_t* info, void* data );
 void* stub_thread(void* pArg);
+void* rwlock_reader_thread(void* pArg);
+void  test_rwlock( pu_rwlock_type enType );
+void* seqlock_writer_thread(void* pArg);
+void  test_seqlock( void );
+void  timer_stub_callback( void* pCookie );
+void  test_timer_info( void );
+void  test_timer_object( void );
+void* mutex_profile_thread(void* pArg);
+void  test_mutex_profile( void );
+void  lockdep_report( const char* szHeld, const char* szAcquired, const char* szReason );
+void  test_lockdep( void );
+void* robust_owner_thread( void* pArg );
+int   robust_recover( pthread_mutex_t* pMtx, void* pArg );
+void  test_mutex_robust( void );
+void  test_shm( void );
+void* sem_consumer_thread( void* pArg );
+void* eventcount_waiter_thread( void* pArg );
+void  test_futex( void );
+void  barrier_member( pu_thread_group_t* pGroup, size_t uiIndex, void* pArg );
+void  test_barrier( void );
+void* spinlock_thread( void* pArg );
+void  test_spinlock( void );
+void* queue_producer_thread( void* pArg );
+void* queue_consumer_thread( void* pArg );
+void  test_queue( void );
+void* delayqueue_consumer_thread( void* pArg );
+void  test_delayqueue( void );
+void  monitor_hang( const char* szName, int iTid, size_t uiStalledMs );
+void* monitor_busy_thread( void* pArg );
+void* monitor_stall_thread( void* pArg );
+void  test_monitor( void );
+void  monitor_slow_hang( const char* szName, int iTid, size_t uiStalledMs );
+void* monitor_stop_thread( void* pArg );
+void  test_monitor_stop( void );
+void* profiler_spin_thread( void* pArg );
+size_t profiler_samples( const char* szThread );
+void  test_profiler( void );
+void  test_perf( void );
+void  test_trace( void );
+void  ebr_obj_free( pu_ebr_node_t* pNode );
+void* ebr_reader_thread( void* pArg );
+void* ebr_writer_thread( void* pArg );
+void  test_ebr( void );
+void  hazard_obj_free( void* pObj );
+void* hazard_reader_thread( void* pArg );
+void  test_hazard( void );
+int   future_add_one( void* pValue, int iError, void* pArg, void** ppResult );
+void* future_producer_thread( void* pArg );
+void  test_future( void );
+void  test_ratelimit( void );
+void  reactor_done( pu_reactor_op_t* pOp, int iResult );
+int   reactor_wait( pu_reactor_t hReactor, pu_reactor_op_t* pOp );
+void  test_reactor( pu_reactor_backend_t enBackend );
 
 /****************************************************************************/
 /* LOCAL FUNCTION DEFINITIONS                                               */
@@ -76,7 +138,1592 @@ void* stub_thread(void* pArg) {
     return (NULL);
 }
 
+// Shared state for the reader-writer lock test. The writer keeps A and B equal,
+// a reader must never see them differ.
+pu_rwlock_t lckRw;
+size_t      uiRwA = 0;
+size_t      uiRwB = 0;
 
+void* rwlock_reader_thread(void* pArg) {
+    UNUSED(pArg);
+    for (int i = 0; i < 100000; i++) {
+        pu_rwlock_rdlock(&lckRw);
+        assert(uiRwA == uiRwB);
+        pu_rwlock_rdunlock(&lckRw);
+    }
+    return (NULL);
+}
+
+void test_rwlock( pu_rwlock_type enType ) {
+    pthread_t pThreadList[BATCH_SIZE];
+
+    std::cout << "Reader-writer lock, type: " << enType << std::endl;
+    int iResult = pu_rwlock_create_type(&lckRw, enType);
+    assert(0 == iResult);
+    for (size_t i = 0; i < BATCH_SIZE; i++) {
+        pThreadList[i] = PU_THREAD_CREATE(rwlock_reader_thread, NULL, 32*1024);
+        assert(0 != pThreadList[i]);
+    }
+    for (int i = 0; i < 1000; i++) {
+        pu_rwlock_wrlock(&lckRw);
+        uiRwA++;
+        uiRwB++;
+        pu_rwlock_wrunlock(&lckRw);
+    }
+    for (size_t i = 0; i < BATCH_SIZE; i++) {
+        pthread_join(pThreadList[i], NULL);
+    }
+    iResult = pu_rwlock_tryrdlock(&lckRw);
+    assert(EBUSY != iResult);
+    pu_rwlock_rdunlock(&lckRw);
+    pu_rwlock_destroy(&lckRw);
+    UNUSED(iResult);
+}
+
+
+// Sequence lock test. The writer keeps both halves equal, a reader must never see them differ.
+struct seq_pair_t {
+    size_t uiA;
+    size_t uiB;
+};
+pu::seqlock<seq_pair_t> seqPair;
+
+void* seqlock_writer_thread(void* pArg) {
+    UNUSED(pArg);
+    for (size_t i = 1; i <= 100000; i++) {
+        seq_pair_t stPair = { i, i };
+        seqPair.store(stPair);
+    }
+    return (NULL);
+}
+
+void test_seqlock( void ) {
+    std::cout << "Sequence lock" << std::endl;
+    pthread_t pidWriter = PU_THREAD_CREATE(seqlock_writer_thread, NULL, 32*1024);
+    assert(0 != pidWriter);
+    size_t uiLast = 0;
+    while (uiLast < 100000) {
+        seq_pair_t stPair = seqPair.load();
+        assert(stPair.uiA == stPair.uiB);
+        assert(stPair.uiA >= uiLast);
+        uiLast = stPair.uiA;
+    }
+    pthread_join(pidWriter, NULL);
+}
+
+void timer_stub_callback( void* pCookie ) {
+    UNUSED(pCookie);
+}
+
+// The published next deadline must track the queue head
+void test_timer_info( void ) {
+    putimer_info_t stInfo;
+
+    std::cout << "Timer info" << std::endl;
+    putimer_hnd_t hndTmr = putimer_create(PUTIMER_TYPE_SINGLESHOT, timer_stub_callback, 20, NULL);
+    assert(NULL != hndTmr);
+    int iResult = putimer_get_info(&stInfo);
+    assert(0 == iResult);
+    assert(0 == stInfo.iHasDeadline);
+    size_t uiFired = stInfo.uiFiredCount;
+    putimer_start(hndTmr);
+    iResult = putimer_get_info(&stInfo);
+    assert(0 == iResult);
+    assert(0 != stInfo.iHasDeadline);
+    usleep(100*1000);
+    iResult = putimer_get_info(&stInfo);
+    assert(0 == iResult);
+    assert(0 == stInfo.iHasDeadline);
+    assert(uiFired + 1 == stInfo.uiFiredCount);
+    putimer_delete(hndTmr);
+    UNUSED(iResult);
+    UNUSED(uiFired);
+}
+
+// C++ timers keep their callable in the timer slot, so the object can move while armed
+void test_timer_object( void ) {
+    int iOnce = 0;
+    int iTicks = 0;
+    int* pOnce = &iOnce;
+    int* pTicks = &iTicks;
+
+    std::cout << "Timer object" << std::endl;
+    auto tmrOnce = pu::make_timer(PUTIMER_TYPE_SINGLESHOT, 20, [pOnce]() {
+        __atomic_add_fetch(pOnce, 1, __ATOMIC_RELAXED);
+    });
+    assert(tmrOnce.valid());
+    int iResult = tmrOnce.start();
+    assert(0 == iResult);
+    assert(tmrOnce.active());
+    auto tmrMoved = std::move(tmrOnce);
+    assert(!tmrOnce.valid());
+    usleep(100*1000);
+    assert(1 == __atomic_load_n(&iOnce, __ATOMIC_RELAXED));
+    assert(!tmrMoved.active());
+
+    // Lock-able, with a capture that fills the slot
+    size_t uiStep = 2;
+    size_t uiUnused[2] = { 0, 0 };
+    auto tmrTick = pu::make_timer(PUTIMER_TYPE_PERIODIC, 10, [pTicks, uiStep, uiUnused]() {
+        __atomic_add_fetch(pTicks, (int)(uiStep + uiUnused[0] + uiUnused[1]), __ATOMIC_RELAXED);
+    }, true);
+    iResult = tmrTick.start();
+    assert(0 == iResult);
+    usleep(100*1000);
+    size_t uiMsLeft = 0;
+    iResult = tmrTick.stop(&uiMsLeft);
+    assert(0 == iResult);
+    int iSeen = __atomic_load_n(&iTicks, __ATOMIC_RELAXED);
+    assert((iSeen >= 4) && (0 == (iSeen % 2)));
+    UNUSED(iResult);
+    UNUSED(iSeen);
+}
+
+// Lock profiling. The holder sleeps, so the other threads are guaranteed to contend.
+pthread_mutex_t mtxProfiled;
+
+void* mutex_profile_thread(void* pArg) {
+    UNUSED(pArg);
+    for (int i = 0; i < 5; i++) {
+        pu_mutex_lock(&mtxProfiled);
+        usleep(1000);
+        pu_mutex_unlock(&mtxProfiled);
+    }
+    return (NULL);
+}
+
+void test_mutex_profile( void ) {
+    pthread_t        pThreadList[4];
+    pu_mutex_stats_t stStats[4];
+    pu_mutex_attr_t  stAttr = PU_MUTEX_ATTR_INITIALIZER(PU_MUTEX_ATTR_PROFILE);
+
+    std::cout << "Mutex profiling" << std::endl;
+    int iResult = pu_mutex_create_attr(&mtxProfiled, PU_MUTEX_TYPE_FAST, &stAttr);
+    assert(0 == iResult);
+    for (size_t i = 0; i < 4; i++) {
+        pThreadList[i] = PU_THREAD_CREATE(mutex_profile_thread, NULL, 32*1024);
+        assert(0 != pThreadList[i]);
+    }
+    for (size_t i = 0; i < 4; i++) {
+        pthread_join(pThreadList[i], NULL);
+    }
+    size_t uiCount = pu_mutex_profile_report(stStats, 4);
+    assert(1 == uiCount);
+    assert(&mtxProfiled == stStats[0].pMtx);
+    assert(20 == stStats[0].uiAcquisitions);
+    assert(0 < stStats[0].uiContended);
+    assert(1000000 <= stStats[0].uiHoldMaxNs);
+    assert(NULL != strstr(stStats[0].szLabel, "tests.cpp"));
+    pu_mutex_profile_print(stdout, 4);
+    pu_mutex_destroy(&mtxProfiled);
+    uiCount = pu_mutex_profile_report(stStats, 4);
+    assert(0 == uiCount);
+    UNUSED(iResult);
+    UNUSED(uiCount);
+}
+
+// Lock order checking. A->B then B->A on the same thread never deadlocks, but must be reported.
+size_t uiLockdepReports = 0;
+
+void lockdep_report( const char* szHeld, const char* szAcquired, const char* szReason ) {
+    std::cout << "LOCKDEP report: " << szReason << " (" << szHeld << " -> " << szAcquired << ")" << std::endl;
+    uiLockdepReports++;
+}
+
+void test_lockdep( void ) {
+    pthread_mutex_t mtxA;
+    pthread_mutex_t mtxB;
+    pu_mutex_attr_t stAttrA = PU_MUTEX_ATTR_INITIALIZER(PU_MUTEX_ATTR_LOCKDEP);
+    pu_mutex_attr_t stAttrB = PU_MUTEX_ATTR_INITIALIZER(PU_MUTEX_ATTR_LOCKDEP);
+
+    std::cout << "Lock order checking" << std::endl;
+    pu_lockdep_set_report(lockdep_report);
+    int iResult = pu_mutex_create_attr(&mtxA, PU_MUTEX_TYPE_FAST, &stAttrA);
+    assert(0 == iResult);
+    iResult = pu_mutex_create_attr(&mtxB, PU_MUTEX_TYPE_FAST, &stAttrB);
+    assert(0 == iResult);
+    size_t uiBefore = pu_lockdep_violations();
+    size_t uiAfter  = 0;
+
+    // Establish A->B, repeating it is silent
+    for (int i = 0; i < 2; i++) {
+        pu_mutex_lock(&mtxA);
+        pu_mutex_lock(&mtxB);
+        pu_mutex_unlock(&mtxB);
+        pu_mutex_unlock(&mtxA);
+    }
+    uiAfter = pu_lockdep_violations();
+    assert(uiBefore == uiAfter);
+
+    // B->A closes the cycle, reported once only
+    for (int i = 0; i < 2; i++) {
+        pu_mutex_lock(&mtxB);
+        pu_mutex_lock(&mtxA);
+        pu_mutex_unlock(&mtxA);
+        pu_mutex_unlock(&mtxB);
+    }
+    uiAfter = pu_lockdep_violations();
+    assert((uiBefore + 1) == uiAfter);
+    assert(1 == uiLockdepReports);
+
+    pu_lockdep_set_report(NULL);
+    pu_mutex_destroy(&mtxA);
+    pu_mutex_destroy(&mtxB);
+    UNUSED(iResult);
+    UNUSED(uiBefore);
+    UNUSED(uiAfter);
+}
+
+
+// Robust mutex: the owner thread exits while holding it, the next locker repairs the data
+pthread_mutex_t mtxRobust;
+int             iRobustData = 0;
+int             iRobustRecoveries = 0;
+
+void* robust_owner_thread( void* pArg ) {
+    UNUSED(pArg);
+    pu_mutex_lock(&mtxRobust);
+    iRobustData = -1;   // "half way through an update"
+    return (NULL);      // dies holding the lock
+}
+
+int robust_recover( pthread_mutex_t* pMtx, void* pArg ) {
+    UNUSED(pMtx);
+    iRobustRecoveries++;
+    iRobustData = *(int*)pArg;
+    return (0);
+}
+
+void test_mutex_robust( void ) {
+    pthread_mutex_t mtxPi;
+    int             iRepaired = 42;
+
+    std::cout << "Priority inheritance and robust mutexes" << std::endl;
+    int iResult = pu_mutex_create_type(&mtxPi, PU_MUTEX_TYPE_PRIO_INHERIT);
+    assert(0 == iResult);
+    iResult = pu_mutex_lock(&mtxPi);
+    assert(0 == iResult);
+    iResult = pu_mutex_unlock(&mtxPi);
+    assert(0 == iResult);
+    pu_mutex_destroy(&mtxPi);
+
+    iResult = pu_mutex_create_type(&mtxRobust, PU_MUTEX_TYPE_ROBUST);
+    assert(0 == iResult);
+    pthread_t thOwner = PU_THREAD_CREATE(robust_owner_thread, NULL, 0);
+    assert(0 != thOwner);
+    pthread_join(thOwner, NULL);
+
+    iResult = pu_mutex_lock_robust(&mtxRobust, robust_recover, &iRepaired);
+    assert(0 == iResult);
+    assert(1 == iRobustRecoveries);
+    assert(42 == iRobustData);
+    iResult = pu_mutex_unlock(&mtxRobust);
+    assert(0 == iResult);
+
+    // Consistent again, so no further recovery
+    iResult = pu_mutex_lock_robust(&mtxRobust, robust_recover, &iRepaired);
+    assert(0 == iResult);
+    assert(1 == iRobustRecoveries);
+    iResult = pu_mutex_unlock(&mtxRobust);
+    assert(0 == iResult);
+    pu_mutex_destroy(&mtxRobust);
+    UNUSED(iResult);
+}
+
+// Shared memory: a child process consumes from the ring, both processes share a counter
+#define SHM_MESSAGES ((unsigned)1000)
+#define SHM_SLOTS    ((size_t)16)
+
+typedef struct {
+    pthread_mutex_t mtxCounter;
+    unsigned        uiCounter;
+    pu_shm_sem_t    semDone;
+}   shm_ctrl_t;
+
+void test_shm( void ) {
+    size_t uiRingSize = pu_shm_ring_size(sizeof(unsigned), SHM_SLOTS);
+    size_t uiSize     = 4096 + uiRingSize;
+    void*  pMem       = mmap(NULL, uiSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    std::cout << "Process-shared synchronisation" << std::endl;
+    assert(MAP_FAILED != pMem);
+    shm_ctrl_t* pCtrl = (shm_ctrl_t*)pMem;
+    void*       pRingMem = (char*)pMem + 4096;
+    int iResult = pu_shm_mutex_create(&pCtrl->mtxCounter, PU_MUTEX_TYPE_ROBUST);
+    assert(0 == iResult);
+    iResult = pu_shm_sem_create(&pCtrl->semDone, 0);
+    assert(0 == iResult);
+    pCtrl->uiCounter = 0;
+    pu_shm_ring_t* pRing = pu_shm_ring_attach(pRingMem);
+    assert(NULL == pRing);
+    pRing = pu_shm_ring_create(pRingMem, uiRingSize, sizeof(unsigned), SHM_SLOTS);
+    assert(NULL != pRing);
+
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (0 == pid) {
+        pRing = pu_shm_ring_attach(pRingMem);
+        int iExit = (NULL == pRing) ? 1 : 0;
+        for (unsigned i = 0; (0 == iExit) && (i < SHM_MESSAGES); i++) {
+            if (0 != pu_shm_ring_wait_data(pRing, 5000)) {
+                iExit = 2;
+            } else if (i != *(const unsigned*)pu_shm_ring_peek(pRing)) {
+                iExit = 3;
+            } else {
+                pu_shm_ring_release(pRing);
+                pu_mutex_lock(&pCtrl->mtxCounter);
+                pCtrl->uiCounter++;
+                pu_mutex_unlock(&pCtrl->mtxCounter);
+            }
+        }
+        pu_shm_sem_post(&pCtrl->semDone);
+        _exit(iExit);
+    }
+
+    // Producer, with a small ring so that it regularly waits for space
+    pRing = pu_shm_ring_attach(pRingMem);
+    assert(NULL != pRing);
+    for (unsigned i = 0; i < SHM_MESSAGES; i++) {
+        iResult = pu_shm_ring_wait_space(pRing, 5000);
+        assert(0 == iResult);
+        *(unsigned*)pu_shm_ring_reserve(pRing) = i;
+        pu_shm_ring_commit(pRing);
+        pu_mutex_lock(&pCtrl->mtxCounter);
+        pCtrl->uiCounter++;
+        pu_mutex_unlock(&pCtrl->mtxCounter);
+    }
+    iResult = pu_shm_sem_timedwait(&pCtrl->semDone, 5000);
+    assert(0 == iResult);
+    int   iStatus = -1;
+    pid_t pidDone = waitpid(pid, &iStatus, 0);
+    assert(pid == pidDone);
+    assert(WIFEXITED(iStatus) && (0 == WEXITSTATUS(iStatus)));
+    assert((2 * SHM_MESSAGES) == pCtrl->uiCounter);
+    iResult = pu_shm_sem_timedwait(&pCtrl->semDone, 10);
+    assert(ETIMEDOUT == iResult);
+    iResult = pu_shm_ring_wait_data(pRing, 10);
+    assert(ETIMEDOUT == iResult);
+
+    pu_mutex_destroy(&pCtrl->mtxCounter);
+    munmap(pMem, uiSize);
+    UNUSED(iResult);
+    UNUSED(pidDone);
+    UNUSED(iStatus);
+}
+
+// Futex semaphore (batch post) and event count
+#define SEM_ITEMS ((unsigned)1000)
+
+pu_sem_t        semItems;
+pu_eventcount_t ecFlag = PU_EVENTCOUNT_INITIALIZER;
+unsigned        uiFlag = 0;
+
+void* sem_consumer_thread( void* pArg ) {
+    UNUSED(pArg);
+    for (unsigned i = 0; i < SEM_ITEMS / 2; i++) {
+        int iResult = pu_sem_timedwait(&semItems, 5000);
+        assert(0 == iResult);
+        UNUSED(iResult);
+    }
+    return (NULL);
+}
+
+void* eventcount_waiter_thread( void* pArg ) {
+    UNUSED(pArg);
+    for (;;) {
+        if (__atomic_load_n(&uiFlag, __ATOMIC_ACQUIRE)) break;
+        unsigned int uiKey = pu_eventcount_prepare_wait(&ecFlag);
+        if (__atomic_load_n(&uiFlag, __ATOMIC_ACQUIRE)) {
+            pu_eventcount_cancel_wait(&ecFlag);
+            break;
+        }
+        int iResult = pu_eventcount_wait(&ecFlag, uiKey, 5000);
+        assert(0 == iResult);
+        UNUSED(iResult);
+    }
+    return (NULL);
+}
+
+void test_futex( void ) {
+    std::cout << "Futex semaphore and event count" << std::endl;
+    int iResult = pu_sem_create(&semItems, 0, 0);
+    assert(0 == iResult);
+    iResult = pu_sem_trywait(&semItems);
+    assert(EAGAIN == iResult);
+    iResult = pu_sem_timedwait(&semItems, 10);
+    assert(ETIMEDOUT == iResult);
+    iResult = pu_sem_post_n(&semItems, 3);
+    assert(0 == iResult);
+    unsigned int uiValue = pu_sem_value(&semItems);
+    assert(3 == uiValue);
+    for (int i = 0; i < 3; i++) {
+        iResult = pu_sem_trywait(&semItems);
+        assert(0 == iResult);
+    }
+
+    // Two consumers, items posted in batches of 10
+    pthread_t thA = PU_THREAD_CREATE(sem_consumer_thread, NULL, 0);
+    pthread_t thB = PU_THREAD_CREATE(sem_consumer_thread, NULL, 0);
+    for (unsigned i = 0; i < SEM_ITEMS; i += 10) {
+        pu_sem_post_n(&semItems, 10);
+    }
+    pthread_join(thA, NULL);
+    pthread_join(thB, NULL);
+    uiValue = pu_sem_value(&semItems);
+    assert(0 == uiValue);
+
+    // Event count: nothing notified, so the wait times out
+    unsigned int uiKey = pu_eventcount_prepare_wait(&ecFlag);
+    iResult = pu_eventcount_wait(&ecFlag, uiKey, 10);
+    assert(ETIMEDOUT == iResult);
+
+    pthread_t thW = PU_THREAD_CREATE(eventcount_waiter_thread, NULL, 0);
+    usleep(10000);
+    __atomic_store_n(&uiFlag, 1, __ATOMIC_RELEASE);
+    pu_eventcount_notify_all(&ecFlag);
+    pthread_join(thW, NULL);
+    UNUSED(iResult);
+    UNUSED(uiValue);
+}
+
+// Barrier through a thread group, and a latch
+#define BAR_THREADS ((size_t)4)
+#define BAR_PHASES  ((size_t)50)
+
+size_t     uiBarCounter = 0;
+size_t     uiBarErrors  = 0;
+pu_latch_t latBarDone;
+
+void barrier_member( pu_thread_group_t* pGroup, size_t uiIndex, void* pArg ) {
+    UNUSED(uiIndex);
+    UNUSED(pArg);
+    for (size_t i = 0; i < BAR_PHASES; i++) {
+        __atomic_fetch_add(&uiBarCounter, 1, __ATOMIC_RELAXED);
+        if (PU_BARRIER_SERIAL_THREAD == pu_thread_group_barrier(pGroup)) {
+            if (__atomic_load_n(&uiBarCounter, __ATOMIC_RELAXED) != (BAR_THREADS * (i + 1))) {
+                uiBarErrors++;
+            }
+        }
+        pu_thread_group_barrier(pGroup);
+    }
+    pu_latch_count_down(&latBarDone, 1);
+}
+
+void test_barrier( void ) {
+    pu_thread_group_t stGroup;
+
+    std::cout << "Barrier, latch and thread group" << std::endl;
+    int iResult = pu_latch_create(&latBarDone, BAR_THREADS);
+    assert(0 == iResult);
+    iResult = pu_latch_wait(&latBarDone, 10);
+    assert(ETIMEDOUT == iResult);
+    iResult = pu_thread_group_create(&stGroup, BAR_THREADS, barrier_member, NULL, 0, "barrier_member");
+    assert(0 == iResult);
+    iResult = pu_latch_wait(&latBarDone, 5000);
+    assert(0 == iResult);
+    iResult = pu_thread_group_join(&stGroup);
+    assert(0 == iResult);
+    iResult = pu_latch_try_wait(&latBarDone);
+    assert(0 != iResult);
+    assert((BAR_THREADS * BAR_PHASES) == uiBarCounter);
+    assert(0 == uiBarErrors);
+    UNUSED(iResult);
+}
+
+// Spinlock: several threads bump a shared counter
+#define SPIN_THREADS ((size_t)4)
+#define SPIN_LOOPS   ((size_t)10000)
+
+pu_spinlock_t lckSpin = PU_SPINLOCK_INITIALIZER;
+size_t        uiSpinCounter = 0;
+
+void* spinlock_thread( void* pArg ) {
+    UNUSED(pArg);
+    for (size_t i = 0; i < SPIN_LOOPS; i++) {
+        pu_spinlock_lock(&lckSpin);
+        uiSpinCounter++;
+        pu_spinlock_unlock(&lckSpin);
+    }
+    return (NULL);
+}
+
+void test_spinlock( void ) {
+    pthread_t pThreads[SPIN_THREADS];
+
+    std::cout << "Spinlock" << std::endl;
+    assert(0 == (sizeof(pu_spinlock_t) % PU_CACHELINE_SIZE));
+    int iResult = pu_spinlock_trylock(&lckSpin);
+    assert(0 == iResult);
+    iResult = pu_spinlock_trylock(&lckSpin);
+    assert(EBUSY == iResult);
+    pu_spinlock_unlock(&lckSpin);
+
+    for (size_t i = 0; i < SPIN_THREADS; i++) {
+        pThreads[i] = PU_THREAD_CREATE(spinlock_thread, NULL, 0);
+    }
+    for (size_t i = 0; i < SPIN_THREADS; i++) {
+        pthread_join(pThreads[i], NULL);
+    }
+    assert((SPIN_THREADS * SPIN_LOOPS) == uiSpinCounter);
+    UNUSED(iResult);
+}
+
+// Queue: 2 producers and 2 consumers through a small MPMC queue, then the batch,
+// timeout and C++ variants
+#define Q_ITEMS_PER_PRODUCER ((size_t)20000)
+
+pu_queue_t qTest;
+size_t     uiQueueSum = 0;
+
+void* queue_producer_thread( void* pArg ) {
+    size_t uiBase = (size_t)pArg;
+    for (size_t i = 1; i <= Q_ITEMS_PER_PRODUCER; i++) {
+        int iResult = pu_queue_push_wait(&qTest, (void*)(uiBase + i), PU_FUTEX_WAIT_FOREVER);
+        assert(0 == iResult);
+        UNUSED(iResult);
+    }
+    return (NULL);
+}
+
+void* queue_consumer_thread( void* pArg ) {
+    UNUSED(pArg);
+    void*  pItem;
+    size_t uiSum = 0;
+    while (0 == pu_queue_pop_wait(&qTest, &pItem, 200)) {
+        uiSum += (size_t)pItem;
+    }
+    __atomic_fetch_add(&uiQueueSum, uiSum, __ATOMIC_RELAXED);
+    return (NULL);
+}
+
+struct queue_msg_t {
+    int    iId;
+    double dValue;
+};
+
+void test_queue( void ) {
+    pthread_t pThreads[4];
+    void*     pBatch[8];
+    void*     pItem;
+
+    std::cout << "Lock-free queue" << std::endl;
+    int iResult = pu_queue_create(&qTest, PU_QUEUE_TYPE_MPMC, 60);
+    assert(0 == iResult);
+    iResult = pu_queue_pop(&qTest, &pItem);
+    assert(EAGAIN == iResult);
+    pThreads[0] = PU_THREAD_CREATE(queue_producer_thread, (void*)0, 0);
+    pThreads[1] = PU_THREAD_CREATE(queue_producer_thread, (void*)1000000, 0);
+    pThreads[2] = PU_THREAD_CREATE(queue_consumer_thread, NULL, 0);
+    pThreads[3] = PU_THREAD_CREATE(queue_consumer_thread, NULL, 0);
+    for (size_t i = 0; i < 4; i++) {
+        pthread_join(pThreads[i], NULL);
+    }
+    size_t uiExpected = (Q_ITEMS_PER_PRODUCER * (Q_ITEMS_PER_PRODUCER + 1)) + (Q_ITEMS_PER_PRODUCER * 1000000);
+    assert(uiExpected == uiQueueSum);
+    size_t uiCount = pu_queue_size(&qTest);
+    assert(0 == uiCount);
+    pu_queue_destroy(&qTest);
+
+    // Batches on an SPSC queue of 4: only 4 of 8 fit
+    iResult = pu_queue_create(&qTest, PU_QUEUE_TYPE_SPSC, 4);
+    assert(0 == iResult);
+    for (size_t i = 0; i < 8; i++) {
+        pBatch[i] = (void*)(i + 1);
+    }
+    uiCount = pu_queue_push_batch(&qTest, pBatch, 8);
+    assert(4 == uiCount);
+    iResult = pu_queue_push_wait(&qTest, pBatch[0], 10);
+    assert(ETIMEDOUT == iResult);
+    memset(pBatch, 0, sizeof(pBatch));
+    uiCount = pu_queue_pop_batch(&qTest, pBatch, 8);
+    assert(4 == uiCount);
+    assert((void*)1 == pBatch[0] && (void*)4 == pBatch[3]);
+    iResult = pu_queue_pop_wait(&qTest, &pItem, 10);
+    assert(ETIMEDOUT == iResult);
+    pu_queue_destroy(&qTest);
+
+    // C++, by value
+    pu::queue<queue_msg_t, PU_QUEUE_TYPE_MPSC> qMsgs(3);
+    queue_msg_t stMsg = { 7, 1.5 };
+    uiCount = qMsgs.capacity();
+    assert(4 == uiCount);
+    bool bResult = qMsgs.try_push(stMsg);
+    assert(bResult);
+    stMsg.iId = 0;
+    bResult = qMsgs.pop(stMsg, 10);
+    assert(bResult);
+    assert((7 == stMsg.iId) && (1.5 == stMsg.dValue));
+    bResult = qMsgs.pop(stMsg, 10);
+    assert(!bResult);
+    UNUSED(iResult);
+    UNUSED(uiCount);
+    UNUSED(bResult);
+    UNUSED(uiExpected);
+}
+
+// Delay queue: a consumer blocked on a late item is woken for an earlier one
+pu_delayqueue_t dqTest;
+
+void* delayqueue_consumer_thread( void* pArg ) {
+    void* pItem = NULL;
+    UNUSED(pArg);
+    int iResult = pu_delayqueue_take(&dqTest, &pItem, PU_DELAYQUEUE_WAIT_FOREVER);
+    assert(0 == iResult);
+    UNUSED(iResult);
+    return (pItem);
+}
+
+void test_delayqueue( void ) {
+    pthread_t pThreads[2];
+    void*     pItem;
+    void*     pResult;
+    uint64_t  ulStart;
+    size_t    uiCount;
+
+    std::cout << "Delay queue" << std::endl;
+    int iResult = pu_delayqueue_create(&dqTest, 2);
+    assert(0 == iResult);
+
+    // Ready time order, not put order. Ties stay FIFO.
+    ulStart = timespec_now_ns_monotonic();
+    iResult = pu_delayqueue_put(&dqTest, (void*)60, 60);
+    assert(0 == iResult);
+    iResult = pu_delayqueue_put(&dqTest, (void*)20, 20);
+    assert(0 == iResult);
+    iResult = pu_delayqueue_put(&dqTest, (void*)40, 40);
+    assert(0 == iResult);
+    for (size_t i = 0; i < 20; i++) {
+        iResult = pu_delayqueue_put_at(&dqTest, (void*)(1000 + i), ulStart + 80000000ULL);
+        assert(0 == iResult);
+    }
+    uiCount = pu_delayqueue_size(&dqTest);
+    assert(23 == uiCount);
+    iResult = pu_delayqueue_poll(&dqTest, &pItem);
+    assert(EAGAIN == iResult);
+    iResult = pu_delayqueue_take(&dqTest, &pItem, 5);
+    assert(ETIMEDOUT == iResult);
+    iResult = pu_delayqueue_take(&dqTest, &pItem, 1000);
+    assert(0 == iResult);
+    assert((void*)20 == pItem);
+    uint64_t ulTaken = timespec_now_ns_monotonic();
+    assert(ulTaken - ulStart >= 20000000ULL);
+    iResult = pu_delayqueue_take(&dqTest, &pItem, 1000);
+    assert(0 == iResult);
+    assert((void*)40 == pItem);
+    iResult = pu_delayqueue_take(&dqTest, &pItem, 1000);
+    assert(0 == iResult);
+    assert((void*)60 == pItem);
+    for (size_t i = 0; i < 20; i++) {
+        iResult = pu_delayqueue_take(&dqTest, &pItem, 1000);
+        assert(0 == iResult);
+        assert((void*)(1000 + i) == pItem);
+    }
+    uiCount = pu_delayqueue_size(&dqTest);
+    assert(0 == uiCount);
+
+    // Two blocked consumers, one waiting for a 10s item, both get the earlier puts
+    iResult = pu_delayqueue_put(&dqTest, (void*)3, 10000);
+    assert(0 == iResult);
+    pThreads[0] = PU_THREAD_CREATE(delayqueue_consumer_thread, NULL, 0);
+    pThreads[1] = PU_THREAD_CREATE(delayqueue_consumer_thread, NULL, 0);
+    usleep(20000);
+    iResult = pu_delayqueue_put(&dqTest, (void*)1, 10);
+    assert(0 == iResult);
+    iResult = pu_delayqueue_put(&dqTest, (void*)2, 0);
+    assert(0 == iResult);
+    size_t uiSum = 0;
+    for (size_t i = 0; i < 2; i++) {
+        pthread_join(pThreads[i], &pResult);
+        uiSum += (size_t)pResult;
+    }
+    assert(3 == uiSum);
+    uiCount = pu_delayqueue_size(&dqTest);
+    assert(1 == uiCount);
+
+    // Closed: puts fail, a take returns instead of waiting for the 10s item
+    pu_delayqueue_close(&dqTest);
+    iResult = pu_delayqueue_put(&dqTest, (void*)4, 0);
+    assert(0 != iResult);
+    iResult = pu_delayqueue_take(&dqTest, &pItem, PU_DELAYQUEUE_WAIT_FOREVER);
+    assert(EPIPE == iResult);
+    iResult = pu_delayqueue_destroy(&dqTest);
+    assert(0 == iResult);
+    UNUSED(iResult);
+    UNUSED(uiCount);
+    UNUSED(ulTaken);
+}
+
+// Hang monitor: one thread keeps beating, the other stalls once for well over its budget
+int          iMonitorStallTid = 0;
+size_t       uiMonitorHangs   = 0;
+size_t       uiMonitorOthers  = 0;
+volatile int bMonitorDone     = 0;
+
+void monitor_hang( const char* szName, int iTid, size_t uiStalledMs ) {
+    if ((0 == strcmp(szName, "monitor_stall_thread")) && (iTid == iMonitorStallTid) && (uiStalledMs >= 50)) {
+        __atomic_fetch_add(&uiMonitorHangs, 1, __ATOMIC_RELAXED);
+    }
+    else {
+        __atomic_fetch_add(&uiMonitorOthers, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void* monitor_busy_thread( void* pArg ) {
+    UNUSED(pArg);
+    int iResult = pu_thread_watch(50);
+    assert(0 == iResult);
+    UNUSED(iResult);
+    while (!bMonitorDone) {
+        pu_thread_heartbeat();
+        usleep(5000);
+    }
+    return (NULL);
+}
+
+void* monitor_stall_thread( void* pArg ) {
+    UNUSED(pArg);
+    iMonitorStallTid = (int)syscall(SYS_gettid);
+    int iResult = pu_thread_watch(50);
+    assert(0 == iResult);
+    UNUSED(iResult);
+    for (size_t i = 0; i < 10; i++) {
+        pu_thread_heartbeat();
+        usleep(5000);
+    }
+    usleep(300000);
+    for (size_t i = 0; i < 10; i++) {
+        pu_thread_heartbeat();
+        usleep(5000);
+    }
+    return (NULL);
+}
+
+void test_monitor( void ) {
+    pthread_t pThreads[2];
+
+    std::cout << "Hang monitor" << std::endl;
+    int iResult = pu_thread_watch(50);
+    assert(0 != iResult);
+    iResult = pu_thread_monitor_start(20, monitor_hang, PU_THREAD_MONITOR_BACKTRACE);
+    assert(0 == iResult);
+    iResult = pu_thread_monitor_start(20, monitor_hang, 0);
+    assert(0 != iResult);
+    pThreads[0] = PU_THREAD_CREATE(monitor_busy_thread, NULL, 0);
+    pThreads[1] = PU_THREAD_CREATE(monitor_stall_thread, NULL, 0);
+    pthread_join(pThreads[1], NULL);
+    bMonitorDone = 1;
+    pthread_join(pThreads[0], NULL);
+    iResult = pu_thread_monitor_stop();
+    assert(0 == iResult);
+    iResult = pu_thread_monitor_stop();
+    assert(0 != iResult);
+    assert(1 == uiMonitorHangs);
+    assert(0 == uiMonitorOthers);
+    UNUSED(iResult);
+}
+
+// Hang monitor stopped while a scan is reporting: stop waits for it, a late backtrace signal is harmless
+int    bMonitorInReport   = 0;
+int    bMonitorReportDone = 0;
+int    bMonitorRelease    = 0;
+size_t uiMonitorSlowHangs = 0;
+
+void monitor_slow_hang( const char* szName, int iTid, size_t uiStalledMs ) {
+    UNUSED(szName);
+    UNUSED(iTid);
+    UNUSED(uiStalledMs);
+    __atomic_fetch_add(&uiMonitorSlowHangs, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&bMonitorInReport, 1, __ATOMIC_RELEASE);
+    usleep(100000);
+    __atomic_store_n(&bMonitorReportDone, 1, __ATOMIC_RELEASE);
+}
+
+void* monitor_stop_thread( void* pArg ) {
+    UNUSED(pArg);
+    int iResult = pu_thread_watch(20);
+    assert(0 == iResult);
+    UNUSED(iResult);
+    for (size_t i = 0; i < 5; i++) {
+        pu_thread_heartbeat();
+        usleep(2000);
+    }
+    while (!__atomic_load_n(&bMonitorRelease, __ATOMIC_ACQUIRE)) {
+        usleep(1000);
+    }
+    return (NULL);
+}
+
+void test_monitor_stop( void ) {
+    std::cout << "Hang monitor, stopped during a report" << std::endl;
+    int iResult = pu_thread_monitor_start(10, monitor_slow_hang, PU_THREAD_MONITOR_BACKTRACE);
+    assert(0 == iResult);
+    pthread_t pThread = PU_THREAD_CREATE(monitor_stop_thread, NULL, 0);
+    for (size_t i = 0; (i < 5000) && !__atomic_load_n(&bMonitorInReport, __ATOMIC_ACQUIRE); i++) {
+        usleep(1000);
+    }
+    assert(1 == __atomic_load_n(&bMonitorInReport, __ATOMIC_ACQUIRE));
+    iResult = pu_thread_monitor_stop();
+    assert(0 == iResult);
+    assert(1 == __atomic_load_n(&bMonitorReportDone, __ATOMIC_ACQUIRE));
+
+    // The handler is still installed, and nothing is reported any more
+    size_t uiHangs = __atomic_load_n(&uiMonitorSlowHangs, __ATOMIC_RELAXED);
+    iResult = pthread_kill(pThread, PU_THREAD_BACKTRACE_SIGNAL);
+    assert(0 == iResult);
+    usleep(50000);
+    assert(uiHangs == __atomic_load_n(&uiMonitorSlowHangs, __ATOMIC_RELAXED));
+    __atomic_store_n(&bMonitorRelease, 1, __ATOMIC_RELEASE);
+    pthread_join(pThread, NULL);
+    UNUSED(iResult);
+    UNUSED(uiHangs);
+}
+
+// Profiler: a thread burning CPU shows up in the folded stacks, a paused profiler records nothing
+volatile size_t uiProfilerSink = 0;
+
+void* profiler_spin_thread( void* pArg ) {
+    struct timespec tsStart;
+    struct timespec tsNow;
+    UNUSED(pArg);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &tsStart);
+    do {
+        for (size_t i = 0; i < 10000; i++) {
+            uiProfilerSink = uiProfilerSink + i;
+        }
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &tsNow);
+    } while (timespec_a_sub_b_us(&tsNow, &tsStart) < 300000);
+    return (NULL);
+}
+
+// Samples of one thread in the dump, every line "name;frame;... count"
+size_t profiler_samples( const char* szThread ) {
+    char*  szDump   = NULL;
+    size_t uiLength = 0;
+    size_t uiCount  = 0;
+    FILE*  pFile    = open_memstream(&szDump, &uiLength);
+    assert(pFile);
+    int iResult = pu_profiler_dump(pFile);
+    assert(0 == iResult);
+    UNUSED(iResult);
+    fclose(pFile);
+    for (char* szLine = strtok(szDump, "\n"); szLine; szLine = strtok(NULL, "\n")) {
+        char* szCount = strrchr(szLine, ' ');
+        assert(szCount);
+        if ((0 == strncmp(szLine, szThread, strlen(szThread))) && (';' == szLine[strlen(szThread)])) {
+            uiCount += (size_t)atol(szCount + 1);
+        }
+    }
+    free(szDump);
+    return (uiCount);
+}
+
+void test_profiler( void ) {
+    pthread_t pid;
+
+    std::cout << "Profiler" << std::endl;
+    int iResult = pu_profiler_set_rate(100);
+    assert(0 != iResult);
+    iResult = pu_profiler_register("main");
+    assert(0 != iResult);
+
+    // 300ms of CPU at 100Hz, with slack for the tick granularity
+    size_t uiSamples = 0;
+    size_t uiDropped = 0;
+    for (unsigned int uiFlags = 0; uiFlags <= PU_PROFILER_FLAG_FRAME_POINTERS; uiFlags++) {
+        pu_profiler_reset();
+        iResult = pu_profiler_start(100, uiFlags);
+        assert(0 == iResult);
+        iResult = pu_profiler_start(100, uiFlags);
+        assert(0 != iResult);
+        pid = PU_THREAD_CREATE(profiler_spin_thread, NULL, 0);
+        pthread_join(pid, NULL);
+        iResult = pu_profiler_stop();
+        assert(0 == iResult);
+        uiSamples = profiler_samples("profiler_spin_thread");
+        uiDropped = pu_profiler_dropped();
+        assert((uiSamples + uiDropped >= 15) && (uiSamples <= 45));
+    }
+
+    // Paused: the thread registers, but is not sampled
+    pu_profiler_reset();
+    iResult = pu_profiler_start(100, 0);
+    assert(0 == iResult);
+    iResult = pu_profiler_set_rate(0);
+    assert(0 == iResult);
+    pid = PU_THREAD_CREATE(profiler_spin_thread, NULL, 0);
+    pthread_join(pid, NULL);
+    iResult = pu_profiler_stop();
+    assert(0 == iResult);
+    uiSamples = profiler_samples("profiler_spin_thread");
+    assert(0 == uiSamples);
+    uiDropped = pu_profiler_dropped();
+    assert(0 == uiDropped);
+    UNUSED(iResult);
+    UNUSED(uiSamples);
+    UNUSED(uiDropped);
+}
+
+// Performance counters: whichever counters the system allows must count the thread only
+#define PERF_SLEEPS (5)
+
+unsigned int uiPerfValid = 0;
+int          bPerfRead   = 0;
+int          bPerfDone   = 0;
+
+void* perf_sleep_thread( void* pArg ) {
+    UNUSED(pArg);
+    pu_perf_counters_t stBefore;
+    pu_perf_counters_t stAfter;
+    // The system may refuse every counter, the thread then runs without
+    if (0 == pu_perf_read(&stBefore)) {
+        for (int i = 0; i < PERF_SLEEPS; i++) {
+            usleep(1000);
+        }
+        int iResult = pu_perf_read(&stAfter);
+        assert(0 == iResult);
+        UNUSED(iResult);
+        assert(0 != stAfter.uiValid);
+        assert(stBefore.uiValid == stAfter.uiValid);
+        if (stAfter.uiValid & PU_PERF_MASK(PU_PERF_CONTEXT_SWITCHES)) {
+            assert(stAfter.pValues[PU_PERF_CONTEXT_SWITCHES] - stBefore.pValues[PU_PERF_CONTEXT_SWITCHES] >= PERF_SLEEPS);
+        }
+        if (stAfter.uiValid & PU_PERF_MASK(PU_PERF_INSTRUCTIONS)) {
+            assert(stAfter.pValues[PU_PERF_INSTRUCTIONS] > stBefore.pValues[PU_PERF_INSTRUCTIONS]);
+        }
+        uiPerfValid = stAfter.uiValid;
+    }
+    __atomic_store_n(&bPerfRead, 1, __ATOMIC_RELEASE);
+    while (!__atomic_load_n(&bPerfDone, __ATOMIC_ACQUIRE)) {
+        usleep(1000);
+    }
+    return (NULL);
+}
+
+void test_perf( void ) {
+    pu_perf_counters_t pCounters[4];
+    pthread_t          pid;
+
+    std::cout << "Performance counters" << std::endl;
+    int iResult = pu_perf_read(&pCounters[0]);
+    assert(0 != iResult);
+    iResult = pu_perf_register("main");
+    assert(0 != iResult);
+    iResult = pu_perf_enable(PU_PERF_ALL);
+    assert(0 == iResult);
+
+    // Another thread reads them while the owner is alive
+    pid = PU_THREAD_CREATE(perf_sleep_thread, NULL, 0);
+    while (!__atomic_load_n(&bPerfRead, __ATOMIC_ACQUIRE)) {
+        usleep(1000);
+    }
+    size_t uiThreads = pu_perf_read_all(pCounters, 4);
+    assert(((0 == uiPerfValid) ? 0U : 1U) == uiThreads);
+    if (uiThreads) {
+        assert(0 == strcmp("perf_sleep_thread", pCounters[0].szName));
+        assert(uiPerfValid == pCounters[0].uiValid);
+        if (uiPerfValid & PU_PERF_MASK(PU_PERF_CONTEXT_SWITCHES)) {
+            assert(pCounters[0].pValues[PU_PERF_CONTEXT_SWITCHES] >= PERF_SLEEPS);
+        }
+    }
+    __atomic_store_n(&bPerfDone, 1, __ATOMIC_RELEASE);
+    pthread_join(pid, NULL);
+    uiThreads = pu_perf_read_all(pCounters, 4);
+    assert(0 == uiThreads);
+    iResult = pu_perf_enable(0);
+    assert(0 == iResult);
+    UNUSED(iResult);
+}
+
+// Tracer: thread, timer and mutex events end up in the JSON, a full buffer drops
+pthread_mutex_t mtxTraced;
+
+void* trace_lock_thread( void* pArg ) {
+    UNUSED(pArg);
+    int iResult = pu_mutex_lock(&mtxTraced);
+    assert(0 == iResult);
+    iResult = pu_mutex_unlock(&mtxTraced);
+    assert(0 == iResult);
+    UNUSED(iResult);
+    return (NULL);
+}
+
+void* trace_flood_thread( void* pArg ) {
+    UNUSED(pArg);
+    for (int i = 0; i < 10; i++) {
+        PU_TRACE_INSTANT("test", "flood", i);
+    }
+    return (NULL);
+}
+
+std::string trace_json( void ) {
+    char*  szJson   = NULL;
+    size_t uiLength = 0;
+    FILE*  pFile    = open_memstream(&szJson, &uiLength);
+    assert(pFile);
+    int iResult = pu_trace_write_json(pFile);
+    assert(0 == iResult);
+    UNUSED(iResult);
+    fclose(pFile);
+    std::string strJson(szJson);
+    free(szJson);
+    return (strJson);
+}
+
+void test_trace( void ) {
+    pu_mutex_attr_t stAttr = PU_MUTEX_ATTR_INITIALIZER(PU_MUTEX_ATTR_PROFILE);
+    pthread_t       pid;
+    size_t          uiDropped;
+
+    std::cout << "Event tracer" << std::endl;
+    int iResult = pu_trace_stop();
+    assert(0 != iResult);
+    iResult = pu_mutex_create_attr(&mtxTraced, PU_MUTEX_TYPE_FAST, &stAttr);
+    assert(0 == iResult);
+    putimer_hnd_t hndTmr = putimer_create(PUTIMER_TYPE_SINGLESHOT, timer_stub_callback, 5, NULL);
+    assert(NULL != hndTmr);
+
+    // Nothing is recorded while stopped
+    PU_TRACE_INSTANT("test", "stopped", 1);
+    iResult = pu_trace_reset();
+    assert(0 == iResult);
+    std::string strJson = trace_json();
+    assert(std::string::npos == strJson.find("\"stopped\""));
+
+    iResult = pu_trace_start(0);
+    assert(0 == iResult);
+    iResult = pu_trace_start(0);
+    assert(0 != iResult);
+    iResult = pu_trace_reset();
+    assert(0 != iResult);
+    pu_trace_name_thread("main");
+    PU_TRACE_BEGIN("test", "span");
+    iResult = pu_mutex_lock(&mtxTraced);
+    assert(0 == iResult);
+    pid = PU_THREAD_CREATE(trace_lock_thread, NULL, 0);
+    usleep(20*1000);
+    iResult = pu_mutex_unlock(&mtxTraced);
+    assert(0 == iResult);
+    pthread_join(pid, NULL);
+    putimer_start(hndTmr);
+    usleep(50*1000);
+    PU_TRACE_END("test", "span");
+    iResult = pu_trace_stop();
+    assert(0 == iResult);
+
+    strJson = trace_json();
+    assert(0 == strJson.compare(0, 2, "{\""));
+    assert(std::string::npos != strJson.find("\"name\":\"main\""));
+    assert(std::string::npos != strJson.find("\"cat\":\"thread_create\",\"name\":\"trace_lock_thread\""));
+    assert(std::string::npos != strJson.find("\"cat\":\"thread_exit\",\"name\":\"trace_lock_thread\""));
+    assert(std::string::npos != strJson.find("\"name\":\"timer arm\""));
+    assert(std::string::npos != strJson.find("\"name\":\"timer fire\""));
+    assert(std::string::npos != strJson.find("\"ph\":\"X\",\"cat\":\"timer\",\"name\":\"timer callback\""));
+    assert(std::string::npos != strJson.find(std::string("\"ph\":\"X\",\"cat\":\"mutex\",\"name\":\"") + stAttr.szLabel));
+    assert(std::string::npos != strJson.find("\"ph\":\"B\",\"cat\":\"test\""));
+    assert(std::string::npos != strJson.find("\"ph\":\"E\",\"cat\":\"test\""));
+    uiDropped = pu_trace_dropped();
+    assert(0 == uiDropped);
+
+    // Small buffers: the thread that has one keeps it, a new thread gets a small one
+    iResult = pu_trace_reset();
+    assert(0 == iResult);
+    iResult = pu_trace_start(4);
+    assert(0 == iResult);
+    for (int i = 0; i < 10; i++) {
+        PU_TRACE_INSTANT("test", "flood", i);
+    }
+    uiDropped = pu_trace_dropped();
+    assert(0 == uiDropped);
+    pid = PU_THREAD_CREATE(trace_flood_thread, NULL, 0);
+    pthread_join(pid, NULL);
+    iResult = pu_trace_stop();
+    assert(0 == iResult);
+    uiDropped = pu_trace_dropped();
+    assert(7 == uiDropped); // 10 + the exit, into 4
+    iResult = pu_trace_reset();
+    assert(0 == iResult);
+    uiDropped = pu_trace_dropped();
+    assert(0 == uiDropped);
+    strJson = trace_json();
+    assert(std::string::npos == strJson.find("\"flood\""));
+
+    putimer_delete(hndTmr);
+    pu_mutex_destroy(&mtxTraced);
+    UNUSED(iResult);
+    UNUSED(uiDropped);
+}
+
+// EBR: readers check an object is still live while a writer keeps replacing and retiring it
+#define EBR_LIVE    (0x4c495645)
+#define EBR_DEAD    (0x44454144)
+#define EBR_UPDATES (20000)
+
+struct ebr_obj_t {
+    pu_ebr_node_t stNode;
+    unsigned int  uiMagic;
+    size_t        uiValue;
+};
+
+ebr_obj_t* pEbrShared = NULL;
+size_t     uiEbrFreed = 0;
+int        bEbrDone   = 0;
+
+void ebr_obj_free( pu_ebr_node_t* pNode ) {
+    ebr_obj_t* pObj = (ebr_obj_t*)((char*)pNode - offsetof(ebr_obj_t, stNode));
+    pObj->uiMagic = EBR_DEAD;
+    delete pObj;
+    __atomic_fetch_add(&uiEbrFreed, 1, __ATOMIC_RELAXED);
+}
+
+void* ebr_reader_thread( void* pArg ) {
+    UNUSED(pArg);
+    size_t uiLast = 0;
+    while (!__atomic_load_n(&bEbrDone, __ATOMIC_ACQUIRE)) {
+        pu::ebr_guard guard;
+        ebr_obj_t* pObj = __atomic_load_n(&pEbrShared, __ATOMIC_ACQUIRE);
+        assert(EBR_LIVE == pObj->uiMagic);
+        assert(pObj->uiValue >= uiLast);
+        uiLast = pObj->uiValue;
+    }
+    UNUSED(uiLast);
+    return (NULL);
+}
+
+void* ebr_writer_thread( void* pArg ) {
+    UNUSED(pArg);
+    for (size_t i = 1; i <= EBR_UPDATES; i++) {
+        ebr_obj_t* pNew = new ebr_obj_t;
+        pNew->uiMagic = EBR_LIVE;
+        pNew->uiValue = i;
+        ebr_obj_t* pOld = __atomic_exchange_n(&pEbrShared, pNew, __ATOMIC_ACQ_REL);
+        pu_ebr_retire(&(pOld->stNode), ebr_obj_free);
+        if (0 == (i % 1000)) {
+            pu_ebr_quiescent();
+            sched_yield();
+        }
+    }
+    __atomic_store_n(&bEbrDone, 1, __ATOMIC_RELEASE);
+    return (NULL);
+}
+
+void test_ebr( void ) {
+    pthread_t pThreads[4];
+
+    std::cout << "Epoch based reclamation" << std::endl;
+    pEbrShared = new ebr_obj_t;
+    pEbrShared->uiMagic = EBR_LIVE;
+    pEbrShared->uiValue = 0;
+    for (size_t i = 0; i < 3; i++) {
+        pThreads[i] = PU_THREAD_CREATE(ebr_reader_thread, NULL, 0);
+    }
+    pThreads[3] = PU_THREAD_CREATE(ebr_writer_thread, NULL, 0);
+    for (size_t i = 0; i < 4; i++) {
+        pthread_join(pThreads[i], NULL);
+    }
+
+    // The writer has exited, the barrier frees what it left behind
+    pu_ebr_barrier();
+    assert(EBR_UPDATES == uiEbrFreed);
+
+    // main is not a pu thread, it registers itself. Sections nest.
+    int iResult = pu_ebr_register();
+    assert(0 == iResult);
+    pu_ebr_enter();
+    pu_ebr_enter();
+    pu_ebr_exit();
+    pu_ebr_exit();
+    pu_ebr_retire(&(pEbrShared->stNode), ebr_obj_free);
+    pEbrShared = NULL;
+    pu_ebr_barrier();
+    assert((EBR_UPDATES + 1) == uiEbrFreed);
+    pu_ebr_unregister();
+    UNUSED(iResult);
+}
+
+// Hazard pointers: same pattern, plus a stalled reader that must not stop reclamation
+struct hazard_obj_t {
+    pu_hazard_node_t stNode;
+    unsigned int     uiMagic;
+    size_t           uiValue;
+};
+
+hazard_obj_t* pHazardShared = NULL;
+size_t        uiHazardFreed = 0;
+int           bHazardDone   = 0;
+
+void hazard_obj_free( void* pObj ) {
+    ((hazard_obj_t*)pObj)->uiMagic = EBR_DEAD;
+    delete (hazard_obj_t*)pObj;
+    __atomic_fetch_add(&uiHazardFreed, 1, __ATOMIC_RELAXED);
+}
+
+void* hazard_reader_thread( void* pArg ) {
+    UNUSED(pArg);
+    size_t uiLast = 0;
+    while (!__atomic_load_n(&bHazardDone, __ATOMIC_ACQUIRE)) {
+        pu::hazard_ptr<hazard_obj_t> pObj(0, &pHazardShared);
+        assert(EBR_LIVE == pObj->uiMagic);
+        assert(pObj->uiValue >= uiLast);
+        uiLast = pObj->uiValue;
+    }
+    UNUSED(uiLast);
+    return (NULL);
+}
+
+void test_hazard( void ) {
+    pthread_t pThreads[3];
+
+    std::cout << "Hazard pointers" << std::endl;
+    int iResult = pu_hazard_register();
+    assert(0 == iResult);
+    pHazardShared = new hazard_obj_t;
+    pHazardShared->uiMagic = EBR_LIVE;
+    pHazardShared->uiValue = 0;
+
+    // main holds the first object for the whole test, like a reader blocked for a long time
+    hazard_obj_t* pStalled = (hazard_obj_t*)pu_hazard_protect(1, (void* const*)&pHazardShared);
+    for (size_t i = 0; i < 3; i++) {
+        pThreads[i] = PU_THREAD_CREATE(hazard_reader_thread, NULL, 0);
+    }
+    for (size_t i = 1; i <= EBR_UPDATES; i++) {
+        hazard_obj_t* pNew = new hazard_obj_t;
+        pNew->uiMagic = EBR_LIVE;
+        pNew->uiValue = i;
+        hazard_obj_t* pOld = __atomic_exchange_n(&pHazardShared, pNew, __ATOMIC_ACQ_REL);
+        pu_hazard_retire(&(pOld->stNode), pOld, hazard_obj_free);
+        if (0 == (i % 1000)) {
+            sched_yield();
+        }
+    }
+    __atomic_store_n(&bHazardDone, 1, __ATOMIC_RELEASE);
+    for (size_t i = 0; i < 3; i++) {
+        pthread_join(pThreads[i], NULL);
+    }
+
+    // Garbage stays bounded, whatever the stalled slot
+    pu_hazard_scan();
+    assert(EBR_UPDATES - 1 == uiHazardFreed);
+    assert(EBR_LIVE == pStalled->uiMagic);
+    pu_hazard_clear(1);
+    pu_hazard_flush();
+    assert(EBR_UPDATES == uiHazardFreed);
+
+    pu_hazard_retire(&(pHazardShared->stNode), pHazardShared, hazard_obj_free);
+    pHazardShared = NULL;
+    pu_hazard_unregister();
+    pu_hazard_flush();
+    assert((EBR_UPDATES + 1) == uiHazardFreed);
+    UNUSED(iResult);
+    UNUSED(pStalled);
+}
+
+// Futures: continuations on a pool, combinators, timeouts and broken promises
+int future_add_one( void* pValue, int iError, void* pArg, void** ppResult ) {
+    UNUSED(pArg);
+    *ppResult = (void*)((uintptr_t)pValue + 1);
+    return (iError);
+}
+
+void* future_producer_thread( void* pArg ) {
+    pu_promise_t* pPromise = (pu_promise_t*)pArg;
+    usleep(1000);
+    int iResult = pu_promise_set_value(pPromise, (void*)40);
+    assert(0 == iResult);
+    UNUSED(iResult);
+    return (NULL);
+}
+
+void test_future( void ) {
+    pu_executor_pool_t stPool;
+    pu_promise_t       prmA;
+    pu_promise_t       prmB;
+    pu_future_t        futA;
+    pu_future_t        futB;
+    void*              pValue = NULL;
+
+    std::cout << "Futures" << std::endl;
+    int iResult = pu_executor_pool_create(&stPool, 2, 16, "future_pool");
+    assert(0 == iResult);
+
+    // Two steps on the pool, completed from another thread
+    iResult = pu_promise_create(&prmA, &futA);
+    assert(0 == iResult);
+    pu_future_t futStep1 = pu_future_then(futA, &(stPool.stExec), future_add_one, NULL);
+    pu_future_t futStep2 = pu_future_then(futStep1, &(stPool.stExec), future_add_one, NULL);
+    iResult = pu_future_is_ready(futStep2);
+    assert(0 == iResult);
+    pthread_t pid = PU_THREAD_CREATE(future_producer_thread, &prmA, 0);
+    iResult = pu_future_get(futStep2, &pValue, PU_FUTURE_WAIT_FOREVER);
+    assert(0 == iResult);
+    assert((void*)42 == pValue);
+    pthread_join(pid, NULL);
+
+    // Attached after completion: runs straight away
+    pu_future_t futLate = pu_future_then(futA, pu_executor_inline(), future_add_one, NULL);
+    iResult = pu_future_is_ready(futLate);
+    assert(0 != iResult);
+    pu_future_release(futLate);
+    pu_future_release(futStep2);
+    pu_future_release(futStep1);
+    pu_future_release(futA);
+
+    // when_all reports the first failure, when_any the first input to complete
+    iResult = pu_promise_create(&prmA, &futA);
+    assert(0 == iResult);
+    iResult = pu_promise_create(&prmB, &futB);
+    assert(0 == iResult);
+    pu_future_t pInputs[2] = { futA, futB };
+    pu_future_t futAll = pu_future_when_all(pInputs, 2);
+    pu_future_t futAny = pu_future_when_any(pInputs, 2);
+    iResult = pu_promise_set_value(&prmB, (void*)7);
+    assert(0 == iResult);
+    iResult = pu_future_get(futAny, &pValue, 0);
+    assert(0 == iResult);
+    assert((void*)1 == pValue);
+    iResult = pu_future_wait(futAll, 0);
+    assert(ETIMEDOUT == iResult);
+    pu_promise_release(&prmA);
+    iResult = pu_future_get(futAll, NULL, 0);
+    assert(EPIPE == iResult);
+    pu_future_release(futAll);
+    pu_future_release(futAny);
+    pu_future_release(futA);
+    pu_future_release(futB);
+
+    // Timeouts, through the timer service
+    iResult = pu_promise_create(&prmA, &futA);
+    assert(0 == iResult);
+    iResult = pu_promise_create(&prmB, &futB);
+    assert(0 == iResult);
+    pu_future_t futTmoA = pu_future_timeout(futA, 30);
+    pu_future_t futTmoB = pu_future_timeout(futB, 1000);
+    iResult = pu_promise_set_value(&prmB, (void*)9);
+    assert(0 == iResult);
+    iResult = pu_future_get(futTmoB, &pValue, 0);
+    assert(0 == iResult);
+    assert((void*)9 == pValue);
+    iResult = pu_future_get(futTmoA, NULL, PU_FUTURE_WAIT_FOREVER);
+    assert(ETIMEDOUT == iResult);
+    iResult = pu_future_is_ready(futA);
+    assert(0 == iResult);
+    pu_promise_release(&prmA);
+    pu_future_release(futTmoA);
+    pu_future_release(futTmoB);
+    pu_future_release(futA);
+    pu_future_release(futB);
+
+    // C++
+    pu::promise<int> prmCount;
+    pu::future<int>  futCount = prmCount.get_future();
+    pu::future<double> futHalf = futCount.then<double>(&(stPool.stExec), [](int iCount, int& iError) {
+        UNUSED(iError);
+        return (iCount / 2.0);
+    });
+    iResult = prmCount.set_value(5);
+    assert(0 == iResult);
+    double dHalf = 0.0;
+    iResult = futHalf.get(dHalf);
+    assert(0 == iResult);
+    assert(2.5 == dHalf);
+
+    iResult = pu_executor_pool_destroy(&stPool);
+    assert(0 == iResult);
+    UNUSED(iResult);
+    UNUSED(dHalf);
+}
+
+// Rate limiter: burst, refill, idle time, blocking acquire and sharding
+void test_ratelimit( void ) {
+    pu_ratelimit_t         stLimit;
+    pu_ratelimit_sharded_t stSharded;
+    struct timespec        tsStart;
+    struct timespec        tsEnd;
+
+    std::cout << "Rate limiter" << std::endl;
+
+    // 10 per second: one token per 100ms, so the checks below have plenty of slack
+    int iResult = pu_ratelimit_init(&stLimit, 10, 5);
+    assert(0 == iResult);
+    for (int i = 0; i < 5; i++) {
+        iResult = pu_ratelimit_try_acquire(&stLimit, 1);
+        assert(0 == iResult);
+    }
+    iResult = pu_ratelimit_try_acquire(&stLimit, 1);
+    assert(EAGAIN == iResult);
+    iResult = pu_ratelimit_try_acquire(&stLimit, 6);
+    assert(EINVAL == iResult);
+    iResult = pu_ratelimit_acquire(&stLimit, 1, 0);
+    assert(ETIMEDOUT == iResult);
+
+    // The next token is due 100ms after the bucket was emptied
+    TIME_GET_HW_TICK(tsStart);
+    iResult = pu_ratelimit_acquire(&stLimit, 1, PU_RATELIMIT_WAIT_FOREVER);
+    assert(0 == iResult);
+    TIME_GET_HW_TICK(tsEnd);
+    assert(timespec_a_sub_b_ms(&tsEnd, &tsStart) >= 50);
+
+    // Time spent full earns nothing: after an idle period the burst is still 5
+    usleep(700 * 1000);
+    size_t uiAvailable = pu_ratelimit_available(&stLimit);
+    assert(5 == uiAvailable);
+    iResult = pu_ratelimit_try_acquire(&stLimit, 5);
+    assert(0 == iResult);
+    iResult = pu_ratelimit_try_acquire(&stLimit, 1);
+    assert(EAGAIN == iResult);
+
+    // Sharded: a short bucket borrows from the others
+    iResult = pu_ratelimit_sharded_create(&stSharded, 40, 8, 4);
+    assert(0 == iResult);
+    for (int i = 0; i < 8; i++) {
+        iResult = pu_ratelimit_sharded_try_acquire(&stSharded, 1);
+        assert(0 == iResult);
+    }
+    iResult = pu_ratelimit_sharded_try_acquire(&stSharded, 1);
+    assert(EAGAIN == iResult);
+    iResult = pu_ratelimit_sharded_try_acquire(&stSharded, 3);
+    assert(EINVAL == iResult);
+    iResult = pu_ratelimit_sharded_acquire(&stSharded, 1, 1000);
+    assert(0 == iResult);
+    iResult = pu_ratelimit_sharded_destroy(&stSharded);
+    assert(0 == iResult);
+
+    // Rate and burst below the shard count: fewer buckets, never more than the limit in total
+    iResult = pu_ratelimit_sharded_create(&stSharded, 3, 2, 8);
+    assert(0 == iResult);
+    assert(2 == stSharded.uiShards);
+    for (int i = 0; i < 2; i++) {
+        iResult = pu_ratelimit_sharded_try_acquire(&stSharded, 1);
+        assert(0 == iResult);
+    }
+    iResult = pu_ratelimit_sharded_try_acquire(&stSharded, 1);
+    assert(EAGAIN == iResult);
+    iResult = pu_ratelimit_sharded_destroy(&stSharded);
+    assert(0 == iResult);
+
+    // The remainders are spread, the buckets add up to the rate and the burst
+    iResult = pu_ratelimit_sharded_create(&stSharded, 102, 10, 4);
+    assert(0 == iResult);
+    size_t uiRate  = 0;
+    size_t uiBurst = 0;
+    for (unsigned int i = 0; i < stSharded.uiShards; i++) {
+        uiRate  += (size_t)(1000000000ULL / stSharded.pShards[i].ulNsPerToken);
+        uiBurst += (size_t)stSharded.pShards[i].iBurst;
+    }
+    assert((102 == uiRate) && (10 == uiBurst));
+    for (int i = 0; i < 10; i++) {
+        iResult = pu_ratelimit_sharded_try_acquire(&stSharded, 1);
+        assert(0 == iResult);
+    }
+    iResult = pu_ratelimit_sharded_try_acquire(&stSharded, 1);
+    assert(EAGAIN == iResult);
+    iResult = pu_ratelimit_sharded_destroy(&stSharded);
+    assert(0 == iResult);
+    UNUSED(iResult);
+    UNUSED(uiAvailable);
+    UNUSED(uiRate);
+    UNUSED(uiBurst);
+}
+
+// Reactor: pipe I/O, timers and timed out reads, on the plain and the registered paths
+struct reactor_wait_t {
+    pu_sem_t semDone;
+    int      iResult;
+};
+
+void reactor_done( pu_reactor_op_t* pOp, int iResult ) {
+    reactor_wait_t* pWait = (reactor_wait_t*)pOp->pArg;
+    pWait->iResult = iResult;
+    pu_sem_post(&(pWait->semDone));
+}
+
+int reactor_wait( pu_reactor_t hReactor, pu_reactor_op_t* pOp ) {
+    reactor_wait_t* pWait = (reactor_wait_t*)pOp->pArg;
+    int iResult = pu_reactor_submit(hReactor, pOp);
+    assert(0 == iResult);
+    iResult = pu_sem_wait(&(pWait->semDone));
+    assert(0 == iResult);
+    UNUSED(iResult);
+    return (pWait->iResult);
+}
+
+void test_reactor( pu_reactor_backend_t enBackend ) {
+    pu_reactor_config_t stConfig;
+    pu_reactor_t        hReactor;
+    pu_reactor_op_t     stOp;
+    reactor_wait_t      stWait;
+    struct timespec     tsStart;
+    struct timespec     tsEnd;
+    int                 pPipe[2];
+    char                pBuffer[16];
+    struct iovec        stIov = { pBuffer, sizeof(pBuffer) };
+
+    std::cout << "Reactor: " << ((PU_REACTOR_BACKEND_URING == enBackend) ? "io_uring" : "epoll") << std::endl;
+    int iResult = pipe(pPipe);
+    assert(0 == iResult);
+    memset(&stConfig, 0, sizeof(stConfig));
+    stConfig.enBackend = enBackend;
+    stConfig.piFiles   = &(pPipe[0]);
+    stConfig.uiFiles   = 1;
+    stConfig.pBuffers  = &stIov;
+    stConfig.uiBuffers = 1;
+    if (0 != pu_reactor_create(&hReactor, &stConfig)) {
+        std::cout << "Reactor: backend not available" << std::endl;
+        close(pPipe[0]);
+        close(pPipe[1]);
+        return;
+    }
+    pu_reactor_backend_t enActual = pu_reactor_backend(hReactor);
+    assert(enBackend == enActual);
+    pu_sem_create(&(stWait.semDone), 0, 0);
+
+    // Readiness, then a plain read
+    ssize_t iBytes = write(pPipe[1], "hello", 5);
+    assert(5 == iBytes);
+    pu_reactor_prep_poll(&stOp, pPipe[0], POLLIN, reactor_done, &stWait);
+    iResult = reactor_wait(hReactor, &stOp);
+    assert(0 != (POLLIN & iResult));
+    pu_reactor_prep_read(&stOp, pPipe[0], pBuffer, sizeof(pBuffer), PU_REACTOR_OFFSET_NONE, reactor_done, &stWait);
+    iResult = reactor_wait(hReactor, &stOp);
+    assert(5 == iResult);
+    assert(0 == memcmp(pBuffer, "hello", 5));
+
+    // Registered file and buffer
+    iBytes = write(pPipe[1], "abc", 3);
+    assert(3 == iBytes);
+    pu_reactor_prep_read(&stOp, 0, pBuffer, sizeof(pBuffer), PU_REACTOR_OFFSET_NONE, reactor_done, &stWait);
+    stOp.uiFlags = PU_REACTOR_FLAG_FIXED_FILE | PU_REACTOR_FLAG_FIXED_BUF;
+    iResult = reactor_wait(hReactor, &stOp);
+    assert(3 == iResult);
+    assert(0 == memcmp(pBuffer, "abc", 3));
+
+    // Timer
+    TIME_GET_HW_TICK(tsStart);
+    pu_reactor_prep_timeout(&stOp, 20, reactor_done, &stWait);
+    iResult = reactor_wait(hReactor, &stOp);
+    assert(0 == iResult);
+    TIME_GET_HW_TICK(tsEnd);
+    assert(timespec_a_sub_b_ms(&tsEnd, &tsStart) >= 20);
+
+    // Read with a timeout on an empty pipe, then the write side
+    pu_reactor_prep_read(&stOp, pPipe[0], pBuffer, sizeof(pBuffer), PU_REACTOR_OFFSET_NONE, reactor_done, &stWait);
+    stOp.uiTimeoutMs = 20;
+    iResult = reactor_wait(hReactor, &stOp);
+    assert(-ETIMEDOUT == iResult);
+    pu_reactor_prep_write(&stOp, pPipe[1], "xyz", 3, PU_REACTOR_OFFSET_NONE, reactor_done, &stWait);
+    stOp.uiTimeoutMs = 1000;
+    iResult = reactor_wait(hReactor, &stOp);
+    assert(3 == iResult);
+    iBytes = read(pPipe[0], pBuffer, sizeof(pBuffer));
+    assert(3 == iBytes);
+
+    iResult = pu_reactor_destroy(hReactor);
+    assert(0 == iResult);
+    close(pPipe[0]);
+    close(pPipe[1]);
+    UNUSED(iResult);
+    UNUSED(iBytes);
+    UNUSED(enActual);
+}
 } // End anonymous namespace
 
 /****************************************************************************/
@@ -127,6 +1774,39 @@ int main( int argc, char *argv[] )
         std::cout << "Thread exited" << std::endl;
     }
 
+    // Reader-writer locks
+    test_rwlock(PU_RWLOCK_TYPE_WRITER_PREF);
+    test_rwlock(PU_RWLOCK_TYPE_READER_PREF);
+
+    // Sequence lock, and the timer information published with it
+    test_seqlock();
+    test_timer_info();
+    test_timer_object();
+
+    // Lock contention profiling
+    test_mutex_profile();
+
+    // Lock order checking
+    test_lockdep();
+    test_mutex_robust();
+    test_shm();
+    test_futex();
+    test_barrier();
+    test_spinlock();
+    test_queue();
+    test_delayqueue();
+    test_monitor();
+    test_monitor_stop();
+    test_profiler();
+    test_perf();
+    test_trace();
+    test_ebr();
+    test_hazard();
+    test_future();
+    test_ratelimit();
+    test_reactor(PU_REACTOR_BACKEND_URING);
+    test_reactor(PU_REACTOR_BACKEND_EPOLL);
+
     // Test multiple exit
     POSUTILS_EXIT;
     POSUTILS_EXIT;